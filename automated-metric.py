@@ -5,14 +5,20 @@
 #
 
 debugOn = True 
+# Show the log on the LCD as a scrolling console instead of the status screen, in
+# debug too (needs lcd.so, not lcdd)
+lcdConsole = False
 
-from Queue import Queue
 from threading import Thread
 import obd
 import sys
-if debugOn is not True:
+if debugOn is not True or lcdConsole is True:
   sys.path.append('/usr/local/lib/lcd')
-  from lcd import *
+  import os
+  if os.path.exists('/var/run/lcdd.sock'):
+    from lcdc import *  # lcdd owns the panel, draw through it
+  else:
+    from lcd import *
 import psutil
 import time
 import urllib2
@@ -26,11 +32,82 @@ import serial
 import requests
 from datetime import datetime
 from netifaces import interfaces, ifaddresses, AF_INET
+from collections import deque
+from itertools import islice
+sys.path.append('/usr/local/lib/automated')
+try:
+  import spool  # crash-safe on-disk queue of metric records waiting for upload
+except ImportError:
+  spool = None
+try:
+  import gorilla  # compact delta-of-delta / XOR blocks of sweeps for the spool
+except ImportError:
+  gorilla = None
+try:
+  import elm  # native ELM327 client, batches several PIDs per request
+  nativeObd = True
+except ImportError:
+  nativeObd = False
+try:
+  import netmon  # link and address state from netlink events, nothing polled per frame
+  useNetmon = netmon.netStart('/', 60) == 0
+except ImportError:
+  useNetmon = False
+try:
+  import dtcdb  # trouble code descriptions, mapped read only, nothing parsed or allocated
+  useDtc = dtcdb.dtcOpen() == 0
+except ImportError:
+  useDtc = False
 
  
-# Setup Influx Queue
-influxQueue = Queue(maxsize=0)
-num_threads = 5 
+class MemorySpool:
+  # The in-memory JSON queue used before the native spool, for a Pi where
+  # native/compile.sh has not been run: records are lost on a power cut
+  def __init__(self):
+    self.records = deque()
+    self.peeked = 0
+  def spoolOpen(self, path):
+    return 0
+  def spoolPut(self, record):
+    self.records.append(record)
+    return 0
+  def spoolPeek(self, count):
+    records = list(islice(self.records, self.peeked, self.peeked + count))
+    self.peeked += len(records)
+    return records
+  def spoolCommit(self):
+    for i in range(self.peeked):
+      self.records.popleft()
+    self.peeked = 0
+    return 0
+  def spoolRewind(self):
+    self.peeked = 0
+    return 0
+  def spoolStats(self):
+    return {'pending': len(self.records)}
+  def uplOpen(self, url):
+    return -1
+  def actOpen(self, url):
+    return -1
+
+# Setup the metric spool. Records survive crashes and power cuts; the old
+# /opt/influxback text dump is imported once and removed.
+spoolDir = '/opt/spool'
+if spool is None:
+  syslog.syslog('Native spool module not found, run native/compile.sh; queueing metrics in memory as JSON until then')
+  spool = MemorySpool()
+if spool.spoolOpen(spoolDir) != 0:
+  syslog.syslog('Unable to open metric spool at '+spoolDir)
+  sys.exit(1)
+if os.path.isfile('/opt/influxback'):
+  try:
+    with open('/opt/influxback') as f:
+      for line in f:
+        if line.strip() != '':
+          spool.spoolPut(line.strip())
+    os.remove('/opt/influxback')
+  except:
+    syslog.syslog('Failed while importing /opt/influxback into the spool')
 
 # Setting initial global variables
 global engineStatus
@@ -52,11 +129,79 @@ global vehicleKey
 global inAction
 inAction = False
 
+# True while the native ELM327 client holds the port; actions then go out on
+# its open session between metric requests instead of a fresh connection
+global nativeSession
+nativeSession = False
+
+# Stored trouble codes read when the engine started, with what they mean
+global troubleCodes
+troubleCodes = []
+
+# VIN or make name (as in native/dtc_codes.txt, e.g. 'GM') whose own trouble
+# codes are looked up before the generic ones; None takes the VIN from the car
+dtcVehicle = None
+
+# Seconds between LCD driver stat dumps to the log, 0 disables
+lcdStatsInterval = 300
+
+# Mirror the LCD to lcdview (pcd8544/cpu_show) for support, as a socket path or
+# 'host:port' the viewer listens on, and the most frames a second sent; None is off.
+# With lcdd owning the panel give it -R instead.
+lcdMirror = None
+lcdMirrorFps = 2
+
+# Send LCD frames from a SCHED_FIFO thread pinned to this core (-1 any), so upload
+# and OBD threads cannot stretch a byte mid frame; None is off. Needs root, and
+# locks the whole script into memory. With lcdd owning the panel give it -T instead.
+lcdRealtimeCpu = None
+lcdRealtimePriority = 50
+
+# Seconds between metric sweeps with the native ELM327 client (python-obd sweeps every 5).
+# Each PID is polled at its own rate meanwhile (RPM/SPEED/THROTTLE_POS 5Hz, trims 1Hz,
+# temperatures and levels every 5s, distances and status every 20s) and the sweep
+# carries the latest value of every PID polled since the last one.
+nativeSampleInterval = 1
+
+# Overrides for the native scheduler as (name, hz, priority), priority 0 is polled first
+nativePidRates = []
+
+# Sweeps held in memory and spooled together as one compressed block when
+# uploading line protocol (a power cut loses at most this many)
+metricBlockSweeps = 12
+metricBlock = []
+
+# Seconds per window summary (count/min/max/mean/last/p95 of every value polled)
+# shipped instead of raw sweeps when uploading line protocol with the native
+# client, and (name, [seconds]) overrides for single PIDs. Raw sweeps then stay
+# on the device in rawSpoolDir. An empty rollupWindows with no overrides ships raw.
+rollupWindows = [60]
+rollupPidWindows = [('RPM', [10, 60]), ('SPEED', [10, 60]), ('THROTTLE_POS', [10, 60]),
+                    ('ENGINE_LOAD', [10, 60]), ('MAF', [10, 60])]
+rawSpoolDir = '/opt/spool-raw'
+useRollups = False
+lastStrings = {}
+
+# Publish the latest value of every PID on the shared memory metric bus for the
+# LCD dashboard (pcd8544/cpu_show/lcddash), needs the native client module
+useBus = False
+
 def outLog(logLine):
   if debugOn is True:
     print(logLine)
   else:
     syslog.syslog(logLine)
+  if lcdConsole is True and 'lcdTermWrite' in globals():
+    lcdTermWrite(logLine+'\n')  # shown by the display thread's next flush
+
+# Metric records go out as JSON, one POST each, unless an influxurl is configured,
+# then as gzipped line protocol batches by the native uploader
+influxUrl = None
+# Remote actions are pulled every 20s unless an actionurl is configured, then long-polled
+actionUrl = None
+# Adapter port, found by scanning unless an elmport is configured (a recorder's or a
+# replay's pty, see native/README.txt)
+elmPort = None
 
 # Checking if a config file exists, if it doesn't, then create one and fill it.
 configFile = '/etc/uhacknect.conf'
@@ -64,6 +209,15 @@ if os.path.isfile(configFile):
     Config = ConfigParser.ConfigParser()
     Config.read(configFile)
     vehicleKey = Config.get('config', 'vehiclekey')
+    # Optional line protocol write endpoint, e.g. https://host:8086/write?db=obd
+    if Config.has_option('config', 'influxurl'):
+      influxUrl = Config.get('config', 'influxurl')
+    # Optional long-poll action endpoint, e.g. https://host/api/actionPoll.php?key=<vehiclekey>
+    if Config.has_option('config', 'actionurl'):
+      actionUrl = Config.get('config', 'actionurl')
+    # Optional fixed adapter port, e.g. /tmp/elm for elmrec or elmsim -R
+    if Config.has_option('config', 'elmport'):
+      elmPort = Config.get('config', 'elmport')
 else:
     outLog('First startup... generating config file')
     vehicleKey = ''.join(random.SystemRandom().choice(string.uppercase + string.digits) for _ in xrange(10))
@@ -78,6 +232,31 @@ else:
         outLog("Failed writing config to "+configFile+".")
     cfgFile.close()
 
+if influxUrl is not None and gorilla is None:
+  outLog('Native gorilla module not found, run native/compile.sh; falling back to JSON uploads')
+  influxUrl = None
+if influxUrl is not None and spool.uplOpen(influxUrl) != 0:
+  outLog('Bad influxurl '+influxUrl+', falling back to JSON uploads')
+  influxUrl = None
+
+# Window summaries need the native client, which sees every value as it is polled
+if influxUrl is not None and nativeObd is True and (len(rollupWindows) > 0 or len(rollupPidWindows) > 0):
+  if spool.rawOpen(rawSpoolDir) == 0:
+    useRollups = True
+  else:
+    outLog('Failed to open '+rawSpoolDir+', uploading raw sweeps')
+
+# The dashboard reads the bus without ever holding up the polling loop
+if nativeObd is True:
+  if elm.elmBus() == 0:
+    useBus = True
+  else:
+    outLog('Failed to open the metric bus, no live dashboard')
+
+if actionUrl is not None and spool.actOpen(actionUrl) != 0:
+  outLog('Bad actionurl '+actionUrl+', falling back to 20s action polls')
+  actionUrl = None
+
 acceptedMetrics = {'03': 'FUEL_STATUS', '04': 'ENGINE_LOAD', '05': 'COOLANT_TEMP', '06': 'SHORT_FUEL_TRIM_1',
                    '07': 'LONG_FUEL_TRIM_1', '08': 'SHORT_FUEL_TRIM_2', '09': 'LONG_FUEL_TRIM_2', '0A': 'FUEL_PRESSURE',
                    '0B': 'INTAKE_PRESSURE', '0C': 'RPM', '0D': 'SPEED', '0E': 'TIMING_ADVANCE', '0F': 'INTAKE_TEMP',
@@ -110,33 +289,90 @@ def ip4_addresses():
       val = null
   return ip_list
 
+# One status row: cleared to the end by the driver where it can lay text out,
+# padded by hand through lcdd
+def lcdLine(y, text):
+  if 'lcdDrawTextLine' in globals():
+    lcdDrawTextLine(0, y, 0, 0, text)
+  else:
+    lcdDisplayText(0, y, text.ljust(14))
+
+# Label on the left, value on the right of the row
+def lcdField(y, label, value):
+  if 'lcdDrawTextLine' in globals():
+    lcdDrawTextLine(0, y, 0, 0, label)
+    lcdDrawTextLine(lcdTextWidth(label), y, 0, 1, value)
+  else:
+    lcdDisplayText(0, y, label+value.rjust(14 - len(label)))
+
+def logLcdStats():
+  stats = lcdStats()
+  frames = max(stats['frames'], 1)
+  hist = ' '.join(str(1 << i)+'us:'+str(count) for i, count in enumerate(stats['flushHistUs']) if count > 0)
+  outLog('LCD stats: frames='+str(stats['frames'])+' bytes='+str(stats['dataBytes'])+' cmds='+str(stats['commands'])+
+         ' skipped='+str(stats['pagesSkipped'])+' gpio='+str(stats['gpioWrites'])+
+         ' raster='+str(stats['rasterNs'] / frames / 1000)+'us/frame xfer='+str(stats['transferNs'] / frames / 1000)+'us/frame'+
+         ' maxflush='+str(stats['maxFlushUs'])+'us hist='+hist)
+  if 'lcdStreamStats' in globals():
+    mirror = lcdStreamStats()
+    if mirror['fps'] > 0:
+      outLog('LCD mirror: sent='+str(mirror['sent'])+' key='+str(mirror['keyFrames'])+' limited='+str(mirror['limited'])+
+             ' dropped='+str(mirror['dropped'])+' bytes/frame='+str(mirror['bytes'] / max(mirror['sent'], 1))+'/504')
+  if 'lcdRealtimeStats' in globals():
+    rt = lcdRealtimeStats()
+    if rt['active']:
+      outLog('LCD realtime: cpu='+str(rt['cpu'])+' prio='+str(rt['priority'])+' sent='+str(rt['frames'])+
+             ' frame p50/p99/max='+str(rt['frameP50Us'])+'/'+str(rt['frameP99Us'])+'/'+str(rt['frameMaxUs'])+'us'+
+             ' byte p50/p99/max='+str(rt['byteP50Ns'])+'/'+str(rt['byteP99Ns'])+'/'+str(rt['byteMaxNs'])+'ns')
+
 def uDisplay():
-  if debugOn is not True:
+  if debugOn is not True or lcdConsole is True:
     initDisplay()
     lcdSetContrast(60)  # Universal contrast value for most lcd's
-    lcdShowLogo()
-    time.sleep(2)
+    lcdShowLogo()  # stays up only until the first status frame below is drawn
+    if lcdMirror is not None and 'lcdStreamStart' in globals():
+      if lcdStreamStart(lcdMirror, lcdMirrorFps) != 0:
+        outLog('LCD mirror: cannot use '+lcdMirror)
+    if lcdRealtimeCpu is not None and 'lcdRealtimeStart' in globals():
+      if lcdRealtimeStart(lcdRealtimeCpu, lcdRealtimePriority) != 0:
+        outLog('LCD realtime: refused on cpu '+str(lcdRealtimeCpu)+', flushing from this thread')
+    if lcdConsole is True:
+      if 'lcdTermStart' in globals() and lcdTermStart(0, 0, 100) == 0:
+        # whatever outLog wrote since the last flush, at most 10 frames a second
+        while True:
+          lcdTermFlush()
+          if 'lcdStreamTick' in globals():
+            lcdStreamTick()  # the mirror's last frame, if its rate limit held it back
+          time.sleep(0.05)
+      outLog('LCD console: not available, showing the status screen')
+    lastStatsLog = time.time()
+    marquee = 'lcdMarqueeInit' in globals() and lcdMarqueeInit(0, 0, 0, 0, 8) == 0
+    codesMarquee = 'lcdMarqueeInit' in globals() and lcdMarqueeInit(1, 0, 40, 0, 8) == 0
+    bootLogged = False
     while True:
       cpuload = psutil.cpu_percent()
       memused = psutil.virtual_memory()
-      rootused = psutil.disk_usage('/')
-      queueSize = influxQueue.qsize()
+      if useNetmon is True:
+        rootused = netmon.netDisk()
+      else:
+        rootused = psutil.disk_usage('/').percent
+      queueSize = spool.spoolStats()['pending']
       # Setting up network/metric stuff
       if networkStatus is False:
-        network = "  Down"
+        network = "Down"
       else:
-        network = "    Up"
+        network = "Up"
       # Setting up Engine text
       if engineStatus is False:
-        engineText = "   Down"
+        engineText = "Down"
       else:
-        engineText = "     Up"
+        engineText = "Up"
   
       # Setting up BT Text
       if portName is None:
-        btStatus = "      Down"
+        btStatus = "Down"
       else:
-        btStatus = "        Up"
+        btStatus = "Up"
 
       # Setup debug
       if debugOn is True:
@@ -144,22 +380,54 @@ def uDisplay():
       else:
         debugMsg = ""
       if networkStatus is True:
-        lcdDisplayText(0, 0, "              ")
         try:
-          lcdDisplayText(0, 0, ip4_addresses()[0])
+          if useNetmon is True:
+            topLine = netmon.netAddress() or "NO IP"
+          else:
+            topLine = ip4_addresses()[0]
         except:
-          lcdDisplayText(0, 0, "NO IP")
+          topLine = "NO IP"
+      else:
+        topLine = "Key:"+vehicleKey
+      # a long address or key scrolls instead of falling off the right edge
+      if marquee:
+        lcdMarqueeText(0, topLine)
       else:
-        lcdDisplayText(0, 0, "Key:"+vehicleKey)
-      lcdDisplayText(0, 8, "OBD:"+btStatus)
-      lcdDisplayText(0, 16, "ENGINE:"+engineText)
-      lcdDisplayText(0, 24, "NETWORK:"+network)
-      lcdDisplayText(0, 32, "              ")
-      lcdDisplayText(0, 32, "CM/:"+str(cpuload).split('.', 1)[0]+" "+str(memused.percent).split('.', 1)[0]+" "+str(rootused.percent).split('.', 1)[0]+"")
-      lcdDisplayText(0, 40, "              ")
-      lcdDisplayText(0, 40, "QT:"+str(queueSize)+ " "+str(metricsSuccess)+" "+debugMsg)
+        lcdLine(0, topLine)
+      lcdField(8, "OBD:", btStatus)
+      lcdField(16, "ENGINE:", engineText)
+      lcdField(24, "NETWORK:", network)
+      lcdLine(32, "CM/:"+str(cpuload).split('.', 1)[0]+" "+str(memused.percent).split('.', 1)[0]+" "+str(rootused).split('.', 1)[0]+"")
+      # stored trouble codes take the bottom row from the queue counts
+      codes = troubleCodes
+      if len(codes) > 0 and codesMarquee:
+        lcdMarqueeText(1, '  '.join(codes))
+      elif len(codes) > 0:
+        lcdLine(40, "DTC:"+codes[0].split(' ', 1)[0]+(" +"+str(len(codes) - 1) if len(codes) > 1 else ""))
+      else:
+        lcdLine(40, "QT:"+str(queueSize)+ " "+str(metricsSuccess)+" "+debugMsg)
       lcdDisplay()
-      time.sleep(0.25)
+      if not bootLogged and 'lcdStats' in globals():
+        stats = lcdStats()
+        outLog('LCD first frame '+str(stats['firstFrameUs'] / 1000)+'ms after start (python up '+str(stats['startUs'] / 1000)+
+               'ms, init '+str(stats['initUs'])+'us)')
+        bootLogged = True
+      if lcdStatsInterval > 0 and 'lcdStats' in globals() and time.time() - lastStatsLog >= lcdStatsInterval:
+        logLcdStats()
+        lastStatsLog = time.time()
+      if marquee:
+        # a pixel every 50ms between refreshes, sending only the marquee's line
+        for step in range(5):
+          changed = lcdMarqueeTick(0, 1)
+          if changed:
+            lcdDisplayRegion(*changed)
+          if len(codes) > 0 and codesMarquee:
+            changed = lcdMarqueeTick(1, 1)
+            if changed:
+              lcdDisplayRegion(*changed)
+          time.sleep(0.05)
+      else:
+        time.sleep(0.25)
 
 # Kick off display thread
 displayThread = Thread(target=uDisplay)
@@ -196,49 +464,170 @@ def callBack():
     else:
       elmCallback = '1'
     global networkStatus
-    try:
-      urllib2.urlopen("https://automated.wreckyour.net/api/callback.php?ping&key="+vehicleKey+"&enginestatus="+engineCallback+"&elmstatus="+elmCallback).read()
-      outLog('Pinging wreckyour.net to let them know we are online')
-      networkStatus = True
-    except:  # Woops, we have no network connection. 
-      outLog('Unable to ping wreckyour.net as the network appears to be down. Trying again')
+    if useNetmon is True:
+      generation = netmon.netGeneration()
+    # No link or no address, no point waiting on a ping to time out
+    if useNetmon is True and netmon.netOnline() == 0:
+      if networkStatus is True:
+        outLog('Network link lost, waiting for it to come back')
       networkStatus = False
-    time.sleep(30)
+    else:
+      try:
+        urllib2.urlopen("https://automated.wreckyour.net/api/callback.php?ping&key="+vehicleKey+"&enginestatus="+engineCallback+"&elmstatus="+elmCallback).read()
+        outLog('Pinging wreckyour.net to let them know we are online')
+        networkStatus = True
+      except:  # Woops, we have no network connection. 
+        outLog('Unable to ping wreckyour.net as the network appears to be down. Trying again')
+        networkStatus = False
+    # A link or address change re-pings at once rather than up to 30s later
+    if useNetmon is True:
+      netmon.netWait(generation, 30)
+    else:
+      time.sleep(30)
 
-def pushInflux(influxQueue):
-  while True:
+def spoolMetrics(metricDic, flush=False):
+  global metricBlock
+  global lastStrings
+  if influxUrl is None:
+    spool.spoolPut(json.dumps(metricDic, default=str))
+    return
+  numbers = {'time': metricDic['time']}
+  strings = {}
+  for metric in metricDic:
+    if metric != 'time':
+      value = getattr(metricDic[metric], 'magnitude', metricDic[metric])  # python-obd values carry units
+      if isinstance(value, (int, long, float)):
+        numbers[metric] = value
+        if useBus is True and nativeSession is False:  # elmPoll() publishes its own
+          elm.elmBusPut(metric, value)
+      else:
+        strings[metric] = str(value)
+  rollups = useRollups is True and nativeSession is True  # python-obd sweeps still ship raw
+  if rollups is True:  # Summaries carry the numbers, strings only go out when they change
+    strings = dict((metric, strings[metric]) for metric in strings if lastStrings.get(metric) != strings[metric])
+    lastStrings.update(strings)
+  if len(strings) > 0:  # Blocks only hold numbers
+    spool.spoolPutRow('obd', {'vehicle': vehicleKey}, strings, metricDic['time'])
+  metricBlock.append(numbers)
+  if flush is True or len(metricBlock) >= metricBlockSweeps:
+    block = gorilla.gorEncode('obd,vehicle='+vehicleKey, metricBlock)
+    if rollups is True:
+      spool.rawPut(block)  # Kept on the device, never uploaded
+    else:
+      spool.spoolPut(block)
+    metricBlock = []
+
+def spoolRollups(flush=False):
+  for windowSecs, start, fields in elm.elmRollups(1 if flush is True else 0):
+    spool.spoolPutRow('obd_rollup', {'vehicle': vehicleKey, 'window': '%gs' % windowSecs}, fields, start)
+
+def pushInflux():
+  global influxStatus
+  global metricsSuccess
+  while influxUrl is not None:
     if networkStatus is True:
-      global influxStatus
-      global metricsSuccess
-      influxQueueGet = influxQueue.get()
-      # Attempt to push, loop over if no network connection
-      try:
-        #outLog("Pushing to Influxdb")
-        headers = {'Content-type': 'application/json'}
-        req = requests.post('https://automated.wreckyour.net/api/influxPush.php?key='+vehicleKey, data=json.dumps(influxQueueGet), headers=headers)
-        influxQueue.task_done()  # If success, skim that off the top of the queue
+      sent = spool.uplPump()  # Sends a batch once it is full or 10s old, retries it in order
+      if sent > 0:
         influxStatus = True
-        metricsSuccess += 1
-      except:  # If we have no network connection. FIX: NEED TO HAVE THIS WRITE TO A FILE AND UPLOAD WHEN AVAILABLE
-        influxQueue.put(influxQueueGet)
-        influxQueue.task_done()  # Have to mark it as done anyway, but we roll it back into the Queue. 
-        outLog('Failed sending metric, Tossing record back into queue and trying again.')
+        metricsSuccess += sent
+      elif sent < 0:
+        stats = spool.uplStats()
+        if stats['lastStatus'] >= 400 and stats['lastStatus'] < 500:
+          outLog('Metric server refused the batch (HTTP '+str(stats['lastStatus'])+'), check the influxurl and its token; leaving it in the spool and trying again.')
+        else:
+          outLog('Failed sending metric batch (HTTP '+str(stats['lastStatus'])+'), leaving it in the spool and trying again.')
         influxStatus = False
-      time.sleep(0.25)
+    time.sleep(0.25)
+  while True:
+    if networkStatus is True:
+      records = spool.spoolPeek(1)
+      # Attempt to push, the record stays in the spool until the server has it
+      if len(records) > 0:
+        try:
+          headers = {'Content-type': 'application/json'}
+          req = requests.post('https://automated.wreckyour.net/api/influxPush.php?key='+vehicleKey, data=records[0], headers=headers)
+          spool.spoolCommit()  # If success, skim that off the top of the spool
+          influxStatus = True
+          metricsSuccess += 1
+        except:  # If we have no network connection, try the same record again
+          spool.spoolRewind()
+          outLog('Failed sending metric, leaving record in the spool and trying again.')
+          influxStatus = False
+    time.sleep(0.25)
 
-def checkCodes(connection):
+def describeCode(code, make):
+  text = None
+  if useDtc is True:
+    text = dtcdb.dtcLookup(code, make)
+    if text is None and dtcdb.dtcManufacturer(code) == 1:
+      text = 'manufacturer specific'
+  return text or 'not known'
+
+# Logs the stored codes with their descriptions and leaves them for the display
+def checkCodes(codes, vin):
+  global troubleCodes
+  if codes is None:
+    outLog('Unable to read trouble codes')
+    return
+  make = 0
+  if useDtc is True:
+    make = max(dtcdb.dtcMake(dtcVehicle or vin or ''), 0)
+  found = []
+  for code in codes:
+    found.append(code+' '+describeCode(code, make))
+    outLog('Trouble code '+found[-1])
+  if len(found) == 0:
+    outLog('No trouble codes stored')
+  troubleCodes = found
+
+# python-obd, before the connection starts watching
+def readCodes(connection):
   outLog('Checking engine for error codes...')
-  obdQuery(connection, 'GET_DTC')
-  readCodes = connection.query(obd.commands.GET_DTC)
-  print readCodes
+  response = connection.query(obd.commands.GET_DTC)
+  if response.is_null():
+    return None
+  return [code for code, desc in response.value]
 
 def getVehicleInfo(connection):
   outLog('Getting vehicle information')
-  obdQuery(connection, 'GET_VIN')
-  vinNum = connection.query(obd.commands.GET_VIN)
-  print vinNum
+  command = getattr(obd.commands, 'VIN', None)  # Mode 09 is only in newer python-obd
+  if command is None:
+    return None
+  response = connection.query(command)
+  if response.is_null():
+    return None
+  return str(response.value)
+
+# Mode 09 PID 02 on the native session, headers on and no spaces, from the
+# engine ECU: 7E8 10 14 49 02 01 and the 17 characters over ISO-TP frames
+def nativeVin():
+  reply = elm.elmCommand('0902')
+  payload = ''
+  if reply is None:
+    return None
+  for line in reply.split():
+    if len(line) < 5 or line[:3] != '7E8':
+      continue
+    try:
+      data = line[3:].decode('hex')
+    except TypeError:
+      continue
+    pci = ord(data[0]) >> 4
+    if pci == 0:
+      payload = data[1:1 + ord(data[0])]
+    elif pci == 1:
+      payload = data[2:]
+    elif pci == 2:
+      payload += data[1:]
+  if payload[:3] != '\x49\x02\x01':
+    return None
+  return payload[3:20]
 
 def pushAction(action, portName):
+  if nativeSession is True:  # Adapter modes are already set, only protocol and header go out if needed
+    raw = elm.elmAction('STP31', 'ATSH1C0', action)
+    outLog("Output: "+str(raw))
+    return raw is not None and 'NO DATA' in raw
   s = serial.Serial(port=portName, baudrate=115200, timeout=1)
   s.flushInput()
   for writeData in ['ATZ', 'ATE0', 'ATH1', 'ATL0', 'STP31', 'ATSH1C0', action]:
@@ -253,7 +642,60 @@ def pushAction(action, portName):
   else:
     return False
 
+actionCodes = {'start': '69AA37901100', 'stop': '6AAA37901100', 'unlock': '24746C901100', 'lock': '21746C901100'}
+
+def runAction(action):
+  # True once the vehicle took the action, False if it failed, None if it can't be done now
+  if action == 'start' and engineStatus is False:
+    outLog('Remote action found... Starting vehicle')
+  elif action == 'stop' and engineStatus is True:
+    outLog('Remote action found... Stopping vehicle')
+  elif action == 'unlock' and engineStatus is False:
+    outLog('Remote action found... Unlocking vehicle')
+  elif action == 'lock' and engineStatus is False:
+    outLog('Remote action found... Locking vehicle')
+  else:
+    outLog('Cant perform action for one reason or another')
+    return None
+  return pushAction(actionCodes[action], portName)
+
+def pollActions():
+  # Long-polls actionurl: the server holds the request until an action is queued,
+  # so it runs within a round trip instead of at the next 20s poll. Results go
+  # back with the following poll; a refused action is reported failed so it is
+  # not handed out again and again.
+  global inAction
+  while True:
+    if portName is None or networkStatus is False:
+      time.sleep(1)
+      continue
+    reply = spool.actPoll()  # Blocks while the server holds the poll, backs off by itself on errors
+    if not reply:
+      continue
+    try:
+      data = json.loads(reply)
+    except ValueError:
+      outLog('Bad reply from the action server')
+      continue
+    for actions in data:
+      actionId = str(actions.get('id', ''))
+      if spool.actSeen(actionId) == 1:  # Already done, the acknowledgement is on its way
+        continue
+      if nativeSession is False:  # python-obd has to let go of the port first
+        inAction = True
+        time.sleep(2)
+      returnOut = runAction(actions.get('action'))
+      inAction = False
+      if returnOut is True:
+        outLog('Marked action as performed')
+      else:
+        outLog('Action '+actionId+' not performed')
+      if spool.actAck(actionId, 1 if returnOut is True else 0) != 0:
+        outLog('Bad action id '+actionId)
+
 def getActions():
+  if actionUrl is not None:
+    pollActions()
   while True:
     if portName is not None:
       while networkStatus is True:
@@ -264,22 +706,10 @@ def getActions():
           try:  # Attempt to push, loop over if no network connection
             for actions in data:
               global inAction
-              inAction = True
-              time.sleep(2)
-              if actions['action'] == 'start' and engineStatus is False:
-                outLog('Remote action found... Starting vehicle')
-                returnOut = pushAction('69AA37901100', portName)
-              elif actions['action'] == 'stop' and engineStatus is True:
-                outLog('Remote action found... Stopping vehicle')
-                returnOut = pushAction('6AAA37901100', portName)
-              elif actions['action'] == 'unlock' and engineStatus is False:
-                outLog('Remote action found... Unlocking vehicle')
-                returnOut = pushAction('24746C901100', portName)
-              elif actions['action'] == 'lock' and engineStatus is False:
-                outLog('Remote action found... Locking vehicle')
-                returnOut = pushAction('21746C901100', portName)
-              else:
-                outLog('Cant perform action for one reason or another')
+              if nativeSession is False:  # python-obd has to let go of the port first
+                inAction = True
+                time.sleep(2)
+              returnOut = runAction(actions['action'])
             if returnOut is True:
               try:
                 actionCallbackUrl = "https://automated.wreckyour.net/api/actionPull.php?key="+vehicleKey+"&id="+actions['id']
@@ -297,15 +727,83 @@ def getActions():
           outLog('No actions to perform')
         time.sleep(20)
 
+def nativeMain():
+  # Runs on the native session until the adapter stops answering. The session
+  # outlives engine runs, so remote actions never wait for a reset.
+  global engineStatus
+  while True:
+    while engineStatus is False:
+      rpm = None
+      if len(elm.elmSupported()) > 0 or elm.elmInit() == 0:  # Protocol search only until an ECU has answered
+        rpm = elm.elmQuery(['RPM']).get('RPM')
+      outLog('Engine RPM: '+str(rpm))
+      if rpm is not None:
+        engineStatus = True
+      elif elm.elmCommand('ATRV') is None:
+        outLog('ELM327 stopped answering, reconnecting')
+        return
+      else:
+        outLog('Engine is not running, checking again')
+        time.sleep(5)
+    outLog('Engine is started. Kicking off metrics loop..')
+    checkCodes(elm.elmCodes(), nativeVin())
+    metricsArray = [metric for metric in elm.elmSupported() if metric in acceptedMetrics.values()]
+    elm.elmSchedule(metricsArray + nativePidRates)
+    outLog('Native ELM327 client polling '+str(len(metricsArray))+' metrics')
+    if useRollups is True:
+      elm.elmRollup(metricsArray + rollupPidWindows, rollupWindows)
+    while engineStatus is True:
+      metricDic = elm.elmPoll(nativeSampleInterval)  # Runs the per-PID schedule for one interval
+      metricDic.update({'time': time.time()})
+      if metricDic.get('RPM') is None:  # Dump if RPM is none
+        outLog("Engine has stopped. Dropping update")
+        rpmStats = elm.elmScheduleStats().get('RPM')
+        if rpmStats is not None:
+          outLog('RPM polled at %.1fHz, jitter %.0fms, %d deadlines missed' % (rpmStats['achievedHz'], rpmStats['jitterMs'], rpmStats['missed']))
+        for metric in metricDic:
+          if metric != 'time':
+            metricDic.update({metric: 0})
+        spoolMetrics(metricDic, True)  # Engine is off, spool the partial block now
+        if useRollups is True:
+          spoolRollups(True)  # And the windows still open
+        engineStatus = False
+      else:
+        spoolMetrics(metricDic)  # Dump metrics to the upload spool
+        if useRollups is True:
+          spoolRollups()
+
 def mainFunction():
   global engineStatus
   global portName
+  global nativeSession
   scanPort = []
-  scanPort = obd.scan_serial()
+  if elmPort is not None:
+    scanPort = [elmPort]
+  else:
+    scanPort = obd.scan_serial()
   while True:
+    if inAction is False and nativeObd is True:
+      if debugOn is True:
+        nativePort = elmPort or '/dev/serial0'
+      else:
+        while len(scanPort) == 0:
+          outLog('No valid device found. Please ensure ELM327 is connected and on. Looping with 5 seconds pause')
+          scanPort = obd.scan_serial()
+          time.sleep(2)
+        nativePort = scanPort[0]
+      if elm.elmOpen(nativePort, 115200) == 0 and elm.elmStart() == 0:
+        portName = nativePort
+        nativeSession = True
+        outLog('Native ELM327 session open on '+portName)
+        nativeMain()
+        nativeSession = False
+        elm.elmClose()
+        continue
+      outLog('Native ELM327 client failed to start, falling back to python-obd')
+      elm.elmClose()
     if inAction is False:
       if debugOn is True:
-        portName = '/dev/serial0'
+        portName = elmPort or '/dev/serial0'
         connection = obd.Async(portName)
       else:
         while len(scanPort) == 0:
@@ -338,22 +836,10 @@ def mainFunction():
       if engineStatus is True:
         connection = obd.Async(portName)
         outLog('Engine is started. Kicking off metrics loop..')
+        checkCodes(readCodes(connection), getVehicleInfo(connection))
         metricsArray = obdWatch(connection, acceptedMetrics)  # Watch all metrics
         connection.start()  # Start async calls now that we're watching PID's
         time.sleep(5)  # Wait for first metrics to come in.
-        if os.path.isfile('/opt/influxback'):  # Check for backup file and push it into the queue for upload.
-          outLog('Old metric data file found... Processing')
-          try:
-            with open('/opt/influxback') as f:
-              lines = f.readlines()
-            for line in lines:
-              outLog('Save data found importing...')
-              influxQueue.put(line)
-            os.remove('/opt/influxback')  # Kill file after we've dumped them all in the backup. 
-            outLog('Imported old metric data.')
-          except:
-            outLog('Failed while importing old queue')
-
         while engineStatus is True:
           metricDic = {}
           currentTime = time.time()
@@ -368,21 +854,12 @@ def mainFunction():
             for metric in metricDic:
               if metric != 'time':
                 metricDic.update({metric: 0})
-            influxQueue.put(json.dumps(metricDic))
+            spoolMetrics(metricDic, True)  # Engine is off, spool the partial block now
             engineStatus = False  # Kill while above
-            if influxQueue.qsize() > 0 and networkStatus is False:
-              outLog('Engine off and network down. Saving queue to file.')
-              try:
-                backupFile = open('/opt/influxback', 'w')
-                while influxQueue.qsize() > 0:
-                  backupFile.write(influxQueue.get()+"\r\n")
-                  influxQueue.task_done()
-              except:
-                outLog('Failed writing queue to file.')
             break  # break from FOR if engine is no longer running
           else: 
             engineStatus = True  # Stay in While
-          influxQueue.put(metricDic)  # Dump metrics to influx queue
+          spoolMetrics(metricDic)  # Dump metrics to the upload spool
           time.sleep(5)
     else:
       if engineStatus is True:
@@ -390,11 +867,10 @@ def mainFunction():
       outLog("Skipping metrics and engine check because an action is running")
       time.sleep(5)    
 
-# Kick off influx threads
-for i in range(num_threads):
-  influxThread = Thread(target=pushInflux, args=(influxQueue,))
-  influxThread.setDaemon(True)
-  influxThread.start()
+# Kick off influx thread, a single reader keeps the spool in order
+influxThread = Thread(target=pushInflux)
+influxThread.setDaemon(True)
+influxThread.start()
 
 # Kick off callback thread
 callbackThread = Thread(target=callBack)
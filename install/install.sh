@@ -54,12 +54,13 @@ EOT
 chmod 755 /etc/init.d/vncboot
 update-rc.d -f lightdm remove
 update-rc.d vncboot defaults
+sed -i -e '$i \/opt/auto-mated/pcd8544/cpu_show/lcdd -S 300\n' /etc/rc.local
 sed -i -e '$i \/opt/auto-mated/automated-metric.py &\n' /etc/rc.local
 { crontab -l -u root; echo '* * * * * /opt/auto-mated/bluetooth_search.sh'; } | crontab -u root -
 sudo apt-get install git-core -y
 sudo apt-get update -y
 sudo apt-get upgrade -y
-apt-get install --no-install-recommends bluetooth htop python-dev python-pip -y
+apt-get install --no-install-recommends bluetooth htop python-dev python-pip libssl-dev zlib1g-dev -y
 service bluetooth start
 service bluetooth status
 hcitool scan
@@ -71,4 +72,7 @@ git pull origin
 cd /opt/auto-mated/pcd8544/cpu_show/
 chmod +x compile.sh
 ./compile.sh
+cd /opt/auto-mated/native/
+chmod +x compile.sh
+./compile.sh
 pip install obd psutil netifaces
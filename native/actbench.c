@@ -0,0 +1,370 @@
+/*
+=================================================================================
+ Name        : actbench.c
+ Version     : 0.1
+
+ Description : Latency of remote actions (lock, unlock, start, stop frames) from
+     the moment one is picked up to the adapter's reply, three ways:
+       - the way pushAction() in automated-metric.py does it, a fresh port,
+         ATZ and six setup commands 250 ms apart, then the frame,
+       - a fresh session per action that waits for each prompt instead,
+       - the persistent session, where actions arrive at random moments while
+         the per-PID scheduler is polling and go out between two requests.
+     For the last it also prints what polling lost to the actions.
+
+     With -u the actions come from an action server over the long-poll channel
+     instead (actsink stands in for it) and the time is measured from the
+     server queueing the action to the frame being written to the adapter.
+
+         ./elmsim -L /tmp/elm -l 30 &
+         ./actbench -d /tmp/elm
+         ./actsink -n 100 -i 1000 &
+         ./actbench -d /tmp/elm -r 0 -n 100 -u 'http://127.0.0.1:8087/actionPull.php?key=TEST'
+
+     actbench -d device [-b baud] [-n actions] [-r resets] [-u action_url [-w wait_secs]]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "elm327.h"
+#include "pidsched.h"
+#include "actions.h"
+
+#define ACTION_PROTOCOL "STP31"
+#define ACTION_HEADER "ATSH1C0"
+
+static const char *frames[] = { "24746C901100", "21746C901100", "69AA37901100", "6AAA37901100" };
+
+// Shared by the polling loop and the action channel thread, actions go first
+static pthread_mutex_t linkMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int actionsWaiting = 0;
+static volatile int channelDone = 0;
+
+typedef struct
+{
+	ELMconn *c;
+	const char *url;
+	int waitSecs;
+	int actions;
+	double *toWrite;        // queued to frame written, ms
+	double *toReply;        // queued to adapter reply, ms
+	int done;
+	ACTstats stats;
+} Channel;
+
+static int64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static double preciseMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static double wallMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int cmpDouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *label, double *ms, int n)
+{
+	if (n == 0)
+	{
+		printf("%-36s no action completed\n", label);
+		return;
+	}
+	qsort(ms, n, sizeof(double), cmpDouble);
+	printf("%-36s %4d %9.1f %9.1f %9.1f\n", label, n, ms[n / 2], ms[(n * 99) / 100], ms[n - 1]);
+}
+
+// pushAction(): every line written blind, 250 ms apart, done at the last prompt
+static double legacyAction(ELMconn *c, const char *dev, int baud, const char *frame)
+{
+	const char *lines[] = { "ATZ", "ATE0", "ATH1", "ATL0", ACTION_PROTOCOL, ACTION_HEADER, frame };
+	int nlines = sizeof(lines) / sizeof(lines[0]), prompts = 0, i;
+	double start = preciseMs();
+	struct pollfd pfd;
+	char buf[256];
+
+	if (ELMopen(c, dev, baud) < 0)
+		return -1;
+	for (i = 0; i < nlines; i++)
+	{
+		char line[32];
+		int len = snprintf(line, sizeof(line), "%s\r\n", lines[i]);
+
+		if (write(c->fd, line, len) != len)
+			break;
+		usleep(250000);
+	}
+	pfd.fd = c->fd;
+	pfd.events = POLLIN;
+	while (prompts < nlines && poll(&pfd, 1, 1000) > 0)
+	{
+		int got = read(c->fd, buf, sizeof(buf));
+
+		for (i = 0; i < got; i++)
+			prompts += buf[i] == '>';
+	}
+	ELMclose(c);
+	return prompts < nlines ? -1 : preciseMs() - start;
+}
+
+// A fresh session per action: reset, modes, then the frame, prompt to prompt
+static double sessionAction(ELMconn *c, const char *dev, int baud, const char *frame)
+{
+	double start = preciseMs();
+	char reply[ELM_RX_SIZE];
+	int len;
+
+	if (ELMopen(c, dev, baud) < 0 || ELMstart(c) < 0)
+		return -1;
+	len = ELMaction(c, ACTION_PROTOCOL, ACTION_HEADER, frame, reply, sizeof(reply));
+	ELMclose(c);
+	return len < 0 ? -1 : preciseMs() - start;
+}
+
+// Long-poll the action server and run each new action on the adapter as it arrives
+static void *channelThread(void *arg)
+{
+	Channel *ch = arg;
+	ACTchannel a;
+	char reply[16384];
+	int executed = 0, i;
+
+	if (ACTopen(&a, ch->url, ch->waitSecs) < 0)
+	{
+		fprintf(stderr, "actbench: bad action url %s\n", ch->url);
+		channelDone = 1;
+		return NULL;
+	}
+	while (executed < ch->actions)
+	{
+		char *p = reply;
+
+		if (ACTpoll(&a, reply, sizeof(reply)) <= 0)
+			continue;
+		while ((p = strstr(p, "\"id\": \"")) != NULL)
+		{
+			char id[ACT_MAX_ID], answer[ELM_RX_SIZE];
+			const char *q = strstr(p, "\"queued\": ");
+			double queued = q ? atof(q + 10) : 0, written;
+			int len;
+
+			sscanf(p + 7, "%31[^\"]", id);
+			p += 7;
+			if (ACTseen(&a, id))
+				continue;
+			__sync_fetch_and_add(&actionsWaiting, 1);
+			pthread_mutex_lock(&linkMutex);
+			__sync_fetch_and_sub(&actionsWaiting, 1);
+			// protocol and header first, so the stamp is the frame going out
+			ELMset(ch->c, ACTION_PROTOCOL);
+			ELMset(ch->c, ACTION_HEADER);
+			written = wallMs();
+			len = ELMaction(ch->c, NULL, NULL, frames[executed % 4], answer, sizeof(answer));
+			pthread_mutex_unlock(&linkMutex);
+			ACTack(&a, id, len >= 0 && strstr(answer, "NO DATA") != NULL);
+			if (queued > 0 && ch->done < ch->actions)
+			{
+				ch->toWrite[ch->done] = written - queued;
+				ch->toReply[ch->done++] = wallMs() - queued;
+			}
+			executed++;
+		}
+	}
+	// the last acknowledgements go with one more poll, retried like any other
+	a.waitSecs = 1;
+	for (i = 0; i < 5 && (a.acks[0] || a.fails[0]); i++)
+		ACTpoll(&a, reply, sizeof(reply));
+	ACTgetStats(&a, &ch->stats);
+	ACTclose(&a);
+	channelDone = 1;
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = NULL, *url = NULL;
+	uint8_t pids[256], ask[PS_DEPTH * ELM_MAX_BATCH];
+	ELMvalue vals[512];
+	ELMstats before, after;
+	double *ms;
+	int baud = 115200, actions = 50, resets = 5, waitSecs = 0, opt, n, i, done, sent;
+	int64_t next;
+	PSsched s;
+	PSentry *rpm;
+	ELMconn c;
+
+	while ((opt = getopt(argc, argv, "d:b:n:r:u:w:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd': dev = optarg; break;
+			case 'b': baud = atoi(optarg); break;
+			case 'n': actions = atoi(optarg); break;
+			case 'r': resets = atoi(optarg); break;
+			case 'u': url = optarg; break;
+			case 'w': waitSecs = atoi(optarg); break;
+			default:
+				dev = NULL;
+				break;
+		}
+	}
+	if (dev == NULL || actions < 1 || resets < 0)
+	{
+		fprintf(stderr, "usage: %s -d device [-b baud] [-n actions] [-r resets] [-u action_url [-w wait_secs]]\n", argv[0]);
+		return 1;
+	}
+	ms = calloc(actions > resets ? actions : resets, sizeof(double));
+	printf("%-36s %4s %9s %9s %9s\n", "action latency, ms", "n", "median", "p99", "max");
+
+	if (resets)
+	{
+		for (i = done = 0; i < resets; i++)
+			if ((ms[done] = legacyAction(&c, dev, baud, frames[i % 4])) >= 0)
+				done++;
+		report("reset + setup 250 ms apart (python)", ms, done);
+		for (i = done = 0; i < resets; i++)
+			if ((ms[done] = sessionAction(&c, dev, baud, frames[i % 4])) >= 0)
+				done++;
+		report("reset + setup per action", ms, done);
+	}
+
+	// Persistent session, actions arriving while the scheduler polls
+	if (ELMopen(&c, dev, baud) < 0 || ELMinit(&c) < 0)
+	{
+		fprintf(stderr, "actbench: no adapter on %s\n", dev);
+		return 1;
+	}
+	n = ELMsupportedList(&c, pids, sizeof(pids));
+	PSinit(&s, c.batch, 0, nowMs());
+	for (i = 0; i < n; i++)
+		PSadd(&s, OBDpidInfo(pids[i]), 0, 0, nowMs());
+	rpm = s.byPid[0x0C] >= 0 ? &s.e[s.byPid[0x0C]] : NULL;
+	srand(1);
+	ELMgetStats(&c, &before);
+	if (url)
+	{
+		Channel ch;
+		pthread_t tid;
+
+		memset(&ch, 0, sizeof(ch));
+		ch.c = &c;
+		ch.url = url;
+		ch.waitSecs = waitSecs;
+		ch.actions = actions;
+		ch.toWrite = calloc(actions, sizeof(double));
+		ch.toReply = calloc(actions, sizeof(double));
+		pthread_create(&tid, NULL, channelThread, &ch);
+		while (!channelDone)
+		{
+			int64_t now = nowMs();
+			int ask_n, got;
+
+			while (actionsWaiting)
+				usleep(500);
+			pthread_mutex_lock(&linkMutex);
+			ask_n = PSnext(&s, nowMs(), ask, sizeof(ask));
+			if (ask_n == 0)
+			{
+				int idle = PSidleMs(&s, now);
+
+				pthread_mutex_unlock(&linkMutex);
+				usleep((idle < 50 ? idle : 50) * 1000);
+				continue;
+			}
+			got = ELMquery(&c, ask, ask_n, vals, 512);
+			if (got > 0)
+				PSupdate(&s, nowMs(), vals, got);
+			pthread_mutex_unlock(&linkMutex);
+		}
+		pthread_join(tid, NULL);
+		report("server queue to frame written", ch.toWrite, ch.done);
+		report("server queue to adapter reply", ch.toReply, ch.done);
+		printf("\n%u polls, %u held open, %u carried actions, %u failed, %u connects, %u acks\n",
+			ch.stats.polls, ch.stats.held, ch.stats.deliveries, ch.stats.failures, ch.stats.connects,
+			ch.stats.acks + ch.stats.fails);
+		if (rpm)
+			printf("RPM polled at %.2f Hz (target %.2f), %u deadlines missed, jitter %.1f ms\n",
+				PSachievedHz(&s, rpm, nowMs()), 1000.0 / rpm->basePeriodMs, PSmissed(rpm, nowMs()), PSjitterMs(rpm));
+		free(ch.toWrite);
+		free(ch.toReply);
+		ELMclose(&c);
+		free(ms);
+		return 0;
+	}
+	next = nowMs() + 500 + rand() % 1000;
+	for (done = sent = 0; sent < actions; )
+	{
+		int64_t now = nowMs();
+		int ask_n, got;
+
+		if (now >= next)
+		{
+			char reply[ELM_RX_SIZE];
+
+			// picked up at next, only goes out once the request in flight is answered
+			if (ELMaction(&c, ACTION_PROTOCOL, ACTION_HEADER, frames[sent % 4], reply, sizeof(reply)) >= 0 &&
+				strstr(reply, "NO DATA"))
+				ms[done++] = preciseMs() - next;
+			sent++;
+			next = nowMs() + 500 + rand() % 1000;
+			continue;
+		}
+		ask_n = PSnext(&s, now, ask, sizeof(ask));
+		if (ask_n == 0)
+		{
+			int idle = PSidleMs(&s, now);
+
+			usleep((idle < next - now ? idle : next - now) * 1000);
+			continue;
+		}
+		got = ELMquery(&c, ask, ask_n, vals, 512);
+		if (got > 0)
+			PSupdate(&s, nowMs(), vals, got);
+	}
+	ELMgetStats(&c, &after);
+	report("persistent session, while polling", ms, done);
+	printf("\n%u settings sent for %u actions, %u already in effect\n", after.settings - before.settings,
+		after.actions - before.actions, after.cached - before.cached);
+	if (rpm)
+		printf("RPM polled at %.2f Hz (target %.2f), %u deadlines missed, jitter %.1f ms\n",
+			PSachievedHz(&s, rpm, nowMs()), 1000.0 / rpm->basePeriodMs, PSmissed(rpm, nowMs()), PSjitterMs(rpm));
+	ELMclose(&c);
+	free(ms);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+=================================================================================
+ Name        : actions.c
+ Version     : 0.1
+
+ Description : Long-poll remote action channel, see actions.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "actions.h"
+
+static int64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int ACTopen(ACTchannel *a, const char *url, int waitSecs)
+{
+	memset(a, 0, sizeof(*a));
+	a->waitSecs = waitSecs > 0 ? waitSecs : ACT_WAIT_SECS;
+	a->pollMs = ACT_POLL_MS;
+	if (UPLopen(&a->http, url, 0, 0) < 0)
+		return -1;
+	// a held poll is silent for up to waitSecs, that is not a dead connection
+	a->http.timeoutMs = (a->waitSecs + 15) * 1000;
+	return 0;
+}
+
+void ACTclose(ACTchannel *a)
+{
+	UPLclose(&a->http);
+}
+
+// add an id to the acknowledgements or the failures, -1 if that list is full
+static int queueAck(ACTchannel *a, const char *id, int ok)
+{
+	char *list = ok ? a->acks : a->fails;
+	size_t len = strlen(list), n = strlen(id);
+
+	if (len + n + 2 > sizeof(a->acks))
+		return -1;
+	if (len)
+		list[len++] = ',';
+	strcpy(list + len, id);
+	return 0;
+}
+
+int ACTpoll(ACTchannel *a, char *reply, int size)
+{
+	char path[sizeof(a->http.path) + sizeof(a->acks) + sizeof(a->fails) + 32];
+	int64_t start, wait = a->nextAt - nowMs();
+	int status, i;
+
+	if (wait > 0)
+		usleep(wait * 1000);
+	snprintf(path, sizeof(path), "%s%cwait=%d%s%s%s%s", a->http.path, strchr(a->http.path, '?') ? '&' : '?',
+		a->waitSecs, a->acks[0] ? "&ack=" : "", a->acks, a->fails[0] ? "&fail=" : "", a->fails);
+	start = nowMs();
+	status = UPLget(&a->http, path, reply, size);
+	a->stats.polls++;
+	a->stats.lastMs = nowMs() - start;
+	a->stats.lastStatus = status < 0 ? 0 : status;
+	a->stats.connects = a->http.stats.connects;
+	if (status < 200 || status >= 300)
+	{
+		// the acknowledgements stay queued for the retry
+		a->stats.failures++;
+		a->backoffMs = a->backoffMs ? a->backoffMs * 2 : ACT_BACKOFF_MIN_MS;
+		if (a->backoffMs > ACT_BACKOFF_MAX_MS)
+			a->backoffMs = ACT_BACKOFF_MAX_MS;
+		a->nextAt = nowMs() + a->backoffMs / 2 + rand() % (a->backoffMs / 2 + 1);
+		return -1;
+	}
+	a->backoffMs = 0;
+	a->acks[0] = a->fails[0] = 0;
+	a->nextAt = 0;
+	// the lists are empty again, queue what did not fit before
+	for (i = 0; i < ACT_SEEN; i++)
+		if (a->owed[i] && queueAck(a, a->seen[i], a->owed[i] == 1) == 0)
+			a->owed[i] = 0;
+	if (a->stats.lastMs >= 1000)
+		a->stats.held++;
+	if (strchr(reply, '{'))
+	{
+		a->stats.deliveries++;
+		return strlen(reply);
+	}
+	// nothing, and at once: the server does not hold polls, don't hammer it
+	if (a->stats.lastMs < 1000)
+		a->nextAt = start + a->pollMs;
+	return 0;
+}
+
+int ACTack(ACTchannel *a, const char *id, int ok)
+{
+	size_t n = strlen(id), i;
+	int slot;
+
+	// ids go into the query string as they are
+	if (n == 0 || n >= ACT_MAX_ID)
+		return -1;
+	for (i = 0; i < n; i++)
+		if (!((id[i] >= '0' && id[i] <= '9') || (id[i] >= 'a' && id[i] <= 'z') ||
+			(id[i] >= 'A' && id[i] <= 'Z') || id[i] == '-' || id[i] == '_'))
+			return -1;
+	// seen before anything else, so a full list never gets the action run twice;
+	// its acknowledgement then goes once a poll has emptied the list
+	for (slot = 0; slot < ACT_SEEN && slot < a->nseen; slot++)
+		if (strcmp(a->seen[slot], id) == 0)
+			break;
+	if (slot == ACT_SEEN || slot == a->nseen)
+	{
+		slot = a->nseen++ % ACT_SEEN;
+		strcpy(a->seen[slot], id);
+	}
+	a->owed[slot] = queueAck(a, id, ok) < 0 ? (ok ? 1 : 2) : 0;
+	if (ok)
+		a->stats.acks++;
+	else
+		a->stats.fails++;
+	return 0;
+}
+
+int ACTseen(const ACTchannel *a, const char *id)
+{
+	int i;
+
+	for (i = 0; i < ACT_SEEN && i < a->nseen; i++)
+		if (strcmp(a->seen[i], id) == 0)
+			return 1;
+	return 0;
+}
+
+void ACTgetStats(const ACTchannel *a, ACTstats *st)
+{
+	*st = a->stats;
+}
@@ -0,0 +1,83 @@
+/*
+=================================================================================
+ Name        : actions.h
+ Version     : 0.1
+
+ Description : Remote action channel. ACTpoll() long-polls the action URL on
+     one keep-alive HTTP or HTTPS connection: the server holds the request
+     until an action is queued or waitSecs pass, so an action arrives within
+     a round trip of being queued instead of at the next 20s poll.
+     Completions are acknowledged in batches on the following poll request,
+     which costs no extra round trip:
+
+         GET <url>&wait=25[&ack=12,13][&fail=14]
+         200 [{"id": "15", "action": "unlock", "queued": 1500000000000}, ...]
+
+     Every action not yet acknowledged is in each reply, so one lost with a
+     dropped connection comes again; ACTseen() tells a repeat from a new one.
+     Failed polls back off from 0.5s to 30s with jitter. A server that
+     answers at once with nothing (it does not hold requests) is polled
+     every pollMs instead.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef ACTIONS_H
+#define ACTIONS_H
+
+#include <stdint.h>
+#include "upload.h"
+
+#define ACT_WAIT_SECS 25        // how long the server may hold a poll
+#define ACT_POLL_MS 20000       // between polls of a server that does not hold them
+#define ACT_BACKOFF_MIN_MS 500
+#define ACT_BACKOFF_MAX_MS 30000
+#define ACT_MAX_ID 32
+#define ACT_SEEN 64             // ids remembered against repeats
+
+typedef struct
+{
+	uint32_t polls;         // requests made
+	uint32_t held;          // polls the server held open
+	uint32_t deliveries;    // replies carrying actions
+	uint32_t acks;          // completions acknowledged
+	uint32_t fails;         // failures reported
+	uint32_t failures;      // polls that failed and were retried
+	uint32_t connects;
+	uint32_t lastStatus;
+	uint32_t lastMs;        // duration of the last poll
+} ACTstats;
+
+typedef struct
+{
+	Uploader http;
+	int waitSecs;
+	uint32_t pollMs;
+	int64_t nextAt;         // earliest time for the next poll
+	uint32_t backoffMs;
+	char acks[512];         // ids waiting to go with the next poll, comma separated
+	char fails[512];
+	char seen[ACT_SEEN][ACT_MAX_ID];
+	uint8_t owed[ACT_SEEN]; // acknowledgement that found its list full: 1 done, 2 failed
+	int nseen;
+	ACTstats stats;
+} ACTchannel;
+
+// all int calls return -1 on failure
+ int ACTopen(ACTchannel *a, const char *url, int waitSecs);  // waitSecs 0 = ACT_WAIT_SECS
+ void ACTclose(ACTchannel *a);
+ int ACTpoll(ACTchannel *a, char *reply, int size);  // blocks, JSON reply length, 0 if no actions
+ int ACTack(ACTchannel *a, const char *id, int ok);  // completion, sent with the next poll with room
+ int ACTseen(const ACTchannel *a, const char *id);   // already acknowledged
+ void ACTgetStats(const ACTchannel *a, ACTstats *st);
+
+#endif
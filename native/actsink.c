@@ -0,0 +1,358 @@
+/*
+=================================================================================
+ Name        : actsink.c
+ Version     : 0.1
+
+ Description : Local stand-in for the action server, for testing the long-poll
+     action channel without a network. Queues -n lock/unlock actions at
+     random, on average -i ms apart, holds GET polls for up to their wait=
+     seconds and answers every held poll the moment an action is queued.
+     Replies carry every action not yet acknowledged, with the wall clock
+     time (ms) it was queued so the client can time it end to end; ack= and
+     fail= lists close them. It can fail every Nth request with 503, add a
+     delay before each reply, or close after each response, to exercise the
+     client's backoff and reconnect paths. Exits once every action is closed
+     and prints the time from queueing to the acknowledgement.
+
+     actsink [-p port] [-n actions] [-i mean_interval_ms] [-f every_nth_fails] [-d delay_ms] [-c] [-q]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define MAX_CONNS 16
+#define MAX_REQUEST 8192
+#define MAX_ACTIONS 10000
+
+typedef struct
+{
+	int fd;
+	char buf[MAX_REQUEST];
+	long len;
+	int waiting;            // a poll is held on this connection
+	int closing;
+	int64_t holdUntil;
+	int64_t notBefore;
+} Conn;
+
+typedef struct
+{
+	int64_t queued;         // wall clock ms
+	int64_t closedAt;
+	int ok;
+} Action;
+
+static Conn conns[MAX_CONNS];
+static Action actions[MAX_ACTIONS];
+static volatile int running = 1;
+static int failEvery = 0, delayMs = 0, closeAfter = 0, quiet = 0, total = 100, meanMs = 2000;
+static int queued, closed;
+static unsigned long requests, failed, held, connections, repeats;
+
+static int64_t wallMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static int cmpLong(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(void)
+{
+	int64_t ms[MAX_ACTIONS];
+	int n = 0, fails = 0, i;
+
+	for (i = 0; i < queued; i++)
+	{
+		if (actions[i].closedAt == 0)
+			continue;
+		if (!actions[i].ok)
+			fails++;
+		ms[n++] = actions[i].closedAt - actions[i].queued;
+	}
+	printf("actsink: %lu connections, %lu requests (%lu failed on purpose, %lu held), %d actions queued, "
+		"%d closed (%d failed), %lu acknowledged twice\n",
+		connections, requests, failed, held, queued, n, fails, repeats);
+	if (n)
+	{
+		qsort(ms, n, sizeof(ms[0]), cmpLong);
+		printf("actsink: queued to acknowledged ms median %lld p99 %lld max %lld\n",
+			(long long)ms[n / 2], (long long)ms[(n * 99) / 100], (long long)ms[n - 1]);
+	}
+	fflush(stdout);
+}
+
+static int anyOpen(void)
+{
+	return closed < queued;
+}
+
+// Close the actions in an ack= or fail= list
+static void closeList(const char *query, const char *name, int ok)
+{
+	const char *p = strstr(query, name);
+
+	if (p == NULL)
+		return;
+	p += strlen(name);
+	while (*p >= '0' && *p <= '9')
+	{
+		int id = strtol(p, (char **)&p, 10);
+
+		if (id >= 1 && id <= queued)
+		{
+			if (actions[id - 1].closedAt)
+				repeats++;
+			else
+			{
+				actions[id - 1].closedAt = wallMs();
+				actions[id - 1].ok = ok;
+				closed++;
+			}
+		}
+		if (*p == ',')
+			p++;
+	}
+}
+
+static int respond(Conn *c, int status)
+{
+	char body[16384], reply[17000];
+	int len = 0, i, n;
+
+	if (status == 200)
+	{
+		len = snprintf(body, sizeof(body), "[");
+		for (i = 0; i < queued && len < (int)sizeof(body) - 100; i++)
+			if (actions[i].closedAt == 0)
+				len += snprintf(body + len, sizeof(body) - len, "%s{\"id\": \"%d\", \"action\": \"%s\", \"queued\": %lld}",
+					len > 1 ? ", " : "", i + 1, i % 2 ? "lock" : "unlock", (long long)actions[i].queued);
+		len += snprintf(body + len, sizeof(body) - len, "]");
+	}
+	n = snprintf(reply, sizeof(reply), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n%s\r\n%.*s",
+		status, status == 200 ? "OK" : status == 503 ? "Service Unavailable" : "Bad Request", len,
+		c->closing ? "Connection: close\r\n" : "", len, body);
+	c->waiting = 0;
+	if (send(c->fd, reply, n, MSG_NOSIGNAL) < 0 || c->closing)
+		return -1;
+	return 0;
+}
+
+// Take the next complete request off the buffer, returns -1 to drop the connection.
+static int serve(Conn *c)
+{
+	char *hdrEnd, *line, *query;
+	long used;
+	int64_t now = wallMs();
+
+	if (c->waiting || (hdrEnd = c->len ? memmem(c->buf, c->len, "\r\n\r\n", 4) : NULL) == NULL)
+		return c->len >= MAX_REQUEST ? -1 : 0;
+	*hdrEnd = 0;
+	used = hdrEnd + 4 - c->buf;
+	c->closing = closeAfter;
+	for (line = strstr(c->buf, "\r\n"); line && line < hdrEnd; line = strstr(line + 2, "\r\n"))
+		if (strncasecmp(line + 2, "Connection:", 11) == 0 && strstr(line + 13, "close"))
+			c->closing = 1;
+	if (strncmp(c->buf, "GET ", 4))
+		return -1;
+	query = strchr(c->buf, '?');
+	if (query && (line = strchr(query, ' ')) != NULL)
+		*line = 0;
+	requests++;
+	memmove(c->buf, c->buf + used, c->len - used);
+	c->len -= used;
+
+	if (failEvery && requests % failEvery == 0)
+	{
+		failed++;
+		if (delayMs)
+			usleep(delayMs * 1000);
+		return respond(c, 503);
+	}
+	c->waiting = 1;
+	c->holdUntil = now;
+	c->notBefore = now + delayMs;
+	if (query)
+	{
+		const char *wait = strstr(query, "wait=");
+
+		closeList(query, "ack=", 1);
+		closeList(query, "fail=", 0);
+		if (wait)
+			c->holdUntil = now + atoi(wait + 5) * 1000;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	struct pollfd pfds[MAX_CONNS + 1];
+	int port = 8087, opt, lfd, one = 1, i;
+	int64_t nextQueue;
+
+	while ((opt = getopt(argc, argv, "p:n:i:f:d:cq")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': port = atoi(optarg); break;
+			case 'n': total = atoi(optarg); break;
+			case 'i': meanMs = atoi(optarg); break;
+			case 'f': failEvery = atoi(optarg); break;
+			case 'd': delayMs = atoi(optarg); break;
+			case 'c': closeAfter = 1; break;
+			case 'q': quiet = 1; break;
+			default:
+				total = 0;
+				break;
+		}
+	}
+	if (total < 1 || total > MAX_ACTIONS || meanMs < 1)
+	{
+		fprintf(stderr, "usage: %s [-p port] [-n actions] [-i mean_interval_ms] [-f every_nth_fails] [-d delay_ms] [-c] [-q]\n",
+			argv[0]);
+		return 1;
+	}
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0)
+	{
+		perror("actsink");
+		return 1;
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	for (i = 0; i < MAX_CONNS; i++)
+		conns[i].fd = -1;
+	srand(time(NULL) ^ getpid());
+	nextQueue = 0;
+
+	while (running && (queued < total || anyOpen()))
+	{
+		int64_t now = wallMs(), next;
+		int n = 0;
+
+		// Queue an action, exponential gaps, from the first poll on
+		if (nextQueue == 0 && requests)
+			nextQueue = now + meanMs;
+		next = queued < total && nextQueue ? nextQueue : now + 1000;
+		if (queued < total && nextQueue && now >= nextQueue)
+		{
+			actions[queued].queued = now;
+			actions[queued++].closedAt = 0;
+			nextQueue = now + (int64_t)(-log((rand() + 1.0) / (RAND_MAX + 2.0)) * meanMs);
+			if (!quiet)
+				printf("actsink: queued %d\n", queued);
+		}
+		// Answer held polls once there is something to say or the wait is over
+		for (i = 0; i < MAX_CONNS; i++)
+		{
+			Conn *c = &conns[i];
+
+			if (c->fd < 0 || !c->waiting)
+				continue;
+			if (now >= c->notBefore && (anyOpen() || now >= c->holdUntil))
+			{
+				if (now - c->notBefore >= 1000)
+					held++;
+				if (respond(c, 200) < 0 || serve(c) < 0)
+				{
+					close(c->fd);
+					c->fd = -1;
+				}
+			}
+			else if (c->waiting)
+			{
+				int64_t due = now < c->notBefore ? c->notBefore : c->holdUntil;
+
+				if (due < next)
+					next = due;
+			}
+		}
+		if (queued < total && nextQueue && nextQueue < next)
+			next = nextQueue;
+
+		pfds[n].fd = lfd;
+		pfds[n++].events = POLLIN;
+		for (i = 0; i < MAX_CONNS; i++)
+		{
+			pfds[n].fd = conns[i].fd;
+			pfds[n++].events = POLLIN;
+		}
+		if (poll(pfds, n, next > now ? (int)(next - now) : 0) < 0)
+			continue;
+		if (pfds[0].revents & POLLIN)
+		{
+			int fd = accept(lfd, NULL, NULL);
+
+			for (i = 0; fd >= 0 && i < MAX_CONNS && conns[i].fd >= 0; i++)
+				;
+			if (fd >= 0 && i == MAX_CONNS)
+				close(fd);
+			else if (fd >= 0)
+			{
+				conns[i].fd = fd;
+				conns[i].len = 0;
+				conns[i].waiting = 0;
+				connections++;
+			}
+		}
+		for (i = 0; i < MAX_CONNS; i++)
+		{
+			Conn *c = &conns[i];
+			long got;
+
+			if (c->fd < 0 || !(pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			got = recv(c->fd, c->buf + c->len, MAX_REQUEST - c->len, 0);
+			if (got > 0)
+				c->len += got;
+			if (got <= 0 || serve(c) < 0)
+			{
+				close(c->fd);
+				c->fd = -1;
+			}
+		}
+	}
+	report();
+	return 0;
+}
@@ -0,0 +1,183 @@
+/*
+=================================================================================
+ Name        : busbench.c
+ Version     : 0.1
+
+ Description : Cost of the shared memory metric bus and proof that readers
+     cannot hold up the writer. One thread publishes into -p PID slots as
+     fast as it can, first alone and then with -r reader threads copying
+     slots out of their own read only mapping as fast as they can. The
+     writer stores value n with time 2n, so a reader that ever sees a time
+     that is not twice the value has read a torn slot.
+
+     busbench [-p pids] [-r readers] [-t seconds]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "metricbus.h"
+
+#define BUS_NAME "/uhacknect-busbench"
+#define MAX_READERS 16
+
+typedef struct
+{
+	pthread_t thread;
+	uint64_t reads;
+	uint64_t torn;
+	uint64_t gaveUp;
+	uint64_t news;          // reads that found a new sequence
+	double cpu;
+} Reader;
+
+static MBUSbus writerBus;
+static Reader readers[MAX_READERS];
+static volatile int stop;
+static int pids = 16;
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// CPU time of the calling thread, so a shared core does not count against it
+static double cpuSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *readerThread(void *arg)
+{
+	Reader *r = arg;
+	MBUSbus bus;
+	uint32_t seen[MBUS_SLOTS];
+	unsigned int pid = 0;
+
+	if (MBUSopen(&bus, BUS_NAME, 0) < 0)
+	{
+		perror("busbench reader");
+		return NULL;
+	}
+	memset(seen, 0, sizeof(seen));
+	r->cpu = cpuSec();
+	while (!stop)
+	{
+		double value;
+		int64_t t;
+		uint32_t seq;
+
+		pid = (pid + 1) % pids;
+		seq = MBUSread(bus.map, pid, &value, &t);
+		r->reads++;
+		if (seq & 1)
+			r->gaveUp++;
+		else
+		{
+			if (t != (int64_t)value * 2)
+				r->torn++;
+			if (seq != seen[pid])
+				r->news++;
+			seen[pid] = seq;
+		}
+	}
+	r->cpu = cpuSec() - r->cpu;
+	MBUSclose(&bus);
+	return NULL;
+}
+
+// Publish round robin for the given time, ns per publish
+static double publishFor(double seconds, uint64_t *count)
+{
+	static uint64_t n;
+	uint64_t start = n;
+	double t0 = nowSec(), cpu = cpuSec();
+
+	do
+	{
+		int i;
+
+		for (i = 0; i < 1000; i++, n++)
+			MBUSpublish(writerBus.map, n % pids, (double)n, (int64_t)n * 2);
+	} while (nowSec() - t0 < seconds);
+	*count = n - start;
+	return (cpuSec() - cpu) / (n - start) * 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	int nreaders = 2, opt, i;
+	double seconds = 2, alone, shared, readCpu = 0;
+	uint64_t n, reads = 0, torn = 0, gaveUp = 0, news = 0;
+
+	while ((opt = getopt(argc, argv, "p:r:t:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': pids = atoi(optarg); break;
+			case 'r': nreaders = atoi(optarg); break;
+			case 't': seconds = atof(optarg); break;
+			default:
+				pids = 0;
+				break;
+		}
+	}
+	if (pids < 1 || pids > MBUS_SLOTS || nreaders < 0 || nreaders > MAX_READERS || seconds <= 0)
+	{
+		fprintf(stderr, "usage: %s [-p pids] [-r readers] [-t seconds]\n", argv[0]);
+		return 1;
+	}
+	shm_unlink(BUS_NAME);
+	if (MBUSopen(&writerBus, BUS_NAME, 1) < 0)
+	{
+		perror("busbench");
+		return 1;
+	}
+
+	alone = publishFor(seconds, &n);
+	printf("%d slots, %.1f M publishes alone, %.1f ns/publish of writer CPU\n", pids, n / 1e6, alone);
+
+	for (i = 0; i < nreaders; i++)
+		pthread_create(&readers[i].thread, NULL, readerThread, &readers[i]);
+	usleep(100000);
+	shared = publishFor(seconds, &n);
+	stop = 1;
+	for (i = 0; i < nreaders; i++)
+	{
+		pthread_join(readers[i].thread, NULL);
+		reads += readers[i].reads;
+		torn += readers[i].torn;
+		gaveUp += readers[i].gaveUp;
+		news += readers[i].news;
+		readCpu += readers[i].cpu;
+	}
+	printf("%d readers, %.1f M publishes, %.1f ns/publish of writer CPU (%.2fx alone)\n", nreaders, n / 1e6, shared, shared / alone);
+	printf("%.1f M reads, %.1f ns/read, %.2f%% found news, %llu torn, %llu gave up on a slot the writer was inside\n",
+		reads / 1e6, reads ? readCpu / reads * 1e9 : 0, reads ? 100.0 * news / reads : 0,
+		(unsigned long long)torn, (unsigned long long)gaveUp);
+
+	MBUSclose(&writerBus);
+	shm_unlink(BUS_NAME);
+	return torn ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+#!/bin/bash
+# Compile the ELM327 simulator and the client, scheduler and action benchmarks
+# (neither needs an adapter, so they also run on a desktop Linux box)
+echo "Building elmsim"
+gcc -O2 -o elmsim elmsim.c obd_pids.c elmtrace.c dtcdb.c -lm -lz
+echo "Building elmrec"
+gcc -O2 -o elmrec elmrec.c elm327.c obd_pids.c elmtrace.c -lz
+echo "Building elmbench"
+gcc -O2 -o elmbench elmbench.c elm327.c obd_pids.c
+echo "Building schedbench"
+gcc -O2 -o schedbench schedbench.c pidsched.c elm327.c obd_pids.c -lm
+echo "Building actbench"
+gcc -O2 -o actbench actbench.c actions.c upload.c spool.c gorilla.c pidsched.c elm327.c obd_pids.c -lz -lssl -lcrypto -lm -lpthread
+# Local HTTP stand-ins for the metric and action servers, and the uploader benchmark
+echo "Building httpsink"
+gcc -O2 -o httpsink httpsink.c -lz
+echo "Building actsink"
+gcc -O2 -o actsink actsink.c -lm
+echo "Building uplbench"
+gcc -O2 -o uplbench uplbench.c upload.c spool.c gorilla.c obd_pids.c -lz -lssl -lcrypto -lm
+echo "Building gorbench"
+gcc -O2 -o gorbench gorbench.c gorilla.c obd_pids.c -lz -lm
+echo "Building rollbench"
+gcc -O2 -o rollbench rollbench.c rollup.c obd_pids.c -lm
+echo "Building e2ebench"
+gcc -O2 -o e2ebench e2ebench.c spool.c upload.c gorilla.c pidsched.c elm327.c obd_pids.c -lz -lssl -lcrypto -lm -lpthread
+echo "Building busbench"
+gcc -O2 -o busbench busbench.c metricbus.c -lpthread -lrt
+echo "Building netbench"
+gcc -O2 -o netbench netbench.c netmon.c -lpthread
+# The trouble code database, packed from its text source, and its benchmark
+echo "Building dtcpack"
+gcc -O2 -o dtcpack dtcpack.c dtcdb.c
+echo "Building dtcbench"
+gcc -O2 -o dtcbench dtcbench.c dtcdb.c
+echo "Packing dtc.db"
+./dtcpack -o dtc.db dtc_codes.txt
+
+# Compile a shared object library that can be used in Python - may need to change location of Python libraries
+# depending on version of Python installed
+VER=NONE
+if [ -f /usr/include/python2.6/Python.h ]
+then
+  VER=python2.6
+fi
+if [ -f /usr/include/python2.7/Python.h ]
+then
+  VER=python2.7
+fi
+if [ "$VER" != "NONE" ]
+then
+  echo "Found Python version : "$VER
+  echo "Building Shared Object Library elm.so"
+  gcc -shared -O2 -I /usr/include/$VER/ -l$VER -o elm.so elm327_py.c elm327.c obd_pids.c pidsched.c rollup.c metricbus.c dtcdb.c -lm -lpthread -lrt
+  echo "Building Shared Object Library spool.so"
+  gcc -shared -O2 -I /usr/include/$VER/ -l$VER -o spool.so spool_py.c spool.c upload.c actions.c gorilla.c -lz -lssl -lcrypto
+  echo "Building Shared Object Library gorilla.so"
+  gcc -shared -O2 -I /usr/include/$VER/ -l$VER -o gorilla.so gorilla_py.c gorilla.c
+  echo "Building Shared Object Library netmon.so"
+  gcc -shared -O2 -I /usr/include/$VER/ -l$VER -o netmon.so netmon_py.c netmon.c -lpthread
+  echo "Building Shared Object Library dtcdb.so"
+  gcc -shared -O2 -I /usr/include/$VER/ -l$VER -o dtcdb.so dtcdb_py.c dtcdb.c
+  echo "Installing Shared Object Libraries elm.so spool.so gorilla.so netmon.so dtcdb.so and dtc.db"
+  mkdir -p /usr/local/lib/automated
+  cp -fp elm.so spool.so gorilla.so netmon.so dtcdb.so /usr/local/lib/automated/.
+  # a new file renamed into place, so a running reader keeps the one it mapped
+  cp -f dtc.db /usr/local/lib/automated/dtc.db.new && mv -f /usr/local/lib/automated/dtc.db.new /usr/local/lib/automated/dtc.db
+else
+  echo "Python.h Library not found - Python 2.7 recommended"
+fi
@@ -0,0 +1,285 @@
+/*
+=================================================================================
+ Name        : dtcbench.c
+ Version     : 0.1
+
+ Description : Check and cost of the trouble code database. Checks every
+     code's text form round trips, and that a lookup of every code under every
+     make gives what a linear scan of the entries gives; then times lookups
+     warm (pages resident) and cold (the file dropped from the page cache
+     before it is mapped, so the first lookup reads it from the card), counts
+     the heap a lookup uses and the pages of the file it leaves resident.
+     Codes given after the database are looked up and printed instead.
+
+     dtcbench [-n lookups] [-r cold rounds] [-v vin] [database] [code...]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "dtcdb.h"
+
+#define MIX 4096                // codes cycled through by the warm loop
+
+static uint32_t rng = 1;
+static uint16_t mix[MIX];
+
+static uint32_t rnd(void)
+{
+	// xorshift32
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t heapUsed(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	return mallinfo2().uordblks;
+#else
+	return mallinfo().uordblks;
+#endif
+}
+
+static long majorFaults(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_majflt;
+}
+
+// what a lookup should return, the slow way
+static const char *scan(const DTCdb *db, uint16_t code, int make)
+{
+	uint32_t i;
+
+	if (make > 0 && (uint32_t)make <= db->makeCount)
+		for (i = 0; i < db->count; i++)
+			if (db->entries[i].key == ((uint32_t)make << 16 | code))
+				return db->pool + db->entries[i].text;
+	for (i = 0; i < db->count; i++)
+		if (db->entries[i].key == code)
+			return db->pool + db->entries[i].text;
+	return NULL;
+}
+
+static int check(const DTCdb *db)
+{
+	char text[6], vin[DTC_MAKE_WMI + 18];
+	uint32_t code, i;
+	int make, lookups = 0;
+
+	for (code = 0; code < 65536; code++)
+	{
+		DTCformat(code, text);
+		if (DTCencode(text) != (int)code)
+		{
+			printf("check %-10s FAILED: %s encodes to %d, not %u\n", "codes", text, DTCencode(text), code);
+			return 1;
+		}
+	}
+	printf("check %-10s ok, all 65536 round trip\n", "codes");
+
+	for (i = 1; i < db->count; i++)
+	{
+		if (db->entries[i].key <= db->entries[i - 1].key)
+		{
+			printf("check %-10s FAILED: entries out of order at %u\n", "lookup", i);
+			return 1;
+		}
+	}
+	for (make = 0; make <= (int)db->makeCount; make++)
+	{
+		for (code = 0; code < 65536; code++)
+		{
+			if (DTClookup(db, code, make) != scan(db, code, make))
+			{
+				DTCformat(code, text);
+				printf("check %-10s FAILED: %s under make %d\n", "lookup", text, make);
+				return 1;
+			}
+			lookups++;
+		}
+	}
+	printf("check %-10s ok, %d codes under %u makes as a linear scan\n", "lookup", lookups, db->makeCount + 1);
+
+	for (make = 1; make <= (int)db->makeCount; make++)
+	{
+		const char *p = db->makes[make - 1].wmi;
+
+		if (DTCmakeByName(db, db->makes[make - 1].name) != make)
+		{
+			printf("check %-10s FAILED: %s not found by name\n", "makes", db->makes[make - 1].name);
+			return 1;
+		}
+		while (*p)
+		{
+			int len = strcspn(p, " ");
+
+			// a full VIN starting with the prefix
+			snprintf(vin, sizeof(vin), "%.*s%s", len, p, "ZZZZZZZZZZZZZZZZZ");
+			if (DTCmakeByVin(db, vin) != make)
+			{
+				printf("check %-10s FAILED: VIN %s is not %s\n", "makes", vin, db->makes[make - 1].name);
+				return 1;
+			}
+			p += len;
+			p += *p == ' ';
+		}
+	}
+	if (DTCmakeByVin(db, "00000000000000000") != 0)
+	{
+		printf("check %-10s FAILED: an unknown VIN found a make\n", "makes");
+		return 1;
+	}
+	printf("check %-10s ok, %u makes by name and VIN\n", "makes", db->makeCount);
+	return 0;
+}
+
+// a lookup whose text is read, as the display would
+static size_t describe(const DTCdb *db, uint16_t code, int make)
+{
+	const char *text = DTClookup(db, code, make);
+
+	return text ? strlen(text) : 0;
+}
+
+// a code in the database half the time, anything else the other half
+static uint16_t pick(const DTCdb *db)
+{
+	uint32_t r = rnd();
+
+	if (r & 1 && db->count)
+		return db->entries[(r >> 1) % db->count].key & 0xffff;
+	return r >> 16;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = DTC_PATH, *vin = NULL;
+	int lookups = 1000000, rounds = 20, opt, make = 0, i, fd;
+	double start, warm, openTime = 0, firstTime = 0, worstFirst = 0;
+	long faults;
+	size_t heap;
+	volatile size_t sink = 0;
+	DTCdb db;
+
+	while ((opt = getopt(argc, argv, "n:r:v:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': lookups = atoi(optarg); break;
+			case 'r': rounds = atoi(optarg); break;
+			case 'v': vin = optarg; break;
+			default:
+				lookups = 0;
+				break;
+		}
+	}
+	if (lookups < 1 || rounds < 1)
+	{
+		fprintf(stderr, "usage: %s [-n lookups] [-r cold rounds] [-v vin] [database] [code...]\n", argv[0]);
+		return 2;
+	}
+	if (optind < argc)
+		path = argv[optind++];
+	if (DTCopen(&db, path) < 0)
+	{
+		fprintf(stderr, "dtcbench: %s is not a trouble code database\n", path);
+		return 1;
+	}
+	if (vin)
+		make = DTCmakeByVin(&db, vin);
+
+	if (optind < argc)
+	{
+		for (; optind < argc; optind++)
+		{
+			int code = DTCencode(argv[optind]);
+			const char *text = code < 0 ? NULL : DTClookup(&db, code, make);
+
+			if (code < 0)
+				printf("%s\tnot a trouble code\n", argv[optind]);
+			else if (text)
+				printf("%s\t%s\n", argv[optind], text);
+			else
+				printf("%s\t%s\n", argv[optind], DTCmanufacturer(code) ? "manufacturer specific, not known" : "not known");
+		}
+		DTCclose(&db);
+		return 0;
+	}
+
+	printf("%s: %u codes, %u makes, %zu bytes%s%s\n", path, db.count, db.makeCount, db.size,
+		vin ? ", make " : "", vin ? (make ? DTCmakeName(&db, make) : "unknown") : "");
+	if (check(&db))
+		return 1;
+
+	// cold: dropped from the page cache while unmapped, then mapped and one code looked up
+	faults = majorFaults();
+	for (i = 0; i < rounds; i++)
+	{
+		double t;
+
+		DTCclose(&db);
+		fd = open(path, O_RDONLY);
+		if (fd >= 0)
+		{
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+		start = nowSec();
+		if (DTCopen(&db, path) < 0)
+			return 1;
+		t = nowSec();
+		openTime += t - start;
+		sink += describe(&db, pick(&db), make);
+		t = nowSec() - t;
+		firstTime += t;
+		if (t > worstFirst)
+			worstFirst = t;
+	}
+	faults = majorFaults() - faults;
+	printf("cold open %8.1f us   first lookup %8.1f us avg, %8.1f us worst, %.1f major faults, %ld KB resident\n",
+		openTime / rounds * 1e6, firstTime / rounds * 1e6, worstFirst * 1e6, (double)faults / rounds, DTCresident(&db) / 1024);
+
+	// warm, and the heap it takes
+	for (i = 0; i < MIX; i++)
+		mix[i] = pick(&db);
+	heap = heapUsed();
+	start = nowSec();
+	for (i = 0; i < lookups; i++)
+		sink += describe(&db, mix[i & (MIX - 1)], make);
+	warm = (nowSec() - start) / lookups;
+	heap = heapUsed() - heap;
+	printf("warm lookup %6.0f ns   heap used by lookups %zu bytes, %ld KB resident, all of a %zu byte file\n",
+		warm * 1e9, heap, DTCresident(&db) / 1024, db.size);
+	DTCclose(&db);
+	return 0;
+}
@@ -0,0 +1,242 @@
+/*
+=================================================================================
+ Name        : dtcdb.c
+ Version     : 0.1
+
+ Description : Memory-mapped trouble code database, see dtcdb.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dtcdb.h"
+
+static const char systems[] = "PCBU";
+
+int DTCopen(DTCdb *db, const char *path)
+{
+	const DTCheader *h;
+	struct stat st;
+	void *map;
+	uint32_t i;
+	int fd;
+
+	memset(db, 0, sizeof(*db));
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(DTCheader))
+	{
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	// a lookup touches a handful of entries and one string, read ahead is wasted
+	madvise(map, st.st_size, MADV_RANDOM);
+
+	// sections inside the file and in order, the pool ending in a NUL, so a
+	// lookup only has to check its string offset; the entries are not read here
+	h = map;
+	if (h->magic != DTC_MAGIC || h->version != DTC_VERSION || h->makes > DTC_MAX_MAKES ||
+		h->entriesOff < sizeof(DTCheader) || h->entriesOff % 4 ||
+		h->makesOff < h->entriesOff || h->makesOff - h->entriesOff != (uint64_t)h->entries * sizeof(DTCentry) ||
+		h->poolOff < h->makesOff || h->poolOff - h->makesOff != (uint64_t)h->makes * sizeof(DTCmake) ||
+		h->poolSize == 0 || (uint64_t)h->poolOff + h->poolSize > (uint64_t)st.st_size ||
+		((const char *)map)[h->poolOff + h->poolSize - 1] != 0)
+	{
+		munmap(map, st.st_size);
+		return -1;
+	}
+	db->map = map;
+	db->makes = (const DTCmake *)(db->map + h->makesOff);
+	for (i = 0; i < h->makes; i++)
+	{
+		// names are handed out as C strings
+		if (db->makes[i].name[DTC_MAKE_NAME - 1] != 0)
+		{
+			munmap(map, st.st_size);
+			db->map = NULL;
+			return -1;
+		}
+	}
+	db->size = st.st_size;
+	db->entries = (const DTCentry *)(db->map + h->entriesOff);
+	db->count = h->entries;
+	db->makeCount = h->makes;
+	db->pool = (const char *)db->map + h->poolOff;
+	db->poolSize = h->poolSize;
+	return 0;
+}
+
+void DTCclose(DTCdb *db)
+{
+	if (db->map)
+		munmap((void *)db->map, db->size);
+	memset(db, 0, sizeof(*db));
+}
+
+static const char *find(const DTCdb *db, uint32_t key)
+{
+	uint32_t lo = 0, hi = db->count;
+
+	// first entry not below key
+	while (lo < hi)
+	{
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (db->entries[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == db->count || db->entries[lo].key != key || db->entries[lo].text >= db->poolSize)
+		return NULL;
+	return db->pool + db->entries[lo].text;
+}
+
+const char *DTClookup(const DTCdb *db, uint16_t code, int make)
+{
+	const char *text = NULL;
+
+	if (db->map == NULL)
+		return NULL;
+	if (make > 0 && (uint32_t)make <= db->makeCount)
+		text = find(db, (uint32_t)make << 16 | code);
+	if (text == NULL)
+		text = find(db, code);
+	return text;
+}
+
+int DTCmakeByName(const DTCdb *db, const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < db->makeCount; i++)
+		if (strncasecmp(db->makes[i].name, name, DTC_MAKE_NAME) == 0)
+			return i + 1;
+	return 0;
+}
+
+int DTCmakeByVin(const DTCdb *db, const char *vin)
+{
+	uint32_t i;
+	int best = 0, bestLen = 0;
+
+	for (i = 0; i < db->makeCount; i++)
+	{
+		const char *p = db->makes[i].wmi, *end = p + DTC_MAKE_WMI;
+
+		while (p < end && *p)
+		{
+			int len = 0;
+
+			while (p + len < end && p[len] && p[len] != ' ')
+				len++;
+			if (len > bestLen && strncasecmp(vin, p, len) == 0)
+			{
+				best = i + 1;
+				bestLen = len;
+			}
+			p += len;
+			while (p < end && *p == ' ')
+				p++;
+		}
+	}
+	return best;
+}
+
+const char *DTCmakeName(const DTCdb *db, int make)
+{
+	if (make <= 0 || (uint32_t)make > db->makeCount)
+		return "";
+	return db->makes[make - 1].name;
+}
+
+static int hexval(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	return -1;
+}
+
+int DTCencode(const char *text)
+{
+	const char *sys = strchr(systems, text[0] & ~0x20);
+	int code, i;
+
+	if (text[0] == 0 || sys == NULL || text[1] < '0' || text[1] > '3')
+		return -1;
+	code = (sys - systems) << 14 | (text[1] - '0') << 12;
+	for (i = 2; i < 5; i++)
+	{
+		if (hexval(text[i]) < 0)
+			return -1;
+		code |= hexval(text[i]) << (4 * (4 - i));
+	}
+	if (text[5] != 0)
+		return -1;
+	return code;
+}
+
+void DTCformat(uint16_t code, char *out)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	out[0] = systems[code >> 14];
+	out[1] = '0' + (code >> 12 & 3);
+	out[2] = hex[code >> 8 & 15];
+	out[3] = hex[code >> 4 & 15];
+	out[4] = hex[code & 15];
+	out[5] = 0;
+}
+
+int DTCmanufacturer(uint16_t code)
+{
+	int sys = code >> 14, digit = code >> 12 & 3;
+
+	// P1xxx and P30xx-P33xx; C, B and U 1xxx and 2xxx
+	if (sys == 0)
+		return digit == 1 || (digit == 3 && (code >> 8 & 15) <= 3);
+	return digit == 1 || digit == 2;
+}
+
+long DTCresident(const DTCdb *db)
+{
+	long page = sysconf(_SC_PAGESIZE), resident = 0;
+	unsigned char vec[256];
+	size_t off, n, i;
+
+	// mincore a chunk at a time, the vector stays on the stack
+	for (off = 0; db->map && off < db->size; off += n * page)
+	{
+		n = (db->size - off + page - 1) / page;
+		if (n > sizeof(vec))
+			n = sizeof(vec);
+		if (mincore((void *)(db->map + off), n * page < db->size - off ? n * page : db->size - off, vec) < 0)
+			return -1;
+		for (i = 0; i < n; i++)
+			resident += vec[i] & 1;
+	}
+	return resident * page;
+}
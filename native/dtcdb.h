@@ -0,0 +1,98 @@
+/*
+=================================================================================
+ Name        : dtcdb.h
+ Version     : 0.1
+
+ Description : Trouble code descriptions from a read-only, memory-mapped
+     database, so the device can show what P0301 means with no network and
+     without loading a text table into the heap. dtcpack builds the file from
+     a text source (dtc_codes.txt); DTCopen() maps it and checks its shape
+     once, and a lookup after that is a binary search over fixed-width keys
+     returning a pointer into the string pool: no allocation, no copy.
+
+     Codes are kept as the two bytes J1979 Mode 03 returns (SAE J2012): the
+     system in the top two bits (P C B U), then the four digits, so P0301 is
+     0x0301 and U0100 is 0xc100. Each key carries a make as well, 0 for the
+     generic codes; a make's own table is searched first, then the generic
+     one. Makes are named in the source with the VIN prefixes (WMI) that
+     identify them, so the VIN read from the car picks the table.
+
+     Nothing is written through the map and the file is replaced, never
+     rewritten, so any number of processes can share its pages.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef DTCDB_H
+#define DTCDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DTC_PATH "/usr/local/lib/automated/dtc.db"
+#define DTC_MAGIC 0x44435444    // "DTCD"
+#define DTC_VERSION 1
+#define DTC_MAKE_NAME 16
+#define DTC_MAKE_WMI 48         // space separated VIN prefixes
+#define DTC_MAX_MAKES 255
+
+// file layout, little endian: the header, the entries sorted by key, the
+// makes (make n is makes[n - 1]), then the pool of NUL terminated strings
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entries;
+	uint32_t makes;
+	uint32_t entriesOff;
+	uint32_t makesOff;
+	uint32_t poolOff;
+	uint32_t poolSize;
+} DTCheader;
+
+typedef struct
+{
+	uint32_t key;           // make << 16 | code
+	uint32_t text;          // offset in the pool
+} DTCentry;
+
+typedef struct
+{
+	char name[DTC_MAKE_NAME];
+	char wmi[DTC_MAKE_WMI];
+} DTCmake;
+
+typedef struct
+{
+	const uint8_t *map;
+	size_t size;
+	const DTCentry *entries;
+	uint32_t count;
+	const DTCmake *makes;
+	uint32_t makeCount;
+	const char *pool;
+	uint32_t poolSize;
+} DTCdb;
+
+// all int calls return -1 on failure
+ int DTCopen(DTCdb *db, const char *path);
+ void DTCclose(DTCdb *db);
+ const char *DTClookup(const DTCdb *db, uint16_t code, int make);  // the make's text, else the generic one, else NULL
+ int DTCmakeByName(const DTCdb *db, const char *name);   // 0 if not in the database
+ int DTCmakeByVin(const DTCdb *db, const char *vin);     // longest WMI prefix match, 0 if none
+ const char *DTCmakeName(const DTCdb *db, int make);     // "" for 0 or out of range
+ int DTCencode(const char *text);         // "P0301" -> 0x0301
+ void DTCformat(uint16_t code, char *out);   // at least 6 bytes
+ int DTCmanufacturer(uint16_t code);      // 1 in a range J2012 leaves to the manufacturers
+ long DTCresident(const DTCdb *db);       // bytes of the file in memory now
+
+#endif
@@ -0,0 +1,172 @@
+/*
+=================================================================================
+ Name        : dtcdb_py.c
+ Version     : 0.1
+
+ Description : Python bindings for the trouble code database, built as
+     dtcdb.so. The database stays mapped between calls; a lookup hands back a
+     new string made from the text in the map, nothing else is allocated.
+
+     dtcOpen(string path=DTC_PATH)  - map the database, 0 or -1
+     dtcLookup(code, int make=0)    - description of a code ('P0301' or its two
+                                    byte value), the make's own text first, then
+                                    the generic one; None if not known
+     dtcMake(string vinOrName)      - make id from a VIN or a make name, 0 if the
+                                    database has no codes of its own for it
+     dtcMakeName(int make)          - name of a make id, '' for 0
+     dtcFormat(int code)            - two byte value as text, e.g. 'P0301'
+     dtcManufacturer(code)          - 1 if J2012 leaves the code to the makes
+     dtcStats()                     - dict of codes, makes, bytes, resident bytes,
+                                    lookups and hits
+     dtcClose()
+
+     All but dtcFormat() and dtcManufacturer() return -1 (dtcLookup() None)
+     before dtcOpen().
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <Python.h>
+#include "dtcdb.h"
+
+static DTCdb db;
+static unsigned long lookups, hits;
+
+// 'P0301' or 0x0301, -1 for anything else
+static int codeArg(PyObject *o)
+{
+  long v;
+
+  if (PyString_Check(o))
+    return DTCencode(PyString_AsString(o));
+  if (PyInt_Check(o) || PyLong_Check(o))
+  {
+    v = PyInt_AsLong(o);
+    if (PyErr_Occurred())
+    {
+      PyErr_Clear();
+      return -1;
+    }
+    return v >= 0 && v <= 0xffff ? (int)v : -1;
+  }
+  return -1;
+}
+
+static PyObject* py_dtcOpen(PyObject* self, PyObject* args)
+{
+  const char *path = DTC_PATH;
+
+  if (!PyArg_ParseTuple(args, "|s", &path))
+    return Py_BuildValue("i", -1);
+  DTCclose(&db);
+  if (DTCopen(&db, path) < 0)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", 0);
+}
+
+static PyObject* py_dtcLookup(PyObject* self, PyObject* args)
+{
+  PyObject *o;
+  const char *text;
+  int make = 0, code;
+
+  if (!PyArg_ParseTuple(args, "O|i", &o, &make) || (code = codeArg(o)) < 0)
+    Py_RETURN_NONE;
+  lookups++;
+  text = DTClookup(&db, code, make);
+  if (text == NULL)
+    Py_RETURN_NONE;
+  hits++;
+  return PyString_FromString(text);
+}
+
+static PyObject* py_dtcMake(PyObject* self, PyObject* args)
+{
+  const char *s;
+  int make;
+
+  if (!PyArg_ParseTuple(args, "s", &s) || db.map == NULL)
+    return Py_BuildValue("i", -1);
+  // a make name first, then the VIN prefixes
+  make = DTCmakeByName(&db, s);
+  if (make == 0)
+    make = DTCmakeByVin(&db, s);
+  return Py_BuildValue("i", make);
+}
+
+static PyObject* py_dtcMakeName(PyObject* self, PyObject* args)
+{
+  int make;
+
+  if (!PyArg_ParseTuple(args, "i", &make) || db.map == NULL)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("s", DTCmakeName(&db, make));
+}
+
+static PyObject* py_dtcFormat(PyObject* self, PyObject* args)
+{
+  char text[6];
+  int code;
+
+  if (!PyArg_ParseTuple(args, "i", &code) || code < 0 || code > 0xffff)
+    return Py_BuildValue("i", -1);
+  DTCformat(code, text);
+  return Py_BuildValue("s", text);
+}
+
+static PyObject* py_dtcManufacturer(PyObject* self, PyObject* args)
+{
+  PyObject *o;
+  int code;
+
+  if (!PyArg_ParseTuple(args, "O", &o) || (code = codeArg(o)) < 0)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", DTCmanufacturer(code));
+}
+
+static PyObject* py_dtcStats(PyObject* self, PyObject* args)
+{
+  if (db.map == NULL)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("{s:I,s:I,s:k,s:l,s:k,s:k}", "codes", db.count, "makes", db.makeCount,
+    "bytes", (unsigned long)db.size, "resident", DTCresident(&db), "lookups", lookups, "hits", hits);
+}
+
+static PyObject* py_dtcClose(PyObject* self, PyObject* args)
+{
+  DTCclose(&db);
+  return Py_BuildValue("i", 0);
+}
+
+
+/*
+ * Bind Python function names to our C functions
+ */
+static PyMethodDef dtcdb_methods[] = {
+  {"dtcOpen", py_dtcOpen, METH_VARARGS},
+  {"dtcLookup", py_dtcLookup, METH_VARARGS},
+  {"dtcMake", py_dtcMake, METH_VARARGS},
+  {"dtcMakeName", py_dtcMakeName, METH_VARARGS},
+  {"dtcFormat", py_dtcFormat, METH_VARARGS},
+  {"dtcManufacturer", py_dtcManufacturer, METH_VARARGS},
+  {"dtcStats", py_dtcStats, METH_VARARGS},
+  {"dtcClose", py_dtcClose, METH_VARARGS},
+  {NULL, NULL}
+};
+
+/*
+ * Python calls this to let us initialize our module
+ */
+void initdtcdb()
+{
+  (void) Py_InitModule("dtcdb", dtcdb_methods);
+}
@@ -0,0 +1,360 @@
+/*
+=================================================================================
+ Name        : dtcpack.c
+ Version     : 0.1
+
+ Description : Builds the trouble code database dtcdb.c maps, from one or
+     more text sources, or dumps a database back out as text.
+
+     Source lines are a code and its description, separated by white space:
+
+       P0301   Cylinder 1 Misfire Detected
+
+     '#' starts a comment. Codes up to the first section are generic; a
+     section line starts a make's own codes, naming the make and the VIN
+     prefixes (WMI) of the cars it covers:
+
+       [GM 1G 2G 3G KL]
+
+     and [Generic] goes back to the generic table. Identical descriptions
+     share one copy in the pool. The database is written to a temporary
+     file and renamed over the old one, so a process that has it mapped
+     keeps a whole file.
+
+     dtcpack [-o database] source...
+     dtcpack -d database
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "dtcdb.h"
+
+#define MAX_LINE 512
+#define HASH_SIZE 65536         // pool dedup buckets, a power of two
+
+typedef struct
+{
+	uint32_t key;
+	uint32_t text;
+	uint32_t seq;           // order read, so a duplicate is reported against the first
+	const char *file;       // where it was defined, for the duplicate error
+	int line;
+} Entry;
+
+static Entry *entries;
+static uint32_t count, room;
+static DTCmake makes[DTC_MAX_MAKES];
+static uint32_t makeCount;
+static char *pool;
+static uint32_t poolSize, poolRoom;
+static uint32_t hashSlots[HASH_SIZE];   // pool offset + 1, 0 = empty
+
+static uint32_t hash(const char *s)
+{
+	uint32_t h = 2166136261u;
+
+	// FNV-1a
+	while (*s)
+		h = (h ^ (uint8_t)*s++) * 16777619u;
+	return h;
+}
+
+// the pool offset of s, adding it the first time it is seen
+static uint32_t intern(const char *s)
+{
+	uint32_t len = strlen(s) + 1, i = hash(s) & (HASH_SIZE - 1), off;
+
+	while (hashSlots[i])
+	{
+		off = hashSlots[i] - 1;
+		if (strcmp(pool + off, s) == 0)
+			return off;
+		i = (i + 1) & (HASH_SIZE - 1);
+	}
+	if (poolSize + len > poolRoom)
+	{
+		poolRoom = (poolSize + len) * 2;
+		pool = realloc(pool, poolRoom);
+		if (pool == NULL)
+		{
+			fprintf(stderr, "dtcpack: out of memory\n");
+			exit(1);
+		}
+	}
+	off = poolSize;
+	memcpy(pool + off, s, len);
+	poolSize += len;
+	hashSlots[i] = off + 1;
+	return off;
+}
+
+static int byKey(const void *a, const void *b)
+{
+	const Entry *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((uint8_t)*s))
+		s++;
+	end = s + strlen(s);
+	while (end > s && isspace((uint8_t)end[-1]))
+		*--end = 0;
+	return s;
+}
+
+// "[Name WMI WMI ...]", returns the make it selects
+static int section(char *s, const char *file, int line)
+{
+	char *name, *wmi, *save, *end = strchr(s, ']');
+	DTCmake *m;
+	uint32_t i;
+
+	if (end == NULL || end[1] != 0)
+	{
+		fprintf(stderr, "%s:%d: section without its ]\n", file, line);
+		return -1;
+	}
+	*end = 0;
+	name = strtok_r(s + 1, " \t", &save);
+	if (name == NULL || strlen(name) >= DTC_MAKE_NAME)
+	{
+		fprintf(stderr, "%s:%d: make names are 1 to %d characters\n", file, line, DTC_MAKE_NAME - 1);
+		return -1;
+	}
+	if (strcasecmp(name, "Generic") == 0)
+		return 0;
+	for (i = 0; i < makeCount; i++)
+		if (strcasecmp(makes[i].name, name) == 0)
+			break;
+	if (i == makeCount)
+	{
+		if (makeCount == DTC_MAX_MAKES)
+		{
+			fprintf(stderr, "%s:%d: more than %d makes\n", file, line, DTC_MAX_MAKES);
+			return -1;
+		}
+		strcpy(makes[makeCount++].name, name);
+	}
+	// prefixes given again add to the ones the make has
+	m = &makes[i];
+	while ((wmi = strtok_r(NULL, " \t", &save)) != NULL)
+	{
+		size_t used = strlen(m->wmi);
+
+		if (used + (used > 0) + strlen(wmi) >= DTC_MAKE_WMI)
+		{
+			fprintf(stderr, "%s:%d: too many VIN prefixes for %s\n", file, line, m->name);
+			return -1;
+		}
+		if (used > 0)
+			strcat(m->wmi, " ");
+		strcat(m->wmi, wmi);
+	}
+	return i + 1;
+}
+
+static int readSource(const char *file)
+{
+	char buf[MAX_LINE], *s, *desc;
+	int make = 0, line = 0, code, errors = 0;
+	FILE *f = fopen(file, "r");
+
+	if (f == NULL)
+	{
+		perror(file);
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), f))
+	{
+		line++;
+		if ((s = strchr(buf, '#')) != NULL)
+			*s = 0;
+		s = trim(buf);
+		if (*s == 0)
+			continue;
+		if (*s == '[')
+		{
+			make = section(s, file, line);
+			if (make < 0)
+				errors++;
+			continue;
+		}
+		desc = s;
+		while (*desc && !isspace((uint8_t)*desc))
+			desc++;
+		if (*desc)
+			*desc++ = 0;
+		desc = trim(desc);
+		code = DTCencode(s);
+		if (code < 0 || *desc == 0 || make < 0)
+		{
+			if (make >= 0)
+				fprintf(stderr, "%s:%d: expected a code such as P0301 and its description\n", file, line);
+			errors++;
+			continue;
+		}
+		if (count == room)
+		{
+			room = room ? room * 2 : 1024;
+			entries = realloc(entries, room * sizeof(Entry));
+			if (entries == NULL)
+			{
+				fprintf(stderr, "dtcpack: out of memory\n");
+				exit(1);
+			}
+		}
+		entries[count].key = (uint32_t)make << 16 | code;
+		entries[count].text = intern(desc);
+		entries[count].seq = count;
+		entries[count].file = file;
+		entries[count].line = line;
+		count++;
+	}
+	fclose(f);
+	return errors ? -1 : 0;
+}
+
+static int writeDatabase(const char *path)
+{
+	DTCheader h;
+	DTCentry e;
+	char tmp[256];
+	uint32_t i;
+	FILE *f;
+	int ok;
+
+	h.magic = DTC_MAGIC;
+	h.version = DTC_VERSION;
+	h.entries = count;
+	h.makes = makeCount;
+	h.entriesOff = sizeof(DTCheader);
+	h.makesOff = h.entriesOff + count * sizeof(DTCentry);
+	h.poolOff = h.makesOff + makeCount * sizeof(DTCmake);
+	h.poolSize = poolSize;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "wb");
+	if (f == NULL)
+	{
+		perror(tmp);
+		return -1;
+	}
+	ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	for (i = 0; ok && i < count; i++)
+	{
+		e.key = entries[i].key;
+		e.text = entries[i].text;
+		ok = fwrite(&e, sizeof(e), 1, f) == 1;
+	}
+	if (ok && makeCount)
+		ok = fwrite(makes, sizeof(DTCmake), makeCount, f) == makeCount;
+	if (ok)
+		ok = fwrite(pool, 1, poolSize, f) == poolSize;
+	if (ok)
+		ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+	if (fclose(f) != 0 || !ok || rename(tmp, path) < 0)
+	{
+		perror(path);
+		unlink(tmp);
+		return -1;
+	}
+	return 0;
+}
+
+static int dump(const char *path)
+{
+	DTCdb db;
+	char code[6];
+	uint32_t i = 0, make;
+
+	if (DTCopen(&db, path) < 0)
+	{
+		fprintf(stderr, "dtcpack: %s is not a trouble code database\n", path);
+		return 1;
+	}
+	printf("# %s: %u codes, %u makes, %u byte pool\n", path, db.count, db.makeCount, db.poolSize);
+	// the entries are sorted by make, so each make's codes follow its section
+	for (make = 0; make <= db.makeCount; make++)
+	{
+		if (make > 0)
+			printf("\n[%s %s]\n", db.makes[make - 1].name, db.makes[make - 1].wmi);
+		for (; i < db.count && db.entries[i].key >> 16 == make; i++)
+		{
+			DTCformat(db.entries[i].key & 0xffff, code);
+			printf("%s\t%s\n", code, db.pool + db.entries[i].text);
+		}
+	}
+	DTCclose(&db);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *out = "dtc.db", *dumpPath = NULL;
+	int opt, i, errors = 0;
+	char code[6];
+
+	while ((opt = getopt(argc, argv, "o:d:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'o': out = optarg; break;
+			case 'd': dumpPath = optarg; break;
+			default:
+				errors++;
+				break;
+		}
+	}
+	if (dumpPath && !errors && optind == argc)
+		return dump(dumpPath);
+	if (errors || dumpPath || optind == argc)
+	{
+		fprintf(stderr, "usage: %s [-o database] source...\n       %s -d database\n", argv[0], argv[0]);
+		return 2;
+	}
+	for (i = optind; i < argc; i++)
+		if (readSource(argv[i]) < 0)
+			errors++;
+	qsort(entries, count, sizeof(Entry), byKey);
+	for (i = 1; i < (int)count; i++)
+	{
+		if (entries[i].key == entries[i - 1].key)
+		{
+			DTCformat(entries[i].key & 0xffff, code);
+			fprintf(stderr, "%s:%d: %s given again, first at %s:%d\n", entries[i].file, entries[i].line, code,
+				entries[i - 1].file, entries[i - 1].line);
+			errors++;
+		}
+	}
+	if (errors)
+		return 1;
+	if (poolSize == 0)
+		intern("");
+	if (writeDatabase(out) < 0)
+		return 1;
+	printf("%s: %u codes, %u makes, %u byte pool, %lu bytes\n", out, count, makeCount, poolSize,
+		(unsigned long)(sizeof(DTCheader) + count * sizeof(DTCentry) + makeCount * sizeof(DTCmake) + poolSize));
+	return 0;
+}
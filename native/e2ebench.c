@@ -0,0 +1,395 @@
+/*
+=================================================================================
+ Name        : e2ebench.c
+ Version     : 0.1
+
+ Description : End to end benchmark of the metric pipeline without a car.
+     Runs what automated-metric.py does with the native client and an
+     influxurl, in one process: the per-PID scheduler polling an adapter,
+     a sweep of the latest values every second, blocks of 12 sweeps into the
+     spool, and the uploader draining the spool on a thread of its own, the
+     POST made without the spool lock as uplPump() does. Feed it a recorded
+     drive and point it at httpsink:
+
+         ./httpsink &
+         ./elmsim -R drive.trc -L /tmp/elm &
+         ./e2ebench -d /tmp/elm -t 60
+
+     With -x N the whole pipeline runs N times faster: the PID rates and the
+     sweep cadence are multiplied by N, so elmsim -R drive.trc -x N keeps the
+     drive in step. It prints, every -i seconds, values/s, the spool depth,
+     rows delivered and resident memory, then the totals with percentiles of
+     the adapter round trip and of the time from a sweep to the server's
+     200 for it.
+
+     e2ebench -d device [-b baud] [-u url] [-t secs] [-x factor] [-k sweeps_per_block]
+              [-f flush_ms] [-i report_secs]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "elm327.h"
+#include "pidsched.h"
+#include "spool.h"
+#include "gorilla.h"
+#include "upload.h"
+
+#define RING 65536              // sweeps spooled and not yet delivered
+#define MAX_BLOCK 64
+
+typedef struct
+{
+	float *v;
+	uint32_t n, cap;
+} Samples;
+
+static Spool spool;
+static Uploader upl;
+static pthread_mutex_t spoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int producing = 1;
+
+// Sweep times of the spooled records, oldest first, to time their delivery
+static int64_t sweepAt[RING];
+static uint32_t sweepHead, sweepTail;
+static uint8_t recordSweeps[RING];
+static uint32_t recHead, recTail;
+static Samples requestMs, deliveryMs;
+static uint64_t delivered, depthMax;
+
+static int64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void addSample(Samples *s, double v)
+{
+	if (s->n == s->cap)
+	{
+		uint32_t cap = s->cap ? s->cap * 2 : 4096;
+		float *grown = realloc(s->v, cap * sizeof(float));
+
+		if (grown == NULL)
+			return;
+		s->v = grown;
+		s->cap = cap;
+	}
+	s->v[s->n++] = v;
+}
+
+static int cmpFloat(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void printPercentiles(const char *what, Samples *s)
+{
+	if (s->n == 0)
+	{
+		printf("%-22s no samples\n", what);
+		return;
+	}
+	qsort(s->v, s->n, sizeof(float), cmpFloat);
+	printf("%-22s p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f ms  (%u)\n", what, s->v[s->n / 2],
+		s->v[(uint32_t)(s->n * 0.9)], s->v[(uint32_t)(s->n * 0.99)], s->v[s->n - 1], s->n);
+}
+
+// VmRSS and VmHWM in kB
+static void memoryKb(long *rss, long *peak)
+{
+	char line[128];
+	FILE *f = fopen("/proc/self/status", "r");
+
+	*rss = *peak = 0;
+	if (f == NULL)
+		return;
+	while (fgets(line, sizeof(line), f))
+	{
+		if (strncmp(line, "VmRSS:", 6) == 0)
+			*rss = atol(line + 6);
+		else if (strncmp(line, "VmHWM:", 6) == 0)
+			*peak = atol(line + 6);
+	}
+	fclose(f);
+}
+
+static void *uploadThread(void *arg)
+{
+	int64_t drainUntil = 0;
+
+	(void)arg;
+	for (;;)
+	{
+		int rc, status, done = 0;
+		uint64_t before;
+
+		pthread_mutex_lock(&spoolMutex);
+		if (!producing && drainUntil == 0)
+			drainUntil = nowMs() + 30000;
+		if (!producing && (spool.pending == 0 || nowMs() > drainUntil))
+			done = 1;
+		rc = done ? 0 : UPLbatch(&upl, &spool, !producing);
+		pthread_mutex_unlock(&spoolMutex);
+		if (done)
+			break;
+		if (rc <= 0)
+		{
+			usleep(rc < 0 ? 200000 : 20000);
+			continue;
+		}
+		status = UPLsend(&upl);
+		pthread_mutex_lock(&spoolMutex);
+		before = spool.pending;
+		if (UPLsettle(&upl, &spool, status) > 0)
+		{
+			uint64_t n = before - spool.pending;
+			int64_t now = nowMs();
+
+			// every sweep in the records just committed has reached the server
+			while (n-- && recTail != recHead)
+			{
+				int k = recordSweeps[recTail++ % RING];
+
+				while (k-- && sweepTail != sweepHead)
+					addSample(&deliveryMs, now - sweepAt[sweepTail++ % RING]);
+				delivered++;
+			}
+		}
+		pthread_mutex_unlock(&spoolMutex);
+	}
+	return NULL;
+}
+
+// Spool a block of sweeps, as metricBlock in the script
+static int spoolBlock(GORblock *b, uint8_t *buf, int size, const int64_t *times, int sweeps)
+{
+	int len = GORfinish(b, buf, size), i;
+
+	if (len < 0)
+		return -1;
+	pthread_mutex_lock(&spoolMutex);
+	if (SPOOLput(&spool, buf, len) == 0)
+	{
+		for (i = 0; i < sweeps; i++)
+			sweepAt[sweepHead++ % RING] = times[i];
+		recordSweeps[recHead++ % RING] = sweeps;
+	}
+	if (spool.pending > depthMax)
+		depthMax = spool.pending;
+	pthread_mutex_unlock(&spoolMutex);
+	return len;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = NULL, *url = "http://127.0.0.1:8086/write";
+	char dir[] = "/tmp/e2ebench.XXXXXX", cmd[64];
+	uint8_t pids[256], ask[PS_DEPTH * ELM_MAX_BATCH], *buf;
+	ELMvalue vals[512];
+	const char *names[PS_MAX_PIDS];
+	double values[PS_MAX_PIDS], latest[256], factor = 1, start, elapsed;
+	uint8_t fresh[256];
+	int64_t times[MAX_BLOCK], nextSweep, nextReport, end, sweepMs;
+	int baud = 115200, secs = 60, perBlock = 12, flushMs = UPL_FLUSH_MS, reportSecs = 5, opt, n, i, sweeps = 0;
+	int bufSize = 1 << 20;
+	uint64_t valuesRead = 0, lastValues = 0, bytes = 0, left;
+	long rss, peak;
+	pthread_t uploader;
+	GORblock block;
+	UPLstats st;
+	PSsched s;
+	ELMconn c;
+
+	while ((opt = getopt(argc, argv, "d:b:u:t:x:k:f:i:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd': dev = optarg; break;
+			case 'b': baud = atoi(optarg); break;
+			case 'u': url = optarg; break;
+			case 't': secs = atoi(optarg); break;
+			case 'x': factor = atof(optarg); break;
+			case 'k': perBlock = atoi(optarg); break;
+			case 'f': flushMs = atoi(optarg); break;
+			case 'i': reportSecs = atoi(optarg); break;
+			default:
+				dev = NULL;
+				break;
+		}
+	}
+	if (dev == NULL || factor <= 0 || perBlock < 1 || perBlock > MAX_BLOCK || flushMs < 1 || reportSecs < 1)
+	{
+		fprintf(stderr, "usage: %s -d device [-b baud] [-u url] [-t secs] [-x factor] [-k sweeps_per_block] [-f flush_ms] [-i report_secs]\n",
+			argv[0]);
+		return 1;
+	}
+	if (ELMopen(&c, dev, baud) < 0 || ELMinit(&c) < 0)
+	{
+		fprintf(stderr, "e2ebench: no adapter on %s\n", dev);
+		return 1;
+	}
+	if (mkdtemp(dir) == NULL || SPOOLopen(&spool, dir, 0, 0) < 0 || UPLopen(&upl, url, UPL_MAX_BYTES, flushMs) < 0)
+	{
+		fprintf(stderr, "e2ebench: cannot set up spool in %s or uploader for %s\n", dir, url);
+		return 1;
+	}
+	buf = malloc(bufSize);
+	GORbegin(&block, "obd,vehicle=BENCH0001");
+
+	n = ELMsupportedList(&c, pids, sizeof(pids));
+	PSinit(&s, c.batch, 0, nowMs());
+	for (i = 0; i < n; i++)
+	{
+		double hz;
+		int prio;
+
+		PSdefaults(pids[i], &hz, &prio);
+		PSadd(&s, OBDpidInfo(pids[i]), hz * factor, prio, nowMs());
+	}
+	memset(fresh, 0, sizeof(fresh));
+	pthread_create(&uploader, NULL, uploadThread, NULL);
+	printf("%d PIDs at %.1fx, sweeps every %.0f ms, %d per block, batches flushed after %d ms\n", n, factor,
+		1000 / factor, perBlock, flushMs);
+	printf("%6s %10s %8s %10s %8s\n", "secs", "values/s", "spooled", "delivered", "rss kB");
+
+	start = nowSec();
+	sweepMs = (int64_t)(1000 / factor);
+	if (sweepMs < 1)
+		sweepMs = 1;
+	nextSweep = nowMs() + sweepMs;
+	nextReport = nowMs() + reportSecs * 1000;
+	end = nowMs() + secs * 1000LL;
+	while (nowMs() < end)
+	{
+		int64_t now = nowMs();
+		int askN = PSnext(&s, now, ask, sizeof(ask)), got, cols = 0;
+
+		if (askN > 0)
+		{
+			double q0 = nowSec();
+
+			got = ELMquery(&c, ask, askN, vals, 512);
+			addSample(&requestMs, (nowSec() - q0) * 1000);   // up to PS_DEPTH pipelined requests
+			if (got > 0)
+			{
+				PSupdate(&s, nowMs(), vals, got);
+				valuesRead += got;
+				for (i = 0; i < got; i++)
+				{
+					latest[vals[i].pid->pid] = vals[i].value;
+					fresh[vals[i].pid->pid] = 1;
+				}
+			}
+		}
+		else if (nextSweep > now)
+		{
+			int idle = PSidleMs(&s, now);
+
+			usleep((idle < nextSweep - now ? idle : nextSweep - now) * 1000);
+		}
+
+		now = nowMs();
+		if (now >= nextSweep)
+		{
+			// the latest value of every PID polled since the last sweep
+			for (i = 0; i < 256; i++)
+				if (fresh[i])
+				{
+					names[cols] = OBDpidInfo(i)->name;
+					values[cols++] = latest[i];
+					fresh[i] = 0;
+				}
+			if (cols)
+			{
+				times[sweeps++] = now;
+				GORadd(&block, now, names, values, cols);
+			}
+			if (sweeps == perBlock)
+			{
+				int len = spoolBlock(&block, buf, bufSize, times, sweeps);
+
+				if (len > 0)
+					bytes += len;
+				sweeps = 0;
+			}
+			nextSweep += sweepMs;
+			if (nextSweep < now)
+				nextSweep = now + sweepMs;
+		}
+		if (now >= nextReport)
+		{
+			uint64_t depth;
+
+			pthread_mutex_lock(&spoolMutex);
+			depth = spool.pending;
+			pthread_mutex_unlock(&spoolMutex);
+			memoryKb(&rss, &peak);
+			printf("%6.0f %10.0f %8llu %10llu %8ld\n", nowSec() - start, (valuesRead - lastValues) / (double)reportSecs,
+				(unsigned long long)depth, (unsigned long long)delivered, rss);
+			fflush(stdout);
+			lastValues = valuesRead;
+			nextReport += reportSecs * 1000;
+		}
+	}
+	elapsed = nowSec() - start;
+	if (sweeps)
+	{
+		int len = spoolBlock(&block, buf, bufSize, times, sweeps);
+
+		if (len > 0)
+			bytes += len;
+	}
+	producing = 0;
+	pthread_join(uploader, NULL);
+
+	UPLgetStats(&upl, &st);
+	memoryKb(&rss, &peak);
+	left = spool.pending;
+	printf("\n%llu values in %.1f s, %.0f values/s, %llu requests, %.1f requests/s\n", (unsigned long long)valuesRead,
+		elapsed, valuesRead / elapsed, (unsigned long long)s.requests, s.requests / elapsed);
+	printf("%llu blocks spooled (%.1f kB), %llu delivered, %llu left, deepest spool %llu records\n",
+		(unsigned long long)recHead, bytes / 1024.0, (unsigned long long)delivered, (unsigned long long)left,
+		(unsigned long long)depthMax);
+	printf("%llu rows in %llu batches, %u retries, %.1f kB on the wire\n", (unsigned long long)st.rows,
+		(unsigned long long)st.batches, st.failures, (st.wireOut + st.wireIn) / 1024.0);
+	printPercentiles("adapter query", &requestMs);
+	printPercentiles("sweep to server", &deliveryMs);
+	printf("memory rss %ld kB, peak %ld kB\n", rss, peak);
+
+	UPLclose(&upl);
+	SPOOLclose(&spool);
+	GORfree(&block);
+	ELMclose(&c);
+	free(buf);
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	if (system(cmd) != 0)
+		fprintf(stderr, "e2ebench: could not remove %s\n", dir);
+	return left ? 1 : 0;
+}
@@ -0,0 +1,693 @@
+/*
+=================================================================================
+ Name        : elm327.c
+ Version     : 0.1
+
+ Description : Native client for ELM327/STN OBD-II adapters, see elm327.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "elm327.h"
+
+// one reassembled ISO-TP message per responder
+typedef struct
+{
+	uint16_t ecu;
+	uint16_t need;
+	uint16_t len;
+	uint8_t data[256];
+} Message;
+
+static int64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static speed_t baudFlag(int baud)
+{
+	switch (baud)
+	{
+		case 9600:   return B9600;
+		case 19200:  return B19200;
+		case 38400:  return B38400;
+		case 57600:  return B57600;
+		case 115200: return B115200;
+		case 230400: return B230400;
+		case 460800: return B460800;
+		case 500000: return B500000;
+	}
+	return 0;
+}
+
+int ELMopen(ELMconn *c, const char *dev, int baud)
+{
+	struct termios tio;
+	speed_t speed = baudFlag(baud);
+
+	memset(c, 0, sizeof(*c));
+	c->timeoutMs = 1000;
+	c->batch = 1;
+	c->fd = open(dev, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (c->fd < 0)
+		return -1;
+	if (tcgetattr(c->fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		if (speed)
+		{
+			cfsetispeed(&tio, speed);
+			cfsetospeed(&tio, speed);
+		}
+		tcsetattr(c->fd, TCSANOW, &tio);
+		tcflush(c->fd, TCIOFLUSH);
+	}
+	return 0;
+}
+
+void ELMclose(ELMconn *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+}
+
+static int sendLine(ELMconn *c, const char *line)
+{
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%s\r", line);
+
+	if (len >= (int)sizeof(buf) || write(c->fd, buf, len) != len)
+		return -1;
+	c->stats.bytesOut += len;
+	return 0;
+}
+
+// Read until the '>' prompt and copy everything before it to reply.
+static int readPrompt(ELMconn *c, char *reply, int size, int timeoutMs)
+{
+	int64_t deadline = nowMs() + timeoutMs;
+	struct pollfd pfd;
+	char *prompt;
+	int n, len;
+
+	pfd.fd = c->fd;
+	pfd.events = POLLIN;
+	while ((prompt = memchr(c->rx, '>', c->rxLen)) == NULL)
+	{
+		int left = (int)(deadline - nowMs());
+
+		if (c->rxLen >= ELM_RX_SIZE)
+			c->rxLen = 0;       // runaway reply, drop it and keep looking for the prompt
+		if (left <= 0 || poll(&pfd, 1, left) <= 0)
+		{
+			c->stats.timeouts++;
+			c->rxLen = 0;
+			return -1;
+		}
+		n = read(c->fd, c->rx + c->rxLen, ELM_RX_SIZE - c->rxLen);
+		if (n <= 0)
+		{
+			c->rxLen = 0;
+			return -1;
+		}
+		c->rxLen += n;
+		c->stats.bytesIn += n;
+	}
+	len = prompt - c->rx;
+	if (len > size - 1)
+		len = size - 1;
+	memcpy(reply, c->rx, len);
+	reply[len] = 0;
+	c->rxLen -= prompt + 1 - c->rx;
+	memmove(c->rx, prompt + 1, c->rxLen);
+	return len;
+}
+
+
+static int hexval(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	return -1;
+}
+
+// Settings whose state is remembered, by the command that sets them and the
+// hex digits their argument takes. The protocol commands share a kind.
+#define KIND_PROTOCOL 6
+#define KIND_HEADER 7
+static const struct
+{
+	const char *prefix;
+	int kind;
+	int argDigits;
+} kinds[] = {
+	{ "ATE", 0, 1 }, { "ATL", 1, 1 }, { "ATS", 2, 1 }, { "ATH", 3, 1 }, { "ATAT", 4, 1 },
+	{ "ATST", 5, 2 }, { "ATSP", KIND_PROTOCOL, 2 }, { "ATTP", KIND_PROTOCOL, 2 },
+	{ "STP", KIND_PROTOCOL, 3 }, { "ATSH", KIND_HEADER, 8 }, { "ATCAF", 8, 1 }, { "ATCRA", 9, 8 },
+	{ NULL, 0, 0 }
+};
+
+static const char *modes[] = { "ATE0", "ATL0", "ATS0", "ATH1", "ATAT1", NULL };
+
+// Upper case without spaces, the way the adapter reads it
+static void canonical(const char *cmd, char *out, int size)
+{
+	int n = 0;
+
+	for (; *cmd && n < size - 1; cmd++)
+		if (*cmd != ' ')
+			out[n++] = (*cmd >= 'a' && *cmd <= 'z') ? *cmd - 'a' + 'A' : *cmd;
+	out[n] = 0;
+}
+
+// Kind of setting, longest matching prefix, -1 if the command is not one
+static int settingKind(const char *cmd)
+{
+	int i, j, best = -1, bestLen = 0;
+
+	for (i = 0; kinds[i].prefix; i++)
+	{
+		int len = strlen(kinds[i].prefix), arg = strlen(cmd) - len;
+
+		if (len <= bestLen || strncmp(cmd, kinds[i].prefix, len) || arg > kinds[i].argDigits ||
+			(arg == 0 && kinds[i].kind != 9))
+			continue;
+		for (j = len; cmd[j] && hexval(cmd[j]) >= 0; j++)
+			;
+		if (cmd[j])
+			continue;
+		best = kinds[i].kind;
+		bestLen = len;
+	}
+	return best;
+}
+
+int ELMcommand(ELMconn *c, const char *cmd, char *reply, int size)
+{
+	char canon[16];
+	int kind, len;
+
+	if (c->fd < 0 || sendLine(c, cmd) < 0)
+		return -1;
+	len = readPrompt(c, reply, size, c->timeoutMs);
+	canonical(cmd, canon, sizeof(canon));
+	kind = settingKind(canon);
+	if (strcmp(canon, "ATZ") == 0 || strcmp(canon, "ATWS") == 0 || strcmp(canon, "ATD") == 0)
+	{
+		memset(c->setting, 0, sizeof(c->setting));
+		c->stats.settings++;
+	}
+	else if (kind >= 0)
+	{
+		// anything but OK leaves the adapter's state unknown
+		if (len >= 0 && strstr(reply, "OK"))
+			strcpy(c->setting[kind], canon);
+		else
+			c->setting[kind][0] = 0;
+		c->stats.settings++;
+	}
+	return len;
+}
+
+int ELMset(ELMconn *c, const char *cmd)
+{
+	char reply[ELM_RX_SIZE], canon[16];
+	int kind;
+
+	canonical(cmd, canon, sizeof(canon));
+	kind = settingKind(canon);
+	if (kind >= 0 && strcmp(c->setting[kind], canon) == 0)
+	{
+		c->stats.cached++;
+		return 0;
+	}
+	if (ELMcommand(c, cmd, reply, sizeof(reply)) < 0 || strstr(reply, "OK") == NULL)
+		return -1;
+	return 0;
+}
+
+// Turns one complete message into whatever the request asked for, stored
+// from out[n] on; returns how many it stored.
+typedef int (*Decoder)(ELMconn *c, const Message *m, void *out, int n, int max);
+
+// Decode every PID in a complete "41 pid data pid data ..." payload.
+static int decodeValues(ELMconn *c, const Message *m, void *values, int first, int max)
+{
+	ELMvalue *out = (ELMvalue *)values + first;
+	int i = 1, n = 0;
+
+	max -= first;
+	if (m->len < 2 || m->data[0] != 0x41)
+		return 0;
+	while (i < m->len && n < max)
+	{
+		const OBDpid *p = OBDpidInfo(m->data[i]);
+
+		// an unknown PID leaves us without a length for the rest
+		if (p == NULL || i + 1 + p->bytes > m->len)
+			break;
+		out[n].ecu = m->ecu;
+		out[n].pid = p;
+		out[n].value = OBDdecode(p, m->data + i + 1);
+		n++;
+		i += 1 + p->bytes;
+	}
+	c->stats.values += n;
+	return n;
+}
+
+// Mode 03 stored trouble codes, two bytes each. CAN replies give the count
+// first; the others are three codes a line, padded with zeros. Several ECUs
+// may report the same code, it is kept once.
+static int decodeCodes(ELMconn *c, const Message *m, void *codes, int first, int max)
+{
+	uint16_t *out = codes;
+	int i = c->protocol >= '6' && c->protocol <= '9' ? 2 : 1, n = first, j;
+
+	if (m->len < 1 || m->data[0] != 0x43)
+		return 0;
+	for (; i + 1 < m->len && n < max; i += 2)
+	{
+		uint16_t code = m->data[i] << 8 | m->data[i + 1];
+
+		if (code == 0)
+			continue;
+		for (j = 0; j < n && out[j] != code; j++)
+			;
+		if (j == n)
+			out[n++] = code;
+	}
+	return n - first;
+}
+
+// Parse one reply (all lines up to the prompt). Sets *partial if a
+// multi-frame message was cut short.
+static int parseReply(ELMconn *c, char *text, Decoder decode, void *out, int max, int *partial)
+{
+	Message msgs[ELM_MAX_ECUS];
+	int nmsgs = 0, n = 0, i;
+	char *line, *save;
+
+	*partial = 0;
+	for (line = strtok_r(text, "\r\n", &save); line; line = strtok_r(NULL, "\r\n", &save))
+	{
+		uint8_t bytes[128];
+		int nbytes = 0, digits = 0, hex = 1;
+		uint32_t hdr = 0;
+		Message *m;
+		char *s;
+
+		for (s = line; *s; s++)
+		{
+			if (*s == ' ')
+				continue;
+			if (hexval(*s) < 0)
+			{
+				hex = 0;
+				break;
+			}
+			if (digits < c->hdrDigits)
+				hdr = (hdr << 4) | hexval(*s);
+			else if (nbytes < (int)sizeof(bytes) && (digits - c->hdrDigits) % 2)
+				bytes[nbytes++] |= hexval(*s);
+			else if (nbytes < (int)sizeof(bytes))
+				bytes[nbytes] = hexval(*s) << 4;
+			digits++;
+		}
+		if (!hex)
+		{
+			if (strncmp(line, "SEARCHING", 9) != 0 && strncmp(line, "BUS INIT", 8) != 0)
+				c->stats.noData++;
+			continue;
+		}
+		if (c->checksum && nbytes)
+			nbytes--;
+		if (digits < c->hdrDigits + 2 || nbytes == 0)
+			continue;
+		c->stats.frames++;
+
+		for (m = NULL, i = 0; i < nmsgs; i++)
+			if (msgs[i].ecu == (uint16_t)hdr)
+				m = &msgs[i];
+		if (m == NULL)
+		{
+			if (nmsgs == ELM_MAX_ECUS)
+				continue;
+			m = &msgs[nmsgs++];
+			m->ecu = hdr;
+			m->need = 0;
+			m->len = 0;
+		}
+		if (!(c->protocol >= '6' && c->protocol <= '9'))
+		{
+			// K-line and J1850 answer one PID per line, no transport layer
+			memcpy(m->data, bytes, nbytes);
+			m->len = nbytes;
+			n += decode(c, m, out, n, max);
+			continue;
+		}
+		switch (bytes[0] >> 4)
+		{
+			case 0:     // single frame
+				m->len = bytes[0] & 0x0f;
+				if (m->len > nbytes - 1)
+					m->len = nbytes - 1;
+				memcpy(m->data, bytes + 1, m->len);
+				n += decode(c, m, out, n, max);
+				m->need = 0;
+				break;
+			case 1:     // first frame, 12 bit length
+				if (nbytes < 2)
+					break;
+				m->need = ((bytes[0] & 0x0f) << 8) | bytes[1];
+				if (m->need > sizeof(m->data))
+					m->need = sizeof(m->data);
+				m->len = nbytes - 2;
+				memcpy(m->data, bytes + 2, m->len);
+				break;
+			case 2:     // consecutive frame
+				if (m->need == 0)
+					break;
+				for (i = 1; i < nbytes && m->len < m->need; i++)
+					m->data[m->len++] = bytes[i];
+				if (m->len >= m->need)
+				{
+					n += decode(c, m, out, n, max);
+					m->need = 0;
+				}
+				break;
+		}
+	}
+	for (i = 0; i < nmsgs; i++)
+		if (msgs[i].need)
+			*partial = 1;
+	return n;
+}
+
+// Number of CAN frames a single ECU needs to answer this batch, for the
+// response count hint.
+static int framesFor(const OBDpid **batch, int n)
+{
+	int len = 1, i;
+
+	for (i = 0; i < n; i++)
+		len += 1 + batch[i]->bytes;
+	if (len <= 7)
+		return 1;
+	return 1 + (len - 6 + 6) / 7;
+}
+
+static int sendBatch(ELMconn *c, const OBDpid **batch, int n)
+{
+	char req[32];
+	int len, i;
+
+	len = sprintf(req, "01");
+	for (i = 0; i < n; i++)
+		len += sprintf(req + len, "%02X", batch[i]->pid);
+	if (c->hint && framesFor(batch, n) < 16)
+		sprintf(req + len, "%X", framesFor(batch, n));
+	c->stats.requests++;
+	return sendLine(c, req);
+}
+
+// An adapter that has not answered in time is stopped with a CR, which ends in
+// a prompt; one kept as a line of its own (a repeat of the request, or nothing)
+// brings another, so prompts are read until the line goes quiet. The next
+// reply read is then the next request's.
+static int resync(ELMconn *c)
+{
+	char junk[ELM_RX_SIZE];
+	int prompts = 0;
+
+	if (sendLine(c, "") < 0)
+		return -1;
+	while (prompts < 4 && readPrompt(c, junk, sizeof(junk), c->timeoutMs) >= 0)
+		prompts++;
+	return prompts ? 0 : -1;
+}
+
+int ELMquery(ELMconn *c, const uint8_t *pids, int n, ELMvalue *out, int max)
+{
+	const OBDpid *batches[256][ELM_MAX_BATCH];
+	int sizes[256], nb = 0, got = 0, b, i;
+	char reply[ELM_RX_SIZE];
+
+	if (c->fd < 0)
+		return -1;
+	// an action may have left the adapter on another protocol or header
+	if (c->pollProtocol[0] && (ELMset(c, c->pollProtocol) < 0 || ELMset(c, c->pollHeader) < 0))
+		return -1;
+	memset(sizes, 0, sizeof(sizes));
+	for (i = 0; i < n && nb < 256; i++)
+	{
+		const OBDpid *p = OBDpidInfo(pids[i]);
+
+		if (p == NULL)
+			continue;
+		if (sizes[nb] == c->batch)
+			nb++;
+		if (nb < 256)
+			batches[nb][sizes[nb]++] = p;
+	}
+	if (nb < 256 && sizes[nb])
+		nb++;
+	if (nb == 0)
+		return 0;
+
+	// Keep the adapter busy: the next request goes out the moment the
+	// prompt for the previous one arrives, then the previous reply is parsed.
+	// Without a prompt nothing more is sent until the adapter is back in step.
+	if (sendBatch(c, batches[0], sizes[0]) < 0)
+		return -1;
+	for (b = 0; b < nb; b++)
+	{
+		int partial, len = readPrompt(c, reply, sizeof(reply), c->timeoutMs);
+
+		// A request sent now would stop one still being answered, and its late
+		// prompt would be taken for the next reply: wait as long again first
+		if (len < 0 && (len = readPrompt(c, reply, sizeof(reply), c->timeoutMs)) < 0 && resync(c) < 0)
+			return got;     // not answering at all, give up on this sweep
+		if (b + 1 < nb && sendBatch(c, batches[b + 1], sizes[b + 1]) < 0)
+			return -1;
+		if (len < 0)
+			continue;
+		got += parseReply(c, reply, decodeValues, out + got, max - got, &partial);
+		// the count hint cut a reply short, fall back to the adapter timeout
+		if (partial && c->hint)
+			c->hint = 0;
+	}
+	return got;
+}
+
+static void markSupported(ELMconn *c, const ELMvalue *v, int n)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++)
+	{
+		uint8_t base = v[i].pid->pid;
+		uint32_t bits = (uint32_t)v[i].value;
+
+		if (base % 0x20 || v[i].pid->bytes != 4)
+			continue;
+		for (j = 0; j < 32; j++)
+			if (bits & (1u << (31 - j)))
+				c->supported[(base + 1 + j) >> 5] |= 1u << ((base + 1 + j) & 31);
+	}
+}
+
+// Header of the OBD functional request, what the adapter defaults to
+static const char *defaultHeader(char protocol)
+{
+	switch (protocol)
+	{
+		case '1': return "ATSH616AF1";
+		case '2': case '3': return "ATSH686AF1";
+		case '4': case '5': return "ATSHC133F1";
+		case '7': case '9': return "ATSH18DB33F1";
+	}
+	return "ATSH7DF";
+}
+
+int ELMstart(ELMconn *c)
+{
+	char reply[ELM_RX_SIZE];
+	int i;
+
+	if (c->fd < 0)
+		return -1;
+	c->started = 0;
+	c->rxLen = 0;
+	c->pollProtocol[0] = 0;
+	memset(c->setting, 0, sizeof(c->setting));
+	tcflush(c->fd, TCIOFLUSH);
+
+	// A bare CR would repeat the adapter's last command, so go straight to ATZ
+	if (sendLine(c, "ATZ") < 0 || readPrompt(c, reply, sizeof(reply), 3000) < 0)
+		return -1;
+	c->stats.settings++;
+	for (i = 0; modes[i]; i++)
+		if (ELMset(c, modes[i]) < 0)
+			return -1;
+	c->started = 1;
+	return 0;
+}
+
+int ELMinit(ELMconn *c)
+{
+	char reply[ELM_RX_SIZE], probe[ELM_RX_SIZE];
+	uint16_t seen[ELM_MAX_ECUS];
+	ELMvalue vals[ELM_MAX_ECUS];
+	int i, j, n, partial;
+
+	if (c->fd < 0 || (!c->started && ELMstart(c) < 0))
+		return -1;
+	memset(c->supported, 0, sizeof(c->supported));
+	c->hint = 0;
+	c->batch = 1;
+	c->ecus = 0;
+	c->pollProtocol[0] = 0;
+
+	// The probe has to go out on the default header of whatever protocol is
+	// found; ATD restores it without a reset, then the modes are put back
+	if (c->setting[KIND_HEADER][0])
+	{
+		if (ELMcommand(c, "ATD", reply, sizeof(reply)) < 0)
+			return -1;
+		for (i = 0; modes[i]; i++)
+			if (ELMset(c, modes[i]) < 0)
+				return -1;
+	}
+	if (ELMset(c, "ATSP0") < 0)
+		return -1;
+
+	// First request runs the protocol search, which can take several seconds
+	if (sendLine(c, "0100") < 0 || readPrompt(c, probe, sizeof(probe), 10000) < 0)
+		return -1;
+	if (ELMcommand(c, "ATDPN", reply, sizeof(reply)) < 1)
+		return -1;
+	for (i = 0; reply[i] && reply[i] != '\r'; i++)
+		;
+	c->protocol = i ? reply[i - 1] : 0;
+	if (c->protocol >= '6' && c->protocol <= '9')
+	{
+		c->hdrDigits = (c->protocol == '7' || c->protocol == '9') ? 8 : 3;
+		c->checksum = 0;
+		c->batch = ELM_MAX_BATCH;
+	}
+	else if (c->protocol >= '1' && c->protocol <= '5')
+	{
+		c->hdrDigits = 6;
+		c->checksum = 1;
+		c->batch = 1;
+	}
+	else
+		return -1;
+
+	n = parseReply(c, probe, decodeValues, vals, ELM_MAX_ECUS, &partial);
+	for (i = 0; i < n; i++)
+	{
+		for (j = 0; j < c->ecus; j++)
+			if (seen[j] == vals[i].ecu)
+				break;
+		if (j == c->ecus && c->ecus < ELM_MAX_ECUS)
+			seen[c->ecus++] = vals[i].ecu;
+	}
+	if (c->ecus == 0)
+		return -1;
+	markSupported(c, vals, n);
+
+	// The search left the adapter on that protocol with its default header,
+	// which is what polling goes back to after an action
+	snprintf(c->pollProtocol, sizeof(c->pollProtocol), "ATSP%c", c->protocol);
+	strcpy(c->pollHeader, defaultHeader(c->protocol));
+	strcpy(c->setting[KIND_PROTOCOL], c->pollProtocol);
+	strcpy(c->setting[KIND_HEADER], c->pollHeader);
+
+	// The count hint only works when exactly one ECU answers
+	c->hint = c->ecus == 1;
+	for (i = 0x20; i < 0x100 && ELMisSupported(c, i); i += 0x20)
+	{
+		uint8_t pid = i;
+
+		n = ELMquery(c, &pid, 1, vals, ELM_MAX_ECUS);
+		if (n <= 0)
+			break;
+		markSupported(c, vals, n);
+	}
+	return 0;
+}
+
+int ELMisSupported(const ELMconn *c, uint8_t pid)
+{
+	return (c->supported[pid >> 5] >> (pid & 31)) & 1;
+}
+
+int ELMsupportedList(const ELMconn *c, uint8_t *pids, int max)
+{
+	int i, n = 0;
+
+	for (i = 0; i < OBDpidCount && n < max; i++)
+		if (OBDpids[i].pid % 0x20 && ELMisSupported(c, OBDpids[i].pid))
+			pids[n++] = OBDpids[i].pid;
+	return n;
+}
+
+int ELMcodes(ELMconn *c, uint16_t *codes, int max)
+{
+	char reply[ELM_RX_SIZE];
+	int partial;
+
+	if (c->fd < 0)
+		return -1;
+	if (c->pollProtocol[0] && (ELMset(c, c->pollProtocol) < 0 || ELMset(c, c->pollHeader) < 0))
+		return -1;
+	c->stats.requests++;
+	if (ELMcommand(c, "03", reply, sizeof(reply)) < 0)
+		return -1;
+	// NO DATA is an ECU with nothing stored
+	return parseReply(c, reply, decodeCodes, codes, max, &partial);
+}
+
+int ELMaction(ELMconn *c, const char *protocol, const char *header, const char *data, char *reply, int size)
+{
+	if (c->fd < 0 || (!c->started && ELMstart(c) < 0))
+		return -1;
+	if ((protocol && ELMset(c, protocol) < 0) || (header && ELMset(c, header) < 0))
+		return -1;
+	c->stats.actions++;
+	return ELMcommand(c, data, reply, size);
+}
+
+void ELMgetStats(const ELMconn *c, ELMstats *s)
+{
+	*s = c->stats;
+}
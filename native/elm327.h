@@ -0,0 +1,99 @@
+/*
+=================================================================================
+ Name        : elm327.h
+ Version     : 0.1
+
+ Description : Native client for ELM327/STN OBD-II adapters on a serial port.
+     The adapter is kept in echo off, headers on, no linefeeds, no spaces
+     mode. Mode 01 PIDs are requested up to six at a time on CAN buses, and
+     when a single ECU answers the request carries the expected response count
+     so the adapter returns as soon as the last frame arrives instead of waiting
+     out its timeout. The next request goes out as soon as the '>' prompt is
+     seen; the previous reply is parsed while the adapter is busy with it.
+
+     The adapter is reset once per session. After that the client remembers
+     which AT/ST settings are in effect (modes, protocol, header) and
+     ELMset() only sends the ones that would change something, so frames
+     for other modules (ELMaction()) can go out between Mode 01 requests and
+     polling picks up again with at most a protocol and a header command.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef ELM327_H
+#define ELM327_H
+
+#include <stdint.h>
+#include "obd_pids.h"
+
+#define ELM_MAX_BATCH 6         // PIDs per Mode 01 request allowed by J1979 on CAN
+#define ELM_RX_SIZE 2048
+#define ELM_MAX_ECUS 8
+#define ELM_SETTINGS 10         // kinds of AT/ST setting whose state is remembered
+#define ELM_MAX_CODES 64        // stored trouble codes ELMcodes() is asked for at most
+
+typedef struct
+{
+	uint32_t requests;      // Mode 01 requests sent
+	uint32_t frames;        // response lines accepted
+	uint32_t values;        // PID values decoded
+	uint32_t noData;        // NO DATA / STOPPED / error replies
+	uint32_t timeouts;      // no prompt within timeoutMs
+	uint32_t settings;      // AT/ST settings sent
+	uint32_t cached;        // settings already in effect, not sent
+	uint32_t actions;       // ELMaction() frames sent
+	uint64_t bytesOut;
+	uint64_t bytesIn;
+} ELMstats;
+
+typedef struct
+{
+	uint16_t ecu;           // CAN id or source address of the responder
+	const OBDpid *pid;
+	double value;
+} ELMvalue;
+
+typedef struct
+{
+	int fd;
+	int timeoutMs;          // per request, default 1000
+	char protocol;          // ATDPN digit, '6'..'9' are CAN
+	uint8_t hdrDigits;      // hex digits of header in front of each response line
+	uint8_t checksum;       // non-CAN lines end with a checksum byte
+	uint8_t ecus;           // distinct responders seen on 0100
+	uint8_t batch;          // PIDs per request, 1 unless the bus is CAN
+	uint8_t hint;           // append the response count to requests
+	uint32_t supported[8];  // Mode 01 PIDs 0x00-0xFF any ECU reported
+	uint8_t started;        // ELMstart() has reset the adapter since the port was opened
+	char setting[ELM_SETTINGS][16];  // command last applied per kind, "" = not known
+	char pollProtocol[8];   // ATSP of the protocol ELMinit() found
+	char pollHeader[16];    // ATSH of the OBD functional request on it
+	char rx[ELM_RX_SIZE];
+	int rxLen;
+	ELMstats stats;
+} ELMconn;
+
+// all int calls return -1 on failure
+ int ELMopen(ELMconn *c, const char *dev, int baud);   // raw 8N1, baud 0 = leave as is
+ void ELMclose(ELMconn *c);
+ int ELMcommand(ELMconn *c, const char *cmd, char *reply, int size);  // one line in, text up to the prompt out
+ int ELMstart(ELMconn *c);         // reset and set modes, once per session
+ int ELMinit(ELMconn *c);          // ELMstart() if needed, detect protocol and supported PIDs
+ int ELMset(ELMconn *c, const char *cmd);  // AT/ST setting, sent only if not already in effect
+ int ELMaction(ELMconn *c, const char *protocol, const char *header, const char *data, char *reply, int size);  // NULL keeps it
+ int ELMcodes(ELMconn *c, uint16_t *codes, int max);   // Mode 03 stored trouble codes in their two byte J2012 form, each once
+ int ELMisSupported(const ELMconn *c, uint8_t pid);
+ int ELMsupportedList(const ELMconn *c, uint8_t *pids, int max);   // accepted Mode 01 PIDs, in order
+ int ELMquery(ELMconn *c, const uint8_t *pids, int n, ELMvalue *out, int max);  // returns values decoded
+ void ELMgetStats(const ELMconn *c, ELMstats *s);
+
+#endif
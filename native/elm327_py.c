@@ -0,0 +1,613 @@
+/*
+=================================================================================
+ Name        : elm327_py.c
+ Version     : 0.1
+
+ Description : Python bindings for the native ELM327 client, built as elm.so.
+
+     elmOpen(string device, int baud)  - open the serial port, 0 or -1
+     elmStart()                        - reset the adapter and set its modes, once
+                                       per session, 0 or -1
+     elmInit()                         - find the protocol and supported PIDs,
+                                       starting the session first if needed, 0 or -1
+     elmSupported()                    - list of supported metric names
+     elmQuery(list names)              - dict of name: value for one sweep
+     elmCommand(string cmd)            - raw reply text, None on timeout
+     elmAction(string protocol, string header, string data) - send one frame
+                                       to another module on the open session,
+                                       e.g. ('STP31', 'ATSH1C0', '24746C901100').
+                                       Protocol and header are only sent when
+                                       not already in effect, None leaves them.
+                                       Goes out between two polling requests.
+                                       Reply text, None on failure
+     elmCodes()                        - stored trouble codes (Mode 03) as a list
+                                       of strings such as 'P0301', None on failure
+     elmStats()                        - dict of client counters
+     elmClose()
+
+     elmSchedule(list pids, int maxRequestsPerSec) - poll each PID at its own
+                                       rate; items are names or (name, hz, priority)
+                                       tuples, hz 0 picks the built in rate. 0 or -1
+     elmPoll(float seconds)            - run the schedule that long, dict of the
+                                       latest value of every PID polled meanwhile
+     elmScheduleStats()                - dict of name: dict of rate, jitter, missed
+
+     elmBus()                          - publish every value elmPoll() reads to the
+                                       shared memory metric bus for the dashboard,
+                                       0 or -1
+     elmBusPut(string name, float value) - publish one value (python-obd readings)
+
+     elmRollup(list pids, list windowSecs) - summarise every value elmPoll()
+                                       reads into tumbling windows of these
+                                       lengths; items are names or (name, [secs])
+                                       tuples, [] leaves a PID out. 0 or -1
+     elmRollups(int all)               - windows closed so far (all: every open
+                                       window too), list of (windowSecs,
+                                       startTime, dict of NAME_count, NAME_min,
+                                       NAME_max, NAME_mean, NAME_last, NAME_p95)
+
+     Names are the python-obd command names used in acceptedMetrics. When
+     several ECUs answer the same PID the first one wins, like python-obd.
+     Calls from different threads take turns on the link, actions first.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <Python.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "elm327.h"
+#include "pidsched.h"
+#include "rollup.h"
+#include "metricbus.h"
+#include "dtcdb.h"
+
+static ELMconn conn = { -1 };
+static PSsched sched;
+static int haveSched = 0;
+static pthread_mutex_t linkMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int actionsWaiting = 0;   // elmPoll() stands aside while non zero
+static ROLLup rollups;
+static int16_t rollByPid[256];
+static int haveRollups = 0;
+static pthread_mutex_t rollMutex = PTHREAD_MUTEX_INITIALIZER;   // rollups and the bus writer
+static MBUSbus bus;
+
+static int64_t nowMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t wallMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Take the link; urgent callers are let in before elmPoll()'s next request
+static void linkLock(int urgent)
+{
+  if (urgent)
+    __sync_fetch_and_add(&actionsWaiting, 1);
+  pthread_mutex_lock(&linkMutex);
+  if (urgent)
+    __sync_fetch_and_sub(&actionsWaiting, 1);
+}
+
+static void linkUnlock(void)
+{
+  pthread_mutex_unlock(&linkMutex);
+}
+
+static const OBDpid *pidFromObject(PyObject *item)
+{
+  if (PyString_Check(item))
+    return OBDpidByName(PyString_AsString(item));
+  if (PyInt_Check(item))
+    return OBDpidInfo(PyInt_AsLong(item) & 0xff);
+  return NULL;
+}
+
+static PyObject* py_elmOpen(PyObject* self, PyObject* args)
+{
+  const char *dev;
+  int baud = 115200, rc;
+
+  if (!PyArg_ParseTuple(args, "s|i", &dev, &baud))
+    return Py_BuildValue("i", -1);
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  ELMclose(&conn);
+  rc = ELMopen(&conn, dev, baud);
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("i", rc);
+}
+
+static PyObject* py_elmStart(PyObject* self, PyObject* args)
+{
+  int rc;
+
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  rc = ELMstart(&conn);
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("i", rc);
+}
+
+static PyObject* py_elmInit(PyObject* self, PyObject* args)
+{
+  int rc;
+
+  // Reset takes up to a few seconds, let the other threads run meanwhile
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  rc = ELMinit(&conn);
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("i", rc);
+}
+
+static PyObject* py_elmSupported(PyObject* self, PyObject* args)
+{
+  uint8_t pids[256];
+  PyObject *list;
+  int n, i;
+
+  n = ELMsupportedList(&conn, pids, sizeof(pids));
+  list = PyList_New(0);
+  for (i = 0; i < n; i++)
+  {
+    PyObject *name = PyString_FromString(OBDpidInfo(pids[i])->name);
+    PyList_Append(list, name);
+    Py_DECREF(name);
+  }
+  return list;
+}
+
+static PyObject* py_elmQuery(PyObject* self, PyObject* args)
+{
+  ELMvalue vals[512];
+  uint8_t pids[256];
+  PyObject *names, *dict;
+  int n = 0, got, i;
+
+  if (!PyArg_ParseTuple(args, "O", &names) || !PySequence_Check(names))
+    return Py_BuildValue("i", -1);
+  for (i = 0; i < PySequence_Size(names) && n < 256; i++)
+  {
+    PyObject *item = PySequence_GetItem(names, i);
+    const OBDpid *p = pidFromObject(item);
+
+    Py_DECREF(item);
+    if (p)
+      pids[n++] = p->pid;
+  }
+
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  got = ELMquery(&conn, pids, n, vals, 512);
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+
+  dict = PyDict_New();
+  for (i = 0; i < got; i++)
+  {
+    PyObject *value;
+
+    if (PyDict_GetItemString(dict, vals[i].pid->name))
+      continue;
+    value = PyFloat_FromDouble(vals[i].value);
+    PyDict_SetItemString(dict, vals[i].pid->name, value);
+    Py_DECREF(value);
+  }
+  return dict;
+}
+
+static PyObject* py_elmCommand(PyObject* self, PyObject* args)
+{
+  char reply[ELM_RX_SIZE];
+  const char *cmd;
+  int len;
+
+  if (!PyArg_ParseTuple(args, "s", &cmd))
+    return Py_BuildValue("i", -1);
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  len = ELMcommand(&conn, cmd, reply, sizeof(reply));
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  if (len < 0)
+    Py_RETURN_NONE;
+  return PyString_FromString(reply);
+}
+
+static PyObject* py_elmAction(PyObject* self, PyObject* args)
+{
+  char reply[ELM_RX_SIZE];
+  const char *protocol, *header, *data;
+  int len;
+
+  if (!PyArg_ParseTuple(args, "zzs", &protocol, &header, &data))
+    return Py_BuildValue("i", -1);
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(1);
+  len = ELMaction(&conn, protocol, header, data, reply, sizeof(reply));
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  if (len < 0)
+    Py_RETURN_NONE;
+  return PyString_FromString(reply);
+}
+
+static PyObject* py_elmCodes(PyObject* self, PyObject* args)
+{
+  uint16_t codes[ELM_MAX_CODES];
+  PyObject *list;
+  char text[6];
+  int n, i;
+
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  n = ELMcodes(&conn, codes, ELM_MAX_CODES);
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  if (n < 0)
+    Py_RETURN_NONE;
+  list = PyList_New(n);
+  for (i = 0; i < n; i++)
+  {
+    DTCformat(codes[i], text);
+    PyList_SetItem(list, i, PyString_FromString(text));
+  }
+  return list;
+}
+
+static PyObject* py_elmStats(PyObject* self, PyObject* args)
+{
+  ELMstats s;
+
+  ELMgetStats(&conn, &s);
+  return Py_BuildValue("{s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:K,s:K}",
+    "requests", s.requests, "frames", s.frames, "values", s.values,
+    "noData", s.noData, "timeouts", s.timeouts,
+    "settings", s.settings, "cached", s.cached, "actions", s.actions,
+    "bytesOut", (unsigned PY_LONG_LONG)s.bytesOut, "bytesIn", (unsigned PY_LONG_LONG)s.bytesIn);
+}
+
+static PyObject* py_elmSchedule(PyObject* self, PyObject* args)
+{
+  PyObject *items;
+  int budget = 0, i;
+
+  if (!PyArg_ParseTuple(args, "O|i", &items, &budget) || !PySequence_Check(items))
+    return Py_BuildValue("i", -1);
+  PSinit(&sched, conn.batch, budget, nowMs());
+  for (i = 0; i < PySequence_Size(items); i++)
+  {
+    PyObject *item = PySequence_GetItem(items, i), *name = item;
+    double hz = 0;
+    int priority = 0;
+
+    if (PyTuple_Check(item) && !PyArg_ParseTuple(item, "O|di", &name, &hz, &priority))
+      PyErr_Clear();
+    // unsupported PIDs would only ever answer NO DATA
+    if (pidFromObject(name) && ELMisSupported(&conn, pidFromObject(name)->pid))
+      PSadd(&sched, pidFromObject(name), hz, priority, nowMs());
+    Py_DECREF(item);
+  }
+  haveSched = sched.n > 0;
+  return Py_BuildValue("i", haveSched ? 0 : -1);
+}
+
+// Every value read goes into the PID's windows and onto the bus, first ECU of each reply
+static void publish(const ELMvalue *vals, int got)
+{
+  uint8_t fed[256];
+  int64_t now = wallMs();
+  int i;
+
+  memset(fed, 0, sizeof(fed));
+  pthread_mutex_lock(&rollMutex);
+  for (i = 0; i < got; i++)
+  {
+    uint8_t pid = vals[i].pid->pid;
+
+    if (fed[pid])
+      continue;
+    fed[pid] = 1;
+    if (haveRollups && rollByPid[pid] >= 0)
+      ROLLsample(&rollups, rollByPid[pid], now, vals[i].value);
+    if (bus.map)
+      MBUSpublish(bus.map, pid, vals[i].value, now);
+  }
+  pthread_mutex_unlock(&rollMutex);
+}
+
+static PyObject* py_elmPoll(PyObject* self, PyObject* args)
+{
+  ELMvalue vals[512];
+  double latest[256], seconds;
+  uint8_t have[256], ask[PS_DEPTH * ELM_MAX_BATCH];
+  PyObject *dict;
+  int64_t end;
+  int i;
+
+  if (!haveSched || !PyArg_ParseTuple(args, "d", &seconds))
+    return Py_BuildValue("i", -1);
+  memset(have, 0, sizeof(have));
+
+  Py_BEGIN_ALLOW_THREADS
+  end = nowMs() + (int64_t)(seconds * 1000);
+  for (;;)
+  {
+    int64_t now = nowMs();
+    int n, got, idle;
+
+    if (now >= end)
+      break;
+    while (actionsWaiting)
+      usleep(500);
+    linkLock(0);
+    if ((n = PSnext(&sched, nowMs(), ask, sizeof(ask))) == 0)
+    {
+      linkUnlock();
+      idle = PSidleMs(&sched, now);
+      usleep((idle < end - now ? idle : end - now) * 1000);
+      continue;
+    }
+    got = ELMquery(&conn, ask, n, vals, 512);
+    if (got >= 0)
+      PSupdate(&sched, nowMs(), vals, got);
+    linkUnlock();
+    if (got < 0)
+      break;
+    if (haveRollups || bus.map)
+      publish(vals, got);
+    // latest value per PID, first ECU of each reply
+    for (i = got - 1; i >= 0; i--)
+    {
+      latest[vals[i].pid->pid] = vals[i].value;
+      have[vals[i].pid->pid] = 1;
+    }
+  }
+  Py_END_ALLOW_THREADS
+
+  dict = PyDict_New();
+  for (i = 0; i < 256; i++)
+  {
+    PyObject *value;
+
+    if (!have[i])
+      continue;
+    value = PyFloat_FromDouble(latest[i]);
+    PyDict_SetItemString(dict, OBDpidInfo(i)->name, value);
+    Py_DECREF(value);
+  }
+  return dict;
+}
+
+static PyObject* py_elmScheduleStats(PyObject* self, PyObject* args)
+{
+  PyObject *dict = PyDict_New();
+  int64_t now = nowMs();
+  int i;
+
+  for (i = 0; haveSched && i < sched.n; i++)
+  {
+    PSentry *e = &sched.e[i];
+    PyObject *entry = Py_BuildValue("{s:i,s:d,s:d,s:d,s:d,s:I,s:I}",
+      "priority", e->priority,
+      "targetHz", 1000.0 / e->basePeriodMs,
+      "hz", 1000.0 / e->periodMs,
+      "achievedHz", PSachievedHz(&sched, e, now),
+      "jitterMs", PSjitterMs(e),
+      "missed", PSmissed(e, now),
+      "boosts", e->boosts);
+
+    PyDict_SetItemString(dict, e->pid->name, entry);
+    Py_DECREF(entry);
+  }
+  return dict;
+}
+
+static PyObject* py_elmBus(PyObject* self, PyObject* args)
+{
+  if (bus.map == NULL && MBUSopen(&bus, NULL, 1) < 0)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", 0);
+}
+
+static PyObject* py_elmBusPut(PyObject* self, PyObject* args)
+{
+  PyObject *name;
+  const OBDpid *p;
+  double value;
+
+  if (bus.map == NULL || !PyArg_ParseTuple(args, "Od", &name, &value) || (p = pidFromObject(name)) == NULL)
+    return Py_BuildValue("i", -1);
+  // the same lock as elmPoll()'s publishing, the bus has one writer
+  pthread_mutex_lock(&rollMutex);
+  MBUSpublish(bus.map, p->pid, value, wallMs());
+  pthread_mutex_unlock(&rollMutex);
+  return Py_BuildValue("i", 0);
+}
+
+// Window lengths in seconds to ms, the count or -1
+static int windowsFromObject(PyObject *seq, uint32_t *ms)
+{
+  int n, i;
+
+  if (!PySequence_Check(seq) || (n = PySequence_Size(seq)) > ROLL_MAX_WINDOWS)
+    return -1;
+  for (i = 0; i < n; i++)
+  {
+    PyObject *item = PySequence_GetItem(seq, i);
+    double secs = PyFloat_AsDouble(item);
+
+    Py_DECREF(item);
+    if (PyErr_Occurred() || secs < 0.001)
+    {
+      PyErr_Clear();
+      return -1;
+    }
+    ms[i] = (uint32_t)(secs * 1000);
+  }
+  return n;
+}
+
+static PyObject* py_elmRollup(PyObject* self, PyObject* args)
+{
+  PyObject *items, *windows;
+  uint32_t defaults[ROLL_MAX_WINDOWS];
+  int ndefaults, rc = 0, i;
+
+  if (!PyArg_ParseTuple(args, "OO", &items, &windows) || !PySequence_Check(items) ||
+    (ndefaults = windowsFromObject(windows, defaults)) < 0)
+    return Py_BuildValue("i", -1);
+  pthread_mutex_lock(&rollMutex);
+  ROLLinit(&rollups);
+  for (i = 0; i < 256; i++)
+    rollByPid[i] = -1;
+  for (i = 0; i < PySequence_Size(items); i++)
+  {
+    PyObject *item = PySequence_GetItem(items, i), *name = item, *own = NULL;
+    uint32_t ms[ROLL_MAX_WINDOWS], *use = defaults;
+    const OBDpid *p;
+    int n = ndefaults;
+
+    if (PyTuple_Check(item) && !PyArg_ParseTuple(item, "OO", &name, &own))
+      PyErr_Clear();
+    if (own != NULL && (n = windowsFromObject(own, ms)) >= 0)
+      use = ms;
+    // a later item for the same PID replaces the earlier one
+    if ((p = pidFromObject(name)) == NULL || n < 0)
+      rc = -1;
+    else if ((rollByPid[p->pid] = n ? ROLLadd(&rollups, p->name, use, n) : -1) < 0 && n)
+      rc = -1;
+    Py_DECREF(item);
+  }
+  haveRollups = rollups.n > 0;
+  pthread_mutex_unlock(&rollMutex);
+  return Py_BuildValue("i", rc);
+}
+
+// Add NAME_suffix: value to a row, taking the reference
+static void setField(PyObject *fields, const char *name, const char *suffix, PyObject *value)
+{
+  char key[ROLL_MAX_NAME + 8];
+
+  snprintf(key, sizeof(key), "%s%s", name, suffix);
+  PyDict_SetItemString(fields, key, value);
+  Py_DECREF(value);
+}
+
+static PyObject* py_elmRollups(PyObject* self, PyObject* args)
+{
+  static ROLLsummary done[ROLL_QUEUE];
+  PyObject *list = PyList_New(0), *rows[ROLL_QUEUE];
+  int64_t starts[ROLL_QUEUE];
+  uint32_t lengths[ROLL_QUEUE];
+  int all = 0, n, nrows = 0, i, j;
+
+  if (!PyArg_ParseTuple(args, "|i", &all))
+    PyErr_Clear();
+  pthread_mutex_lock(&rollMutex);
+  ROLLflush(&rollups, wallMs(), all);
+  n = ROLLtake(&rollups, done, ROLL_QUEUE);
+  pthread_mutex_unlock(&rollMutex);
+
+  // one row per window, every PID's summary in it
+  for (i = 0; i < n; i++)
+  {
+    ROLLsummary *w = &done[i];
+    const char *name = rollups.s[w->series].name;
+    PyObject *fields;
+
+    for (j = 0; j < nrows && !(lengths[j] == w->lengthMs && starts[j] == w->start); j++)
+      ;
+    if (j == nrows)
+    {
+      lengths[j] = w->lengthMs;
+      starts[j] = w->start;
+      rows[nrows++] = PyDict_New();
+    }
+    fields = rows[j];
+    setField(fields, name, "_count", PyInt_FromLong(w->count));
+    setField(fields, name, "_min", PyFloat_FromDouble(w->min));
+    setField(fields, name, "_max", PyFloat_FromDouble(w->max));
+    setField(fields, name, "_mean", PyFloat_FromDouble(w->mean));
+    setField(fields, name, "_last", PyFloat_FromDouble(w->last));
+    setField(fields, name, "_p95", PyFloat_FromDouble(w->p95));
+  }
+  for (j = 0; j < nrows; j++)
+  {
+    PyObject *row = Py_BuildValue("(ddO)", lengths[j] / 1000.0, starts[j] / 1000.0, rows[j]);
+
+    PyList_Append(list, row);
+    Py_DECREF(row);
+    Py_DECREF(rows[j]);
+  }
+  return list;
+}
+
+static PyObject* py_elmClose(PyObject* self, PyObject* args)
+{
+  Py_BEGIN_ALLOW_THREADS
+  linkLock(0);
+  ELMclose(&conn);
+  linkUnlock();
+  Py_END_ALLOW_THREADS
+  haveSched = 0;
+  return Py_BuildValue("i", 0);
+}
+
+
+/*
+ * Bind Python function names to our C functions
+ */
+static PyMethodDef elm_methods[] = {
+  {"elmOpen", py_elmOpen, METH_VARARGS},
+  {"elmStart", py_elmStart, METH_VARARGS},
+  {"elmInit", py_elmInit, METH_VARARGS},
+  {"elmSupported", py_elmSupported, METH_VARARGS},
+  {"elmQuery", py_elmQuery, METH_VARARGS},
+  {"elmCommand", py_elmCommand, METH_VARARGS},
+  {"elmAction", py_elmAction, METH_VARARGS},
+  {"elmCodes", py_elmCodes, METH_VARARGS},
+  {"elmStats", py_elmStats, METH_VARARGS},
+  {"elmClose", py_elmClose, METH_VARARGS},
+  {"elmSchedule", py_elmSchedule, METH_VARARGS},
+  {"elmPoll", py_elmPoll, METH_VARARGS},
+  {"elmScheduleStats", py_elmScheduleStats, METH_VARARGS},
+  {"elmBus", py_elmBus, METH_VARARGS},
+  {"elmBusPut", py_elmBusPut, METH_VARARGS},
+  {"elmRollup", py_elmRollup, METH_VARARGS},
+  {"elmRollups", py_elmRollups, METH_VARARGS},
+  {NULL, NULL}
+};
+
+/*
+ * Python calls this to let us initialize our module
+ */
+void initelm()
+{
+  (void) Py_InitModule("elm", elm_methods);
+}
@@ -0,0 +1,117 @@
+/*
+=================================================================================
+ Name        : elmbench.c
+ Version     : 0.1
+
+ Description : Samples per second of the native ELM327 client over every
+     supported PID, compared with one PID per request the way python-obd
+     polls. Run it against an adapter or against elmsim:
+
+         ./elmsim -L /tmp/elm &
+         ./elmbench -d /tmp/elm
+
+     elmbench -d device [-b baud] [-t secs]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "elm327.h"
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sweep the PID list for secs seconds, returns values per second.
+static double run(ELMconn *c, const char *label, const uint8_t *pids, int n, int batch, int hint, double secs)
+{
+	ELMvalue vals[256];
+	ELMstats before, after;
+	double start = nowSec(), elapsed;
+	long values = 0;
+	int sweeps = 0;
+
+	c->batch = batch;
+	c->hint = hint;
+	ELMgetStats(c, &before);
+	do
+	{
+		int got = ELMquery(c, pids, n, vals, 256);
+
+		if (got > 0)
+			values += got;
+		sweeps++;
+	} while ((elapsed = nowSec() - start) < secs);
+	ELMgetStats(c, &after);
+
+	printf("%-22s %7.1f samples/s %7.1f ms/sweep %5.1f req/sweep %4u timeouts %7.0f bytes in/sweep\n",
+		label, values / elapsed, elapsed * 1000 / sweeps,
+		(double)(after.requests - before.requests) / sweeps, after.timeouts - before.timeouts,
+		(double)(after.bytesIn - before.bytesIn) / sweeps);
+	return values / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = NULL;
+	uint8_t pids[256];
+	double secs = 5, base, best;
+	int baud = 115200, opt, n, hint;
+	ELMconn c;
+
+	while ((opt = getopt(argc, argv, "d:b:t:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd': dev = optarg; break;
+			case 'b': baud = atoi(optarg); break;
+			case 't': secs = atof(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s -d device [-b baud] [-t secs]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (dev == NULL)
+	{
+		fprintf(stderr, "usage: %s -d device [-b baud] [-t secs]\n", argv[0]);
+		return 1;
+	}
+	if (ELMopen(&c, dev, baud) < 0 || ELMinit(&c) < 0)
+	{
+		fprintf(stderr, "elmbench: no adapter on %s\n", dev);
+		return 1;
+	}
+	n = ELMsupportedList(&c, pids, sizeof(pids));
+	hint = c.hint;
+	printf("protocol %c, %d ECU(s), %d supported PIDs, count hint %s\n\n",
+		c.protocol, c.ecus, n, hint ? "on" : "off");
+
+	base = run(&c, "one PID per request", pids, n, 1, 0, secs);
+	if (c.protocol < '6' || c.protocol > '9')
+	{
+		printf("\nnot a CAN bus, batching is not available\n");
+		ELMclose(&c);
+		return 0;
+	}
+	run(&c, "six PIDs per request", pids, n, ELM_MAX_BATCH, 0, secs);
+	best = run(&c, "six PIDs + count hint", pids, n, ELM_MAX_BATCH, hint, secs);
+	printf("\nspeedup %.1fx\n", best / base);
+	ELMclose(&c);
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+=================================================================================
+ Name        : elmrec.c
+ Version     : 0.1
+
+ Description : Records a drive. Sits between the collector and the real
+     adapter: opens the adapter's serial port, offers a pseudo terminal in
+     its place (printed, and symlinked with -L) and passes bytes both ways
+     untouched, writing every request line with the adapter's reply up to
+     the prompt and their timing to a trace (elmtrace.h). Point the
+     collector at the link instead of /dev/serial0 and drive:
+
+         ./elmrec -d /dev/serial0 -o drive.trc -L /tmp/elm &
+
+     elmsim -R drive.trc plays it back. SIGINT or SIGTERM closes the trace.
+
+     elmrec -d device [-b baud] -o trace [-L link] [-v]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "elm327.h"
+#include "elmtrace.h"
+
+#define MAX_PENDING 8           // requests sent before the adapter's prompt
+
+typedef struct
+{
+	int64_t timeUs;
+	int len;
+	char line[TRC_MAX_LINE];
+} Request;
+
+static volatile sig_atomic_t running = 1;
+static Request pending[MAX_PENDING];
+static int npending;
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static int64_t nowUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int writeAll(int fd, const char *buf, int len)
+{
+	struct pollfd pfd;
+	int done = 0, n;
+
+	pfd.fd = fd;
+	pfd.events = POLLOUT;
+	while (done < len)
+	{
+		n = write(fd, buf + done, len - done);
+		if (n > 0)
+			done += n;
+		else if (n < 0 && errno != EAGAIN && errno != EINTR)
+			return -1;
+		else
+			poll(&pfd, 1, 100);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dev = NULL, *out = NULL, *linkPath = NULL, *name;
+	char buf[1024], req[TRC_MAX_LINE], resp[TRC_MAX_LINE * 8];
+	int baud = 115200, verbose = 0, opt, reqLen = 0, respLen = 0, master, slave, n, i;
+	int64_t start;
+	struct termios tio;
+	struct pollfd pfd[2];
+	TRCwriter w;
+	ELMconn c;
+
+	while ((opt = getopt(argc, argv, "d:b:o:L:v")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd': dev = optarg; break;
+			case 'b': baud = atoi(optarg); break;
+			case 'o': out = optarg; break;
+			case 'L': linkPath = optarg; break;
+			case 'v': verbose = 1; break;
+			default:
+				dev = NULL;
+				break;
+		}
+	}
+	if (dev == NULL || out == NULL)
+	{
+		fprintf(stderr, "usage: %s -d device [-b baud] -o trace [-L link] [-v]\n", argv[0]);
+		return 1;
+	}
+	if (ELMopen(&c, dev, baud) < 0)
+	{
+		perror("elmrec: adapter");
+		return 1;
+	}
+	if (TRCcreate(&w, out, baud) < 0)
+	{
+		fprintf(stderr, "elmrec: cannot write %s\n", out);
+		return 1;
+	}
+
+	master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0 || (name = ptsname(master)) == NULL)
+	{
+		perror("elmrec: pty");
+		return 1;
+	}
+	// Hold the slave open and raw, as elmsim does
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0 || tcgetattr(slave, &tio) < 0)
+	{
+		perror("elmrec: slave");
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	if (linkPath)
+	{
+		unlink(linkPath);
+		if (symlink(name, linkPath) < 0)
+			perror("elmrec: symlink");
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	signal(SIGPIPE, SIG_IGN);
+	printf("%s\n", name);
+	fflush(stdout);
+
+	start = nowUs();
+	pfd[0].fd = master;
+	pfd[1].fd = c.fd;
+	pfd[0].events = pfd[1].events = POLLIN;
+	while (running)
+	{
+		if (poll(pfd, 2, 1000) <= 0)
+			continue;
+		// client to adapter: a request is complete at its CR
+		if (pfd[0].revents & POLLIN && (n = read(master, buf, sizeof(buf))) > 0)
+		{
+			if (writeAll(c.fd, buf, n) < 0)
+			{
+				perror("elmrec: adapter");
+				break;
+			}
+			for (i = 0; i < n; i++)
+			{
+				if (buf[i] != '\r')
+				{
+					if (buf[i] != '\n' && reqLen < (int)sizeof(req))
+						req[reqLen++] = buf[i];
+					continue;
+				}
+				if (npending == MAX_PENDING)
+				{
+					memmove(pending, pending + 1, (MAX_PENDING - 1) * sizeof(Request));
+					npending--;
+				}
+				pending[npending].timeUs = nowUs() - start;
+				pending[npending].len = reqLen;
+				memcpy(pending[npending].line, req, reqLen);
+				npending++;
+				reqLen = 0;
+			}
+		}
+		// adapter to client: the reply ends at the prompt
+		if (pfd[1].revents & POLLIN && (n = read(c.fd, buf, sizeof(buf))) > 0)
+		{
+			if (writeAll(master, buf, n) < 0)
+				break;
+			for (i = 0; i < n; i++)
+			{
+				int64_t now;
+
+				if (respLen < (int)sizeof(resp))
+					resp[respLen++] = buf[i];
+				if (buf[i] != '>')
+					continue;
+				now = nowUs() - start;
+				if (npending)
+				{
+					TRCwrite(&w, pending[0].timeUs, now - pending[0].timeUs, pending[0].line, pending[0].len, resp, respLen);
+					if (verbose)
+						fprintf(stderr, "elmrec: %.*s %lld us\n", pending[0].len, pending[0].line,
+							(long long)(now - pending[0].timeUs));
+					memmove(pending, pending + 1, (npending - 1) * sizeof(Request));
+					npending--;
+				}
+				else
+					TRCwrite(&w, now, 0, "", 0, resp, respLen);  // nothing asked for it
+				respLen = 0;
+			}
+		}
+		if (pfd[1].revents & (POLLERR | POLLHUP))
+		{
+			fprintf(stderr, "elmrec: adapter went away\n");
+			break;
+		}
+	}
+	fprintf(stderr, "elmrec: %u exchanges, %llu bytes of traffic in %.1f s\n", w.exchanges,
+		(unsigned long long)w.bytes, (nowUs() - start) / 1e6);
+	TRCclose(&w);
+	ELMclose(&c);
+	if (linkPath)
+		unlink(linkPath);
+	return 0;
+}
@@ -0,0 +1,765 @@
+/*
+=================================================================================
+ Name        : elmsim.c
+ Version     : 0.1
+
+ Description : ELM327 simulator on a pseudo terminal, for running the native
+     OBD code without a car. Prints the slave device name (and optionally
+     symlinks it) and then answers AT/ST setup commands and Mode 01 requests
+     like an ELM327 v1.5 on 11 bit 500k CAN: echo, headers, spaces and
+     linefeeds follow ATE/ATH/ATS/ATL, up to six PIDs per request, ISO-TP
+     multi-frame replies, the response count hint, and STOPPED when a
+     character arrives while a request is in progress.
+
+     Timing is what makes it useful for benchmarking: each ECU answers after
+     -l ms, and unless the request's count hint was met the prompt only comes
+     back after the adapter's -w ms silence timeout. Output is paced at -b baud.
+
+     With -R the values and timing come from a drive recorded by elmrec
+     (elmtrace.h) instead: every Mode 01 PID answers with what the car sent
+     at the same point of the drive, each request takes as long as the
+     recorded ones did then, and the drive plays at -x times real time (0 as
+     fast as the client asks, the clock then moving by the recorded
+     latencies). The drive starts with the first Mode 01 data request and
+     loops at its end. Other requests are answered with the recorded reply
+     to the same request, ATRV included.
+
+     -D gives the engine ECU stored trouble codes (P0301,P0420,...) for
+     Mode 03 to return; without it Mode 03 answers with none.
+
+     elmsim [-l latency_ms] [-w timeout_ms] [-b baud] [-e ecus] [-L link] [-v]
+            [-R trace [-x speed]] [-D codes]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "obd_pids.h"
+#include "elmtrace.h"
+#include "dtcdb.h"
+
+#define MAX_ECUS TRC_MAX_ECUS
+#define SIM_ECUS 2              // synthetic ECUs, see supportsData()
+#define MAX_CODES 24            // stored trouble codes, -D
+
+static int master = -1;
+static int latencyMs = 8;
+static int timeoutMs = 50;
+static int baud = 115200;
+static int ecuCount = 1;
+static int verbose = 0;
+static const char *linkPath = NULL;
+static uint16_t codes[MAX_CODES];
+static int codeCount;
+
+// replay of a recorded drive
+static TRCtrace trace;
+static int replay;
+static double speed = 1;        // 0 = as fast as the client asks
+static double replayStart = -1;
+static int64_t virtualUs;       // drive clock at speed 0
+static int64_t playedUs;        // of the drive in all, loops included
+static uint32_t loops, fromTrace, unmatched;
+
+// adapter state, reset by ATZ
+static int echo, headers, linefeeds, spaces, searched;
+static char protocol;
+static unsigned txHeader;
+
+static char out[8192];
+static int outLen;
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void resetAdapter(void)
+{
+	echo = 1;
+	headers = 0;
+	linefeeds = 1;
+	spaces = 1;
+	searched = 0;
+	protocol = '0';
+	txHeader = 0x7df;
+}
+
+// Send what is buffered, taking as long as the serial line would.
+static void flushOut(void)
+{
+	int done = 0, n;
+
+	if (outLen == 0)
+		return;
+	if (!replay)    // a recorded latency has the line time in it
+		usleep((useconds_t)((double)outLen * 10 * 1000000 / baud));
+	while (done < outLen)
+	{
+		n = write(master, out + done, outLen - done);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	outLen = 0;
+}
+
+static void put(const char *s)
+{
+	int len = strlen(s);
+
+	if (outLen + len > (int)sizeof(out))
+		flushOut();
+	memcpy(out + outLen, s, len);
+	outLen += len;
+}
+
+static void endLine(void)
+{
+	put(linefeeds ? "\r\n" : "\r");
+}
+
+static void prompt(void)
+{
+	endLine();
+	put(">");
+	flushOut();
+}
+
+static void reply(const char *s)
+{
+	put(s);
+	endLine();
+	prompt();
+}
+
+// Wait ms, returning 1 early if the host sends anything (which aborts the request).
+static int busy(int ms)
+{
+	struct pollfd pfd;
+	double until = nowSec() + ms / 1000.0;
+	int left;
+
+	pfd.fd = master;
+	pfd.events = POLLIN;
+	while ((left = (int)((until - nowSec()) * 1000 + 0.5)) > 0)
+		if (poll(&pfd, 1, left) > 0)
+			return 1;
+	return 0;
+}
+
+// ECU 0 is the engine controller and knows every PID in the table, ECU 1 a
+// transmission controller with a handful.
+static int supportsData(int ecu, uint8_t pid)
+{
+	if (replay)
+		return TRCsupports(&trace, ecu, pid);
+	if (ecu == 1)
+		return pid == 0x05 || pid == 0x0c || pid == 0x0d;
+	return OBDpidInfo(pid) != NULL;
+}
+
+static int supports(int ecu, uint8_t pid)
+{
+	int p;
+
+	if (pid == 0)
+		return 1;
+	if (pid % 0x20)
+		return supportsData(ecu, pid);
+	// range PIDs are supported when anything above them is
+	for (p = pid + 1; p <= 0xff; p++)
+		if (p % 0x20 && supportsData(ecu, p))
+			return 1;
+	return 0;
+}
+
+// Point of the recorded drive we are at; the drive starts with the first
+// Mode 01 data request (start), before that it stands at its beginning
+static int64_t driveUs(int start)
+{
+	int64_t t;
+
+	if (replayStart < 0 && !start)
+		return 0;
+	if (replayStart < 0)
+		replayStart = nowSec();
+	t = speed > 0 ? (int64_t)((nowSec() - replayStart) * speed * 1e6) : virtualUs;
+	playedUs = t;
+	if (trace.durationUs > 0 && t / (trace.durationUs + 1) > loops)
+	{
+		loops = t / (trace.durationUs + 1);
+		if (verbose)
+			fprintf(stderr, "elmsim: drive looped, %u times\n", loops);
+	}
+	return trace.durationUs > 0 ? t % (trace.durationUs + 1) : 0;
+}
+
+// How long the request at this point of the drive took, scaled to the speed
+static int replayDelayMs(uint32_t latencyUs)
+{
+	if (speed > 0)
+		return (int)(latencyUs / speed / 1000 + 0.5);
+	virtualUs += latencyUs;
+	return 0;
+}
+
+static void simData(int ecu, const OBDpid *p, uint8_t *data)
+{
+	double t = nowSec(), s = sin(t * 0.7 + p->pid + ecu);
+	uint32_t bits = 0;
+	int i;
+
+	if (p->pid % 0x20 == 0)
+	{
+		for (i = 0; i < 32; i++)
+			if (supports(ecu, p->pid + 1 + i))
+				bits |= 1u << (31 - i);
+		OBDencode(p, bits, data);
+		return;
+	}
+	if (replay)
+	{
+		TRCvalue(&trace, ecu, p->pid, driveUs(1), data);
+		return;
+	}
+	switch (p->pid)
+	{
+		case 0x0c: OBDencode(p, 1800 + 1000 * s, data); return;
+		case 0x0d: OBDencode(p, 60 + 40 * s, data); return;
+		case 0x05: OBDencode(p, 88 + 4 * s, data); return;
+		case 0x10: OBDencode(p, 20 + 15 * s, data); return;
+		case 0x42: OBDencode(p, 14.1 + 0.2 * s, data); return;
+	}
+	for (i = 0; i < p->bytes; i++)
+		data[i] = (uint8_t)(128 + 100 * sin(t * 0.3 + p->pid * 7 + i));
+}
+
+static void putBytes(const uint8_t *b, int n)
+{
+	char hex[4];
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		sprintf(hex, spaces ? "%02X " : "%02X", b[i]);
+		put(hex);
+	}
+	if (spaces && n)
+		outLen--;
+}
+
+// Emit one ECU's reply as CAN frames, returns the number of frames sent.
+static int sendFrames(int ecu, const uint8_t *payload, int len, int limit)
+{
+	uint8_t frame[8];
+	char hdr[12];
+	int off, seq = 1, frames = 0;
+
+	sprintf(hdr, spaces ? "%03X " : "%03X", 0x7e8 + ecu);
+	if (len <= 7)
+	{
+		memset(frame, 0, sizeof(frame));
+		frame[0] = len;
+		memcpy(frame + 1, payload, len);
+		if (headers)
+		{
+			put(hdr);
+			putBytes(frame, 8);
+		}
+		else
+			putBytes(payload, len);
+		endLine();
+		flushOut();
+		return 1;
+	}
+	if (!headers)
+	{
+		// ELM327 formatting of multi-frame replies without headers
+		sprintf(hdr, "%03X", len);
+		put(hdr);
+		endLine();
+	}
+	for (off = 0; off < len && frames < limit; frames++)
+	{
+		int n, first = off == 0;
+
+		memset(frame, 0, sizeof(frame));
+		if (first)
+		{
+			frame[0] = 0x10 | (len >> 8);
+			frame[1] = len & 0xff;
+			n = 6;
+		}
+		else
+		{
+			frame[0] = 0x20 | (seq++ & 0x0f);
+			n = 7;
+		}
+		if (n > len - off)
+			n = len - off;
+		memcpy(frame + 8 - (first ? 6 : 7), payload + off, n);
+		off += n;
+		if (headers)
+		{
+			put(hdr);
+			putBytes(frame, 8);
+		}
+		else
+		{
+			char idx[8];
+
+			sprintf(idx, spaces ? "%X: " : "%X:", frames & 0x0f);
+			put(idx);
+			putBytes(frame + (first ? 2 : 1), first ? 6 : 7);
+		}
+		endLine();
+		flushOut();
+	}
+	return frames;
+}
+
+static void obdRequest(const char *req)
+{
+	uint8_t bytes[16], payload[64];
+	int digits = strlen(req), nbytes = digits / 2, hint = 0, sent = 0, ecu, i;
+
+	if (digits < 2 || nbytes > (int)sizeof(bytes))
+	{
+		reply("?");
+		return;
+	}
+	for (i = 0; i < digits; i++)
+		if (!isxdigit((unsigned char)req[i]))
+		{
+			reply("?");
+			return;
+		}
+	for (i = 0; i < nbytes; i++)
+	{
+		unsigned v;
+
+		sscanf(req + i * 2, "%2x", &v);
+		bytes[i] = v;
+	}
+	if (digits % 2)
+		hint = strtol(req + digits - 1, NULL, 16);
+
+	if (!searched)
+	{
+		put("SEARCHING...");
+		endLine();
+		flushOut();
+		if (busy(300))
+		{
+			reply("STOPPED");
+			return;
+		}
+		searched = 1;
+		if (protocol == '0')
+			protocol = 'A';
+	}
+	// Mode 03 from the engine ECU: the count, then two bytes a code
+	if ((txHeader == 0x7df || txHeader == 0x7e0) && bytes[0] == 0x03 && nbytes == 1)
+	{
+		payload[0] = 0x43;
+		payload[1] = codeCount;
+		for (i = 0; i < codeCount; i++)
+		{
+			payload[2 + i * 2] = codes[i] >> 8;
+			payload[3 + i * 2] = codes[i] & 0xff;
+		}
+		if (busy(latencyMs))
+		{
+			reply("STOPPED");
+			return;
+		}
+		sent = sendFrames(0, payload, 2 + codeCount * 2, hint ? hint : 64);
+		if (!(hint && sent >= hint) && busy(timeoutMs))
+		{
+			reply("STOPPED");
+			return;
+		}
+		prompt();
+		return;
+	}
+	// Only the OBD request ids reach the simulated powertrain bus
+	if ((txHeader != 0x7df && txHeader != 0x7e0 && txHeader != 0x7e1) || bytes[0] != 0x01 || nbytes > 7)
+	{
+		if (busy(timeoutMs))
+			reply("STOPPED");
+		else
+			reply("NO DATA");
+		return;
+	}
+
+	if (replay && busy(replayDelayMs(TRClatency(&trace, driveUs(0)))))
+	{
+		reply("STOPPED");
+		return;
+	}
+	for (ecu = 0; ecu < ecuCount; ecu++)
+	{
+		int len = 1;
+
+		if (txHeader != 0x7df && txHeader != 0x7e0u + ecu)
+			continue;
+		payload[0] = 0x41;
+		for (i = 1; i < nbytes; i++)
+		{
+			const OBDpid *p = OBDpidInfo(bytes[i]);
+
+			if (p == NULL || !supports(ecu, bytes[i]))
+				continue;
+			payload[len++] = bytes[i];
+			simData(ecu, p, payload + len);
+			len += p->bytes;
+		}
+		if (len == 1)
+			continue;
+		if (!replay && busy(ecu == 0 ? latencyMs : 2))
+		{
+			reply("STOPPED");
+			return;
+		}
+		sent += sendFrames(ecu, payload, len, hint ? hint - sent : 64);
+		if (hint && sent >= hint)
+		{
+			prompt();
+			return;
+		}
+	}
+	// Without a satisfied hint the adapter waits out its timeout (a recorded one already did)
+	if (!replay && busy(sent ? timeoutMs : latencyMs + timeoutMs))
+	{
+		reply("STOPPED");
+		return;
+	}
+	if (sent)
+		prompt();
+	else
+		reply("NO DATA");
+}
+
+static void atCommand(const char *cmd)
+{
+	const char *arg = cmd + 2;
+
+	if (strcmp(arg, "Z") == 0 || strcmp(arg, "WS") == 0)
+	{
+		resetAdapter();
+		usleep(arg[0] == 'Z' ? 500000 : 100000);
+		endLine();
+		reply("ELM327 v1.5");
+		return;
+	}
+	if (strcmp(arg, "D") == 0)
+	{
+		// defaults as at power on, but the protocol stays
+		char keep = protocol;
+		int wasSearched = searched;
+
+		resetAdapter();
+		protocol = keep;
+		searched = wasSearched;
+		reply("OK");
+		return;
+	}
+	if (strcmp(arg, "I") == 0)
+		reply("ELM327 v1.5");
+	else if (strcmp(arg, "RV") == 0)
+		reply("12.6V");
+	else if (strcmp(arg, "DPN") == 0)
+	{
+		char p[3] = { 0 };
+
+		p[0] = protocol;
+		if (protocol == 'A')
+		{
+			p[0] = 'A';
+			p[1] = '6';
+		}
+		reply(p);
+	}
+	else if (strcmp(arg, "DP") == 0)
+		reply(protocol == 'A' ? "AUTO, ISO 15765-4 (CAN 11/500)" : "ISO 15765-4 (CAN 11/500)");
+	else if (arg[0] == 'E' && (arg[1] == '0' || arg[1] == '1') && !arg[2])
+	{
+		echo = arg[1] == '1';
+		reply("OK");
+	}
+	else if (arg[0] == 'H' && (arg[1] == '0' || arg[1] == '1') && !arg[2])
+	{
+		headers = arg[1] == '1';
+		reply("OK");
+	}
+	else if (arg[0] == 'L' && (arg[1] == '0' || arg[1] == '1') && !arg[2])
+	{
+		linefeeds = arg[1] == '1';
+		reply("OK");
+	}
+	else if (arg[0] == 'S' && (arg[1] == '0' || arg[1] == '1') && !arg[2])
+	{
+		spaces = arg[1] == '1';
+		reply("OK");
+	}
+	else if ((strncmp(arg, "SP", 2) == 0 || strncmp(arg, "TP", 2) == 0) && arg[2])
+	{
+		// everything but auto and CAN 11/500 is "no car on that bus"
+		protocol = arg[2] == 'A' ? 'A' : arg[2];
+		searched = arg[2] == '6';
+		reply("OK");
+	}
+	else if (strncmp(arg, "SH", 2) == 0 && arg[2])
+	{
+		txHeader = strtoul(arg + 2, NULL, 16);
+		reply("OK");
+	}
+	else if (strncmp(arg, "AT", 2) == 0 || strncmp(arg, "ST", 2) == 0 ||
+		strncmp(arg, "CAF", 3) == 0 || strncmp(arg, "CRA", 3) == 0 || strcmp(arg, "M0") == 0)
+		reply("OK");
+	else
+		reply("?");
+}
+
+static void stCommand(const char *cmd)
+{
+	if (strcmp(cmd, "STI") == 0)
+		reply("STN1110 v4.0.1");
+	else if (strncmp(cmd, "STP", 3) == 0)
+	{
+		// STN protocol numbers, 31 is CAN 11/500; anything else has no ECU here
+		protocol = strcmp(cmd + 3, "31") == 0 ? '6' : 'X';
+		searched = 1;
+		reply("OK");
+	}
+	else
+		reply("OK");
+}
+
+// Requests other than Mode 01 data and the settings get the recorded reply, if any
+static int replayOther(const char *cmd)
+{
+	int x;
+
+	if (strncmp(cmd, "AT", 2) == 0 ? strcmp(cmd, "ATRV") != 0 : strncmp(cmd, "ST", 2) == 0 || strncmp(cmd, "01", 2) == 0)
+		return 0;
+	if ((x = TRCfind(&trace, cmd, driveUs(0))) < 0)
+	{
+		unmatched++;
+		return 0;
+	}
+	fromTrace++;
+	if (busy(replayDelayMs(trace.x[x].latencyUs)))
+	{
+		reply("STOPPED");
+		return 1;
+	}
+	// the reply as recorded, it ends with the prompt
+	if (trace.x[x].respLen)
+	{
+		const char *r = trace.text + trace.x[x].resp, *end = strchr(r, '\r');
+		char line[TRC_MAX_LINE + 1];
+		int i, n = 0;
+
+		// skip a recorded echo, ours (if on) has gone out already
+		for (i = 0; end && r + i < end && n < TRC_MAX_LINE; i++)
+			if (!isspace((unsigned char)r[i]))
+				line[n++] = toupper((unsigned char)r[i]);
+		line[n] = 0;
+		if (end && strcmp(line, cmd) == 0)
+			r = end + 1;
+		put(r);
+		flushOut();
+	}
+	else
+		prompt();
+	return 1;
+}
+
+static void command(char *line)
+{
+	char cmd[128];
+	int n = 0;
+	char *s;
+
+	if (echo)
+	{
+		put(line);
+		put("\r");
+	}
+	for (s = line; *s && n < (int)sizeof(cmd) - 1; s++)
+		if (!isspace((unsigned char)*s))
+			cmd[n++] = toupper((unsigned char)*s);
+	cmd[n] = 0;
+	if (verbose)
+		fprintf(stderr, "elmsim: %s\n", cmd);
+	if (replay && n && replayOther(cmd))
+		return;
+	if (n == 0)
+		prompt();
+	else if (strncmp(cmd, "AT", 2) == 0)
+		atCommand(cmd);
+	else if (strncmp(cmd, "ST", 2) == 0)
+		stCommand(cmd);
+	else if (protocol == 'X')
+		reply("NO DATA");
+	else
+		obdRequest(cmd);
+}
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	if (linkPath)
+		unlink(linkPath);
+	if (replay && verbose)
+	{
+		char msg[160];
+		int n = snprintf(msg, sizeof(msg), "elmsim: replayed %.1f s of the drive, looped %u times, %u replies from the trace, %u not recorded\n",
+			playedUs / 1e6, loops, fromTrace, unmatched);
+
+		if (write(2, msg, n) < 0)
+			n = 0;
+	}
+	_exit(0);
+}
+
+int main(int argc, char **argv)
+{
+	struct termios tio;
+	char line[256], buf[256];
+	int opt, len = 0, slave, n, i;
+	const char *name;
+	char *s;
+
+	while ((opt = getopt(argc, argv, "l:w:b:e:L:vR:x:D:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'l': latencyMs = atoi(optarg); break;
+			case 'w': timeoutMs = atoi(optarg); break;
+			case 'b': baud = atoi(optarg); break;
+			case 'e': ecuCount = atoi(optarg); break;
+			case 'L': linkPath = optarg; break;
+			case 'v': verbose = 1; break;
+			case 'R':
+				if (TRCload(&trace, optarg) < 0)
+				{
+					fprintf(stderr, "elmsim: cannot read trace %s\n", optarg);
+					return 1;
+				}
+				replay = 1;
+				break;
+			case 'x': speed = atof(optarg); break;
+			case 'D':
+				for (s = strtok(optarg, ", "); s; s = strtok(NULL, ", "))
+				{
+					int code = DTCencode(s);
+
+					if (code <= 0 || codeCount == MAX_CODES)
+					{
+						fprintf(stderr, "elmsim: -D takes up to %d codes such as P0301,P0420\n", MAX_CODES);
+						return 1;
+					}
+					codes[codeCount++] = code;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-l latency_ms] [-w timeout_ms] [-b baud] [-e ecus] [-L link] [-v] [-R trace [-x speed]] [-D codes]\n",
+					argv[0]);
+				return 1;
+		}
+	}
+	if (ecuCount < 1 || ecuCount > SIM_ECUS || baud <= 0 || speed < 0)
+	{
+		fprintf(stderr, "elmsim: -e must be 1 or 2, -b positive and -x not negative\n");
+		return 1;
+	}
+	if (replay)
+	{
+		if (trace.necus == 0)
+		{
+			fprintf(stderr, "elmsim: no Mode 01 replies in the trace\n");
+			return 1;
+		}
+		ecuCount = trace.necus;
+		fprintf(stderr, "elmsim: replaying %.1f s, %u requests, %llu values from %d ECUs at %s\n", trace.durationUs / 1e6,
+			trace.n, (unsigned long long)trace.samples, trace.necus, speed > 0 ? "real time" : "full speed");
+		if (speed > 0 && speed != 1)
+			fprintf(stderr, "elmsim: %.1fx real time\n", speed);
+	}
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0 || (name = ptsname(master)) == NULL)
+	{
+		perror("elmsim: pty");
+		return 1;
+	}
+	// Hold the slave open so the master never sees EIO between clients,
+	// and make it raw so CR is not turned into NL on the way through
+	slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0 || tcgetattr(slave, &tio) < 0)
+	{
+		perror("elmsim: slave");
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	if (linkPath)
+	{
+		unlink(linkPath);
+		if (symlink(name, linkPath) < 0)
+			perror("elmsim: symlink");
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	printf("%s\n", name);
+	fflush(stdout);
+
+	resetAdapter();
+	for (;;)
+	{
+		n = read(master, buf, sizeof(buf));
+		if (n <= 0)
+		{
+			usleep(10000);
+			continue;
+		}
+		for (i = 0; i < n; i++)
+		{
+			if (buf[i] == '\r')
+			{
+				line[len] = 0;
+				command(line);
+				len = 0;
+			}
+			else if (buf[i] != '\n' && len < (int)sizeof(line) - 1)
+				line[len++] = buf[i];
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,617 @@
+/*
+=================================================================================
+ Name        : elmtrace.c
+ Version     : 0.1
+
+ Description : Recorded adapter sessions, see elmtrace.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <zlib.h>
+#include "obd_pids.h"
+#include "elmtrace.h"
+
+// Adapter state the replies depend on, followed through the recording
+typedef struct
+{
+	int echo;
+	int headers;
+	char protocol;          // ATDPN digit, 0 = not known (taken as CAN 11 bit)
+	struct
+	{
+		uint32_t id;
+		int len, got;
+		uint8_t buf[256];
+	} part[TRC_MAX_ECUS];   // ISO-TP messages being put together
+	int nparts;
+} ParseState;
+
+static int putVarint(uint8_t *out, uint64_t v)
+{
+	int n = 0;
+
+	while (v >= 0x80)
+	{
+		out[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	out[n++] = (uint8_t)v;
+	return n;
+}
+
+static int getVarint(const uint8_t *in, uint32_t len, uint32_t *pos, uint64_t *v)
+{
+	int shift = 0;
+
+	*v = 0;
+	while (*pos < len && shift < 64)
+	{
+		uint8_t b = in[(*pos)++];
+
+		*v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return 0;
+		shift += 7;
+	}
+	return -1;
+}
+
+int TRCcreate(TRCwriter *w, const char *path, int baud)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memset(w, 0, sizeof(*w));
+	w->gz = gzopen(path, "wb6");
+	if (w->gz == NULL)
+		return -1;
+	if (gzprintf(w->gz, "%s %d %lld\n", TRC_MAGIC, baud, (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) <= 0 ||
+		gzflush(w->gz, Z_SYNC_FLUSH) != Z_OK)
+	{
+		gzclose(w->gz);
+		w->gz = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int TRCwrite(TRCwriter *w, int64_t timeUs, uint32_t latencyUs, const char *req, int reqLen, const char *resp, int respLen)
+{
+	uint8_t head[40];
+	int n = 0;
+
+	if (w->gz == NULL || reqLen < 0 || respLen < 0)
+		return -1;
+	if (reqLen > TRC_MAX_LINE)
+		reqLen = TRC_MAX_LINE;
+	if (respLen > TRC_MAX_LINE * 8)
+		respLen = TRC_MAX_LINE * 8;
+	n += putVarint(head + n, timeUs > w->lastUs ? timeUs - w->lastUs : 0);
+	n += putVarint(head + n, latencyUs);
+	n += putVarint(head + n, reqLen);
+	if (gzwrite(w->gz, head, n) != n || (reqLen && gzwrite(w->gz, req, reqLen) != reqLen))
+		return -1;
+	n = putVarint(head, respLen);
+	if (gzwrite(w->gz, head, n) != n || (respLen && gzwrite(w->gz, resp, respLen) != respLen))
+		return -1;
+	if (timeUs > w->lastUs)
+		w->lastUs = timeUs;
+	w->exchanges++;
+	w->bytes += reqLen + respLen;
+	// a power cut loses at most the last second
+	if (w->lastUs - w->syncedUs >= TRC_SYNC_US)
+	{
+		gzflush(w->gz, Z_SYNC_FLUSH);
+		w->syncedUs = w->lastUs;
+	}
+	return 0;
+}
+
+int TRCclose(TRCwriter *w)
+{
+	int rc = 0;
+
+	if (w->gz && gzclose(w->gz) != Z_OK)
+		rc = -1;
+	w->gz = NULL;
+	return rc;
+}
+
+static int hexByte(const char *s)
+{
+	int v = 0, i;
+
+	for (i = 0; i < 2; i++)
+	{
+		int c = toupper((unsigned char)s[i]);
+
+		if (c >= '0' && c <= '9')
+			v = v * 16 + c - '0';
+		else if (c >= 'A' && c <= 'F')
+			v = v * 16 + c - 'A' + 10;
+		else
+			return -1;
+	}
+	return v;
+}
+
+static int isHex(const char *s, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (!isxdigit((unsigned char)s[i]))
+			return 0;
+	return n > 0;
+}
+
+static int addText(TRCtrace *t, const char *s, int n)
+{
+	uint32_t at = t->textLen;
+
+	if (t->textLen + n + 1 > t->textCap)
+	{
+		uint32_t cap = t->textCap ? t->textCap * 2 : 65536;
+		char *text;
+
+		while (cap < t->textLen + n + 1)
+			cap *= 2;
+		if ((text = realloc(t->text, cap)) == NULL)
+			return -1;
+		t->text = text;
+		t->textCap = cap;
+	}
+	memcpy(t->text + at, s, n);
+	t->text[at + n] = 0;
+	t->textLen += n + 1;
+	return at;
+}
+
+static int ecuIndex(TRCtrace *t, uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < t->necus; i++)
+		if (t->ecuId[i] == id)
+			return i;
+	if (t->necus == TRC_MAX_ECUS)
+		return -1;
+	t->ecuId[t->necus] = id;
+	return t->necus++;
+}
+
+static int addSample(TRCtrace *t, int ecu, uint8_t pid, int64_t timeUs, const uint8_t *data, int n)
+{
+	TRCseries *s = &t->pid[ecu][pid];
+
+	if (s->n == s->cap)
+	{
+		uint32_t cap = s->cap ? s->cap * 2 : 64;
+		TRCsample *grown = realloc(s->s, cap * sizeof(TRCsample));
+
+		if (grown == NULL)
+			return -1;
+		s->s = grown;
+		s->cap = cap;
+	}
+	s->s[s->n].timeUs = timeUs;
+	memset(s->s[s->n].data, 0, sizeof(s->s[s->n].data));
+	memcpy(s->s[s->n].data, data, n);
+	s->n++;
+	t->samples++;
+	return 0;
+}
+
+// One Mode 01 reply from one responder: 41 pid data pid data ...
+static int addPayload(TRCtrace *t, uint32_t id, int64_t timeUs, const uint8_t *p, int len)
+{
+	int ecu = ecuIndex(t, id), i = 1, added = 0;
+
+	if (ecu < 0 || len < 2 || p[0] != 0x41)
+		return 0;
+	while (i < len)
+	{
+		const OBDpid *info = OBDpidInfo(p[i]);
+
+		if (info == NULL || i + 1 + info->bytes > len)
+			break;
+		if (addSample(t, ecu, p[i], timeUs, p + i + 1, info->bytes) == 0)
+			added++;
+		i += 1 + info->bytes;
+	}
+	return added;
+}
+
+static int partFor(ParseState *ps, uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < ps->nparts; i++)
+		if (ps->part[i].id == id)
+			return i;
+	if (ps->nparts == TRC_MAX_ECUS)
+		return -1;
+	ps->part[ps->nparts].id = id;
+	ps->part[ps->nparts].len = ps->part[ps->nparts].got = 0;
+	return ps->nparts++;
+}
+
+// ISO-TP frame (PCI byte first) from a CAN responder
+static int addFrame(TRCtrace *t, ParseState *ps, uint32_t id, int64_t timeUs, const uint8_t *f, int n)
+{
+	int k, type;
+
+	if (n < 1)
+		return 0;
+	type = f[0] >> 4;
+	if (type == 0)
+		return addPayload(t, id, timeUs, f + 1, (f[0] & 0x0f) < n - 1 ? (f[0] & 0x0f) : n - 1);
+	if ((k = partFor(ps, id)) < 0)
+		return 0;
+	if (type == 1 && n >= 2)
+	{
+		ps->part[k].len = ((f[0] & 0x0f) << 8 | f[1]);
+		if (ps->part[k].len > (int)sizeof(ps->part[k].buf))
+			ps->part[k].len = sizeof(ps->part[k].buf);
+		ps->part[k].got = 0;
+		f += 2;
+		n -= 2;
+	}
+	else if (type == 2 && ps->part[k].len)
+	{
+		f++;
+		n--;
+	}
+	else
+		return 0;
+	if (n > ps->part[k].len - ps->part[k].got)
+		n = ps->part[k].len - ps->part[k].got;
+	memcpy(ps->part[k].buf + ps->part[k].got, f, n);
+	ps->part[k].got += n;
+	if (ps->part[k].got < ps->part[k].len)
+		return 0;
+	n = ps->part[k].len;
+	ps->part[k].len = 0;
+	return addPayload(t, id, timeUs, ps->part[k].buf, n);
+}
+
+// Decode a Mode 01 reply, as the adapter formatted it then, into the timeline
+static int parseReply(TRCtrace *t, ParseState *ps, const char *req, int64_t timeUs, const char *resp, int len)
+{
+	char line[TRC_MAX_LINE];
+	uint8_t bytes[TRC_MAX_LINE / 2];
+	int i = 0, added = 0;
+	int can = ps->protocol == 0 || (ps->protocol >= '6' && ps->protocol <= '9') || ps->protocol > '9';
+	int hdrDigits = !can ? 6 : ps->protocol == '7' || ps->protocol == '9' ? 8 : 3;
+
+	ps->nparts = 0;
+	while (i < len)
+	{
+		int n = 0, nb, k;
+
+		while (i < len && resp[i] != '\r' && resp[i] != '\n')
+		{
+			if (resp[i] != ' ' && n < (int)sizeof(line) - 1)
+				line[n++] = resp[i];
+			i++;
+		}
+		while (i < len && (resp[i] == '\r' || resp[i] == '\n'))
+			i++;
+		line[n] = 0;
+		if (n == 0 || strcmp(line, req) == 0)  // blank or the echo
+			continue;
+		if (!ps->headers)
+		{
+			// 3 digit length line, then "0:" "1:" ... lines, or one line of payload
+			if (n == 3 && isHex(line, 3))
+			{
+				ps->part[0].id = 0;
+				ps->part[0].len = strtol(line, NULL, 16);
+				if (ps->part[0].len > (int)sizeof(ps->part[0].buf))
+					ps->part[0].len = sizeof(ps->part[0].buf);
+				ps->part[0].got = 0;
+				continue;
+			}
+			if (n > 2 && line[1] == ':' && isHex(line, 1) && isHex(line + 2, n - 2) && ps->part[0].len)
+			{
+				for (k = 0; k + 1 < n - 2 && ps->part[0].got < ps->part[0].len; k += 2)
+					ps->part[0].buf[ps->part[0].got++] = hexByte(line + 2 + k);
+				if (ps->part[0].got == ps->part[0].len)
+				{
+					added += addPayload(t, 0x7e8, timeUs, ps->part[0].buf, ps->part[0].len);
+					ps->part[0].len = 0;
+				}
+				continue;
+			}
+			if (!isHex(line, n) || n % 2)
+				continue;
+			for (nb = 0; nb < n / 2; nb++)
+				bytes[nb] = hexByte(line + nb * 2);
+			added += addPayload(t, 0x7e8, timeUs, bytes, nb);   // no header, no checksum
+			continue;
+		}
+		if (n <= hdrDigits || !isHex(line, n) || (n - hdrDigits) % 2)
+			continue;   // SEARCHING..., NO DATA, BUS INIT and the like
+		for (nb = 0; nb < (n - hdrDigits) / 2; nb++)
+			bytes[nb] = hexByte(line + hdrDigits + nb * 2);
+		if (can)
+			added += addFrame(t, ps, strtoul(line + (hdrDigits == 8 ? 6 : 0), NULL, 16), timeUs, bytes, nb);
+		else
+		{
+			char src[3] = { line[4], line[5], 0 };
+
+			added += addPayload(t, strtoul(src, NULL, 16), timeUs, bytes, nb - 1);  // checksum last
+		}
+	}
+	return added;
+}
+
+// AT commands that change how later replies look
+static void followSettings(ParseState *ps, const char *req, const char *resp, int respLen)
+{
+	if (strcmp(req, "ATZ") == 0 || strcmp(req, "ATWS") == 0 || strcmp(req, "ATD") == 0)
+	{
+		ps->echo = 1;
+		ps->headers = 0;
+	}
+	else if (strcmp(req, "ATE0") == 0 || strcmp(req, "ATE1") == 0)
+		ps->echo = req[3] == '1';
+	else if (strcmp(req, "ATH0") == 0 || strcmp(req, "ATH1") == 0)
+		ps->headers = req[3] == '1';
+	else if ((strncmp(req, "ATSP", 4) == 0 || strncmp(req, "ATTP", 4) == 0) && req[4] && req[4] != '0' &&
+		req[4] != 'A')
+		ps->protocol = req[4];
+	else if (strcmp(req, "ATDPN") == 0)
+	{
+		int i;
+
+		for (i = 0; i < respLen; i++)
+			if (isxdigit((unsigned char)resp[i]) && (i == 0 || resp[i - 1] != 'N'))
+			{
+				ps->protocol = toupper((unsigned char)resp[i]);
+				if (ps->protocol == 'A' && i + 1 < respLen)
+					ps->protocol = toupper((unsigned char)resp[i + 1]);
+				break;
+			}
+	}
+}
+
+static int cmpSample(const void *a, const void *b)
+{
+	const TRCsample *x = a, *y = b;
+
+	return x->timeUs < y->timeUs ? -1 : x->timeUs > y->timeUs;
+}
+
+// Responders by id, so the lowest (the engine, 7E8) replays as the first ECU
+static void sortEcus(TRCtrace *t)
+{
+	int i, j;
+
+	for (i = 1; i < t->necus; i++)
+		for (j = i; j > 0 && t->ecuId[j] < t->ecuId[j - 1]; j--)
+		{
+			uint32_t id = t->ecuId[j];
+			int p;
+
+			t->ecuId[j] = t->ecuId[j - 1];
+			t->ecuId[j - 1] = id;
+			for (p = 0; p < 256; p++)
+			{
+				TRCseries s = t->pid[j][p];
+
+				t->pid[j][p] = t->pid[j - 1][p];
+				t->pid[j - 1][p] = s;
+			}
+		}
+}
+
+int TRCload(TRCtrace *t, const char *path)
+{
+	gzFile gz;
+	uint8_t *buf = NULL;
+	uint32_t len = 0, cap = 0, pos;
+	char magic[16];
+	long long start;
+	ParseState ps;
+	int64_t timeUs = 0;
+	int n, i;
+
+	memset(t, 0, sizeof(*t));
+	memset(&ps, 0, sizeof(ps));
+	ps.echo = 1;
+	if ((gz = gzopen(path, "rb")) == NULL)
+		return -1;
+	for (;;)
+	{
+		if (len + 65536 > cap)
+		{
+			uint8_t *grown = realloc(buf, cap ? cap * 2 : 1 << 20);
+
+			if (grown == NULL)
+				break;
+			buf = grown;
+			cap = cap ? cap * 2 : 1 << 20;
+		}
+		n = gzread(gz, buf + len, 65536);
+		if (n <= 0)
+			break;  // the end, or the tail of a recording that was cut off
+		len += n;
+	}
+	gzclose(gz);
+	for (pos = 0; pos < len && buf[pos] != '\n'; pos++)
+		;
+	if (pos == len || sscanf((char *)buf, "%15s %d %lld", magic, &t->baud, &start) != 3 || strcmp(magic, TRC_MAGIC))
+	{
+		free(buf);
+		return -1;
+	}
+	t->startWallMs = start;
+	pos++;
+	while (pos < len)
+	{
+		uint64_t dt, lat, reqLen, respLen;
+		char req[TRC_MAX_LINE + 1];
+		TRCexchange *x;
+		uint32_t at;
+		int rn = 0;
+
+		if (getVarint(buf, len, &pos, &dt) < 0 || getVarint(buf, len, &pos, &lat) < 0 ||
+			getVarint(buf, len, &pos, &reqLen) < 0 || reqLen > len - pos)
+			break;
+		at = pos;
+		pos += reqLen;
+		if (getVarint(buf, len, &pos, &respLen) < 0 || respLen > len - pos)
+			break;
+		for (i = 0; i < (int)reqLen && rn < TRC_MAX_LINE; i++)
+			if (!isspace(buf[at + i]))
+				req[rn++] = toupper(buf[at + i]);
+		req[rn] = 0;
+		timeUs += dt;
+		if (t->n == t->cap)
+		{
+			uint32_t c = t->cap ? t->cap * 2 : 1024;
+			TRCexchange *grown = realloc(t->x, c * sizeof(TRCexchange));
+
+			if (grown == NULL)
+				break;
+			t->x = grown;
+			t->cap = c;
+		}
+		x = &t->x[t->n];
+		memset(x, 0, sizeof(*x));
+		x->timeUs = timeUs;
+		x->latencyUs = lat;
+		x->reqLen = rn;
+		x->respLen = respLen;
+		if ((n = addText(t, req, rn)) < 0)
+			break;
+		x->req = n;
+		if ((n = addText(t, (char *)buf + pos, respLen)) < 0)
+			break;
+		x->resp = n;
+		if (rn >= 4 && strncmp(req, "01", 2) == 0 && isHex(req, rn))
+		{
+			x->mode01 = 1;
+			if (parseReply(t, &ps, req, timeUs, (char *)buf + pos, respLen) == 0)
+				t->undecoded++;
+		}
+		else
+			followSettings(&ps, req, (char *)buf + pos, respLen);
+		pos += respLen;
+		t->durationUs = timeUs;
+		t->n++;
+	}
+	free(buf);
+
+	// Requests are written in order, but the samples of one PID may come from
+	// pipelined requests whose times cross; keep every series sorted
+	for (i = 0; i < t->necus; i++)
+		for (n = 0; n < 256; n++)
+			if (t->pid[i][n].n > 1)
+				qsort(t->pid[i][n].s, t->pid[i][n].n, sizeof(TRCsample), cmpSample);
+	sortEcus(t);
+	if (t->n)
+	{
+		t->m01 = malloc(t->n * sizeof(uint32_t));
+		for (i = 0; t->m01 && i < (int)t->n; i++)
+			if (t->x[i].mode01)
+				t->m01[t->nm01++] = i;
+	}
+	return 0;
+}
+
+void TRCfree(TRCtrace *t)
+{
+	int i, p;
+
+	for (i = 0; i < TRC_MAX_ECUS; i++)
+		for (p = 0; p < 256; p++)
+			free(t->pid[i][p].s);
+	free(t->x);
+	free(t->text);
+	free(t->m01);
+	memset(t, 0, sizeof(*t));
+}
+
+int TRCsupports(const TRCtrace *t, int ecu, uint8_t pid)
+{
+	return ecu >= 0 && ecu < t->necus && t->pid[ecu][pid].n > 0;
+}
+
+int TRCvalue(const TRCtrace *t, int ecu, uint8_t pid, int64_t atUs, uint8_t *data)
+{
+	const TRCseries *s;
+	const OBDpid *p = OBDpidInfo(pid);
+	uint32_t lo = 0, hi;
+
+	if (!TRCsupports(t, ecu, pid) || p == NULL)
+		return -1;
+	s = &t->pid[ecu][pid];
+	// last sample at or before atUs, the first one before the car first answered
+	hi = s->n;
+	while (hi - lo > 1)
+	{
+		uint32_t mid = (lo + hi) / 2;
+
+		if (s->s[mid].timeUs <= atUs)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	memcpy(data, s->s[lo].data, p->bytes);
+	return p->bytes;
+}
+
+uint32_t TRClatency(const TRCtrace *t, int64_t atUs)
+{
+	uint32_t lo = 0, hi = t->nm01;
+
+	if (t->nm01 == 0)
+		return 0;
+	while (hi - lo > 1)
+	{
+		uint32_t mid = (lo + hi) / 2;
+
+		if (t->x[t->m01[mid]].timeUs <= atUs)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return t->x[t->m01[lo]].latencyUs;
+}
+
+int TRCfind(const TRCtrace *t, const char *req, int64_t atUs)
+{
+	int64_t best = -1, dist;
+	uint32_t i;
+	int at = -1;
+
+	for (i = 0; i < t->n; i++)
+	{
+		if (strcmp(t->text + t->x[i].req, req))
+			continue;
+		dist = t->x[i].timeUs > atUs ? t->x[i].timeUs - atUs : atUs - t->x[i].timeUs;
+		if (best < 0 || dist < best)
+		{
+			best = dist;
+			at = i;
+		}
+	}
+	return at;
+}
@@ -0,0 +1,105 @@
+/*
+=================================================================================
+ Name        : elmtrace.h
+ Version     : 0.1
+
+ Description : Recorded adapter sessions. elmrec sits between a client and a
+     real adapter and writes every exchange, the request line, the adapter's
+     reply up to the prompt, when the request went out and how long the
+     reply took, to a gzipped trace. elmsim -R replays a trace as a fake
+     ELM327 on a pseudo terminal.
+
+     File: a text line "ELMTRACE1 baud start_wall_ms\n", then per exchange
+     the varints time since the previous request (us), reply latency (us),
+     request length and bytes, reply length and bytes. The stream is sync
+     flushed once a second, so a recording cut off by a power loss reads
+     back up to the last flush.
+
+     On load the Mode 01 replies are decoded into a timeline of data bytes
+     per responder and PID. The replay answers whatever PIDs the client asks
+     for, in whatever batches its scheduler makes, with the values the car
+     had at that point of the drive; only other requests (actions, AT
+     queries) need the same request text to have been recorded.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef ELMTRACE_H
+#define ELMTRACE_H
+
+#include <stdint.h>
+
+#define TRC_MAGIC "ELMTRACE1"
+#define TRC_MAX_LINE 512        // longest request or reply kept
+#define TRC_MAX_ECUS 8
+#define TRC_SYNC_US 1000000     // sync flush the stream at least this often
+
+typedef struct
+{
+	void *gz;
+	int64_t lastUs;
+	int64_t syncedUs;
+	uint32_t exchanges;
+	uint64_t bytes;         // request and reply bytes written
+} TRCwriter;
+
+typedef struct
+{
+	int64_t timeUs;         // request time from the start of the recording
+	uint32_t latencyUs;
+	uint16_t reqLen, respLen;
+	uint32_t req, resp;     // offsets into TRCtrace.text, request normalised (upper case, no spaces)
+	uint8_t mode01;         // a Mode 01 request decoded into the timeline
+} TRCexchange;
+
+typedef struct
+{
+	int64_t timeUs;
+	uint8_t data[4];
+} TRCsample;
+
+typedef struct
+{
+	uint32_t n, cap;
+	TRCsample *s;
+} TRCseries;
+
+typedef struct
+{
+	int baud;
+	int64_t startWallMs;
+	int64_t durationUs;     // time of the last request
+	uint32_t n, cap;
+	TRCexchange *x;
+	char *text;
+	uint32_t textLen, textCap;
+	int necus;
+	uint32_t ecuId[TRC_MAX_ECUS];   // CAN id or source address of each responder
+	TRCseries pid[TRC_MAX_ECUS][256];
+	uint32_t *m01;          // exchanges that were Mode 01 requests, for latencies
+	uint32_t nm01;
+	uint64_t samples;
+	uint32_t undecoded;     // Mode 01 replies that could not be parsed
+} TRCtrace;
+
+// all int calls return -1 on failure
+ int TRCcreate(TRCwriter *w, const char *path, int baud);
+ int TRCwrite(TRCwriter *w, int64_t timeUs, uint32_t latencyUs, const char *req, int reqLen, const char *resp, int respLen);
+ int TRCclose(TRCwriter *w);
+ int TRCload(TRCtrace *t, const char *path);
+ void TRCfree(TRCtrace *t);
+ int TRCsupports(const TRCtrace *t, int ecu, uint8_t pid);
+ int TRCvalue(const TRCtrace *t, int ecu, uint8_t pid, int64_t atUs, uint8_t *data);  // bytes, last value at atUs
+ uint32_t TRClatency(const TRCtrace *t, int64_t atUs);     // of the Mode 01 request nearest atUs
+ int TRCfind(const TRCtrace *t, const char *req, int64_t atUs);   // exchange with the same request nearest atUs
+
+#endif
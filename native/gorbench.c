@@ -0,0 +1,396 @@
+/*
+=================================================================================
+ Name        : gorbench.c
+ Version     : 0.1
+
+ Description : Bytes per sample and encode/decode throughput of the
+     delta-of-delta / XOR block encoding against the JSON records the
+     metric loop writes today, plain and gzipped. Every block is decoded
+     again and compared bit for bit with what went in, after a check of
+     the values with the longest encodings behind runs of absent sweeps.
+
+     With -f it reads a recorded drive, one JSON sweep per line as found in
+     /opt/influxback or exported from the spool ({"time": secs, "RPM": ...});
+     without it a drive is synthesised: idle, town and motorway phases with
+     values quantised through the real PID formulas, sampled every -i ms with
+     a little scheduling jitter.
+
+     gorbench [-f drive.json] [-n sweeps] [-i interval_ms] [-b sweeps_per_block]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "obd_pids.h"
+#include "gorilla.h"
+
+typedef struct
+{
+	int64_t timeMs;
+	int n;
+	const char *names[GOR_MAX_COLUMNS];
+	double values[GOR_MAX_COLUMNS];
+} Sweep;
+
+static Sweep *sweeps;
+static int nsweeps;
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Round a value through the PID's wire format, as a real ECU reading would be.
+static double quantise(const OBDpid *p, double v)
+{
+	uint8_t data[4];
+
+	OBDencode(p, v, data);
+	return OBDdecode(p, data);
+}
+
+static void synthesise(int n, int intervalMs)
+{
+	double speed = 0, rpm = 800, coolant = 20, fuel = 62, dist = 0, t = 1500000000000.0;
+	int i, j;
+
+	sweeps = calloc(n, sizeof(Sweep));
+	srand(1);
+	for (i = 0; i < n; i++)
+	{
+		Sweep *s = &sweeps[nsweeps++];
+		double phase = fmod(i * intervalMs / 1000.0, 1800), target, throttle;
+
+		// 5 min idle, 10 min town, 15 min motorway, repeated
+		target = phase < 300 ? 0 : phase < 900 ? 25 + 20 * sin(phase / 20) : 110 + 5 * sin(phase / 60);
+		if (target < 0)
+			target = 0;
+		speed += (target - speed) * 0.05 + (rand() % 100 - 50) / 100.0;
+		if (speed < 0)
+			speed = 0;
+		rpm = speed < 1 ? 780 + rand() % 40 : 900 + speed * 22 + rand() % 50;
+		throttle = speed < 1 ? 14.5 : 18 + (target - speed) * 2 + rand() % 5;
+		coolant += (90 - coolant) * 0.002;
+		fuel -= speed * 0.000002 * intervalMs;
+		dist += speed * intervalMs / 3600000.0;
+		t += intervalMs + rand() % 21 - 10;
+		s->timeMs = (int64_t)t;
+
+		for (j = 0; j < OBDpidCount; j++)
+		{
+			const OBDpid *p = &OBDpids[j];
+			double v;
+
+			if (p->pid % 0x20 == 0)
+				continue;
+			switch (p->pid)
+			{
+				case 0x0C: v = rpm; break;
+				case 0x0D: v = speed; break;
+				case 0x11: v = throttle; break;
+				case 0x04: v = speed < 1 ? 22 : 30 + throttle; break;
+				case 0x05: v = coolant; break;
+				case 0x06: case 0x08: v = (rand() % 9) - 4; break;
+				case 0x10: v = rpm * 0.004 + throttle * 0.1; break;
+				case 0x2F: v = fuel; break;
+				case 0x31: v = dist; break;
+				case 0x1F: v = i * intervalMs / 1000; break;
+				case 0x42: v = 14.2 + (rand() % 5) / 100.0; break;
+				default: v = (p->pid * 37) % 100; break;   // sensors that do not move
+			}
+			s->names[s->n] = p->name;
+			s->values[s->n++] = quantise(p, v);
+		}
+	}
+}
+
+// Flat JSON objects only, string values are skipped as the encoder takes numbers.
+static int loadDrive(const char *path)
+{
+	static char line[65536];
+	FILE *f = fopen(path, "r");
+	int cap = 0;
+
+	if (f == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), f))
+	{
+		char *p = line, *key, *end;
+		Sweep *s;
+
+		if (nsweeps == cap)
+		{
+			cap = cap ? cap * 2 : 1024;
+			sweeps = realloc(sweeps, cap * sizeof(Sweep));
+		}
+		s = &sweeps[nsweeps];
+		s->n = 0;
+		s->timeMs = -1;
+		while ((key = strchr(p, '"')) != NULL && (end = strchr(key + 1, '"')) != NULL)
+		{
+			double v;
+
+			*end = 0;
+			p = end + 1;
+			while (*p == ' ' || *p == ':')
+				p++;
+			if (*p == '"')
+			{
+				if ((p = strchr(p + 1, '"')) == NULL)
+					break;
+				p++;
+				continue;
+			}
+			v = strtod(p, &end);
+			if (end == p)
+				continue;
+			p = end;
+			if (strcmp(key + 1, "time") == 0)
+				s->timeMs = (int64_t)(v * 1000);
+			else if (s->n < GOR_MAX_COLUMNS)
+			{
+				s->names[s->n] = strdup(key + 1);
+				s->values[s->n++] = v;
+			}
+		}
+		if (s->timeMs >= 0 && s->n > 0)
+			nsweeps++;
+	}
+	fclose(f);
+	return nsweeps;
+}
+
+// Python's json.dumps, which writes the shortest repr that reads back exactly.
+static int jsonSweep(char *out, int size, const Sweep *s)
+{
+	int len, i;
+
+	len = snprintf(out, size, "{\"time\": %.17g", s->timeMs / 1000.0);
+	for (i = 0; i < s->n; i++)
+	{
+		char num[32];
+		int prec;
+
+		for (prec = 1; prec < 17; prec++)
+		{
+			snprintf(num, sizeof(num), "%.*g", prec, s->values[i]);
+			if (strtod(num, NULL) == s->values[i])
+				break;
+		}
+		if (prec == 17)
+			snprintf(num, sizeof(num), "%.17g", s->values[i]);
+		len += snprintf(out + len, size - len, ", \"%s\": %s%s", s->names[i], num,
+			strchr(num, '.') || strchr(num, 'e') ? "" : ".0");
+	}
+	len += snprintf(out + len, size - len, "}\n");
+	return len;
+}
+
+static long gzip(const void *in, long len, uint8_t *out, long size)
+{
+	z_stream zs;
+	long n;
+
+	memset(&zs, 0, sizeof(zs));
+	deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = len;
+	zs.next_out = out;
+	zs.avail_out = size;
+	deflate(&zs, Z_FINISH);
+	n = zs.total_out;
+	deflateEnd(&zs);
+	return n;
+}
+
+static double fromBits(uint64_t v)
+{
+	double d;
+
+	memcpy(&d, &v, sizeof(d));
+	return d;
+}
+
+// Values that take the longest encodings: all 64 bits of the XOR significant
+// (a sign flip that also changes the last mantissa bit, as a fuel trim crossing
+// zero can), NaN, infinities and -0, written after every count of absent sweeps
+// up to a few buffer sizes so one lands right at the end of the buffer.
+static int checkEdges(void)
+{
+	static const uint64_t edge[] = { 0xBFF0000000000001ull, 0x3FF0000000000000ull, 0xBFE9000000000001ull,
+		0x3FE9000000000000ull, 0x7FF8000000000001ull, 0x8000000000000000ull, 0x7FF0000000000000ull,
+		0xFFF0000000000000ull, 0x0000000000000001ull, 0xFFFFFFFFFFFFFFFFull };
+	const int nedge = sizeof(edge) / sizeof(edge[0]);
+	const char *names[2] = { "SHORT_FUEL_TRIM_1", "RPM" };
+	static uint8_t buf[64 * 1024];
+	double values[2], got[GOR_MAX_COLUMNS];
+	int absent, i, len, cols[GOR_MAX_COLUMNS], n, bad = 0;
+	int64_t t;
+	GORblock b;
+	GORdecoder d;
+
+	for (absent = 0; absent < 4200 && bad == 0; absent++)
+	{
+		GORbegin(&b, "obd,vehicle=EDGE");
+		values[0] = 1.0;
+		values[1] = 800;
+		GORadd(&b, 0, names, values, 2);
+		for (i = 0; i < absent; i++)
+			GORadd(&b, (i + 1) * 1000, names + 1, values + 1, 1);
+		for (i = 0; i < nedge; i++)
+		{
+			values[0] = fromBits(edge[i]);
+			GORadd(&b, (absent + 1 + i) * 1000, names, values, 2);
+		}
+		len = GORfinish(&b, buf, sizeof(buf));
+		GORfree(&b);
+		if (len < 0 || GORdecode(&d, buf, len) < 0)
+		{
+			bad++;
+			break;
+		}
+		for (i = 0; i < 1 + absent + nedge && bad == 0; i++)
+		{
+			uint64_t want = i == 0 ? 0x3FF0000000000000ull : i <= absent ? 0 : edge[i - 1 - absent], v;
+
+			n = GORnext(&d, &t, cols, got);
+			if (n != (i == 0 || i > absent ? 2 : 1))
+				bad++;
+			else if (n == 2)
+			{
+				memcpy(&v, &got[strcmp(d.names[cols[0]], names[0]) == 0 ? 0 : 1], sizeof(v));
+				if (v != want)
+					bad++;
+			}
+		}
+	}
+	if (bad)
+		printf("edge values       MISMATCH after %d absent sweeps\n", absent - 1);
+	else
+		printf("edge values       exact, %d 64 bit XORs after 0 to %d absent sweeps\n", nedge * absent, absent - 1);
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	int n = 7200, intervalMs = 1000, perBlock = 60, opt, i, j, k, blocks = 0, bad = 0;
+	long jsonBytes = 0, gzBytes = 0, gorBytes = 0, gorGzBytes = 0, samples = 0, bufSize = 0;
+	double start, encodeSec = 0, decodeSec = 0;
+	char *json;
+	uint8_t *buf;
+	GORblock b;
+	GORdecoder d;
+
+	while ((opt = getopt(argc, argv, "f:n:i:b:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'f': path = optarg; break;
+			case 'n': n = atoi(optarg); break;
+			case 'i': intervalMs = atoi(optarg); break;
+			case 'b': perBlock = atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-f drive.json] [-n sweeps] [-i interval_ms] [-b sweeps_per_block]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (path ? loadDrive(path) <= 0 : (synthesise(n, intervalMs), 0))
+	{
+		fprintf(stderr, "gorbench: no sweeps read from %s\n", path);
+		return 1;
+	}
+	for (i = 0; i < nsweeps; i++)
+		samples += sweeps[i].n;
+	if (checkEdges())
+		return 1;
+
+	// JSON as spooled today, and the same sweeps gzipped a block at a time as the uploader would
+	json = malloc(64 * 1024 * 1024);
+	buf = malloc(bufSize = 64 * 1024 * 1024);
+	for (i = 0; i < nsweeps; i += perBlock)
+	{
+		long from = jsonBytes;
+
+		for (j = i; j < nsweeps && j < i + perBlock; j++)
+			jsonBytes += jsonSweep(json + jsonBytes, 64 * 1024 * 1024 - jsonBytes, &sweeps[j]);
+		gzBytes += gzip(json + from, jsonBytes - from, buf, bufSize);
+	}
+	free(buf);
+
+	// Blocks, decoded again and checked
+	buf = malloc(bufSize = 4 * 1024 * 1024);
+	GORbegin(&b, "obd,vehicle=BENCH0001");
+	for (i = 0; i < nsweeps; i += perBlock)
+	{
+		int last = i + perBlock < nsweeps ? i + perBlock : nsweeps, len, cols[GOR_MAX_COLUMNS];
+		double values[GOR_MAX_COLUMNS];
+		int64_t t;
+
+		start = nowSec();
+		for (j = i; j < last; j++)
+			GORadd(&b, sweeps[j].timeMs, sweeps[j].names, sweeps[j].values, sweeps[j].n);
+		len = GORfinish(&b, buf, bufSize);
+		encodeSec += nowSec() - start;
+		gorBytes += len;
+		gorGzBytes += gzip(buf, len, (uint8_t *)json, 64 * 1024 * 1024);
+		blocks++;
+
+		start = nowSec();
+		if (GORdecode(&d, buf, len) == 0)
+			while (GORnext(&d, &t, cols, values) > 0)
+				;
+		decodeSec += nowSec() - start;
+
+		if (GORdecode(&d, buf, len) < 0)
+			bad++;
+		for (j = i; j < last && bad == 0; j++)
+		{
+			int got = GORnext(&d, &t, cols, values);
+
+			if (got != sweeps[j].n || t != sweeps[j].timeMs)
+				bad++;
+			// columns come back in block order, recorded sweeps may list PIDs in any order
+			for (k = 0; k < got && bad == 0; k++)
+			{
+				int m;
+
+				for (m = 0; m < sweeps[j].n && strcmp(d.names[cols[k]], sweeps[j].names[m]) != 0; m++)
+					;
+				if (m == sweeps[j].n || memcmp(&values[k], &sweeps[j].values[m], sizeof(double)) != 0)
+					bad++;
+			}
+		}
+	}
+	GORfree(&b);
+
+	printf("%d sweeps, %ld samples (%.1f PIDs/sweep), %d blocks of %d sweeps\n", nsweeps, samples,
+		(double)samples / nsweeps, blocks, perBlock);
+	printf("json              %8.2f bytes/sample  %10ld bytes\n", (double)jsonBytes / samples, jsonBytes);
+	printf("json + gzip       %8.2f bytes/sample  %10ld bytes\n", (double)gzBytes / samples, gzBytes);
+	printf("dod + xor         %8.2f bytes/sample  %10ld bytes  (%.1fx smaller than json, %.1fx than json + gzip)\n",
+		(double)gorBytes / samples, gorBytes, (double)jsonBytes / gorBytes, (double)gzBytes / gorBytes);
+	printf("dod + xor + gzip  %8.2f bytes/sample  %10ld bytes\n", (double)gorGzBytes / samples, gorGzBytes);
+	printf("encode            %8.1f M samples/s\n", samples / encodeSec / 1e6);
+	printf("decode            %8.1f M samples/s\n", samples / decodeSec / 1e6);
+	printf("round trip        %s\n", bad ? "MISMATCH" : "exact");
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,482 @@
+/*
+=================================================================================
+ Name        : gorilla.c
+ Version     : 0.1
+
+ Description : Delta-of-delta time and XOR value compression for blocks of
+     metric sweeps, see gorilla.h for the block layout.
+
+     Time codes (milliseconds), dod = this delta - previous delta, the first
+     sweep is stored as 64 bits
+         0                 dod == 0
+         10  + 7 bits      -64 .. 63
+         110 + 9 bits      -256 .. 255
+         1110 + 12 bits    -2048 .. 2047
+         1111 + 32 bits    anything else that fits
+     Value codes, x = this value XOR previous value (as 64 bit patterns)
+         0                 not read in this sweep
+         1 + 64 bits       first value of the column
+         10                x == 0
+         110 + bits        x fits inside the previous meaningful bit window
+         111 + 5 bits leading zeros + 6 bits length + bits
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "gorilla.h"
+
+static int grow(GORbits *o, uint32_t n)
+{
+	uint32_t need = (o->bits + n + 7) / 8;
+
+	if (need > o->cap)
+	{
+		uint32_t cap = o->cap ? o->cap * 2 : 256;
+		uint8_t *p;
+
+		while (cap < need)
+			cap *= 2;
+		if ((p = realloc(o->buf, cap)) == NULL)
+			return -1;
+		memset(p + o->cap, 0, cap - o->cap);
+		o->buf = p;
+		o->cap = cap;
+	}
+	return 0;
+}
+
+// Append the low n bits of v, most significant first
+static void putBits(GORbits *o, uint64_t v, int n)
+{
+	while (n > 0)
+	{
+		int room = 8 - (o->bits & 7), take = n < room ? n : room;
+		uint8_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+
+		o->buf[o->bits >> 3] |= chunk << (room - take);
+		o->bits += take;
+		n -= take;
+	}
+}
+
+static uint64_t getBits(GORreader *r, int n)
+{
+	uint64_t v = 0;
+
+	if (r->pos + n > r->bits)
+	{
+		r->pos = r->bits + 1;   // mark the stream as corrupt
+		return 0;
+	}
+	while (n > 0)
+	{
+		int room = 8 - (r->pos & 7), take = n < room ? n : room;
+		uint8_t byte = r->buf[r->pos >> 3];
+
+		v = (v << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+		r->pos += take;
+		n -= take;
+	}
+	return v;
+}
+
+static int64_t signExtend(uint64_t v, int n)
+{
+	return (int64_t)(v << (64 - n)) >> (64 - n);
+}
+
+static void putTime(GORblock *b, int64_t t)
+{
+	int64_t delta = t - b->t, dod = delta - b->delta;
+
+	if (b->sweeps == 0)
+	{
+		putBits(&b->time, (uint64_t)t, 64);
+		delta = 0;
+	}
+	else if (dod == 0)
+		putBits(&b->time, 0, 1);
+	else if (dod >= -64 && dod <= 63)
+	{
+		putBits(&b->time, 2, 2);
+		putBits(&b->time, dod, 7);
+	}
+	else if (dod >= -256 && dod <= 255)
+	{
+		putBits(&b->time, 6, 3);
+		putBits(&b->time, dod, 9);
+	}
+	else if (dod >= -2048 && dod <= 2047)
+	{
+		putBits(&b->time, 14, 4);
+		putBits(&b->time, dod, 12);
+	}
+	else
+	{
+		putBits(&b->time, 15, 4);
+		putBits(&b->time, dod, 32);
+	}
+	b->t = t;
+	b->delta = delta;
+}
+
+// The longest a value can take: present, control, lead, length, 64 bits
+#define VALUE_MAX_BITS (1 + 2 + 5 + 6 + 64)
+
+static int putValue(GORcolumn *c, double value)
+{
+	uint64_t v, x;
+
+	if (grow(&c->out, VALUE_MAX_BITS) < 0)
+		return -1;
+	memcpy(&v, &value, sizeof(v));
+	putBits(&c->out, 1, 1);
+	if (!c->have)
+	{
+		putBits(&c->out, v, 64);
+		c->v = v;
+		c->have = 1;
+		return 0;
+	}
+	x = v ^ c->v;
+	if (x == 0)
+		putBits(&c->out, 0, 1);
+	else
+	{
+		int lead = __builtin_clzll(x), trail = __builtin_ctzll(x);
+
+		if (lead > 31)
+			lead = 31;
+		if (c->lead + c->trail && lead >= c->lead && trail >= c->trail)
+		{
+			putBits(&c->out, 2, 2);
+			putBits(&c->out, x >> c->trail, 64 - c->lead - c->trail);
+		}
+		else
+		{
+			int sig = 64 - lead - trail;
+
+			putBits(&c->out, 3, 2);
+			putBits(&c->out, lead, 5);
+			putBits(&c->out, sig & 63, 6);  // 64 is stored as 0
+			putBits(&c->out, x >> trail, sig);
+			c->lead = lead;
+			c->trail = trail;
+		}
+	}
+	c->v = v;
+	return 0;
+}
+
+// Mark the sweeps a column was not read in, up to (not including) sweep
+static int fillAbsent(GORcolumn *c, uint32_t sweep)
+{
+	if (grow(&c->out, sweep - c->next) < 0)
+		return -1;
+	c->out.bits += sweep - c->next;     // absent is a 0 bit, the buffer is zeroed
+	c->next = sweep;
+	return 0;
+}
+
+static int readTime(GORdecoder *d)
+{
+	GORreader *r = &d->time;
+	int64_t dod = 0;
+
+	if (d->sweep == 0)
+	{
+		d->t = (int64_t)getBits(r, 64);
+		d->delta = 0;
+	}
+	else
+	{
+		if (getBits(r, 1))
+		{
+			if (getBits(r, 1) == 0)
+				dod = signExtend(getBits(r, 7), 7);
+			else if (getBits(r, 1) == 0)
+				dod = signExtend(getBits(r, 9), 9);
+			else if (getBits(r, 1) == 0)
+				dod = signExtend(getBits(r, 12), 12);
+			else
+				dod = signExtend(getBits(r, 32), 32);
+		}
+		d->delta += dod;
+		d->t += d->delta;
+	}
+	return r->pos > r->bits ? -1 : 0;
+}
+
+// 1 with the next value in r->v, 0 if absent from this sweep
+static int readValue(GORreader *r)
+{
+	if (getBits(r, 1) == 0)
+		return r->pos > r->bits ? -1 : 0;
+	if (!r->have)
+	{
+		r->v = getBits(r, 64);
+		r->have = 1;
+	}
+	else if (getBits(r, 1))
+	{
+		if (getBits(r, 1) == 0)
+		{
+			if (r->lead + r->trail == 0)
+				return -1;
+			r->v ^= getBits(r, 64 - r->lead - r->trail) << r->trail;
+		}
+		else
+		{
+			int lead = getBits(r, 5), sig = getBits(r, 6);
+
+			if (sig == 0)
+				sig = 64;
+			if (lead + sig > 64)
+				return -1;
+			r->lead = lead;
+			r->trail = 64 - lead - sig;
+			r->v ^= getBits(r, sig) << r->trail;
+		}
+	}
+	return r->pos > r->bits ? -1 : 1;
+}
+
+int GORbegin(GORblock *b, const char *key)
+{
+	memset(b, 0, sizeof(*b));
+	if (strlen(key) >= sizeof(b->key))
+		return -1;
+	strcpy(b->key, key);
+	return 0;
+}
+
+int GORadd(GORblock *b, int64_t timeMs, const char **names, const double *values, int n)
+{
+	int64_t dod = timeMs - b->t - b->delta;
+	int i, j;
+
+	if ((b->sweeps && (dod < INT32_MIN || dod > INT32_MAX)) || grow(&b->time, 64) < 0)
+		return -1;
+	for (i = 0; i < n; i++)
+	{
+		GORcolumn *c;
+
+		// sweeps usually list the PIDs in the same order, try the same slot first
+		if (i < b->ncolumns && strcmp(b->col[i].name, names[i]) == 0)
+			j = i;
+		else
+		{
+			for (j = 0; j < b->ncolumns && strcmp(b->col[j].name, names[i]) != 0; j++)
+				;
+			if (j == b->ncolumns)
+			{
+				if (j == GOR_MAX_COLUMNS || strlen(names[i]) >= GOR_MAX_NAME)
+					return -1;
+				c = &b->col[j];
+				strcpy(c->name, names[i]);
+				c->first = c->next = b->sweeps;
+				c->have = 0;
+				c->lead = c->trail = 0;
+				b->ncolumns++;
+			}
+		}
+		c = &b->col[j];
+		if (c->next > b->sweeps)
+			continue;       // same PID twice in one sweep, keep the first
+		if (fillAbsent(c, b->sweeps) < 0 || putValue(c, values[i]) < 0)
+			return -1;
+		c->next = b->sweeps + 1;
+	}
+	putTime(b, timeMs);
+	b->sweeps++;
+	return 0;
+}
+
+int GORsize(const GORblock *b)
+{
+	int i, size = 4 + 2 + strlen(b->key) + 8 + (b->time.bits + 7) / 8 + 2;
+
+	for (i = 0; i < b->ncolumns; i++)
+	{
+		const GORcolumn *c = &b->col[i];
+
+		size += 1 + strlen(c->name) + 8 + (c->out.bits + b->sweeps - c->next + 7) / 8;
+	}
+	return size;
+}
+
+static int putBytes(uint8_t *out, int pos, const void *data, uint32_t len)
+{
+	if (len)
+		memcpy(out + pos, data, len);
+	return pos + len;
+}
+
+int GORfinish(GORblock *b, uint8_t *out, int size)
+{
+	uint32_t magic = GOR_MAGIC, bytes;
+	uint16_t len16;
+	uint8_t len8;
+	int i, pos;
+
+	if (size < GORsize(b))
+		return -1;
+	for (i = 0; i < b->ncolumns; i++)
+	{
+		if (fillAbsent(&b->col[i], b->sweeps) < 0)
+			return -1;
+	}
+	pos = putBytes(out, 0, &magic, 4);
+	len16 = strlen(b->key);
+	pos = putBytes(out, pos, &len16, 2);
+	pos = putBytes(out, pos, b->key, len16);
+	pos = putBytes(out, pos, &b->sweeps, 4);
+	pos = putBytes(out, pos, &b->time.bits, 4);
+	pos = putBytes(out, pos, b->time.buf, (b->time.bits + 7) / 8);
+	len16 = b->ncolumns;
+	pos = putBytes(out, pos, &len16, 2);
+	for (i = 0; i < b->ncolumns; i++)
+	{
+		GORcolumn *c = &b->col[i];
+
+		len8 = strlen(c->name);
+		out[pos++] = len8;
+		pos = putBytes(out, pos, c->name, len8);
+		pos = putBytes(out, pos, &c->first, 4);
+		pos = putBytes(out, pos, &c->out.bits, 4);
+		bytes = (c->out.bits + 7) / 8;
+		pos = putBytes(out, pos, c->out.buf, bytes);
+	}
+	GORreset(b);
+	return pos;
+}
+
+void GORreset(GORblock *b)
+{
+	int i;
+
+	// keep the buffers for the next block, zeroed as putBits() expects
+	if (b->time.bits)
+		memset(b->time.buf, 0, (b->time.bits + 7) / 8);
+	b->time.bits = 0;
+	for (i = 0; i < b->ncolumns; i++)
+	{
+		GORcolumn *c = &b->col[i];
+
+		if (c->out.bits)
+			memset(c->out.buf, 0, (c->out.bits + 7) / 8);
+		c->out.bits = 0;
+		c->name[0] = 0;
+	}
+	b->ncolumns = 0;
+	b->sweeps = 0;
+}
+
+void GORfree(GORblock *b)
+{
+	int i;
+
+	free(b->time.buf);
+	for (i = 0; i < GOR_MAX_COLUMNS; i++)
+		free(b->col[i].out.buf);
+	memset(b, 0, sizeof(*b));
+}
+
+int GORisBlock(const uint8_t *in, uint32_t len)
+{
+	uint32_t magic;
+
+	if (len < 8)
+		return 0;
+	memcpy(&magic, in, 4);
+	return magic == GOR_MAGIC;
+}
+
+int GORdecode(GORdecoder *d, const uint8_t *in, uint32_t len)
+{
+	uint16_t len16;
+	uint32_t pos, bits;
+	int i;
+
+	if (!GORisBlock(in, len))
+		return -1;
+	memset(d, 0, sizeof(GORdecoder) - sizeof(d->r));
+	memcpy(&len16, in + 4, 2);
+	if (len16 >= sizeof(d->key) || 6u + len16 + 8 > len)
+		return -1;
+	memcpy(d->key, in + 6, len16);
+	pos = 6 + len16;
+	memcpy(&d->sweeps, in + pos, 4);
+	memcpy(&bits, in + pos + 4, 4);
+	pos += 8;
+	if ((bits + 7) / 8 + 2 > len - pos)
+		return -1;
+	d->time.buf = in + pos;
+	d->time.bits = bits;
+	pos += (bits + 7) / 8;
+	memcpy(&len16, in + pos, 2);
+	pos += 2;
+	if (len16 > GOR_MAX_COLUMNS)
+		return -1;
+	d->ncolumns = len16;
+	for (i = 0; i < d->ncolumns; i++)
+	{
+		GORreader *r = &d->r[i];
+		uint8_t nameLen;
+
+		if (pos + 1 > len || (nameLen = in[pos]) >= GOR_MAX_NAME || pos + 1 + nameLen + 8 > len)
+			return -1;
+		memcpy(d->names[i], in + pos + 1, nameLen);
+		d->names[i][nameLen] = 0;
+		pos += 1 + nameLen;
+		memset(r, 0, sizeof(*r));
+		memcpy(&r->first, in + pos, 4);
+		memcpy(&bits, in + pos + 4, 4);
+		pos += 8;
+		if ((bits + 7) / 8 > len - pos)
+			return -1;
+		r->buf = in + pos;
+		r->bits = bits;
+		pos += (bits + 7) / 8;
+	}
+	return 0;
+}
+
+int GORnext(GORdecoder *d, int64_t *timeMs, int *cols, double *values)
+{
+	int i, n = 0, rc;
+
+	if (d->sweep >= d->sweeps)
+		return 0;
+	if (readTime(d) < 0)
+		return -1;
+	for (i = 0; i < d->ncolumns; i++)
+	{
+		GORreader *r = &d->r[i];
+
+		if (r->first > d->sweep)
+			continue;
+		if ((rc = readValue(r)) < 0)
+			return -1;
+		if (rc == 1)
+		{
+			cols[n] = i;
+			memcpy(&values[n], &r->v, sizeof(double));
+			n++;
+		}
+	}
+	d->sweep++;
+	*timeMs = d->t;
+	return n;
+}
@@ -0,0 +1,100 @@
+/*
+=================================================================================
+ Name        : gorilla.h
+ Version     : 0.1
+
+ Description : Compact columnar encoding for blocks of metric sweeps. Sweep
+     times are stored once per block as delta-of-delta, and every PID is its
+     own column of values stored as the XOR with its previous value, both in
+     variable length bit codes (Pelkonen et al, "Gorilla", VLDB 2015). A PID
+     that reads the same value every sweep costs 2 bits per sample, one that
+     was not read in a sweep costs 1.
+
+     Block layout, host byte order:
+         uint32 magic "GOR1", uint16 keyLen, key (line protocol series key),
+         uint32 sweeps, uint32 timeBits, time codes,
+         uint16 columns, then per column:
+         uint8 nameLen, name, uint32 first sweep, uint32 bits, (bits+7)/8 bytes
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#include <stdint.h>
+
+#define GOR_MAGIC 0x31524f47    // "GOR1"
+#define GOR_MAX_COLUMNS 128
+#define GOR_MAX_NAME 40
+
+typedef struct
+{
+	uint8_t *buf;
+	uint32_t cap;           // bytes allocated
+	uint32_t bits;          // bits written
+} GORbits;
+
+typedef struct
+{
+	char name[GOR_MAX_NAME];
+	GORbits out;
+	uint32_t first;         // sweep the column starts at
+	uint32_t next;          // next sweep to write, earlier ones missed are marked absent
+	int have;               // v holds a previous value
+	uint64_t v;             // previous value bits
+	uint8_t lead, trail;    // meaningful bit window of the previous XOR
+} GORcolumn;
+
+typedef struct
+{
+	char key[128];          // measurement and tags, "obd,vehicle=KEY"
+	uint32_t sweeps;
+	GORbits time;
+	int64_t t, delta;       // previous sweep time and delta
+	int ncolumns;
+	GORcolumn col[GOR_MAX_COLUMNS];
+} GORblock;
+
+typedef struct
+{
+	const uint8_t *buf;
+	uint32_t bits, pos;
+	uint32_t first;
+	int have;
+	uint64_t v;
+	uint8_t lead, trail;
+} GORreader;
+
+typedef struct
+{
+	char key[128];
+	uint32_t sweeps, sweep; // sweeps in the block, next to read
+	GORreader time;
+	int64_t t, delta;
+	int ncolumns;
+	char names[GOR_MAX_COLUMNS][GOR_MAX_NAME];
+	GORreader r[GOR_MAX_COLUMNS];
+} GORdecoder;
+
+// all int calls return -1 on failure
+ int GORbegin(GORblock *b, const char *key);
+ int GORadd(GORblock *b, int64_t timeMs, const char **names, const double *values, int n);  // one sweep
+ int GORsize(const GORblock *b);                               // bytes GORfinish() will write
+ int GORfinish(GORblock *b, uint8_t *out, int size);           // serialise, returns length, block is emptied
+ void GORreset(GORblock *b);                                   // drop the sweeps added so far
+ void GORfree(GORblock *b);
+ int GORisBlock(const uint8_t *in, uint32_t len);
+ int GORdecode(GORdecoder *d, const uint8_t *in, uint32_t len);
+ int GORnext(GORdecoder *d, int64_t *timeMs, int *cols, double *values);  // next sweep, fields read, 0 at the end
+
+#endif
@@ -0,0 +1,144 @@
+/*
+=================================================================================
+ Name        : gorilla_py.c
+ Version     : 0.1
+
+ Description : Python bindings for the block encoding, built as gorilla.so.
+
+     gorEncode(string key, list sweeps) - one block from a list of metric
+                 dicts, each with 'time' in seconds; values that are not
+                 numbers are left out. Returns the block as a string, or -1
+     gorDecode(string block)            - (key, list of dicts), or -1
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <Python.h>
+#include <stdint.h>
+#include "gorilla.h"
+
+static GORblock block;      // column buffers are kept between calls
+static GORdecoder decoder;
+
+static PyObject* py_gorEncode(PyObject* self, PyObject* args)
+{
+  const char *key, *names[GOR_MAX_COLUMNS];
+  double values[GOR_MAX_COLUMNS];
+  PyObject *sweeps, *result;
+  Py_ssize_t i;
+  int len;
+
+  if (!PyArg_ParseTuple(args, "sO!", &key, &PyList_Type, &sweeps) || strlen(key) >= sizeof(block.key))
+    return Py_BuildValue("i", -1);
+  strcpy(block.key, key);
+  for (i = 0; i < PyList_Size(sweeps); i++)
+  {
+    PyObject *sweep = PyList_GetItem(sweeps, i), *k, *v, *t, *utf8[GOR_MAX_COLUMNS];
+    Py_ssize_t pos = 0;
+    int n = 0, nutf8 = 0, rc;
+
+    if (!PyDict_Check(sweep) || (t = PyDict_GetItemString(sweep, "time")) == NULL || !PyNumber_Check(t))
+      continue;
+    while (n < GOR_MAX_COLUMNS && PyDict_Next(sweep, &pos, &k, &v))
+    {
+      if (v == Py_None || PyString_Check(v) || PyUnicode_Check(v) || !PyNumber_Check(v))
+        continue;
+      values[n] = PyFloat_AsDouble(v);
+      if (PyErr_Occurred())
+      {
+        PyErr_Clear();
+        continue;
+      }
+      // dicts from json.loads() have unicode keys
+      if (PyUnicode_Check(k) && (k = utf8[nutf8] = PyUnicode_AsUTF8String(k)) != NULL)
+        nutf8++;
+      if (k == NULL || !PyString_Check(k) || strcmp(PyString_AsString(k), "time") == 0)
+      {
+        PyErr_Clear();
+        continue;
+      }
+      names[n++] = PyString_AsString(k);
+    }
+    rc = GORadd(&block, (int64_t)(PyFloat_AsDouble(t) * 1000 + 0.5), names, values, n);
+    while (nutf8 > 0)
+    {
+      nutf8--;
+      Py_DECREF(utf8[nutf8]);
+    }
+    if (rc < 0)
+    {
+      GORreset(&block);
+      return Py_BuildValue("i", -1);
+    }
+  }
+  result = PyString_FromStringAndSize(NULL, GORsize(&block));
+  len = GORfinish(&block, (uint8_t *)PyString_AS_STRING(result), GORsize(&block));
+  if (len < 0)
+  {
+    Py_DECREF(result);
+    return Py_BuildValue("i", -1);
+  }
+  _PyString_Resize(&result, len);
+  return result;
+}
+
+static PyObject* py_gorDecode(PyObject* self, PyObject* args)
+{
+  const char *data;
+  int len, cols[GOR_MAX_COLUMNS], n, i;
+  double values[GOR_MAX_COLUMNS];
+  int64_t t;
+  PyObject *list;
+
+  if (!PyArg_ParseTuple(args, "s#", &data, &len) || GORdecode(&decoder, (const uint8_t *)data, len) < 0)
+    return Py_BuildValue("i", -1);
+  list = PyList_New(0);
+  while ((n = GORnext(&decoder, &t, cols, values)) > 0)
+  {
+    PyObject *sweep = PyDict_New(), *v = PyFloat_FromDouble(t / 1000.0);
+
+    PyDict_SetItemString(sweep, "time", v);
+    Py_DECREF(v);
+    for (i = 0; i < n; i++)
+    {
+      v = PyFloat_FromDouble(values[i]);
+      PyDict_SetItemString(sweep, decoder.names[cols[i]], v);
+      Py_DECREF(v);
+    }
+    PyList_Append(list, sweep);
+    Py_DECREF(sweep);
+  }
+  if (n < 0)
+  {
+    Py_DECREF(list);
+    return Py_BuildValue("i", -1);
+  }
+  return Py_BuildValue("(sN)", decoder.key, list);
+}
+
+
+/*
+ * Bind Python function names to our C functions
+ */
+static PyMethodDef gorilla_methods[] = {
+  {"gorEncode", py_gorEncode, METH_VARARGS},
+  {"gorDecode", py_gorDecode, METH_VARARGS},
+  {NULL, NULL}
+};
+
+/*
+ * Python calls this to let us initialize our module
+ */
+void initgorilla()
+{
+  (void) Py_InitModule("gorilla", gorilla_methods);
+}
@@ -0,0 +1,287 @@
+/*
+=================================================================================
+ Name        : httpsink.c
+ Version     : 0.1
+
+ Description : Local stand-in for the metric server, for testing the
+     uploader without a network. Accepts HTTP/1.1 POSTs with keep-alive,
+     gunzips line protocol bodies, counts rows and bytes, and checks that
+     row timestamps never go backwards (a reordered retry would). It can
+     fail every Nth request with 503, answer slowly, or close after each
+     response to exercise the uploader's retry and reconnect paths.
+
+     httpsink [-p port] [-f every_nth_fails] [-d delay_ms] [-c] [-q]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+#define MAX_CONNS 16
+#define MAX_REQUEST (4 * 1024 * 1024)
+
+typedef struct
+{
+	int fd;
+	char *buf;
+	long len;
+} Conn;
+
+static Conn conns[MAX_CONNS];
+static volatile int running = 1;
+static int failEvery = 0, delayMs = 0, closeAfter = 0, quiet = 0;
+static unsigned long requests, failed, rows, jsonPosts, outOfOrder, bytesIn, connections;
+static long long lastTs = 0;
+static char *plain;
+static long plainCap;
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static void report(void)
+{
+	printf("httpsink: %lu connections, %lu requests (%lu failed on purpose), %lu rows, %lu json posts, "
+		"%lu bytes in, %lu rows out of order\n",
+		connections, requests, failed, rows, jsonPosts, bytesIn, outOfOrder);
+	fflush(stdout);
+}
+
+static long gunzip(const char *in, long len)
+{
+	z_stream zs;
+	int rc;
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit2(&zs, 15 + 16) != Z_OK)
+		return -1;
+	zs.next_in = (Bytef *)in;
+	zs.avail_in = len;
+	do
+	{
+		if (plainCap - (long)zs.total_out < 65536)
+		{
+			plainCap = plainCap ? plainCap * 2 : 1 << 20;
+			plain = realloc(plain, plainCap);
+		}
+		zs.next_out = (Bytef *)plain + zs.total_out;
+		zs.avail_out = plainCap - zs.total_out;
+		rc = inflate(&zs, Z_NO_FLUSH);
+	} while (rc == Z_OK);
+	inflateEnd(&zs);
+	return rc == Z_STREAM_END ? (long)zs.total_out : -1;
+}
+
+// Count rows and check each timestamp (the last token) against the one before.
+static int consume(const char *body, long len)
+{
+	const char *p = body, *end = body + len;
+
+	while (p < end)
+	{
+		const char *nl = memchr(p, '\n', end - p), *ts;
+
+		if (nl == NULL)
+			nl = end;
+		if (nl > p)
+		{
+			long long t;
+
+			for (ts = nl; ts > p && ts[-1] != ' '; ts--)
+				;
+			t = atoll(ts);
+			if (ts == p || t <= 0)
+				return -1;
+			if (t < lastTs)
+				outOfOrder++;
+			lastTs = t;
+			rows++;
+		}
+		p = nl + 1;
+	}
+	return 0;
+}
+
+// Handle every complete request in the buffer, returns -1 to drop the connection.
+static int serve(Conn *c)
+{
+	for (;;)
+	{
+		char *hdrEnd = c->len ? memmem(c->buf, c->len, "\r\n\r\n", 4) : NULL;
+		long length = 0, used;
+		int gz = 0, closing = closeAfter, status = 204;
+		char *line, reply[160];
+
+		if (hdrEnd == NULL)
+			return c->len > 65536 ? -1 : 0;
+		*hdrEnd = 0;
+		for (line = strstr(c->buf, "\r\n"); line && line < hdrEnd; line = strstr(line + 2, "\r\n"))
+		{
+			if (strncasecmp(line + 2, "Content-Length:", 15) == 0)
+				length = atol(line + 17);
+			else if (strncasecmp(line + 2, "Content-Encoding:", 17) == 0 && strstr(line + 19, "gzip"))
+				gz = 1;
+			else if (strncasecmp(line + 2, "Connection:", 11) == 0 && strstr(line + 13, "close"))
+				closing = 1;
+		}
+		used = hdrEnd + 4 - c->buf + length;
+		if (length < 0 || used > MAX_REQUEST)
+			return -1;
+		if (c->len < used)
+		{
+			*hdrEnd = '\r';
+			return 0;
+		}
+
+		requests++;
+		if (failEvery && requests % failEvery == 0)
+		{
+			status = 503;
+			failed++;
+		}
+		else
+		{
+			const char *body = hdrEnd + 4;
+			long plainLen = length;
+
+			if (gz && (plainLen = gunzip(body, length)) >= 0)
+				body = plain;
+			if (plainLen < 0)
+				status = 400;
+			else if (plainLen && body[0] == '{')
+				jsonPosts++;
+			else if (consume(body, plainLen) < 0)
+				status = 400;
+		}
+		if (delayMs)
+			usleep(delayMs * 1000);
+		snprintf(reply, sizeof(reply), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n%s\r\n", status,
+			status == 204 ? "No Content" : status == 503 ? "Service Unavailable" : "Bad Request",
+			closing ? "Connection: close\r\n" : "");
+		if (send(c->fd, reply, strlen(reply), MSG_NOSIGNAL) < 0 || closing)
+			return -1;
+		memmove(c->buf, c->buf + used, c->len - used);
+		c->len -= used;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	struct pollfd pfds[MAX_CONNS + 1];
+	int port = 8086, opt, lfd, one = 1, i;
+	time_t lastReport = time(NULL);
+	unsigned long reported = 0;
+
+	while ((opt = getopt(argc, argv, "p:f:d:cq")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': port = atoi(optarg); break;
+			case 'f': failEvery = atoi(optarg); break;
+			case 'd': delayMs = atoi(optarg); break;
+			case 'c': closeAfter = 1; break;
+			case 'q': quiet = 1; break;
+			default:
+				fprintf(stderr, "usage: %s [-p port] [-f every_nth_fails] [-d delay_ms] [-c] [-q]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0)
+	{
+		perror("httpsink");
+		return 1;
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	for (i = 0; i < MAX_CONNS; i++)
+		conns[i].fd = -1;
+
+	while (running)
+	{
+		int n = 0;
+
+		pfds[n].fd = lfd;
+		pfds[n++].events = POLLIN;
+		for (i = 0; i < MAX_CONNS; i++)
+		{
+			pfds[n].fd = conns[i].fd;
+			pfds[n++].events = POLLIN;
+		}
+		if (poll(pfds, n, 1000) < 0)
+			continue;
+		if (pfds[0].revents & POLLIN)
+		{
+			int fd = accept(lfd, NULL, NULL);
+
+			for (i = 0; fd >= 0 && i < MAX_CONNS && conns[i].fd >= 0; i++)
+				;
+			if (fd >= 0 && i == MAX_CONNS)
+				close(fd);
+			else if (fd >= 0)
+			{
+				conns[i].fd = fd;
+				conns[i].len = 0;
+				if (conns[i].buf == NULL)
+					conns[i].buf = malloc(MAX_REQUEST + 1);
+				connections++;
+			}
+		}
+		for (i = 0; i < MAX_CONNS; i++)
+		{
+			Conn *c = &conns[i];
+			long got;
+
+			if (c->fd < 0 || !(pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			got = recv(c->fd, c->buf + c->len, MAX_REQUEST - c->len, 0);
+			if (got > 0)
+			{
+				bytesIn += got;
+				c->len += got;
+			}
+			if (got <= 0 || serve(c) < 0)
+			{
+				close(c->fd);
+				c->fd = -1;
+			}
+		}
+		if (!quiet && time(NULL) - lastReport >= 5 && requests != reported)
+		{
+			report();
+			reported = requests;
+			lastReport = time(NULL);
+		}
+	}
+	report();
+	return 0;
+}
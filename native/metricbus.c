@@ -0,0 +1,76 @@
+/*
+=================================================================================
+ Name        : metricbus.c
+ Version     : 0.1
+
+ Description : Shared memory metric bus, see metricbus.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "metricbus.h"
+
+int MBUSopen(MBUSbus *b, const char *name, int writer)
+{
+	struct stat st;
+	MBUSmap *m;
+	int fd, i;
+
+	memset(b, 0, sizeof(*b));
+	fd = shm_open(name ? name : MBUS_NAME, writer ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0 || (writer && st.st_size < (off_t)sizeof(MBUSmap) && ftruncate(fd, sizeof(MBUSmap)) < 0) ||
+		(!writer && st.st_size < (off_t)sizeof(MBUSmap)))
+	{
+		close(fd);
+		return -1;
+	}
+	m = mmap(NULL, sizeof(MBUSmap), writer ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED)
+		return -1;
+	if (writer)
+	{
+		if (m->magic != MBUS_MAGIC || m->slots != MBUS_SLOTS)
+		{
+			memset(m, 0, sizeof(*m));
+			m->slots = MBUS_SLOTS;
+			__atomic_store_n(&m->magic, MBUS_MAGIC, __ATOMIC_RELEASE);
+		}
+		// a writer that died inside a slot left it odd
+		for (i = 0; i < MBUS_SLOTS; i++)
+			if (m->slot[i].seq & 1)
+				__atomic_store_n(&m->slot[i].seq, m->slot[i].seq + 1, __ATOMIC_RELEASE);
+		m->writerPid = getpid();
+	}
+	else if (__atomic_load_n(&m->magic, __ATOMIC_ACQUIRE) != MBUS_MAGIC || m->slots != MBUS_SLOTS)
+	{
+		munmap(m, sizeof(MBUSmap));
+		return -1;
+	}
+	b->map = m;
+	b->writer = writer;
+	return 0;
+}
+
+void MBUSclose(MBUSbus *b)
+{
+	if (b->map)
+		munmap(b->map, sizeof(MBUSmap));
+	b->map = NULL;
+}
@@ -0,0 +1,115 @@
+/*
+=================================================================================
+ Name        : metricbus.h
+ Version     : 0.1
+
+ Description : Shared memory bus carrying the latest value of every Mode 01
+     PID from the OBD collector to other processes (the LCD dashboard). The
+     collector maps /dev/shm/uhacknect-metrics read-write and publishes each
+     value with its wall clock time into the PID's slot; readers map it read
+     only and copy slots out without a system call or a lock.
+
+     Every slot is a seqlock on its own cache line: the writer makes the
+     sequence odd, stores the value and time, then makes it even again. A
+     reader that saw an odd sequence, or a different one after copying,
+     copies again. Readers never block the writer, it does not even know they
+     are there, and a reader can tell a slot has news by its sequence alone.
+     There is one writer; a second one would need a lock of its own.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef METRICBUS_H
+#define METRICBUS_H
+
+#include <stdint.h>
+
+#define MBUS_NAME "/uhacknect-metrics"  // shm_open() name
+#define MBUS_MAGIC 0x3153424d           // "MBS1"
+#define MBUS_SLOTS 256                  // one per Mode 01 PID
+#define MBUS_TRIES 1000                 // copies before a reader gives up on a slot for now
+
+typedef struct
+{
+	volatile uint32_t seq;          // odd while the writer is inside
+	volatile uint32_t updates;
+	volatile int64_t timeMs;        // wall clock ms of the reading, 0 = never published
+	volatile double value;
+	uint8_t pad[40];                // a 64 byte cache line each
+} MBUSslot;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t slots;
+	volatile uint32_t writerPid;
+	volatile uint32_t generation;   // bumped after every publish
+	uint8_t pad[48];
+	MBUSslot slot[MBUS_SLOTS];
+} MBUSmap;
+
+typedef struct
+{
+	MBUSmap *map;
+	int writer;
+} MBUSbus;
+
+// all int calls return -1 on failure
+ int MBUSopen(MBUSbus *b, const char *name, int writer);    // name NULL = MBUS_NAME, the writer creates it
+ void MBUSclose(MBUSbus *b);
+
+// Single writer only
+static inline void MBUSpublish(MBUSmap *m, uint8_t pid, double value, int64_t timeMs)
+{
+	MBUSslot *s = &m->slot[pid];
+	uint32_t seq = s->seq;
+
+	__atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	s->value = value;
+	s->timeMs = timeMs;
+	s->updates++;
+	__atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&m->generation, m->generation + 1, __ATOMIC_RELEASE);
+}
+
+// Consistent copy of a slot, returns its sequence (compare it to tell news).
+// An odd return means no consistent copy: the writer is stalled inside the slot
+// (preempted on a single core) or died there; try again later.
+static inline uint32_t MBUSread(const MBUSmap *m, uint8_t pid, double *value, int64_t *timeMs)
+{
+	const MBUSslot *s = &m->slot[pid];
+	uint32_t before = 1, after;
+	int tries;
+
+	for (tries = 0; tries < MBUS_TRIES; tries++)
+	{
+		before = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+		if (before & 1)
+			continue;
+		*value = s->value;
+		*timeMs = s->timeMs;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+		if (after == before)
+			return before;
+	}
+	return before | 1;
+}
+
+// Sequence only, one load, to skip slots with nothing new
+static inline uint32_t MBUSseq(const MBUSmap *m, uint8_t pid)
+{
+	return __atomic_load_n(&m->slot[pid].seq, __ATOMIC_ACQUIRE);
+}
+
+#endif
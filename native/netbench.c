@@ -0,0 +1,212 @@
+/*
+=================================================================================
+ Name        : netbench.c
+ Version     : 0.1
+
+ Description : Cost of reading the network status from the netlink monitor
+     against walking the interfaces, as ip4_addresses() does through
+     netifaces (one getifaddrs() for the list and one per interface), and of
+     a disk usage sample. With -i it also times how long a link change takes
+     to reach a thread sleeping in NETpoll(), by taking the named interface
+     down and up -n times (needs root, use a spare interface).
+
+     netbench [-n iterations] [-i interface]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ifaddrs.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/statvfs.h>
+#include "netmon.h"
+
+static NETmon mon;
+static pthread_mutex_t monMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t monChanged = PTHREAD_COND_INITIALIZER;
+static volatile int stop;
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// What ip4_addresses() costs: the interface list, then each interface's addresses
+static int walkInterfaces(char *first, int size)
+{
+	struct ifaddrs *list, *a, *each, *b;
+	int n = 0;
+
+	first[0] = 0;
+	if (getifaddrs(&list) < 0)
+		return -1;
+	for (a = list; a; a = a->ifa_next)
+	{
+		if (a->ifa_addr == NULL || a->ifa_addr->sa_family != AF_PACKET)
+			continue;
+		if (getifaddrs(&each) < 0)
+			break;
+		for (b = each; b; b = b->ifa_next)
+			if (b->ifa_addr && b->ifa_addr->sa_family == AF_INET && strcmp(b->ifa_name, a->ifa_name) == 0 &&
+				!(b->ifa_flags & IFF_LOOPBACK) && !first[0])
+			{
+				inet_ntop(AF_INET, &((struct sockaddr_in *)b->ifa_addr)->sin_addr, first, size);
+				n++;
+			}
+		freeifaddrs(each);
+	}
+	freeifaddrs(list);
+	return n;
+}
+
+// As netmon_py.c: sleep on the socket unlocked, apply what came under the lock
+static void *monitor(void *arg)
+{
+	struct pollfd pfd;
+
+	(void)arg;
+	pfd.fd = mon.fd;
+	pfd.events = POLLIN;
+	while (!stop)
+	{
+		poll(&pfd, 1, 100);
+		pthread_mutex_lock(&monMutex);
+		if (NETpoll(&mon, 0) > 0)
+			pthread_cond_broadcast(&monChanged);
+		pthread_mutex_unlock(&monMutex);
+	}
+	return NULL;
+}
+
+static int setUp(int fd, const char *ifname, int up)
+{
+	struct ifreq ifr;
+
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+	if (ioctl(fd, SIOCGIFFLAGS, &ifr) < 0)
+		return -1;
+	ifr.ifr_flags = up ? ifr.ifr_flags | IFF_UP : ifr.ifr_flags & ~IFF_UP;
+	return ioctl(fd, SIOCSIFFLAGS, &ifr);
+}
+
+int main(int argc, char **argv)
+{
+	const char *ifname = NULL;
+	char addr[INET_ADDRSTRLEN];
+	int iterations = 100000, opt, i;
+	double start, cached, walked, disk;
+	volatile int sink = 0;
+	struct statvfs st;
+
+	while ((opt = getopt(argc, argv, "n:i:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': iterations = atoi(optarg); break;
+			case 'i': ifname = optarg; break;
+			default:
+				iterations = 0;
+				break;
+		}
+	}
+	if (iterations < 1)
+	{
+		fprintf(stderr, "usage: %s [-n iterations] [-i interface]\n", argv[0]);
+		return 1;
+	}
+	if (NETopen(&mon) < 0)
+	{
+		perror("netbench: netlink");
+		return 1;
+	}
+	NETaddress(&mon, addr, sizeof(addr));
+	printf("%d interfaces, online %d, first address %s\n", mon.nifs, mon.online, addr[0] ? addr : "none");
+
+	start = nowSec();
+	for (i = 0; i < iterations; i++)
+		sink += NETaddress(&mon, addr, sizeof(addr)) + mon.online;
+	cached = (nowSec() - start) / iterations;
+	start = nowSec();
+	for (i = 0; i < iterations / 100 + 1; i++)
+		sink += walkInterfaces(addr, sizeof(addr));
+	walked = (nowSec() - start) / (iterations / 100 + 1);
+	start = nowSec();
+	for (i = 0; i < iterations / 100 + 1; i++)
+		sink += statvfs("/", &st);
+	disk = (nowSec() - start) / (iterations / 100 + 1);
+	printf("cached address + online %8.0f ns/read\n", cached * 1e9);
+	printf("interface walk          %8.0f ns/read (%.0fx), %.2f%% of a core at the display's 4 Hz\n", walked * 1e9,
+		walked / cached, walked * 4 * 100);
+	printf("statvfs                 %8.0f ns/sample\n", disk * 1e9);
+
+	if (ifname)
+	{
+		pthread_t thread;
+		double worst = 0, total = 0;
+		int fd = socket(AF_INET, SOCK_DGRAM, 0), n = iterations < 50 ? iterations : 50, done = 0;
+
+		pthread_create(&thread, NULL, monitor, NULL);
+		usleep(100000);
+		for (i = 0; i < n; i++)
+		{
+			uint32_t before;
+			struct timespec until;
+			double t0, dt;
+			int up = !(i % 2);
+
+			pthread_mutex_lock(&monMutex);
+			before = mon.generation;
+			pthread_mutex_unlock(&monMutex);
+			t0 = nowSec();
+			if (setUp(fd, ifname, up) < 0)
+			{
+				perror("netbench: SIOCSIFFLAGS");
+				break;
+			}
+			clock_gettime(CLOCK_REALTIME, &until);
+			until.tv_sec++;
+			pthread_mutex_lock(&monMutex);
+			while (mon.generation == before)
+				if (pthread_cond_timedwait(&monChanged, &monMutex, &until) != 0)
+					break;
+			pthread_mutex_unlock(&monMutex);
+			dt = nowSec() - t0;
+			if (dt >= 1)
+				continue;
+			total += dt;
+			if (dt > worst)
+				worst = dt;
+			done++;
+		}
+		setUp(fd, ifname, 0);
+		stop = 1;
+		pthread_join(thread, NULL);
+		if (done)
+			printf("link change seen after  %8.0f us on average, %.0f us at worst (%d of %d), "
+				"against 15 s on average for the 30 s ping\n", total / done * 1e6, worst * 1e6, done, n);
+	}
+	NETclose(&mon);
+	return sink == -1;
+}
@@ -0,0 +1,338 @@
+/*
+=================================================================================
+ Name        : netmon.c
+ Version     : 0.1
+
+ Description : Network status from rtnetlink, see netmon.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/statvfs.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "netmon.h"
+
+#define NET_RX_SIZE 16384
+
+static int64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static NETif *findIf(NETmon *m, int index, int create)
+{
+	int i;
+
+	for (i = 0; i < m->nifs; i++)
+		if (m->ifs[i].index == index)
+			return &m->ifs[i];
+	if (!create || m->nifs == NET_MAX_IFS)
+		return NULL;
+	memset(&m->ifs[m->nifs], 0, sizeof(NETif));
+	m->ifs[m->nifs].index = index;
+	return &m->ifs[m->nifs++];
+}
+
+static int isOnline(const NETif *f)
+{
+	return !(f->flags & IFF_LOOPBACK) && (f->flags & IFF_UP) && f->carrier && f->naddrs > 0;
+}
+
+static void changed(NETmon *m)
+{
+	int i;
+
+	m->online = 0;
+	for (i = 0; i < m->nifs; i++)
+		if (isOnline(&m->ifs[i]))
+			m->online = 1;
+	m->generation++;
+	m->stats.changes++;
+}
+
+static int applyLink(NETmon *m, struct nlmsghdr *h)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(h);
+	struct rtattr *a;
+	int len = IFLA_PAYLOAD(h);
+	char name[NET_NAME] = "";
+	NETif *f, before;
+
+	if (h->nlmsg_type == RTM_DELLINK)
+	{
+		if ((f = findIf(m, ifi->ifi_index, 0)) == NULL)
+			return 0;
+		*f = m->ifs[--m->nifs];
+		return 1;
+	}
+	for (a = IFLA_RTA(ifi); RTA_OK(a, len); a = RTA_NEXT(a, len))
+		if (a->rta_type == IFLA_IFNAME)
+			snprintf(name, sizeof(name), "%s", (char *)RTA_DATA(a));
+	if ((f = findIf(m, ifi->ifi_index, 1)) == NULL)
+		return 0;
+	before = *f;
+	if (name[0])
+		memcpy(f->name, name, sizeof(name));
+	f->flags = ifi->ifi_flags;
+	f->carrier = (ifi->ifi_flags & IFF_RUNNING) != 0;
+	return memcmp(&before, f, sizeof(before)) != 0;
+}
+
+static int applyAddr(NETmon *m, struct nlmsghdr *h)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(h);
+	struct rtattr *a;
+	int len = IFA_PAYLOAD(h), i;
+	uint32_t addr = 0;
+	int have = 0;
+	NETif *f;
+
+	if (ifa->ifa_family != AF_INET)
+		return 0;
+	// IFA_LOCAL is the address itself on point to point links, IFA_ADDRESS the peer
+	for (a = IFA_RTA(ifa); RTA_OK(a, len); a = RTA_NEXT(a, len))
+		if ((a->rta_type == IFA_LOCAL || (a->rta_type == IFA_ADDRESS && !have)) && RTA_PAYLOAD(a) == 4)
+		{
+			memcpy(&addr, RTA_DATA(a), 4);
+			have = a->rta_type == IFA_LOCAL ? 2 : 1;
+		}
+	if (!have || (f = findIf(m, ifa->ifa_index, h->nlmsg_type == RTM_NEWADDR)) == NULL)
+		return 0;
+	for (i = 0; i < f->naddrs; i++)
+		if (f->addr[i] == addr)
+			break;
+	if (h->nlmsg_type == RTM_DELADDR)
+	{
+		if (i == f->naddrs)
+			return 0;
+		memmove(f->addr + i, f->addr + i + 1, (f->naddrs - i - 1) * sizeof(uint32_t));
+		memmove(f->prefix + i, f->prefix + i + 1, f->naddrs - i - 1);
+		f->naddrs--;
+		return 1;
+	}
+	if (i < f->naddrs || f->naddrs == NET_MAX_ADDRS)
+		return 0;
+	f->addr[f->naddrs] = addr;
+	f->prefix[f->naddrs++] = ifa->ifa_prefixlen;
+	return 1;
+}
+
+// Apply one buffer of messages; 1 once the dump with seq is done
+static int apply(NETmon *m, char *buf, int n, uint32_t seq, int *changes)
+{
+	struct nlmsghdr *h;
+	int done = 0;
+
+	for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, (unsigned)n); h = NLMSG_NEXT(h, n))
+	{
+		int c = 0;
+
+		switch (h->nlmsg_type)
+		{
+			case NLMSG_DONE:
+			case NLMSG_ERROR:
+				if (seq && h->nlmsg_seq == seq)
+					done = 1;
+				continue;
+			case RTM_NEWLINK:
+			case RTM_DELLINK:
+				c = applyLink(m, h);
+				break;
+			case RTM_NEWADDR:
+			case RTM_DELADDR:
+				c = applyAddr(m, h);
+				break;
+			default:
+				continue;
+		}
+		m->stats.events++;
+		if (c)
+		{
+			changed(m);
+			(*changes)++;
+		}
+	}
+	return done;
+}
+
+// Full dump of one kind, events that arrive meanwhile are applied in order
+static int dump(NETmon *m, int type, int family)
+{
+	struct
+	{
+		struct nlmsghdr h;
+		struct rtgenmsg g;
+	} req;
+	struct sockaddr_nl kernel;
+	char buf[NET_RX_SIZE];
+	int n, changes = 0;
+
+	memset(&req, 0, sizeof(req));
+	memset(&kernel, 0, sizeof(kernel));
+	kernel.nl_family = AF_NETLINK;
+	req.h.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+	req.h.nlmsg_type = type;
+	req.h.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.h.nlmsg_seq = ++m->seq;
+	req.g.rtgen_family = family;
+	if (sendto(m->fd, &req, req.h.nlmsg_len, 0, (struct sockaddr *)&kernel, sizeof(kernel)) < 0)
+		return -1;
+	for (;;)
+	{
+		struct pollfd pfd = { m->fd, POLLIN, 0 };
+
+		if (poll(&pfd, 1, 2000) <= 0)
+			return -1;
+		n = recv(m->fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (n < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (n <= 0)
+			return -1;
+		if (apply(m, buf, n, m->seq, &changes))
+			return changes;
+	}
+}
+
+static int resync(NETmon *m)
+{
+	m->nifs = 0;
+	if (dump(m, RTM_GETLINK, AF_UNSPEC) < 0 || dump(m, RTM_GETADDR, AF_INET) < 0)
+		return -1;
+	changed(m);
+	return 0;
+}
+
+int NETopen(NETmon *m)
+{
+	struct sockaddr_nl local;
+	int rcvbuf = 256 * 1024;
+
+	memset(m, 0, sizeof(*m));
+	m->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (m->fd < 0)
+		return -1;
+	memset(&local, 0, sizeof(local));
+	local.nl_family = AF_NETLINK;
+	local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR;
+	setsockopt(m->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	if (bind(m->fd, (struct sockaddr *)&local, sizeof(local)) < 0 || resync(m) < 0)
+	{
+		close(m->fd);
+		m->fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+void NETclose(NETmon *m)
+{
+	if (m->fd >= 0)
+		close(m->fd);
+	m->fd = -1;
+}
+
+int NETpoll(NETmon *m, int timeoutMs)
+{
+	struct pollfd pfd = { m->fd, POLLIN, 0 };
+	char buf[NET_RX_SIZE];
+	int n, changes = 0;
+
+	if (m->fd < 0)
+		return -1;
+	if (poll(&pfd, 1, timeoutMs) < 0 && errno != EINTR)
+		return -1;
+	for (;;)
+	{
+		n = recv(m->fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (n > 0)
+		{
+			apply(m, buf, n, 0, &changes);
+			continue;
+		}
+		if (n < 0 && errno == ENOBUFS)
+		{
+			// the kernel dropped messages, what we hold may be stale
+			m->stats.resyncs++;
+			if (resync(m) < 0)
+				return -1;
+			changes++;
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EINTR))
+			return changes;
+		return -1;
+	}
+}
+
+int NETaddress(const NETmon *m, char *out, int size)
+{
+	int i;
+
+	for (i = 0; i < m->nifs; i++)
+		if (isOnline(&m->ifs[i]))
+		{
+			inet_ntop(AF_INET, &m->ifs[i].addr[0], out, size);
+			return 1;
+		}
+	if (size)
+		out[0] = 0;
+	return 0;
+}
+
+int NETaddresses(const NETmon *m, uint32_t *out, int max)
+{
+	int i, j, n = 0;
+
+	for (i = 0; i < m->nifs; i++)
+	{
+		if (m->ifs[i].flags & IFF_LOOPBACK)
+			continue;
+		for (j = 0; j < m->ifs[i].naddrs && n < max; j++)
+			out[n++] = m->ifs[i].addr[j];
+	}
+	return n;
+}
+
+int NETdisk(NETmon *m, const char *path, int maxAgeMs)
+{
+	struct statvfs st;
+	int64_t now = nowMs();
+	double used, total;
+
+	if (m->diskAt && now - m->diskAt < maxAgeMs && strcmp(path, m->diskPath) == 0)
+		return 0;
+	if (statvfs(path, &st) < 0)
+		return -1;
+	// as df and psutil: used over what an unprivileged user could have
+	used = (double)(st.f_blocks - st.f_bfree) * st.f_frsize;
+	total = used + (double)st.f_bavail * st.f_frsize;
+	m->diskUsed = total > 0 ? used * 100 / total : 0;
+	m->diskFree = (uint64_t)st.f_bavail * st.f_frsize;
+	m->diskAt = now;
+	if (path != m->diskPath)
+		snprintf(m->diskPath, sizeof(m->diskPath), "%s", path);
+	m->stats.diskSamples++;
+	return 1;
+}
@@ -0,0 +1,83 @@
+/*
+=================================================================================
+ Name        : netmon.h
+ Version     : 0.1
+
+ Description : Network status kept current by the kernel instead of polled.
+     One rtnetlink socket subscribed to link and IPv4 address changes
+     (RTMGRP_LINK, RTMGRP_IPV4_IFADDR) is seeded with a dump of both and
+     then updated from the messages as they come, so the cached interfaces,
+     their addresses and whether the box is online are always current and
+     cost nothing to read. NETpoll() blocks on the socket, so a caller can
+     sleep in it and hear about a cable pulled or a DHCP lease within
+     milliseconds. Disk usage, which no event covers, is sampled on a slow
+     timer by NETdisk().
+
+     Online means an interface other than loopback is up, has carrier and
+     holds an IPv4 address; whether the server answers is the caller's
+     business.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef NETMON_H
+#define NETMON_H
+
+#include <stdint.h>
+
+#define NET_MAX_IFS 16
+#define NET_MAX_ADDRS 4         // IPv4 addresses kept per interface
+#define NET_NAME 16
+
+typedef struct
+{
+	int index;
+	char name[NET_NAME];
+	uint32_t flags;         // IFF_*
+	int carrier;            // IFF_RUNNING / operstate up
+	int naddrs;
+	uint32_t addr[NET_MAX_ADDRS];   // network order
+	uint8_t prefix[NET_MAX_ADDRS];
+} NETif;
+
+typedef struct
+{
+	uint32_t events;        // netlink messages applied
+	uint32_t changes;       // of them, the ones that changed something
+	uint32_t resyncs;       // full dumps after the socket overflowed
+	uint32_t diskSamples;
+} NETstats;
+
+typedef struct
+{
+	int fd;
+	uint32_t seq;
+	int nifs;
+	NETif ifs[NET_MAX_IFS];
+	uint32_t generation;    // bumped on every change to ifs
+	int online;
+	char diskPath[128];
+	double diskUsed;        // percent of the filesystem used, as df
+	uint64_t diskFree;      // bytes available to unprivileged users
+	int64_t diskAt;         // monotonic ms of the last sample
+	NETstats stats;
+} NETmon;
+
+// all int calls return -1 on failure
+ int NETopen(NETmon *m);
+ void NETclose(NETmon *m);
+ int NETpoll(NETmon *m, int timeoutMs);   // apply pending messages, waiting up to timeoutMs for one; changes
+ int NETaddress(const NETmon *m, char *out, int size);  // first IPv4 address of an online interface, 0 if none
+ int NETaddresses(const NETmon *m, uint32_t *out, int max);
+ int NETdisk(NETmon *m, const char *path, int maxAgeMs);  // statvfs when the sample is older, 1 if it did
+
+#endif
@@ -0,0 +1,251 @@
+/*
+=================================================================================
+ Name        : netmon_py.c
+ Version     : 0.1
+
+ Description : Python bindings for the network monitor, built as netmon.so.
+     A thread of its own sleeps on the netlink socket and applies changes as
+     they arrive, and samples disk usage every diskSecs; the calls below only
+     copy out what it holds, under a mutex, without a system call.
+
+     netStart(string diskPath='/', int diskSecs=60) - start the monitor, 0 or -1
+     netAddress()                 - first IPv4 address of an online interface, '' if none
+     netAddresses()               - every IPv4 address but loopback's, as strings
+     netOnline()                  - 1 if an interface is up with carrier and an address
+     netDisk()                    - percent of diskPath used, as psutil.disk_usage()
+     netGeneration()              - bumped on every link or address change
+     netWait(int generation, float secs) - block until the generation differs
+                                    from the one given or secs pass, returns it
+     netInterfaces()              - list of {name, up, carrier, addresses}
+     netStats()                   - dict of monitor counters
+
+     All return -1 (netAddress() '') before netStart().
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <Python.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include "netmon.h"
+
+static NETmon mon;
+static int started = 0;
+static int diskMs = 60000;
+static pthread_t monThread;
+static pthread_mutex_t monMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t monChanged = PTHREAD_COND_INITIALIZER;
+
+static void *monitor(void *arg)
+{
+  struct pollfd pfd;
+
+  pfd.fd = mon.fd;
+  pfd.events = POLLIN;
+  for (;;)
+  {
+    // sleep on the socket unlocked, apply what came under the lock
+    poll(&pfd, 1, diskMs);
+    pthread_mutex_lock(&monMutex);
+    if (NETpoll(&mon, 0) > 0)
+      pthread_cond_broadcast(&monChanged);
+    NETdisk(&mon, mon.diskPath, diskMs);
+    pthread_mutex_unlock(&monMutex);
+  }
+  return NULL;
+}
+
+static PyObject* py_netStart(PyObject* self, PyObject* args)
+{
+  const char *diskPath = "/";
+  int diskSecs = 60;
+
+  if (started)
+    return Py_BuildValue("i", 0);
+  if (!PyArg_ParseTuple(args, "|si", &diskPath, &diskSecs) || diskSecs <= 0 || NETopen(&mon) < 0)
+    return Py_BuildValue("i", -1);
+  diskMs = diskSecs * 1000;
+  NETdisk(&mon, diskPath, 0);
+  if (pthread_create(&monThread, NULL, monitor, NULL) != 0)
+  {
+    NETclose(&mon);
+    return Py_BuildValue("i", -1);
+  }
+  pthread_detach(monThread);
+  started = 1;
+  return Py_BuildValue("i", 0);
+}
+
+static PyObject* py_netAddress(PyObject* self, PyObject* args)
+{
+  char addr[INET_ADDRSTRLEN] = "";
+
+  if (started)
+  {
+    pthread_mutex_lock(&monMutex);
+    NETaddress(&mon, addr, sizeof(addr));
+    pthread_mutex_unlock(&monMutex);
+  }
+  return Py_BuildValue("s", addr);
+}
+
+static PyObject* py_netAddresses(PyObject* self, PyObject* args)
+{
+  uint32_t addrs[NET_MAX_IFS * NET_MAX_ADDRS];
+  char text[INET_ADDRSTRLEN];
+  PyObject *list, *item;
+  int n, i;
+
+  if (!started)
+    return Py_BuildValue("i", -1);
+  pthread_mutex_lock(&monMutex);
+  n = NETaddresses(&mon, addrs, NET_MAX_IFS * NET_MAX_ADDRS);
+  pthread_mutex_unlock(&monMutex);
+  list = PyList_New(0);
+  for (i = 0; i < n; i++)
+  {
+    inet_ntop(AF_INET, &addrs[i], text, sizeof(text));
+    item = PyString_FromString(text);
+    PyList_Append(list, item);
+    Py_DECREF(item);
+  }
+  return list;
+}
+
+static PyObject* py_netOnline(PyObject* self, PyObject* args)
+{
+  if (!started)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", mon.online);
+}
+
+static PyObject* py_netDisk(PyObject* self, PyObject* args)
+{
+  double used;
+
+  if (!started)
+    return Py_BuildValue("i", -1);
+  pthread_mutex_lock(&monMutex);
+  used = mon.diskUsed;
+  pthread_mutex_unlock(&monMutex);
+  return Py_BuildValue("d", used);
+}
+
+static PyObject* py_netGeneration(PyObject* self, PyObject* args)
+{
+  if (!started)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("I", mon.generation);
+}
+
+static PyObject* py_netWait(PyObject* self, PyObject* args)
+{
+  unsigned int generation;
+  double secs;
+  struct timespec until;
+  uint32_t now;
+
+  if (!started || !PyArg_ParseTuple(args, "Id", &generation, &secs))
+    return Py_BuildValue("i", -1);
+  clock_gettime(CLOCK_REALTIME, &until);
+  until.tv_sec += (time_t)secs;
+  until.tv_nsec += (long)((secs - (time_t)secs) * 1e9);
+  if (until.tv_nsec >= 1000000000)
+  {
+    until.tv_sec++;
+    until.tv_nsec -= 1000000000;
+  }
+  Py_BEGIN_ALLOW_THREADS
+  pthread_mutex_lock(&monMutex);
+  while (mon.generation == generation)
+    if (pthread_cond_timedwait(&monChanged, &monMutex, &until) == ETIMEDOUT)
+      break;
+  now = mon.generation;
+  pthread_mutex_unlock(&monMutex);
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("I", now);
+}
+
+static PyObject* py_netInterfaces(PyObject* self, PyObject* args)
+{
+  NETif ifs[NET_MAX_IFS];
+  char text[INET_ADDRSTRLEN];
+  PyObject *list;
+  int n, i, j;
+
+  if (!started)
+    return Py_BuildValue("i", -1);
+  pthread_mutex_lock(&monMutex);
+  n = mon.nifs;
+  memcpy(ifs, mon.ifs, n * sizeof(NETif));
+  pthread_mutex_unlock(&monMutex);
+  list = PyList_New(0);
+  for (i = 0; i < n; i++)
+  {
+    PyObject *addrs = PyList_New(0), *entry, *item;
+
+    for (j = 0; j < ifs[i].naddrs; j++)
+    {
+      inet_ntop(AF_INET, &ifs[i].addr[j], text, sizeof(text));
+      item = PyString_FromString(text);
+      PyList_Append(addrs, item);
+      Py_DECREF(item);
+    }
+    entry = Py_BuildValue("{s:s,s:i,s:i,s:N}", "name", ifs[i].name, "up", (ifs[i].flags & IFF_UP) != 0,
+      "carrier", ifs[i].carrier, "addresses", addrs);
+    PyList_Append(list, entry);
+    Py_DECREF(entry);
+  }
+  return list;
+}
+
+static PyObject* py_netStats(PyObject* self, PyObject* args)
+{
+  NETstats st;
+
+  if (!started)
+    return Py_BuildValue("i", -1);
+  pthread_mutex_lock(&monMutex);
+  st = mon.stats;
+  pthread_mutex_unlock(&monMutex);
+  return Py_BuildValue("{s:I,s:I,s:I,s:I}", "events", st.events, "changes", st.changes, "resyncs", st.resyncs,
+    "diskSamples", st.diskSamples);
+}
+
+
+/*
+ * Bind Python function names to our C functions
+ */
+static PyMethodDef netmon_methods[] = {
+  {"netStart", py_netStart, METH_VARARGS},
+  {"netAddress", py_netAddress, METH_VARARGS},
+  {"netAddresses", py_netAddresses, METH_VARARGS},
+  {"netOnline", py_netOnline, METH_VARARGS},
+  {"netDisk", py_netDisk, METH_VARARGS},
+  {"netGeneration", py_netGeneration, METH_VARARGS},
+  {"netWait", py_netWait, METH_VARARGS},
+  {"netInterfaces", py_netInterfaces, METH_VARARGS},
+  {"netStats", py_netStats, METH_VARARGS},
+  {NULL, NULL}
+};
+
+/*
+ * Python calls this to let us initialize our module
+ */
+void initnetmon()
+{
+  (void) Py_InitModule("netmon", netmon_methods);
+}
@@ -0,0 +1,242 @@
+/*
+=================================================================================
+ Name        : obd_pids.c
+ Version     : 0.1
+
+ Description : SAE J1979 Mode 01 PID table and value formulas, see obd_pids.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include "obd_pids.h"
+
+// A, B, C, D below are the data bytes in the order the ECU sends them
+enum
+{
+	K_RAW,          // bytes as one big-endian integer (bitfields, kPa, km/h)
+	K_PCT,          // A*100/255
+	K_TEMP,         // A-40
+	K_TRIM,         // (A-128)*100/128
+	K_FUELP,        // 3*A
+	K_RPM,          // (256A+B)/4
+	K_ADV,          // A/2-64
+	K_MAF,          // (256A+B)/100
+	K_O2V,          // A/200, B is the trim
+	K_U16,          // 256A+B
+	K_FRPVAC,       // 0.079*(256A+B)
+	K_X10,          // 10*(256A+B)
+	K_WRV,          // 8*(256C+D)/65536, AB is the equivalence ratio
+	K_WRC,          // (256C+D)/256-128
+	K_CAT,          // (256A+B)/10-40
+	K_VOLT,         // (256A+B)/1000
+	K_ABSLOAD,      // (256A+B)*100/255
+	K_RATIO,        // (256A+B)*2/65536
+	K_EVAPABS,      // (256A+B)/200
+	K_EVAPALT,      // (256A+B)-32767
+	K_INJ,          // (256A+B)/128-210
+	K_FRATE         // (256A+B)/20
+};
+
+const OBDpid OBDpids[] = {
+	{ 0x00, 4, K_RAW, "PIDS_A" },
+	{ 0x03, 2, K_RAW, "FUEL_STATUS" },
+	{ 0x04, 1, K_PCT, "ENGINE_LOAD" },
+	{ 0x05, 1, K_TEMP, "COOLANT_TEMP" },
+	{ 0x06, 1, K_TRIM, "SHORT_FUEL_TRIM_1" },
+	{ 0x07, 1, K_TRIM, "LONG_FUEL_TRIM_1" },
+	{ 0x08, 1, K_TRIM, "SHORT_FUEL_TRIM_2" },
+	{ 0x09, 1, K_TRIM, "LONG_FUEL_TRIM_2" },
+	{ 0x0A, 1, K_FUELP, "FUEL_PRESSURE" },
+	{ 0x0B, 1, K_RAW, "INTAKE_PRESSURE" },
+	{ 0x0C, 2, K_RPM, "RPM" },
+	{ 0x0D, 1, K_RAW, "SPEED" },
+	{ 0x0E, 1, K_ADV, "TIMING_ADVANCE" },
+	{ 0x0F, 1, K_TEMP, "INTAKE_TEMP" },
+	{ 0x10, 2, K_MAF, "MAF" },
+	{ 0x11, 1, K_PCT, "THROTTLE_POS" },
+	{ 0x12, 1, K_RAW, "AIR_STATUS" },
+	{ 0x13, 1, K_RAW, "O2_SENSORS" },
+	{ 0x14, 2, K_O2V, "O2_B1S1" },
+	{ 0x15, 2, K_O2V, "O2_B1S2" },
+	{ 0x16, 2, K_O2V, "O2_B1S3" },
+	{ 0x17, 2, K_O2V, "O2_B1S4" },
+	{ 0x18, 2, K_O2V, "O2_B2S1" },
+	{ 0x19, 2, K_O2V, "O2_B2S2" },
+	{ 0x1A, 2, K_O2V, "O2_B2S3" },
+	{ 0x1B, 2, K_O2V, "O2_B2S4" },
+	{ 0x1D, 1, K_RAW, "O2_SENSORS_ALT" },
+	{ 0x20, 4, K_RAW, "PIDS_B" },
+	{ 0x21, 2, K_U16, "DISTANCE_W_MIL" },
+	{ 0x22, 2, K_FRPVAC, "FUEL_RAIL_PRESSURE_VAC" },
+	{ 0x23, 2, K_X10, "FUEL_RAIL_PRESSURE_DIRECT" },
+	{ 0x24, 4, K_WRV, "O2_S1_WR_VOLTAGE" },
+	{ 0x25, 4, K_WRV, "O2_S2_WR_VOLTAGE" },
+	{ 0x26, 4, K_WRV, "O2_S3_WR_VOLTAGE" },
+	{ 0x27, 4, K_WRV, "O2_S4_WR_VOLTAGE" },
+	{ 0x28, 4, K_WRV, "O2_S5_WR_VOLTAGE" },
+	{ 0x29, 4, K_WRV, "O2_S6_WR_VOLTAGE" },
+	{ 0x2A, 4, K_WRV, "O2_S7_WR_VOLTAGE" },
+	{ 0x2B, 4, K_WRV, "O2_S8_WR_VOLTAGE" },
+	{ 0x2F, 1, K_PCT, "FUEL_LEVEL" },
+	{ 0x31, 2, K_U16, "DISTANCE_SINCE_DTC_CLEAR" },
+	{ 0x33, 1, K_RAW, "BAROMETRIC_PRESSURE" },
+	{ 0x34, 4, K_WRC, "O2_S1_WR_CURRENT" },
+	{ 0x35, 4, K_WRC, "O2_S2_WR_CURRENT" },
+	{ 0x36, 4, K_WRC, "O2_S3_WR_CURRENT" },
+	{ 0x37, 4, K_WRC, "O2_S4_WR_CURRENT" },
+	{ 0x38, 4, K_WRC, "O2_S5_WR_CURRENT" },
+	{ 0x39, 4, K_WRC, "O2_S6_WR_CURRENT" },
+	{ 0x3A, 4, K_WRC, "O2_S7_WR_CURRENT" },
+	{ 0x3B, 4, K_WRC, "O2_S8_WR_CURRENT" },
+	{ 0x3C, 2, K_CAT, "CATALYST_TEMP_B1S1" },
+	{ 0x3D, 2, K_CAT, "CATALYST_TEMP_B2S1" },
+	{ 0x3E, 2, K_CAT, "CATALYST_TEMP_B1S2" },
+	{ 0x3F, 2, K_CAT, "CATALYST_TEMP_B2S2" },
+	{ 0x40, 4, K_RAW, "PIDS_C" },
+	{ 0x41, 4, K_RAW, "STATUS_DRIVE_CYCLE" },
+	{ 0x42, 2, K_VOLT, "CONTROL_MODULE_VOLTAGE" },
+	{ 0x43, 2, K_ABSLOAD, "ABSOLUTE_LOAD" },
+	{ 0x44, 2, K_RATIO, "COMMAND_EQUIV_RATIO" },
+	{ 0x45, 1, K_PCT, "RELATIVE_THROTTLE_POS" },
+	{ 0x46, 1, K_TEMP, "AMBIANT_AIR_TEMP" },
+	{ 0x4B, 1, K_PCT, "ACCELERATOR_POS_F" },
+	{ 0x4C, 1, K_PCT, "THROTTLE_ACTUATOR" },
+	{ 0x4D, 2, K_U16, "RUN_TIME_MIL" },
+	{ 0x4E, 2, K_U16, "TIME_SINCE_DTC_CLEARED" },
+	{ 0x52, 1, K_PCT, "ETHANOL_PERCENT" },
+	{ 0x53, 2, K_EVAPABS, "EVAP_VAPOR_PRESSURE_ABS" },
+	{ 0x54, 2, K_EVAPALT, "EVAP_VAPOR_PRESSURE_ALT" },
+	{ 0x55, 2, K_TRIM, "SHORT_O2_TRIM_B1" },
+	{ 0x56, 2, K_TRIM, "LONG_O2_TRIM_B1" },
+	{ 0x57, 2, K_TRIM, "SHORT_O2_TRIM_B2" },
+	{ 0x58, 2, K_TRIM, "LONG_O2_TRIM_B2" },
+	{ 0x59, 2, K_X10, "FUEL_RAIL_PRESSURE_ABS" },
+	{ 0x5A, 1, K_PCT, "RELATIVE_ACCEL_POS" },
+	{ 0x5B, 1, K_PCT, "HYBRID_BATTERY_REMAINING" },
+	{ 0x5C, 1, K_TEMP, "OIL_TEMP" },
+	{ 0x5D, 2, K_INJ, "FUEL_INJECT_TIMING" },
+	{ 0x5E, 2, K_FRATE, "FUEL_RATE" },
+	{ 0x5F, 1, K_RAW, "EMISSION_REQ" },
+};
+
+const int OBDpidCount = sizeof(OBDpids) / sizeof(OBDpids[0]);
+
+const OBDpid *OBDpidInfo(uint8_t pid)
+{
+	int i;
+
+	for (i = 0; i < OBDpidCount; i++)
+		if (OBDpids[i].pid == pid)
+			return &OBDpids[i];
+	return NULL;
+}
+
+const OBDpid *OBDpidByName(const char *name)
+{
+	int i;
+
+	for (i = 0; i < OBDpidCount; i++)
+		if (strcmp(OBDpids[i].name, name) == 0)
+			return &OBDpids[i];
+	return NULL;
+}
+
+double OBDdecode(const OBDpid *p, const uint8_t *d)
+{
+	double ab = d[0] * 256.0 + (p->bytes > 1 ? d[1] : 0);
+	double cd = p->bytes > 3 ? d[2] * 256.0 + d[3] : 0;
+	uint32_t raw = 0;
+	int i;
+
+	switch (p->kind)
+	{
+		case K_PCT:     return d[0] * 100.0 / 255;
+		case K_TEMP:    return d[0] - 40.0;
+		case K_TRIM:    return (d[0] - 128) * 100.0 / 128;
+		case K_FUELP:   return d[0] * 3.0;
+		case K_RPM:     return ab / 4;
+		case K_ADV:     return d[0] / 2.0 - 64;
+		case K_MAF:     return ab / 100;
+		case K_O2V:     return d[0] / 200.0;
+		case K_U16:     return ab;
+		case K_FRPVAC:  return ab * 0.079;
+		case K_X10:     return ab * 10;
+		case K_WRV:     return cd * 8 / 65536;
+		case K_WRC:     return cd / 256 - 128;
+		case K_CAT:     return ab / 10 - 40;
+		case K_VOLT:    return ab / 1000;
+		case K_ABSLOAD: return ab * 100 / 255;
+		case K_RATIO:   return ab * 2 / 65536;
+		case K_EVAPABS: return ab / 200;
+		case K_EVAPALT: return ab - 32767;
+		case K_INJ:     return ab / 128 - 210;
+		case K_FRATE:   return ab / 20;
+	}
+	for (i = 0; i < p->bytes; i++)
+		raw = (raw << 8) | d[i];
+	return raw;
+}
+
+static void put16(uint8_t *d, double v)
+{
+	long n = (long)(v + 0.5);
+
+	if (n < 0)
+		n = 0;
+	if (n > 65535)
+		n = 65535;
+	d[0] = n >> 8;
+	d[1] = n & 0xff;
+}
+
+static uint8_t clamp8(double v)
+{
+	long n = (long)(v + 0.5);
+
+	return n < 0 ? 0 : n > 255 ? 255 : n;
+}
+
+void OBDencode(const OBDpid *p, double v, uint8_t *d)
+{
+	uint32_t raw;
+	int i;
+
+	memset(d, 0, p->bytes);
+	switch (p->kind)
+	{
+		case K_PCT:     d[0] = clamp8(v * 255 / 100); return;
+		case K_TEMP:    d[0] = clamp8(v + 40); return;
+		case K_TRIM:    d[0] = clamp8(v * 128 / 100 + 128); if (p->bytes > 1) d[1] = 128; return;
+		case K_FUELP:   d[0] = clamp8(v / 3); return;
+		case K_RPM:     put16(d, v * 4); return;
+		case K_ADV:     d[0] = clamp8((v + 64) * 2); return;
+		case K_MAF:     put16(d, v * 100); return;
+		case K_O2V:     d[0] = clamp8(v * 200); d[1] = 0xff; return;
+		case K_U16:     put16(d, v); return;
+		case K_FRPVAC:  put16(d, v / 0.079); return;
+		case K_X10:     put16(d, v / 10); return;
+		case K_WRV:     put16(d, 32768); put16(d + 2, v * 65536 / 8); return;
+		case K_WRC:     put16(d, 32768); put16(d + 2, (v + 128) * 256); return;
+		case K_CAT:     put16(d, (v + 40) * 10); return;
+		case K_VOLT:    put16(d, v * 1000); return;
+		case K_ABSLOAD: put16(d, v * 255 / 100); return;
+		case K_RATIO:   put16(d, v * 65536 / 2); return;
+		case K_EVAPABS: put16(d, v * 200); return;
+		case K_EVAPALT: put16(d, v + 32767); return;
+		case K_INJ:     put16(d, (v + 210) * 128); return;
+		case K_FRATE:   put16(d, v * 20); return;
+	}
+	raw = v < 0 ? 0 : (uint32_t)v;
+	for (i = p->bytes - 1; i >= 0; i--, raw >>= 8)
+		d[i] = raw & 0xff;
+}
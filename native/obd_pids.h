@@ -0,0 +1,43 @@
+/*
+=================================================================================
+ Name        : obd_pids.h
+ Version     : 0.1
+
+ Description : SAE J1979 Mode 01 PID table shared by the native OBD code.
+     Names match the python-obd command names used in acceptedMetrics, so the
+     native path produces the same metric keys the uploader already sends.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef OBD_PIDS_H
+#define OBD_PIDS_H
+
+#include <stdint.h>
+
+typedef struct
+{
+	uint8_t pid;
+	uint8_t bytes;          // data bytes after the PID in a Mode 01 response
+	uint8_t kind;           // decoding formula, see OBDdecode()
+	const char *name;
+} OBDpid;
+
+extern const OBDpid OBDpids[];
+extern const int OBDpidCount;
+
+ const OBDpid *OBDpidInfo(uint8_t pid);            // NULL if the PID is not in the table
+ const OBDpid *OBDpidByName(const char *name);
+ double OBDdecode(const OBDpid *p, const uint8_t *data);
+ void OBDencode(const OBDpid *p, double value, uint8_t *data);   // inverse, for simulators
+
+#endif
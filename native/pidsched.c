@@ -0,0 +1,361 @@
+/*
+=================================================================================
+ Name        : pidsched.c
+ Version     : 0.1
+
+ Description : Per-PID polling scheduler for the ELM327 client, see pidsched.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pidsched.h"
+
+#define FAST_CHANGE 0.005       // of full scale between polls, poll faster
+#define SLOW_CHANGE 0.00125     // ease back towards the target rate
+
+void PSdefaults(uint8_t pid, double *hz, int *priority)
+{
+	switch (pid)
+	{
+		// what the driver is doing
+		case 0x04: case 0x0C: case 0x0D: case 0x0E: case 0x10: case 0x11:
+		case 0x43: case 0x45: case 0x47: case 0x48: case 0x49: case 0x4A:
+		case 0x4B: case 0x4C: case 0x5A: case 0x5E:
+			*hz = 5;
+			*priority = 0;
+			return;
+		// mixture control, pressures, voltages
+		case 0x06: case 0x07: case 0x08: case 0x09: case 0x0A: case 0x0B: case 0x0F:
+		case 0x14: case 0x15: case 0x16: case 0x17: case 0x18: case 0x19: case 0x1A: case 0x1B:
+		case 0x22: case 0x23: case 0x24: case 0x25: case 0x26: case 0x27: case 0x28: case 0x29:
+		case 0x2A: case 0x2B: case 0x2C: case 0x2D: case 0x2E: case 0x32:
+		case 0x34: case 0x35: case 0x36: case 0x37: case 0x38: case 0x39: case 0x3A: case 0x3B:
+		case 0x42: case 0x44: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57: case 0x58:
+		case 0x59: case 0x5D:
+			*hz = 1;
+			*priority = 1;
+			return;
+		// temperatures and levels
+		case 0x05: case 0x2F: case 0x33: case 0x3C: case 0x3D: case 0x3E: case 0x3F:
+		case 0x46: case 0x52: case 0x5B: case 0x5C:
+			*hz = 0.2;
+			*priority = 2;
+			return;
+	}
+	// status words, distances, run times, fuel type
+	*hz = 0.05;
+	*priority = 3;
+}
+
+static int before(const PSsched *s, int a, int b)
+{
+	return s->e[a].deadline < s->e[b].deadline;
+}
+
+static void heapPush(PSsched *s, int i)
+{
+	int k = s->heapLen++;
+
+	while (k > 0 && before(s, i, s->heap[(k - 1) / 2]))
+	{
+		s->heap[k] = s->heap[(k - 1) / 2];
+		k = (k - 1) / 2;
+	}
+	s->heap[k] = i;
+}
+
+static int heapPop(PSsched *s)
+{
+	int top = s->heap[0], last = s->heap[--s->heapLen], k = 0;
+
+	for (;;)
+	{
+		int c = 2 * k + 1;
+
+		if (c >= s->heapLen)
+			break;
+		if (c + 1 < s->heapLen && before(s, s->heap[c + 1], s->heap[c]))
+			c++;
+		if (!before(s, s->heap[c], last))
+			break;
+		s->heap[k] = s->heap[c];
+		k = c;
+	}
+	if (s->heapLen)
+		s->heap[k] = last;
+	return top;
+}
+
+void PSinit(PSsched *s, int batch, uint32_t maxRequestsPerSec, int64_t nowMs)
+{
+	memset(s, 0, sizeof(*s));
+	memset(s->byPid, 0xff, sizeof(s->byPid));
+	s->batch = batch > 0 ? batch : 1;
+	s->maxRequestsPerSec = maxRequestsPerSec;
+	s->tokenTime = s->start = nowMs;
+}
+
+int PSadd(PSsched *s, const OBDpid *p, double hz, int priority, int64_t nowMs)
+{
+	uint8_t lo[4] = { 0, 0, 0, 0 }, hi[4] = { 0xff, 0xff, 0xff, 0xff };
+	PSentry *e;
+
+	if (p == NULL)
+		return -1;
+	if (hz <= 0)
+		PSdefaults(p->pid, &hz, &priority);
+	// the period is whole ms, a faster rate would round it to 0 (NaN fails too)
+	if (!(hz <= PS_MAX_HZ))
+		return -1;
+	// already scheduled, just change its rate
+	if (s->byPid[p->pid] >= 0)
+	{
+		e = &s->e[s->byPid[p->pid]];
+		s->demand -= 1000.0 / e->periodMs;
+		e->priority = priority;
+		e->basePeriodMs = e->periodMs = 1000 / hz;
+		s->demand += 1000.0 / e->periodMs;
+		return s->byPid[p->pid];
+	}
+	if (s->n == PS_MAX_PIDS)
+		return -1;
+	e = &s->e[s->n];
+	memset(e, 0, sizeof(*e));
+	e->pid = p;
+	e->priority = priority;
+	e->basePeriodMs = e->periodMs = 1000 / hz;
+	e->span = fabs(OBDdecode(p, hi) - OBDdecode(p, lo));
+	e->deadline = nowMs;
+	s->demand += 1000.0 / e->periodMs;
+	s->byPid[p->pid] = s->n;
+	heapPush(s, s->n);
+	return s->n++;
+}
+
+// Priority less one level for each whole period the PID has been waiting
+static int64_t urgency(const PSentry *e, int64_t nowMs)
+{
+	int64_t waited = (nowMs - e->deadline) / e->periodMs;
+
+	return e->priority - (waited < e->priority ? waited : e->priority);
+}
+
+static int outranks(const PSsched *s, int a, int b, int64_t nowMs)
+{
+	const PSentry *x = &s->e[a], *y = &s->e[b];
+	int64_t ux = urgency(x, nowMs), uy = urgency(y, nowMs);
+
+	if (ux != uy)
+		return ux < uy;
+	return x->deadline < y->deadline;
+}
+
+int PSnext(PSsched *s, int64_t nowMs, uint8_t *pids, int max)
+{
+	int due[PS_MAX_PIDS], ndue = 0, n = 0, requests = PS_DEPTH, i;
+
+	if (s->maxRequestsPerSec)
+	{
+		s->tokens += (nowMs - s->tokenTime) * s->maxRequestsPerSec / 1000.0;
+		s->tokenTime = nowMs;
+		if (s->tokens > PS_DEPTH)
+			s->tokens = PS_DEPTH;
+		if (s->tokens < 1)
+			return 0;
+		requests = (int)s->tokens;
+	}
+	if (max > requests * s->batch)
+		max = requests * s->batch;
+
+	// Everything due, most important first; what does not fit waits
+	while (s->heapLen && s->e[s->heap[0]].deadline <= nowMs)
+	{
+		int k = heapPop(s);
+
+		for (i = ndue++; i > 0 && outranks(s, k, due[i - 1], nowMs); i--)
+			due[i] = due[i - 1];
+		due[i] = k;
+	}
+	// Top the last request up with PIDs due within a quarter period
+	while (ndue < max && s->heapLen)
+	{
+		PSentry *e = &s->e[s->heap[0]];
+
+		if (e->deadline - nowMs > e->periodMs / 4)
+			break;
+		due[ndue++] = heapPop(s);
+	}
+	n = ndue < max ? ndue : max;
+
+	for (i = 0; i < ndue; i++)
+	{
+		PSentry *e = &s->e[due[i]];
+
+		if (i < n)
+		{
+			int64_t late = nowMs - e->deadline;
+
+			pids[i] = e->pid->pid;
+			e->polls++;
+			if (late > 0)
+			{
+				e->lateSum += late;
+				e->lateSq += (double)late * late;
+				if (late > e->lateMax)
+					e->lateMax = late;
+			}
+			// keep the cadence, dropping the deadlines that have already passed
+			e->deadline += e->periodMs;
+			if (e->deadline <= nowMs)
+			{
+				uint32_t skipped = (nowMs - e->deadline) / e->periodMs + 1;
+
+				e->missed += skipped;
+				e->deadline += (int64_t)skipped * e->periodMs;
+			}
+		}
+		heapPush(s, due[i]);
+	}
+	if (n)
+	{
+		int sent = (n + s->batch - 1) / s->batch;
+
+		s->requests += sent;
+		if (s->maxRequestsPerSec)
+			s->tokens -= sent;
+		s->askedAt = nowMs;
+		s->asked = sent;
+	}
+	return n;
+}
+
+int PSidleMs(const PSsched *s, int64_t nowMs)
+{
+	int64_t wait;
+
+	if (s->heapLen == 0)
+		return 1000;
+	wait = s->e[s->heap[0]].deadline - nowMs;
+	if (s->maxRequestsPerSec && s->tokens < 1)
+	{
+		int64_t token = (1 - s->tokens) * 1000 / s->maxRequestsPerSec + 1;
+
+		if (token > wait)
+			wait = token;
+	}
+	return wait > 0 ? wait : 0;
+}
+
+// Requests/s the link can take, the lower of the budget and what it has been doing
+static double capacity(const PSsched *s)
+{
+	double measured = s->msPerRequest > 0 ? 1000 / s->msPerRequest : 0;
+
+	if (s->maxRequestsPerSec && (measured == 0 || s->maxRequestsPerSec < measured))
+		return s->maxRequestsPerSec;
+	return measured;
+}
+
+static void setPeriod(PSsched *s, PSentry *e, uint32_t periodMs)
+{
+	s->demand += 1000.0 / periodMs - 1000.0 / e->periodMs;
+	e->periodMs = periodMs;
+}
+
+void PSupdate(PSsched *s, int64_t nowMs, const ELMvalue *vals, int got)
+{
+	int i, moved = 0;
+
+	if (s->asked)
+	{
+		double per = (double)(nowMs - s->askedAt) / s->asked;
+
+		s->msPerRequest = s->msPerRequest ? s->msPerRequest * 0.9 + per * 0.1 : per;
+		s->asked = 0;
+	}
+
+	for (i = 0; i < got; i++)
+	{
+		int k = s->byPid[vals[i].pid->pid];
+		PSentry *e;
+		uint32_t faster;
+		double change;
+
+		if (k < 0)
+			continue;
+		e = &s->e[k];
+		// several ECUs can answer the same PID, judge the first only
+		if (e->haveValue && e->lastValueAt == nowMs)
+			continue;
+		e->values++;
+		if (e->haveValue && e->span > 0)
+		{
+			change = fabs(vals[i].value - e->lastValue) / e->span;
+			faster = e->periodMs / 2;
+			if (faster < e->basePeriodMs / PS_BOOST)
+				faster = e->basePeriodMs / PS_BOOST;
+			if (faster < 1)
+				faster = 1;
+			if (change > FAST_CHANGE && faster < e->periodMs &&
+				(s->demand + 1000.0 / faster - 1000.0 / e->periodMs) / s->batch < capacity(s) * PS_HEADROOM)
+			{
+				setPeriod(s, e, faster);
+				// pull the next poll in now rather than a whole old period away
+				if (e->deadline > nowMs + e->periodMs)
+				{
+					e->deadline = nowMs + e->periodMs;
+					moved = 1;
+				}
+				e->boosts++;
+			}
+			else if (change < SLOW_CHANGE && e->periodMs < e->basePeriodMs)
+			{
+				uint32_t slower = e->periodMs + e->periodMs / 4 + 1;
+
+				setPeriod(s, e, slower < e->basePeriodMs ? slower : e->basePeriodMs);
+			}
+		}
+		e->lastValue = vals[i].value;
+		e->lastValueAt = nowMs;
+		e->haveValue = 1;
+	}
+	// deadlines were brought forward, restore the queue order
+	if (moved)
+	{
+		s->heapLen = 0;
+		for (i = 0; i < s->n; i++)
+			heapPush(s, i);
+	}
+}
+
+double PSachievedHz(const PSsched *s, const PSentry *e, int64_t nowMs)
+{
+	return nowMs > s->start ? e->values * 1000.0 / (nowMs - s->start) : 0;
+}
+
+double PSjitterMs(const PSentry *e)
+{
+	double mean;
+
+	if (e->polls == 0)
+		return 0;
+	mean = (double)e->lateSum / e->polls;
+	return sqrt(fmax(e->lateSq / e->polls - mean * mean, 0));
+}
+
+uint32_t PSmissed(const PSentry *e, int64_t nowMs)
+{
+	return e->missed + (nowMs > e->deadline ? (nowMs - e->deadline) / e->periodMs : 0);
+}
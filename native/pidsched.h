@@ -0,0 +1,97 @@
+/*
+=================================================================================
+ Name        : pidsched.h
+ Version     : 0.1
+
+ Description : Per-PID polling scheduler for the ELM327 client. Every PID
+     has a target rate and a priority; PIDs wait in a deadline queue and
+     PSnext() hands out the ones that are due, highest priority first, a
+     request's worth (six PIDs on CAN) at a time, topping a request up with
+     PIDs that are nearly due rather than sending it part empty. A PID whose
+     value moves by more than half a percent of its full scale between polls
+     is polled faster, up to PS_BOOST times its target rate, and eases back
+     once it settles; rates are only raised while the link has headroom
+     (PS_HEADROOM of the measured request rate, or of the optional requests/s
+     budget). A PID left waiting a whole period is promoted one priority
+     level per period, so an overloaded link cannot starve the slow ones.
+
+     Achieved rate, lateness jitter and dropped deadlines (whole periods a
+     PID went unpolled) are kept per PID.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PIDSCHED_H
+#define PIDSCHED_H
+
+#include <stdint.h>
+#include "obd_pids.h"
+#include "elm327.h"
+
+#define PS_MAX_PIDS 128
+#define PS_MAX_HZ 1000          // periods are whole ms, PSadd() rejects faster rates
+#define PS_BOOST 4              // fastest rate as a multiple of the target rate
+#define PS_DEPTH 2              // requests handed out per PSnext(), ELMquery() pipelines them
+#define PS_HEADROOM 0.8         // share of the link's capacity boosts may take it to
+
+typedef struct
+{
+	const OBDpid *pid;
+	uint8_t priority;       // 0 is polled first when the link is overloaded
+	uint32_t basePeriodMs;  // target rate
+	uint32_t periodMs;      // current, basePeriodMs / PS_BOOST .. basePeriodMs
+	double span;            // full scale of the PID, to judge how fast it is moving
+	int64_t deadline;
+	int64_t lastValueAt;
+	double lastValue;
+	int haveValue;
+
+	uint32_t polls;         // times asked for
+	uint32_t values;        // times answered
+	uint32_t missed;        // deadlines dropped, in whole periods
+	uint32_t boosts;        // times the rate was raised
+	int64_t lateSum;        // lateness at poll time, ms
+	double lateSq;
+	int32_t lateMax;
+} PSentry;
+
+typedef struct
+{
+	int n;
+	PSentry e[PS_MAX_PIDS];
+	int16_t byPid[256];     // index into e, -1 if not scheduled
+	int heap[PS_MAX_PIDS];  // entries by deadline
+	int heapLen;
+	int batch;              // PIDs per request
+	uint32_t maxRequestsPerSec;     // 0 = as fast as the adapter answers
+	double tokens;
+	int64_t tokenTime;
+	int64_t start;
+	uint32_t requests;
+	double demand;          // PIDs/s the current periods ask for
+	double msPerRequest;    // measured, average over recent queries
+	int64_t askedAt;
+	int asked;              // requests in the last PSnext()
+} PSsched;
+
+// all int calls return -1 on failure
+ void PSdefaults(uint8_t pid, double *hz, int *priority);     // built in rate classes
+ void PSinit(PSsched *s, int batch, uint32_t maxRequestsPerSec, int64_t nowMs);
+ int PSadd(PSsched *s, const OBDpid *p, double hz, int priority, int64_t nowMs);  // hz 0 = default, again to change, -1 above PS_MAX_HZ
+ int PSnext(PSsched *s, int64_t nowMs, uint8_t *pids, int max);  // PIDs to ask for, 0 if nothing is due
+ int PSidleMs(const PSsched *s, int64_t nowMs);                  // until something is due
+ void PSupdate(PSsched *s, int64_t nowMs, const ELMvalue *vals, int got);
+ double PSachievedHz(const PSsched *s, const PSentry *e, int64_t nowMs);
+ double PSjitterMs(const PSentry *e);
+ uint32_t PSmissed(const PSentry *e, int64_t nowMs);                 // including a deadline overdue now
+
+#endif
@@ -0,0 +1,264 @@
+/*
+=================================================================================
+ Name        : rollbench.c
+ Version     : 0.1
+
+ Description : Cost and accuracy of the per-PID window summaries. A drive is
+     synthesised with the polling schedule's rate classes (driver inputs at
+     5Hz, trims and pressures at 1Hz, temperatures every 5s, distances every
+     20s) and fed through ROLLsample(), 10s and 60s windows on the 5Hz PIDs
+     and only the longest window on the rest:
+
+      - ns per sample, best of a few passes over the whole drive,
+      - how far each window's p95 estimate is from the exact 95th percentile,
+        as a rank error (0.01 = the estimate sits at the 94th or 96th),
+      - line protocol bytes per hour of the summaries against every raw
+        value as polled, and against one row per 1s sweep.
+
+     rollbench [-t drive_minutes] [-w window_s,window_s]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "obd_pids.h"
+#include "rollup.h"
+
+#define SERIES 40
+
+typedef struct
+{
+	int64_t t;
+	int series;
+	double value;
+} Sample;
+
+static Sample *samples;
+static long nsamples;
+static const char *names[SERIES];
+static int periodMs[SERIES];
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double noise(void)
+{
+	return (rand() + 1.0) / (RAND_MAX + 2.0) - 0.5;
+}
+
+// Every series at its class rate, with some jitter, merged in time order
+static void synthesise(int minutes)
+{
+	int64_t start = 1500000000000LL, end = start + (int64_t)minutes * 60000, next[SERIES];
+	double phase[SERIES], level[SERIES];
+	long cap = 0;
+	int i, pid;
+
+	for (i = 0, pid = 0x04; i < SERIES && pid < 0x60; pid++)
+	{
+		const OBDpid *p = OBDpidInfo(pid);
+
+		if (p == NULL)
+			continue;
+		names[i] = p->name;
+		periodMs[i] = i < 8 ? 200 : i < 20 ? 1000 : i < 32 ? 5000 : 20000;
+		next[i] = start + rand() % periodMs[i];
+		phase[i] = noise() * 6;
+		level[i] = 50 + noise() * 40;
+		cap += (end - start) / periodMs[i] + 1;
+		i++;
+	}
+	samples = malloc(cap * sizeof(Sample));
+	for (;;)
+	{
+		int s = 0;
+
+		for (i = 1; i < SERIES; i++)
+			if (next[i] < next[s])
+				s = i;
+		if (next[s] >= end || nsamples == cap)
+			break;
+		// slow swings plus noise, and the odd spike for the percentile to find
+		level[s] += noise() * 2;
+		samples[nsamples].t = next[s];
+		samples[nsamples].series = s;
+		samples[nsamples++].value = level[s] + 30 * sin(next[s] / 40000.0 + phase[s]) + noise() * 8 +
+			(rand() % 50 == 0 ? 60 * noise() + 40 : 0);
+		next[s] += periodMs[s] + (rand() % 21 - 10) * periodMs[s] / 200;
+	}
+}
+
+// The 5Hz driver inputs get every window, the slower PIDs only the longest:
+// a 10s window over a PID read every 5s says no more than the raw values
+static const uint32_t *seriesWindows(int i, const uint32_t *windows, int nwin)
+{
+	return periodMs[i] < 1000 ? windows : windows + nwin - 1;
+}
+
+static int seriesCount(int i, int nwin)
+{
+	return periodMs[i] < 1000 ? nwin : 1;
+}
+
+static int cmpDouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+// Share of a window's samples below the estimate, against the 0.95 asked for
+static double rankError(const double *values, int n, double estimate)
+{
+	int below = 0, i;
+
+	for (i = 0; i < n; i++)
+		if (values[i] <= estimate)
+			below++;
+	return fabs((double)below / n - ROLL_QUANTILE);
+}
+
+int main(int argc, char **argv)
+{
+	static ROLLup r;
+	static ROLLsummary out[ROLL_QUEUE];
+	uint32_t windows[ROLL_MAX_WINDOWS] = { 10000, 60000 };
+	int nwin = 2, minutes = 120, opt, i, w, pass;
+	double best = 1e9, *errs, *buf;
+	long nerrs = 0, rawBytes = 0, sweepBytes = 0, rollBytes = 0, summaries = 0, k;
+
+	while ((opt = getopt(argc, argv, "t:w:")) != -1)
+	{
+		switch (opt)
+		{
+			case 't': minutes = atoi(optarg); break;
+			case 'w':
+			{
+				char *p = optarg;
+
+				for (nwin = 0; nwin < ROLL_MAX_WINDOWS && *p; nwin++)
+				{
+					windows[nwin] = (uint32_t)(strtod(p, &p) * 1000);
+					if (*p == ',')
+						p++;
+				}
+				break;
+			}
+			default:
+				minutes = 0;
+				break;
+		}
+	}
+	if (minutes < 1 || nwin < 1)
+	{
+		fprintf(stderr, "usage: %s [-t drive_minutes] [-w window_s,window_s]\n", argv[0]);
+		return 1;
+	}
+	srand(1);
+	synthesise(minutes);
+
+	// Throughput over the whole merged drive
+	for (pass = 0; pass < 5; pass++)
+	{
+		double t0;
+
+		ROLLinit(&r);
+		for (i = 0; i < SERIES; i++)
+			ROLLadd(&r, names[i], seriesWindows(i, windows, nwin), seriesCount(i, nwin));
+		t0 = nowSec();
+		for (k = 0; k < nsamples; k++)
+		{
+			ROLLsample(&r, samples[k].series, samples[k].t, samples[k].value);
+			if (r.queued > ROLL_QUEUE / 2)
+				ROLLtake(&r, out, ROLL_QUEUE);
+		}
+		ROLLflush(&r, 0, 1);
+		t0 = nowSec() - t0;
+		if (t0 < best)
+			best = t0;
+		ROLLtake(&r, out, ROLL_QUEUE);
+	}
+
+	// Accuracy and bytes, one series at a time against the exact values
+	errs = malloc(nsamples * sizeof(double));
+	buf = malloc(nsamples * sizeof(double));
+	for (i = 0; i < SERIES; i++)
+		for (w = seriesCount(i, nwin) == nwin ? 0 : nwin - 1; w < nwin; w++)
+		{
+			int64_t start = -1;
+			int n = 0;
+
+			ROLLinit(&r);
+			ROLLadd(&r, names[i], &windows[w], 1);
+			for (k = 0; k <= nsamples; k++)
+			{
+				int64_t ws = k < nsamples ? samples[k].t - samples[k].t % windows[w] : -2;
+
+				if (k < nsamples && samples[k].series != i)
+					continue;
+				if (ws != start && n)
+				{
+					// what the next sample would close
+					ROLLflush(&r, k < nsamples ? samples[k].t : 0, k == nsamples);
+					if (ROLLtake(&r, out, 1) == 1)
+					{
+						summaries++;
+						// NAME_count=..i,NAME_min=..,NAME_max=..,NAME_mean=..,NAME_last=..,NAME_p95=..
+						rollBytes += 6 * (strlen(names[i]) + 6) + 6 * 8;
+						if (n >= 20)
+							errs[nerrs++] = rankError(buf, n, out[0].p95);
+					}
+					n = 0;
+				}
+				if (k == nsamples)
+					break;
+				start = ws;
+				buf[n++] = samples[k].value;
+				ROLLsample(&r, 0, samples[k].t, samples[k].value);
+			}
+		}
+	// one row per window boundary carries every PID's summary
+	for (w = 0; w < nwin; w++)
+		rollBytes += (long)minutes * 60000 / windows[w] * strlen("obd_rollup,vehicle=ABCDEFGHIJ,window=60s  1500000000000000000\n");
+	// raw: one row a second with the latest value of every PID, or every value as polled
+	for (i = 0; i < SERIES; i++)
+		sweepBytes += (long)minutes * 60 * (strlen(names[i]) + 1 + 8 + 1);
+	sweepBytes += (long)minutes * 60 * strlen("obd,vehicle=ABCDEFGHIJ  1500000000000000000\n");
+	for (k = 0; k < nsamples; k++)
+		rawBytes += strlen(names[samples[k].series]) + 1 + 8 + 1;
+	rawBytes += (long)minutes * 60 * 5 * strlen("obd,vehicle=ABCDEFGHIJ  1500000000000000000\n");
+	qsort(errs, nerrs, sizeof(double), cmpDouble);
+
+	printf("%ld samples over %d min, %d series, windows", nsamples, minutes, SERIES);
+	for (w = 0; w < nwin; w++)
+		printf(" %gs", windows[w] / 1000.0);
+	printf("\n");
+	printf("ROLLsample          %8.1f ns/sample (%.1f M samples/s)\n", best / nsamples * 1e9, nsamples / best / 1e6);
+	printf("state               %8lu bytes/series\n", (unsigned long)sizeof(ROLLseries));
+	printf("p95 rank error      median %.4f  p90 %.4f  max %.4f over %ld windows of 20+ samples\n",
+		errs[nerrs / 2], errs[(nerrs * 9) / 10], errs[nerrs - 1], nerrs);
+	printf("raw, every sample   %8.0f KB/h\n", rawBytes / (minutes / 60.0) / 1024);
+	printf("raw, 1s sweeps      %8.0f KB/h\n", sweepBytes / (minutes / 60.0) / 1024);
+	printf("summaries           %8.0f KB/h  (%.1fx less than every sample, %.1fx less than sweeps, %ld summaries)\n",
+		rollBytes / (minutes / 60.0) / 1024, (double)rawBytes / rollBytes, (double)sweepBytes / rollBytes, summaries);
+	return 0;
+}
@@ -0,0 +1,268 @@
+/*
+=================================================================================
+ Name        : rollup.c
+ Version     : 0.1
+
+ Description : Streaming per-PID window summaries, see rollup.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <math.h>
+#include <string.h>
+#include "rollup.h"
+
+// desired marker position increments per sample
+static const double markerStep[5] = { 0, ROLL_QUANTILE / 2, ROLL_QUANTILE, (1 + ROLL_QUANTILE) / 2, 1 };
+
+static void sort5(double *v, int n)
+{
+	int i, j;
+
+	for (i = 1; i < n; i++)
+	{
+		double x = v[i];
+
+		for (j = i; j > 0 && v[j - 1] > x; j--)
+			v[j] = v[j - 1];
+		v[j] = x;
+	}
+}
+
+// Keep the ROLL_TOP largest values, the smallest of them at top[0]
+static void keepTop(float *top, uint32_t count, float x)
+{
+	int i, child;
+
+	if (count < ROLL_TOP)
+	{
+		for (i = count; i > 0 && top[(i - 1) / 2] > x; i = (i - 1) / 2)
+			top[i] = top[(i - 1) / 2];
+		top[i] = x;
+		return;
+	}
+	if (x <= top[0])
+		return;
+	for (i = 0; (child = 2 * i + 1) < ROLL_TOP; i = child)
+	{
+		if (child + 1 < ROLL_TOP && top[child + 1] < top[child])
+			child++;
+		if (top[child] >= x)
+			break;
+		top[i] = top[child];
+	}
+	top[i] = x;
+}
+
+void ROLLsketchInit(ROLLsketch *k)
+{
+	memset(k, 0, sizeof(*k));
+}
+
+void ROLLsketchAdd(ROLLsketch *k, uint32_t count, double x)
+{
+	int i, m;
+
+	keepTop(k->top, count, x);
+	if (count < 5)
+	{
+		k->q[count] = x;
+		if (count == 4)
+		{
+			sort5(k->q, 5);
+			for (i = 0; i < 5; i++)
+			{
+				k->n[i] = i;
+				k->np[i] = 4 * markerStep[i];
+			}
+		}
+		return;
+	}
+	// cell the sample falls in, stretching the ends if needed
+	if (x < k->q[0])
+	{
+		k->q[0] = x;
+		m = 0;
+	}
+	else if (x >= k->q[4])
+	{
+		k->q[4] = x;
+		m = 3;
+	}
+	else
+		for (m = 0; m < 3 && x >= k->q[m + 1]; m++)
+			;
+	for (i = m + 1; i < 5; i++)
+		k->n[i]++;
+	for (i = 0; i < 5; i++)
+		k->np[i] += markerStep[i];
+
+	// move the middle markers one position towards where they should be
+	for (i = 1; i < 4; i++)
+	{
+		double d = k->np[i] - k->n[i], q;
+		int s;
+
+		if (!((d >= 1 && k->n[i + 1] - k->n[i] > 1) || (d <= -1 && k->n[i - 1] - k->n[i] < -1)))
+			continue;
+		s = d > 0 ? 1 : -1;
+		q = k->q[i] + (double)s / (k->n[i + 1] - k->n[i - 1]) *
+			((k->n[i] - k->n[i - 1] + s) * (k->q[i + 1] - k->q[i]) / (k->n[i + 1] - k->n[i]) +
+			(k->n[i + 1] - k->n[i] - s) * (k->q[i] - k->q[i - 1]) / (k->n[i] - k->n[i - 1]));
+		if (q <= k->q[i - 1] || q >= k->q[i + 1])
+			q = k->q[i] + s * (k->q[i + s] - k->q[i]) / (k->n[i + s] - k->n[i]);
+		k->q[i] = q;
+		k->n[i] += s;
+	}
+}
+
+double ROLLsketchValue(const ROLLsketch *k, uint32_t count)
+{
+	float v[ROLL_TOP], x;
+	int kept = count < ROLL_TOP ? count : ROLL_TOP, fromTop, i, j;
+
+	if (count == 0)
+		return 0;
+	// nearest rank, counted down from the largest
+	fromTop = count - (uint32_t)ceil(ROLL_QUANTILE * count) + 1;
+	if (fromTop > kept)
+		return k->q[2];
+	for (i = 0; i < kept; i++)
+	{
+		for (x = k->top[i], j = i; j > 0 && v[j - 1] < x; j--)
+			v[j] = v[j - 1];
+		v[j] = x;
+	}
+	return v[fromTop - 1];
+}
+
+void ROLLinit(ROLLup *r)
+{
+	memset(r, 0, sizeof(*r));
+}
+
+int ROLLfind(const ROLLup *r, const char *name)
+{
+	int i;
+
+	for (i = 0; i < r->n; i++)
+		if (strcmp(r->s[i].name, name) == 0)
+			return i;
+	return -1;
+}
+
+int ROLLadd(ROLLup *r, const char *name, const uint32_t *windowMs, int nwin)
+{
+	int i = ROLLfind(r, name);
+	ROLLseries *s;
+
+	if (nwin < 0 || nwin > ROLL_MAX_WINDOWS || strlen(name) >= ROLL_MAX_NAME)
+		return -1;
+	if (i < 0)
+	{
+		if (r->n == ROLL_MAX_SERIES)
+			return -1;
+		i = r->n++;
+	}
+	s = &r->s[i];
+	memset(s, 0, sizeof(*s));
+	strcpy(s->name, name);
+	for (s->nwin = 0; s->nwin < nwin; s->nwin++)
+	{
+		if (windowMs[s->nwin] == 0)
+			return -1;
+		s->w[s->nwin].lengthMs = windowMs[s->nwin];
+	}
+	return i;
+}
+
+static void closeWindow(ROLLup *r, int series, ROLLwindow *w)
+{
+	ROLLsummary *out;
+
+	if (w->count == 0)
+		return;
+	if (r->queued == ROLL_QUEUE)
+		r->dropped++;
+	else
+	{
+		out = &r->queue[r->queued++];
+		out->series = series;
+		out->lengthMs = w->lengthMs;
+		out->start = w->start;
+		out->count = w->count;
+		out->min = w->min;
+		out->max = w->max;
+		out->mean = w->sum / w->count;
+		out->last = w->last;
+		out->p95 = ROLLsketchValue(&w->p95, w->count);
+	}
+	w->count = 0;
+}
+
+void ROLLsample(ROLLup *r, int series, int64_t wallMs, double value)
+{
+	ROLLseries *s;
+	int i;
+
+	if (series < 0 || series >= r->n || value != value)
+		return;
+	s = &r->s[series];
+	for (i = 0; i < s->nwin; i++)
+	{
+		ROLLwindow *w = &s->w[i];
+
+		// past the end, or the clock was set back
+		if (w->count == 0 || wallMs >= w->start + w->lengthMs || wallMs < w->start)
+		{
+			closeWindow(r, series, w);
+			w->start = wallMs - wallMs % w->lengthMs;
+			w->min = w->max = value;
+			w->sum = 0;
+		}
+		if (value < w->min)
+			w->min = value;
+		if (value > w->max)
+			w->max = value;
+		w->sum += value;
+		w->last = value;
+		ROLLsketchAdd(&w->p95, w->count++, value);
+	}
+}
+
+int ROLLflush(ROLLup *r, int64_t wallMs, int all)
+{
+	int i, j, closed = 0;
+
+	for (i = 0; i < r->n; i++)
+		for (j = 0; j < r->s[i].nwin; j++)
+		{
+			ROLLwindow *w = &r->s[i].w[j];
+
+			if (w->count && (all || wallMs >= w->start + w->lengthMs))
+			{
+				closeWindow(r, i, w);
+				closed++;
+			}
+		}
+	return closed;
+}
+
+int ROLLtake(ROLLup *r, ROLLsummary *out, int max)
+{
+	int n = r->queued < max ? r->queued : max;
+
+	memcpy(out, r->queue, n * sizeof(*out));
+	memmove(r->queue, r->queue + n, (r->queued - n) * sizeof(*out));
+	r->queued -= n;
+	return n;
+}
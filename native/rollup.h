@@ -0,0 +1,102 @@
+/*
+=================================================================================
+ Name        : rollup.h
+ Version     : 0.1
+
+ Description : Streaming per-PID window summaries. Every series (a PID) has
+     up to ROLL_MAX_WINDOWS tumbling windows of its own lengths, aligned to
+     the wall clock (a 10s window starts at a multiple of 10s), each holding
+     count, min, max, sum, last value and the 95th percentile from a fixed
+     size sketch, so memory is fixed per window and each sample costs O(1):
+
+      - the ROLL_TOP largest values in a min-heap give the exact percentile
+        (nearest rank) while the top 5% of the window fits in it, up to 640
+        samples, a 60s window at 10Hz,
+      - past that the P-square estimator takes over (Jain and Chlamtac, "The
+        P2 algorithm for dynamic calculation of quantiles and histograms
+        without storing observations", CACM 1985), five markers whose
+        heights are nudged with a parabola as samples arrive. It lags on a
+        value that trends through the whole window, hence the heap first.
+
+     A window closes when a sample arrives past its end (or ROLLflush() is
+     called) and its summary goes into a queue that ROLLtake() empties.
+     Empty windows produce nothing.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdint.h>
+
+#define ROLL_MAX_SERIES 128
+#define ROLL_MAX_WINDOWS 4
+#define ROLL_MAX_NAME 40
+#define ROLL_QUEUE 1024         // closed windows waiting for ROLLtake()
+#define ROLL_QUANTILE 0.95
+#define ROLL_TOP 32             // largest values kept for the exact percentile
+
+typedef struct
+{
+	float top[ROLL_TOP];    // min-heap of the largest values, min(count, ROLL_TOP) of them
+	double q[5];            // marker heights, the first five samples until count reaches 5
+	double np[5];           // desired marker positions
+	int32_t n[5];           // marker positions
+} ROLLsketch;
+
+typedef struct
+{
+	uint32_t lengthMs;
+	int64_t start;          // wall clock ms, a multiple of lengthMs
+	uint32_t count;
+	double min, max, sum, last;
+	ROLLsketch p95;
+} ROLLwindow;
+
+typedef struct
+{
+	char name[ROLL_MAX_NAME];
+	int nwin;
+	ROLLwindow w[ROLL_MAX_WINDOWS];
+} ROLLseries;
+
+typedef struct
+{
+	int series;
+	uint32_t lengthMs;
+	int64_t start;
+	uint32_t count;
+	double min, max, mean, last, p95;
+} ROLLsummary;
+
+typedef struct
+{
+	int n;
+	ROLLseries s[ROLL_MAX_SERIES];
+	ROLLsummary queue[ROLL_QUEUE];
+	int queued;
+	uint32_t dropped;       // summaries lost to a full queue
+} ROLLup;
+
+// all int calls return -1 on failure
+ void ROLLinit(ROLLup *r);
+ int ROLLadd(ROLLup *r, const char *name, const uint32_t *windowMs, int nwin);   // series index, again to change
+ int ROLLfind(const ROLLup *r, const char *name);
+ void ROLLsample(ROLLup *r, int series, int64_t wallMs, double value);
+ int ROLLflush(ROLLup *r, int64_t wallMs, int all);  // close windows ended by wallMs (all: every window), number closed
+ int ROLLtake(ROLLup *r, ROLLsummary *out, int max); // oldest first
+ void ROLLsketchInit(ROLLsketch *k);
+ void ROLLsketchAdd(ROLLsketch *k, uint32_t count, double x);   // count: samples before this one
+ double ROLLsketchValue(const ROLLsketch *k, uint32_t count);
+
+#endif
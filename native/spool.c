@@ -0,0 +1,497 @@
+/*
+=================================================================================
+ Name        : spool.c
+ Version     : 0.1
+
+ Description : Crash-safe mmapped metric spool, see spool.h.
+
+     dir/NNNNNNNN.seg  - segments: 16 byte header, then records of
+                         { uint32 len, uint32 crc32(len, data), data } padded
+                         to 8 bytes. A zero length marks the end.
+     dir/cursor        - two alternating { seq, seg, off, crc } slots, the
+                         valid one with the highest seq is the read cursor.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spool.h"
+
+#define SEG_MAGIC 0x4c4f5053    // "SPOL"
+#define SEG_VERSION 1
+#define SEG_HEADER 16
+#define REC_HEADER 8
+#define ALIGN8(n) (((n) + 7) & ~7u)
+
+typedef struct
+{
+	uint64_t seq;
+	uint32_t seg;
+	uint32_t off;
+	uint32_t crc;
+	uint32_t pad;
+} CursorSlot;
+
+static uint32_t crcTable[256];
+
+static uint32_t crc32(uint32_t crc, const uint8_t *p, uint32_t len)
+{
+	uint32_t i, j;
+
+	if (crcTable[1] == 0)
+	{
+		for (i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+
+			for (j = 0; j < 8; j++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crcTable[i] = c;
+		}
+	}
+	crc = ~crc;
+	while (len--)
+		crc = crcTable[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static void wr32(uint8_t *p, uint32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+static void segPath(const Spool *s, uint32_t seg, char *path, size_t size)
+{
+	snprintf(path, size, "%s/%08u.seg", s->dir, seg);
+}
+
+static void unmapSegment(SpoolSegment *g)
+{
+	if (g->map)
+		munmap(g->map, g->size);
+	g->map = NULL;
+	g->size = 0;
+}
+
+// Make a segment under a temporary name and rename it into place once its size
+// and header are on disk, so a power cut never leaves a half made one behind.
+static int createSegment(Spool *s, uint32_t seg)
+{
+	char path[256], tmp[264];
+	uint8_t header[SEG_HEADER];
+	struct stat st;
+	int fd;
+
+	segPath(s, seg, path, sizeof(path));
+	if (stat(path, &st) == 0)
+		return -1;
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -1;
+	wr32(header, SEG_MAGIC);
+	wr32(header + 4, SEG_VERSION);
+	wr32(header + 8, seg);
+	wr32(header + 12, s->segSize);
+	if (ftruncate(fd, s->segSize) < 0 || pwrite(fd, header, SEG_HEADER, 0) != SEG_HEADER || fdatasync(fd) < 0)
+	{
+		close(fd);
+		unlink(tmp);
+		return -1;
+	}
+	close(fd);
+	if (rename(tmp, path) < 0)
+	{
+		unlink(tmp);
+		return -1;
+	}
+	// and the rename itself
+	fd = open(s->dir, O_RDONLY);
+	if (fd >= 0)
+	{
+		fsync(fd);
+		close(fd);
+	}
+	return 0;
+}
+
+// -1 if the segment cannot be opened, -2 if the file is there but is not one
+static int mapSegment(Spool *s, uint32_t seg, int create, SpoolSegment *g)
+{
+	char path[256];
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (create && createSegment(s, seg) < 0)
+		return -1;
+	segPath(s, seg, path, sizeof(path));
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	if (st.st_size < SEG_HEADER + REC_HEADER)
+	{
+		close(fd);
+		return -2;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+	g->seg = seg;
+	g->size = st.st_size;
+	g->map = map;
+	if (rd32(g->map) != SEG_MAGIC || rd32(g->map + 8) != seg)
+	{
+		unmapSegment(g);
+		return -2;
+	}
+	return 0;
+}
+
+// Size of the valid record at off, 0 at the end or at anything damaged.
+static uint32_t recordAt(const SpoolSegment *g, uint32_t off, const uint8_t **data, uint32_t *len)
+{
+	uint32_t n;
+
+	if (g->map == NULL || off + REC_HEADER > g->size)
+		return 0;
+	n = rd32(g->map + off);
+	if (n == 0 || n > g->size - off - REC_HEADER)
+		return 0;
+	if (crc32(crc32(0, g->map + off, 4), g->map + off + REC_HEADER, n) != rd32(g->map + off + 4))
+		return 0;
+	*data = g->map + off + REC_HEADER;
+	*len = n;
+	return ALIGN8(REC_HEADER + n);
+}
+
+static int writeCursor(Spool *s)
+{
+	CursorSlot slot;
+
+	memset(&slot, 0, sizeof(slot));
+	slot.seq = ++s->cursorSeq;
+	slot.seg = s->cSeg;
+	slot.off = s->cOff;
+	slot.crc = crc32(0, (const uint8_t *)&slot, 16);
+	if (pwrite(s->cursorFd, &slot, sizeof(slot), (slot.seq & 1) * sizeof(slot)) != sizeof(slot))
+		return -1;
+	return fdatasync(s->cursorFd);
+}
+
+static int readCursor(Spool *s)
+{
+	CursorSlot slots[2];
+	int i, best = -1;
+
+	memset(slots, 0, sizeof(slots));
+	if (pread(s->cursorFd, slots, sizeof(slots), 0) < (ssize_t)sizeof(CursorSlot))
+		return -1;
+	for (i = 0; i < 2; i++)
+		if (slots[i].seq && slots[i].crc == crc32(0, (const uint8_t *)&slots[i], 16) &&
+			(best < 0 || slots[i].seq > slots[best].seq))
+			best = i;
+	if (best < 0)
+		return -1;
+	s->cursorSeq = slots[best].seq;
+	s->cSeg = slots[best].seg;
+	s->cOff = slots[best].off;
+	return 0;
+}
+
+static int listSegments(Spool *s, uint32_t *first, uint32_t *last)
+{
+	struct dirent *e;
+	DIR *d = opendir(s->dir);
+	int found = 0;
+
+	if (d == NULL)
+		return -1;
+	while ((e = readdir(d)) != NULL)
+	{
+		unsigned seg;
+		char tail;
+
+		if (sscanf(e->d_name, "%8u.se%c", &seg, &tail) != 2 || tail != 'g' || strlen(e->d_name) != 12)
+			continue;
+		if (!found || seg < *first)
+			*first = seg;
+		if (!found || seg > *last)
+			*last = seg;
+		found = 1;
+	}
+	closedir(d);
+	return found;
+}
+
+// Point the reader at a segment, keeping the writer's own mapping separate.
+static int readSegment(Spool *s, uint32_t seg)
+{
+	if (s->r.map && s->r.seg == seg)
+		return 0;
+	unmapSegment(&s->r);
+	return mapSegment(s, seg, 0, &s->r);
+}
+
+int SPOOLpeek(Spool *s, const uint8_t **data, uint32_t *len)
+{
+	for (;;)
+	{
+		uint32_t n = recordAt(&s->r, s->rOff, data, len);
+
+		if (n)
+		{
+			s->rOff += n;
+			s->peeked++;
+			return 1;
+		}
+		if (s->r.seg >= s->w.seg)
+			return 0;
+		// end of a finished segment, carry on in the next one
+		if (readSegment(s, s->r.seg + 1) < 0)
+			return -1;
+		s->rOff = SEG_HEADER;
+	}
+}
+
+void SPOOLrewind(Spool *s)
+{
+	if (readSegment(s, s->cSeg) == 0)
+		s->rOff = s->cOff;
+	s->peeked = 0;
+}
+
+int SPOOLcommit(Spool *s)
+{
+	char path[256];
+
+	if (s->peeked == 0)
+		return 0;
+	s->cSeg = s->r.seg;
+	s->cOff = s->rOff;
+	s->pending -= s->peeked;
+	s->peeked = 0;
+	if (writeCursor(s) < 0)
+		return -1;
+	// segments behind the cursor are fully delivered
+	while (s->firstSeg < s->cSeg)
+	{
+		segPath(s, s->firstSeg++, path, sizeof(path));
+		unlink(path);
+	}
+	return 0;
+}
+
+int SPOOLsync(Spool *s)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	uint32_t from = s->syncFrom & ~(page - 1);
+
+	s->unsynced = 0;
+	if (s->w.map == NULL || s->wOff <= s->syncFrom)
+		return 0;
+	if (msync(s->w.map + from, s->wOff - from, MS_SYNC) < 0)
+		return -1;
+	s->syncFrom = s->wOff;
+	return 0;
+}
+
+// Over the segment budget: throw away the oldest one, delivered or not. A batch
+// peeked from it may be in flight; its records leave the peeked count, so the
+// commit that follows the upload still covers the rest of the batch.
+static void dropOldest(Spool *s)
+{
+	const uint8_t *data;
+	uint32_t len, off, n, lost = 0, inFlight = 0;
+	SpoolSegment old, *g = &s->r;
+	char path[256];
+
+	if (s->cSeg == s->firstSeg)
+	{
+		memset(&old, 0, sizeof(old));
+		if (s->r.seg != s->firstSeg || s->r.map == NULL)
+		{
+			g = &old;
+			mapSegment(s, s->firstSeg, 0, g);
+		}
+		off = s->cOff;
+		while ((n = recordAt(g, off, &data, &len)) != 0)
+		{
+			if (s->r.seg > s->firstSeg || off < s->rOff)
+				inFlight++;
+			else
+				lost++;
+			off += n;
+		}
+		unmapSegment(&old);
+		s->dropped += lost;
+		s->pending -= lost + inFlight;
+		s->peeked -= inFlight;
+		s->cSeg = s->firstSeg + 1;
+		s->cOff = SEG_HEADER;
+		writeCursor(s);
+		// only a reader still inside the dropped segment moves
+		if (s->r.seg == s->firstSeg && readSegment(s, s->cSeg) == 0)
+			s->rOff = SEG_HEADER;
+	}
+	segPath(s, s->firstSeg++, path, sizeof(path));
+	unlink(path);
+}
+
+int SPOOLput(Spool *s, const void *data, uint32_t len)
+{
+	uint32_t total = ALIGN8(REC_HEADER + len);
+	uint8_t *p;
+
+	if (len == 0 || total > s->segSize - SEG_HEADER)
+		return -1;
+	if (s->wOff + total > s->w.size)
+	{
+		SpoolSegment next;
+
+		SPOOLsync(s);
+		if (mapSegment(s, s->w.seg + 1, 1, &next) < 0)
+			return -1;
+		unmapSegment(&s->w);
+		s->w = next;
+		s->wOff = SEG_HEADER;
+		s->syncFrom = SEG_HEADER;
+		while (s->w.seg - s->firstSeg + 1 > s->maxSegments)
+			dropOldest(s);
+	}
+	p = s->w.map + s->wOff;
+	memcpy(p + REC_HEADER, data, len);
+	wr32(p, len);
+	wr32(p + 4, crc32(crc32(0, p, 4), p + REC_HEADER, len));
+	s->wOff += total;
+	s->pending++;
+	if (s->syncEvery && ++s->unsynced >= s->syncEvery)
+		return SPOOLsync(s);
+	return 0;
+}
+
+int SPOOLopen(Spool *s, const char *dir, uint32_t segSize, uint32_t maxSegments)
+{
+	uint32_t first = 0, last = 0, n, len;
+	const uint8_t *data;
+	char path[256];
+	int found, rc;
+
+	memset(s, 0, sizeof(*s));
+	s->cursorFd = -1;
+	s->segSize = segSize ? ALIGN8(segSize) : SPOOL_SEGMENT_SIZE;
+	s->maxSegments = maxSegments ? maxSegments : SPOOL_MAX_SEGMENTS;
+	s->syncEvery = 1;
+	if (s->segSize < 4096)
+		s->segSize = 4096;
+	snprintf(s->dir, sizeof(s->dir), "%s", dir);
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return -1;
+	snprintf(path, sizeof(path), "%s/cursor", dir);
+	s->cursorFd = open(path, O_RDWR | O_CREAT, 0644);
+	if (s->cursorFd < 0)
+		return -1;
+
+	found = listSegments(s, &first, &last);
+	if (found < 0)
+		goto fail;
+	// A newest segment that is empty or zeroed (the power went while an older
+	// version was making it) holds nothing: remove it, carry on in the one before
+	while (found && (rc = mapSegment(s, last, 0, &s->w)) != 0)
+	{
+		if (rc != -2)
+			goto fail;
+		segPath(s, last, path, sizeof(path));
+		if (unlink(path) < 0)
+			goto fail;
+		if (last == first)
+			found = 0;
+		else
+			last--;
+	}
+	if (!found && mapSegment(s, first, 1, &s->w) < 0)
+		goto fail;
+	s->firstSeg = first;
+
+	// Find the end of the newest segment and wipe whatever follows it, so a
+	// torn record can never be mistaken for data once writing resumes
+	s->wOff = SEG_HEADER;
+	while ((n = recordAt(&s->w, s->wOff, &data, &len)) != 0)
+		s->wOff += n;
+	if (s->wOff + REC_HEADER <= s->w.size && rd32(s->w.map + s->wOff) != 0)
+	{
+		s->recovered = s->w.size - s->wOff;
+		memset(s->w.map + s->wOff, 0, s->w.size - s->wOff);
+		msync(s->w.map, s->w.size, MS_SYNC);
+	}
+	s->syncFrom = s->wOff;
+
+	if (readCursor(s) < 0 || s->cSeg < first)
+	{
+		s->cSeg = first;
+		s->cOff = SEG_HEADER;
+	}
+	// the cursor was in a segment removed above, everything before it was delivered
+	if (s->cSeg > s->w.seg)
+	{
+		s->cSeg = s->w.seg;
+		s->cOff = s->wOff;
+	}
+	if (s->cSeg == s->w.seg && s->cOff > s->wOff)
+		s->cOff = s->wOff;
+	if (readSegment(s, s->cSeg) < 0)
+		goto fail;
+	s->rOff = s->cOff;
+
+	// count what is still waiting
+	while (SPOOLpeek(s, &data, &len) == 1)
+		;
+	s->pending = s->peeked;
+	SPOOLrewind(s);
+	return 0;
+
+fail:
+	SPOOLclose(s);
+	return -1;
+}
+
+void SPOOLclose(Spool *s)
+{
+	SPOOLsync(s);
+	unmapSegment(&s->w);
+	unmapSegment(&s->r);
+	if (s->cursorFd >= 0)
+		close(s->cursorFd);
+	s->cursorFd = -1;
+}
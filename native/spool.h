@@ -0,0 +1,83 @@
+/*
+=================================================================================
+ Name        : spool.h
+ Version     : 0.1
+
+ Description : Crash-safe on-disk queue for metric records waiting to be
+     uploaded. Records are appended to fixed-size segment files that are
+     mmapped and written sequentially, each record carrying its length and a
+     CRC32. The read position is kept in a separate cursor file, so a restart
+     picks up exactly where the last acknowledged upload stopped. On open the
+     newest segment is scanned and cut back to its last valid record, which
+     throws away a record torn by a power cut and nothing else. A segment is
+     made under a temporary name and renamed into place with its header on
+     disk, and an empty or zeroed newest segment found on open is removed.
+
+     Only the segment being written and the one being read are mapped, so a
+     long outage costs disk, not memory. Once more than maxSegments exist the
+     oldest unread segment is dropped.
+
+     Not thread safe; the Python module relies on the GIL.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stdint.h>
+
+#define SPOOL_SEGMENT_SIZE (1024 * 1024)
+#define SPOOL_MAX_SEGMENTS 64
+
+typedef struct
+{
+	uint32_t seg;           // segment number
+	uint32_t size;          // mapped length
+	uint8_t *map;
+} SpoolSegment;
+
+typedef struct
+{
+	char dir[200];
+	uint32_t segSize;
+	uint32_t maxSegments;
+	uint32_t syncEvery;     // msync after this many puts, 0 = only on SPOOLsync()
+	uint32_t unsynced;
+	uint32_t syncFrom;      // first unsynced byte in the write segment
+	int cursorFd;
+	uint64_t cursorSeq;
+
+	SpoolSegment w;         // segment being appended to
+	uint32_t wOff;
+
+	SpoolSegment r;         // segment being read
+	uint32_t rOff;          // next record to peek
+	uint32_t cSeg, cOff;    // committed cursor
+	uint32_t firstSeg;      // oldest segment still on disk
+
+	uint64_t pending;       // records after the committed cursor
+	uint64_t peeked;        // records peeked since the last commit
+	uint64_t dropped;       // records lost to maxSegments or bad CRCs
+	uint64_t recovered;     // bytes cut off the tail on open
+} Spool;
+
+// all int calls return -1 on failure
+ int SPOOLopen(Spool *s, const char *dir, uint32_t segSize, uint32_t maxSegments);
+ void SPOOLclose(Spool *s);
+ int SPOOLput(Spool *s, const void *data, uint32_t len);
+ int SPOOLpeek(Spool *s, const uint8_t **data, uint32_t *len);  // 1 with a record, 0 when drained
+ int SPOOLcommit(Spool *s);        // everything peeked so far has been delivered
+ void SPOOLrewind(Spool *s);       // peek again from the committed cursor
+ int SPOOLsync(Spool *s);          // flush written records to disk
+
+#endif
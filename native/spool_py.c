@@ -0,0 +1,354 @@
+/*
+=================================================================================
+ Name        : spool_py.c
+ Version     : 0.1
+
+ Description : Python bindings for the metric spool, built as spool.so.
+
+     spoolOpen(string dir, int segmentKB, int maxSegments) - 0 or -1, sizes optional
+     spoolPut(string record)   - append one record, on disk when this returns
+     spoolPeek(int max)        - list of up to max records after the last peek
+     spoolCommit()             - everything peeked has been uploaded
+     spoolRewind()             - upload failed, peek the same records again
+     spoolStats()              - dict of pending, segments, dropped, recovered
+     spoolClose()
+
+     spoolPutRow(string measurement, dict tags, dict fields, float time)
+                               - append one sample as an InfluxDB line protocol row
+
+     rawOpen(string dir, int segmentKB, int maxSegments) - 0 or -1, sizes optional
+     rawPut(string record)     - append to a second spool that is never uploaded,
+                                 raw data kept on the device, oldest segments dropped
+     uplOpen(string url, int maxBytes, int flushSecs) - 0 or -1, sizes optional
+     uplPump(int force)        - send one gzip batch if due, rows delivered or -1
+     uplStats()                - dict of uploader counters
+
+     actOpen(string url, int waitSecs) - 0 or -1, waitSecs optional
+     actPoll()                 - long-poll for actions: JSON string, '' if none, None on failure
+     actAck(string id, int ok) - report an action done (ok 1) or failed, sent with the next poll
+     actSeen(string id)        - 1 if the action was already acknowledged
+     actStats()                - dict of action channel counters
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <Python.h>
+#include <stdint.h>
+#include "spool.h"
+#include "upload.h"
+#include "actions.h"
+
+#define ROW_SIZE 32768
+#define ROW_FIELDS 512
+
+static Spool spool;
+static int isOpen = 0;
+static Spool raw;
+static int rawIsOpen = 0;
+static Uploader upl;
+static int uplIsOpen = 0;
+static ACTchannel act;
+static int actIsOpen = 0;
+static char actReply[65536];
+
+static PyObject* py_spoolOpen(PyObject* self, PyObject* args)
+{
+  const char *dir;
+  int segmentKB = SPOOL_SEGMENT_SIZE / 1024, maxSegments = SPOOL_MAX_SEGMENTS;
+
+  if (!PyArg_ParseTuple(args, "s|ii", &dir, &segmentKB, &maxSegments) || segmentKB <= 0 || maxSegments <= 0)
+    return Py_BuildValue("i", -1);
+  if (isOpen)
+    SPOOLclose(&spool);
+  isOpen = SPOOLopen(&spool, dir, segmentKB * 1024, maxSegments) == 0;
+  return Py_BuildValue("i", isOpen ? 0 : -1);
+}
+
+static PyObject* py_spoolPut(PyObject* self, PyObject* args)
+{
+  const char *data;
+  int len;
+
+  if (!isOpen || !PyArg_ParseTuple(args, "s#", &data, &len))
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", SPOOLput(&spool, data, len));
+}
+
+static PyObject* py_spoolPeek(PyObject* self, PyObject* args)
+{
+  const uint8_t *data;
+  uint32_t len;
+  PyObject *list;
+  int max = 1;
+
+  if (!PyArg_ParseTuple(args, "|i", &max))
+    return Py_BuildValue("i", -1);
+  list = PyList_New(0);
+  while (isOpen && PyList_Size(list) < max && SPOOLpeek(&spool, &data, &len) == 1)
+  {
+    PyObject *record = PyString_FromStringAndSize((const char *)data, len);
+    PyList_Append(list, record);
+    Py_DECREF(record);
+  }
+  return list;
+}
+
+static PyObject* py_spoolCommit(PyObject* self, PyObject* args)
+{
+  if (!isOpen)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", SPOOLcommit(&spool));
+}
+
+static PyObject* py_spoolRewind(PyObject* self, PyObject* args)
+{
+  if (!isOpen)
+    return Py_BuildValue("i", -1);
+  SPOOLrewind(&spool);
+  return Py_BuildValue("i", 0);
+}
+
+static PyObject* py_spoolStats(PyObject* self, PyObject* args)
+{
+  if (!isOpen)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("{s:K,s:I,s:K,s:K}",
+    "pending", (unsigned PY_LONG_LONG)spool.pending,
+    "segments", spool.w.seg - spool.firstSeg + 1,
+    "dropped", (unsigned PY_LONG_LONG)spool.dropped,
+    "recovered", (unsigned PY_LONG_LONG)spool.recovered);
+}
+
+static PyObject* py_spoolClose(PyObject* self, PyObject* args)
+{
+  if (isOpen)
+    SPOOLclose(&spool);
+  isOpen = 0;
+  return Py_BuildValue("i", 0);
+}
+
+static PyObject* py_spoolPutRow(PyObject* self, PyObject* args)
+{
+  const char *measurement;
+  PyObject *tagDict, *fieldDict, *key, *value;
+  UPLtag tags[16];
+  UPLfield fields[ROW_FIELDS];
+  char row[ROW_SIZE];
+  int ntags = 0, nfields = 0, len;
+  Py_ssize_t pos = 0;
+  double t;
+
+  if (!isOpen || !PyArg_ParseTuple(args, "sO!O!d", &measurement, &PyDict_Type, &tagDict, &PyDict_Type, &fieldDict, &t))
+    return Py_BuildValue("i", -1);
+  while (ntags < 16 && PyDict_Next(tagDict, &pos, &key, &value))
+  {
+    if (!PyString_Check(key) || !PyString_Check(value))
+      continue;
+    tags[ntags].key = PyString_AsString(key);
+    tags[ntags++].value = PyString_AsString(value);
+  }
+  pos = 0;
+  while (nfields < ROW_FIELDS && PyDict_Next(fieldDict, &pos, &key, &value))
+  {
+    if (!PyString_Check(key) || value == Py_None)
+      continue;
+    fields[nfields].key = PyString_AsString(key);
+    fields[nfields].str = NULL;
+    if (PyString_Check(value))
+      fields[nfields].str = PyString_AsString(value);
+    else if (PyNumber_Check(value))
+    {
+      fields[nfields].value = PyFloat_AsDouble(value);
+      if (PyErr_Occurred())
+      {
+        PyErr_Clear();
+        continue;
+      }
+    }
+    else
+      continue;
+    nfields++;
+  }
+  len = UPLencode(row, sizeof(row), measurement, tags, ntags, fields, nfields, (int64_t)(t * 1e6) * 1000);
+  if (len < 0)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", SPOOLput(&spool, row, len));
+}
+
+static PyObject* py_rawOpen(PyObject* self, PyObject* args)
+{
+  const char *dir;
+  int segmentKB = SPOOL_SEGMENT_SIZE / 1024, maxSegments = SPOOL_MAX_SEGMENTS;
+
+  if (!PyArg_ParseTuple(args, "s|ii", &dir, &segmentKB, &maxSegments) || segmentKB <= 0 || maxSegments <= 0)
+    return Py_BuildValue("i", -1);
+  if (rawIsOpen)
+    SPOOLclose(&raw);
+  rawIsOpen = SPOOLopen(&raw, dir, segmentKB * 1024, maxSegments) == 0;
+  return Py_BuildValue("i", rawIsOpen ? 0 : -1);
+}
+
+static PyObject* py_rawPut(PyObject* self, PyObject* args)
+{
+  const char *data;
+  int len;
+
+  if (!rawIsOpen || !PyArg_ParseTuple(args, "s#", &data, &len))
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", SPOOLput(&raw, data, len));
+}
+
+static PyObject* py_uplOpen(PyObject* self, PyObject* args)
+{
+  const char *url;
+  int maxBytes = UPL_MAX_BYTES, flushSecs = UPL_FLUSH_MS / 1000;
+
+  if (!PyArg_ParseTuple(args, "s|ii", &url, &maxBytes, &flushSecs) || maxBytes <= 0 || flushSecs <= 0)
+    return Py_BuildValue("i", -1);
+  if (uplIsOpen)
+    UPLclose(&upl);
+  uplIsOpen = UPLopen(&upl, url, maxBytes, flushSecs * 1000) == 0;
+  return Py_BuildValue("i", uplIsOpen ? 0 : -1);
+}
+
+static PyObject* py_uplPump(PyObject* self, PyObject* args)
+{
+  int force = 0, status, rc;
+
+  if (!isOpen || !uplIsOpen || !PyArg_ParseTuple(args, "|i", &force))
+    return Py_BuildValue("i", -1);
+  // The spool is only touched with the GIL held, the POST runs without it
+  if ((rc = UPLbatch(&upl, &spool, force)) <= 0)
+    return Py_BuildValue("i", rc);
+  Py_BEGIN_ALLOW_THREADS
+  status = UPLsend(&upl);
+  Py_END_ALLOW_THREADS
+  return Py_BuildValue("i", UPLsettle(&upl, &spool, status));
+}
+
+static PyObject* py_uplStats(PyObject* self, PyObject* args)
+{
+  if (!uplIsOpen)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:I,s:I,s:I,s:I,s:I,s:I}",
+    "rows", (unsigned PY_LONG_LONG)upl.stats.rows,
+    "batches", (unsigned PY_LONG_LONG)upl.stats.batches,
+    "rawBytes", (unsigned PY_LONG_LONG)upl.stats.rawBytes,
+    "wireOut", (unsigned PY_LONG_LONG)upl.stats.wireOut,
+    "wireIn", (unsigned PY_LONG_LONG)upl.stats.wireIn,
+    "failures", upl.stats.failures,
+    "rejected", upl.stats.rejected,
+    "skipped", upl.stats.skipped,
+    "connects", upl.stats.connects,
+    "lastStatus", upl.stats.lastStatus,
+    "lastMs", upl.stats.lastMs);
+}
+
+static PyObject* py_actOpen(PyObject* self, PyObject* args)
+{
+  const char *url;
+  int waitSecs = 0;
+
+  if (!PyArg_ParseTuple(args, "s|i", &url, &waitSecs) || waitSecs < 0)
+    return Py_BuildValue("i", -1);
+  if (actIsOpen)
+    ACTclose(&act);
+  actIsOpen = ACTopen(&act, url, waitSecs) == 0;
+  return Py_BuildValue("i", actIsOpen ? 0 : -1);
+}
+
+static PyObject* py_actPoll(PyObject* self, PyObject* args)
+{
+  int len;
+
+  if (!actIsOpen)
+    Py_RETURN_NONE;
+  // The poll is held by the server for up to waitSecs, the metric loop runs meanwhile
+  Py_BEGIN_ALLOW_THREADS
+  len = ACTpoll(&act, actReply, sizeof(actReply));
+  Py_END_ALLOW_THREADS
+  if (len < 0)
+    Py_RETURN_NONE;
+  return Py_BuildValue("s#", actReply, len);
+}
+
+static PyObject* py_actAck(PyObject* self, PyObject* args)
+{
+  const char *id;
+  int ok = 1;
+
+  if (!actIsOpen || !PyArg_ParseTuple(args, "s|i", &id, &ok))
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", ACTack(&act, id, ok));
+}
+
+static PyObject* py_actSeen(PyObject* self, PyObject* args)
+{
+  const char *id;
+
+  if (!actIsOpen || !PyArg_ParseTuple(args, "s", &id))
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", ACTseen(&act, id));
+}
+
+static PyObject* py_actStats(PyObject* self, PyObject* args)
+{
+  ACTstats st;
+
+  if (!actIsOpen)
+    return Py_BuildValue("i", -1);
+  ACTgetStats(&act, &st);
+  return Py_BuildValue("{s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:I}",
+    "polls", st.polls,
+    "held", st.held,
+    "deliveries", st.deliveries,
+    "acks", st.acks,
+    "fails", st.fails,
+    "failures", st.failures,
+    "connects", st.connects,
+    "lastStatus", st.lastStatus,
+    "lastMs", st.lastMs);
+}
+
+
+/*
+ * Bind Python function names to our C functions
+ */
+static PyMethodDef spool_methods[] = {
+  {"spoolOpen", py_spoolOpen, METH_VARARGS},
+  {"spoolPut", py_spoolPut, METH_VARARGS},
+  {"spoolPeek", py_spoolPeek, METH_VARARGS},
+  {"spoolCommit", py_spoolCommit, METH_VARARGS},
+  {"spoolRewind", py_spoolRewind, METH_VARARGS},
+  {"spoolStats", py_spoolStats, METH_VARARGS},
+  {"spoolClose", py_spoolClose, METH_VARARGS},
+  {"spoolPutRow", py_spoolPutRow, METH_VARARGS},
+  {"rawOpen", py_rawOpen, METH_VARARGS},
+  {"rawPut", py_rawPut, METH_VARARGS},
+  {"uplOpen", py_uplOpen, METH_VARARGS},
+  {"uplPump", py_uplPump, METH_VARARGS},
+  {"uplStats", py_uplStats, METH_VARARGS},
+  {"actOpen", py_actOpen, METH_VARARGS},
+  {"actPoll", py_actPoll, METH_VARARGS},
+  {"actAck", py_actAck, METH_VARARGS},
+  {"actSeen", py_actSeen, METH_VARARGS},
+  {"actStats", py_actStats, METH_VARARGS},
+  {NULL, NULL}
+};
+
+/*
+ * Python calls this to let us initialize our module
+ */
+void initspool()
+{
+  (void) Py_InitModule("spool", spool_methods);
+}
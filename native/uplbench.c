@@ -0,0 +1,198 @@
+/*
+=================================================================================
+ Name        : uplbench.c
+ Version     : 0.1
+
+ Description : Uploader benchmark. Spools a drive's worth of synthetic OBD
+     sweeps as line protocol, drains them through the batched uploader and
+     reports rows/s and bytes on the wire, next to the old scheme of one JSON
+     POST per sweep on a fresh connection. Run it against httpsink:
+
+         ./httpsink &
+         ./uplbench -u http://127.0.0.1:8086/write
+
+     uplbench [-u url] [-n sweeps] [-b batch_bytes] [-j json_posts]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "obd_pids.h"
+#include "spool.h"
+#include "upload.h"
+
+#define ROW_SIZE 8192
+#define MAX_FAILURES 5          // posts failing in a row before giving up, about 15 s of backoff
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// One sweep of every table PID, values with the decimals real decoders produce.
+static int makeSweep(UPLfield *fields, int sweep)
+{
+	int i, n = 0;
+
+	for (i = 0; i < OBDpidCount; i++)
+	{
+		if (OBDpids[i].pid % 0x20 == 0)
+			continue;
+		fields[n].key = OBDpids[i].name;
+		fields[n].str = NULL;
+		fields[n].value = round((50 + 40 * sin(sweep * 0.05 + i)) * 100) / 100;
+		n++;
+	}
+	return n;
+}
+
+static void benchFormat(void)
+{
+	char buf[64];
+	double start, fast, slow, v;
+	volatile int sink = 0;
+	int i, n = 1000000;
+
+	start = nowSec();
+	for (i = 0; i < n; i++)
+	{
+		v = i * 0.25 - 1000;
+		sink += UPLformatDouble(buf, v);
+	}
+	fast = (nowSec() - start) * 1e9 / n;
+	start = nowSec();
+	for (i = 0; i < n; i++)
+	{
+		v = i * 0.25 - 1000;
+		sink += snprintf(buf, sizeof(buf), "%.17g", v);
+	}
+	slow = (nowSec() - start) * 1e9 / n;
+	printf("float format     %6.1f ns/value (snprintf %%.17g %6.1f ns/value)\n", fast, slow);
+}
+
+int main(int argc, char **argv)
+{
+	const char *url = "http://127.0.0.1:8086/write";
+	char dir[] = "/tmp/uplbench.XXXXXX", row[ROW_SIZE], cmd[64];
+	UPLfield fields[128];
+	UPLtag tag = { "vehicle", "BENCH0001" };
+	int sweeps = 3600, jsonPosts = 300, maxBytes = UPL_MAX_BYTES, opt, i, j, n = 0, len = 0, failures = 0;
+	double start, batchedRate, jsonRate, elapsed;
+	uint64_t jsonWire = 0;
+	Uploader u;
+	UPLstats st;
+	Spool s;
+
+	while ((opt = getopt(argc, argv, "u:n:b:j:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'u': url = optarg; break;
+			case 'n': sweeps = atoi(optarg); break;
+			case 'b': maxBytes = atoi(optarg); break;
+			case 'j': jsonPosts = atoi(optarg); break;
+			default:
+				fprintf(stderr, "usage: %s [-u url] [-n sweeps] [-b batch_bytes] [-j json_posts]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (mkdtemp(dir) == NULL || SPOOLopen(&s, dir, 0, 0) < 0 || UPLopen(&u, url, maxBytes, 1) < 0)
+	{
+		fprintf(stderr, "uplbench: cannot set up spool in %s or uploader for %s\n", dir, url);
+		return 1;
+	}
+	s.syncEvery = 0;
+	benchFormat();
+
+	// Encode and spool, as the metric loop does
+	start = nowSec();
+	for (i = 0; i < sweeps; i++)
+	{
+		n = makeSweep(fields, i);
+		len = UPLencode(row, sizeof(row), "obd", &tag, 1, fields, n, 1500000000000000000LL + i * 1000000000LL);
+		if (len < 0 || SPOOLput(&s, row, len) < 0)
+			return 1;
+	}
+	SPOOLsync(&s);
+	elapsed = nowSec() - start;
+	printf("encode + spool   %6.1f us/row, %d fields, %d bytes/row\n", elapsed * 1e6 / sweeps, n, len);
+
+	// Drain through the uploader
+	start = nowSec();
+	while (s.pending)
+	{
+		int rc = UPLpump(&u, &s, 1);
+		double wait = u.retryAt / 1e3 - nowSec();
+
+		if (rc > 0)
+			failures = 0;
+		else if (rc < 0 && ++failures == MAX_FAILURES)
+		{
+			UPLgetStats(&u, &st);
+			fprintf(stderr, "uplbench: %d posts to %s failed in a row, last status %u\n", failures, url, st.lastStatus);
+			return 1;
+		}
+		// nothing is due before the backoff has passed, sleep rather than spin
+		if (rc <= 0 && wait > 0)
+			usleep(wait * 1e6);
+	}
+	elapsed = nowSec() - start;
+	UPLgetStats(&u, &st);
+	batchedRate = st.rows / elapsed;
+	printf("batched gzip     %8.0f rows/s, %llu batches, %u retries, %u connects, %6.1f wire bytes/row (%.1fx compression)\n",
+		batchedRate, (unsigned long long)st.batches, st.failures, st.connects,
+		(double)(st.wireOut + st.wireIn) / st.rows, (double)st.rawBytes / st.bodyBytes);
+	UPLclose(&u);
+
+	// The old way: one JSON object per POST, new connection each time
+	if (jsonPosts > 0)
+	{
+		Uploader old;
+
+		UPLopen(&old, url, 0, 0);
+		old.keepAlive = 0;
+		start = nowSec();
+		for (i = 0; i < jsonPosts; i++)
+		{
+			n = makeSweep(fields, i);
+			len = snprintf(row, sizeof(row), "{\"time\": %.17g", 1500000000.0 + i);
+			for (j = 0; j < n; j++)
+				len += snprintf(row + len, sizeof(row) - len, ", \"%s\": %.17g", fields[j].key, fields[j].value);
+			len += snprintf(row + len, sizeof(row) - len, "}");
+			if (UPLpost(&old, "application/json", NULL, row, len) < 0)
+				break;
+		}
+		elapsed = nowSec() - start;
+		UPLgetStats(&old, &st);
+		jsonWire = st.wireOut + st.wireIn;
+		jsonRate = i / elapsed;
+		printf("json per POST    %8.0f rows/s, %d connects, %6.1f wire bytes/row (plain http, no TLS handshakes)\n",
+			jsonRate, i, (double)jsonWire / (i ? i : 1));
+		printf("\nspeedup %.0fx rows/s, %.1fx fewer bytes on the wire\n", batchedRate / jsonRate,
+			((double)jsonWire / (i ? i : 1)) / ((double)(u.stats.wireOut + u.stats.wireIn) / u.stats.rows));
+		UPLclose(&old);
+	}
+
+	SPOOLclose(&s);
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	if (system(cmd) != 0)
+		fprintf(stderr, "uplbench: could not remove %s\n", dir);
+	return 0;
+}
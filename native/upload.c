@@ -0,0 +1,746 @@
+/*
+=================================================================================
+ Name        : upload.c
+ Version     : 0.1
+
+ Description : Batched gzip line protocol uploader, see upload.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <zlib.h>
+#ifndef UPLOAD_NO_TLS
+#include <openssl/ssl.h>
+#endif
+#include "upload.h"
+
+static int64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Fixed point with up to six decimals, trailing zeros trimmed. OBD values
+// never need more; very large or very small numbers fall back to %.17g.
+int UPLformatDouble(char *out, double v)
+{
+	char digits[24];
+	uint64_t scaled, ip;
+	uint32_t fp;
+	int len = 0, n = 0, i;
+
+	if (isnan(v) || isinf(v))
+		return -1;
+	if (fabs(v) >= 1e12 || (v != 0 && fabs(v) < 1e-6))
+		return sprintf(out, "%.17g", v);
+	scaled = (uint64_t)(fabs(v) * 1e6 + 0.5);
+	if (v < 0 && scaled)
+		out[len++] = '-';
+	ip = scaled / 1000000;
+	fp = scaled % 1000000;
+	do
+	{
+		digits[n++] = '0' + ip % 10;
+		ip /= 10;
+	} while (ip);
+	while (n)
+		out[len++] = digits[--n];
+	if (fp)
+	{
+		out[len++] = '.';
+		for (i = 5; i >= 0; i--)
+		{
+			out[len + i] = '0' + fp % 10;
+			fp /= 10;
+		}
+		len += 6;
+		while (out[len - 1] == '0')
+			len--;
+	}
+	out[len] = 0;
+	return len;
+}
+
+// Append str with backslashes before any of the characters in special.
+static int putEscaped(char *out, int size, int len, const char *str, const char *special)
+{
+	for (; *str; str++)
+	{
+		if (strchr(special, *str))
+		{
+			if (len + 1 >= size)
+				return -1;
+			out[len++] = '\\';
+		}
+		if (len + 1 >= size)
+			return -1;
+		out[len++] = *str;
+	}
+	return len;
+}
+
+int UPLencode(char *out, int size, const char *measurement, const UPLtag *tags, int ntags,
+	const UPLfield *fields, int nfields, int64_t timeNs)
+{
+	char num[32];
+	int len, i, n = 0, written = 0;
+
+	len = putEscaped(out, size, 0, measurement, ", ");
+	for (i = 0; i < ntags && len >= 0; i++)
+	{
+		if (tags[i].value == NULL || tags[i].value[0] == 0)
+			continue;       // line protocol has no empty tag values
+		out[len++] = ',';
+		len = putEscaped(out, size, len, tags[i].key, ",= ");
+		if (len < 0 || len + 1 >= size)
+			return -1;
+		out[len++] = '=';
+		len = putEscaped(out, size, len, tags[i].value, ",= ");
+	}
+	for (i = 0; i < nfields && len >= 0; i++)
+	{
+		if (fields[i].str == NULL && (n = UPLformatDouble(num, fields[i].value)) < 0)
+			continue;
+		if (len + 2 >= size)
+			return -1;
+		out[len++] = written++ ? ',' : ' ';
+		len = putEscaped(out, size, len, fields[i].key, ",= ");
+		if (len < 0 || len + 2 >= size)
+			return -1;
+		out[len++] = '=';
+		if (fields[i].str)
+		{
+			out[len++] = '"';
+			len = putEscaped(out, size, len, fields[i].str, "\"\\");
+			if (len < 0 || len + 1 >= size)
+				return -1;
+			out[len++] = '"';
+		}
+		else
+		{
+			if (len + n >= size)
+				return -1;
+			memcpy(out + len, num, n);
+			len += n;
+		}
+	}
+	if (len < 0 || written == 0)
+		return -1;
+	if (timeNs > 0)
+	{
+		n = snprintf(out + len, size - len, " %lld", (long long)timeNs);
+		if (n >= size - len)
+			return -1;
+		len += n;
+	}
+	out[len] = 0;
+	return len;
+}
+
+static int parseUrl(Uploader *u, const char *url)
+{
+	const char *host, *p;
+	size_t n;
+
+	if (strncmp(url, "http://", 7) == 0)
+	{
+		host = url + 7;
+		strcpy(u->port, "80");
+	}
+	else if (strncmp(url, "https://", 8) == 0)
+	{
+		host = url + 8;
+		strcpy(u->port, "443");
+		u->tls = 1;
+	}
+	else
+		return -1;
+	n = strcspn(host, ":/");
+	if (n == 0 || n >= sizeof(u->host))
+		return -1;
+	memcpy(u->host, host, n);
+	u->host[n] = 0;
+	p = host + n;
+	if (*p == ':')
+	{
+		n = strcspn(++p, "/");
+		if (n == 0 || n >= sizeof(u->port))
+			return -1;
+		memcpy(u->port, p, n);
+		u->port[n] = 0;
+		p += n;
+	}
+	snprintf(u->path, sizeof(u->path), "%s", *p ? p : "/");
+	return 0;
+}
+
+static void disconnect(Uploader *u)
+{
+#ifndef UPLOAD_NO_TLS
+	if (u->ssl)
+	{
+		SSL_shutdown(u->ssl);
+		SSL_free(u->ssl);
+	}
+#endif
+	u->ssl = NULL;
+	if (u->fd >= 0)
+		close(u->fd);
+	u->fd = -1;
+	u->onConn = 0;
+	u->rpos = u->rlen = 0;
+}
+
+static int connectTo(Uploader *u)
+{
+	struct addrinfo hints, *res, *ai;
+	struct timeval tv;
+	int one = 1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(u->host, u->port, &hints, &res) != 0)
+		return -1;
+	tv.tv_sec = u->timeoutMs / 1000;
+	tv.tv_usec = (u->timeoutMs % 1000) * 1000;
+	for (ai = res; ai; ai = ai->ai_next)
+	{
+		u->fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (u->fd < 0)
+			continue;
+		setsockopt(u->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(u->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		setsockopt(u->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		if (connect(u->fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(u->fd);
+		u->fd = -1;
+	}
+	freeaddrinfo(res);
+	if (u->fd < 0)
+		return -1;
+	u->stats.connects++;
+	u->onConn = 0;
+	u->rpos = u->rlen = 0;
+#ifndef UPLOAD_NO_TLS
+	if (u->tls)
+	{
+		if (u->sslCtx == NULL)
+		{
+			SSL_library_init();
+			u->sslCtx = SSL_CTX_new(SSLv23_client_method());
+			if (u->sslCtx == NULL)
+				goto fail;
+			SSL_CTX_set_default_verify_paths(u->sslCtx);
+			SSL_CTX_set_verify(u->sslCtx, SSL_VERIFY_PEER, NULL);
+		}
+		u->ssl = SSL_new(u->sslCtx);
+		if (u->ssl == NULL)
+			goto fail;
+		SSL_set_fd(u->ssl, u->fd);
+		SSL_set_tlsext_host_name(u->ssl, u->host);
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+		SSL_set1_host(u->ssl, u->host);
+#endif
+		if (SSL_connect(u->ssl) != 1)
+			goto fail;
+	}
+	return 0;
+fail:
+	disconnect(u);
+	return -1;
+#else
+	return 0;
+#endif
+}
+
+static int ioWrite(Uploader *u, const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+	int n;
+
+	while (len)
+	{
+#ifndef UPLOAD_NO_TLS
+		if (u->ssl)
+			n = SSL_write(u->ssl, p, len);
+		else
+#endif
+			n = send(u->fd, p, len, MSG_NOSIGNAL);
+		if (n <= 0)
+			return -1;
+		u->stats.wireOut += n;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int ioFill(Uploader *u)
+{
+	int n;
+
+	if (u->rpos < u->rlen)
+		return u->rlen - u->rpos;
+#ifndef UPLOAD_NO_TLS
+	if (u->ssl)
+		n = SSL_read(u->ssl, u->rbuf, sizeof(u->rbuf));
+	else
+#endif
+		n = recv(u->fd, u->rbuf, sizeof(u->rbuf), 0);
+	if (n <= 0)
+		return -1;
+	u->stats.wireIn += n;
+	u->rpos = 0;
+	u->rlen = n;
+	return n;
+}
+
+static int readLine(Uploader *u, char *line, int size)
+{
+	int len = 0;
+
+	for (;;)
+	{
+		char ch;
+
+		if (ioFill(u) < 0)
+			return -1;
+		ch = u->rbuf[u->rpos++];
+		if (ch == '\n')
+			break;
+		if (ch != '\r' && len < size - 1)
+			line[len++] = ch;
+	}
+	line[len] = 0;
+	return len;
+}
+
+// Skip n bytes of body, keeping what fits in out[size - 1] from *outLen on
+static int discard(Uploader *u, long n, char *out, int size, int *outLen)
+{
+	while (n > 0)
+	{
+		int have = ioFill(u);
+
+		if (have < 0)
+			return -1;
+		if (have > n)
+			have = n;
+		if (out && *outLen < size - 1)
+		{
+			int keep = have < size - 1 - *outLen ? have : size - 1 - *outLen;
+
+			memcpy(out + *outLen, u->rbuf + u->rpos, keep);
+			*outLen += keep;
+		}
+		u->rpos += have;
+		n -= have;
+	}
+	return 0;
+}
+
+// Status line, headers and body of one response, the body kept in out if it
+// is not NULL. *closing is set when the server will not take another request
+// on this connection.
+static int readResponse(Uploader *u, int *closing, char *out, int size, int *outLen)
+{
+	char line[512];
+	long length;
+	int status, chunked;
+
+	do
+	{
+		if (readLine(u, line, sizeof(line)) < 0 || sscanf(line, "HTTP/%*d.%*d %d", &status) != 1)
+			return -1;
+		length = -1;
+		chunked = 0;
+		*closing = strncmp(line, "HTTP/1.0", 8) == 0;
+		while (readLine(u, line, sizeof(line)) > 0)
+		{
+			if (strncasecmp(line, "Content-Length:", 15) == 0)
+				length = atol(line + 15);
+			else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked"))
+				chunked = 1;
+			else if (strncasecmp(line, "Connection:", 11) == 0)
+				*closing = strstr(line, "close") || strstr(line, "Close");
+		}
+	} while (status == 100);
+
+	if (out)
+		*out = 0;
+	*outLen = 0;
+	if (status == 204 || status == 304)
+		return status;
+	if (chunked)
+	{
+		long chunk;
+
+		do
+		{
+			if (readLine(u, line, sizeof(line)) < 0)
+				return -1;
+			chunk = strtol(line, NULL, 16);
+			if (chunk && (discard(u, chunk, out, size, outLen) < 0 || discard(u, 2, NULL, 0, outLen) < 0))
+				return -1;
+		} while (chunk > 0);
+		while (readLine(u, line, sizeof(line)) > 0)
+			;       // trailers
+	}
+	else if (length >= 0)
+	{
+		if (discard(u, length, out, size, outLen) < 0)
+			return -1;
+	}
+	else
+	{
+		// body runs to the end of the connection
+		while (ioFill(u) > 0)
+			discard(u, u->rlen - u->rpos, out, size, outLen);
+		*closing = 1;
+	}
+	if (out)
+		out[*outLen] = 0;
+	return status;
+}
+
+// One request on the kept-alive connection, a body is sent when contentType is set
+static int request(Uploader *u, const char *method, const char *path, const char *contentType,
+	const char *encoding, const void *body, uint32_t len, char *reply, int size, int *replyLen)
+{
+	char hdr[1024], length[40];
+	int n, attempt, status, closing, got;
+
+	if (replyLen == NULL)
+		replyLen = &got;
+	if (contentType)
+		snprintf(length, sizeof(length), "Content-Length: %u\r\n", len);
+	for (attempt = 0; attempt < 2; attempt++)
+	{
+		int reused;
+
+		if (u->fd < 0 && connectTo(u) < 0)
+			return -1;
+		reused = u->onConn > 0;
+		n = snprintf(hdr, sizeof(hdr),
+			"%s %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: automated-upload/0.1\r\n"
+			"%s%s%s%s%s%s%s%sConnection: %s\r\n\r\n",
+			method, path, u->host,
+			contentType ? "Content-Type: " : "", contentType ? contentType : "", contentType ? "\r\n" : "",
+			encoding ? "Content-Encoding: " : "", encoding ? encoding : "", encoding ? "\r\n" : "",
+			u->headers, contentType ? length : "", u->keepAlive ? "keep-alive" : "close");
+		if (n >= (int)sizeof(hdr))
+			return -1;
+		if (ioWrite(u, hdr, n) < 0 || (contentType && ioWrite(u, body, len) < 0) ||
+			(status = readResponse(u, &closing, reply, size, replyLen)) < 0)
+		{
+			disconnect(u);
+			// an idle keep-alive connection the server already dropped, try a fresh one
+			if (reused)
+				continue;
+			return -1;
+		}
+		u->onConn++;
+		if (closing || !u->keepAlive)
+			disconnect(u);
+		return status;
+	}
+	return -1;
+}
+
+int UPLpost(Uploader *u, const char *contentType, const char *encoding, const void *body, uint32_t len)
+{
+	return request(u, "POST", u->path, contentType, encoding, body, len, NULL, 0, NULL);
+}
+
+int UPLget(Uploader *u, const char *path, char *reply, int size)
+{
+	int len;
+
+	return request(u, "GET", path ? path : u->path, NULL, NULL, NULL, 0, reply, size, &len);
+}
+
+static int gzipBatch(Uploader *u, uint32_t rawLen)
+{
+	z_stream zs;
+	uLong bound;
+	int rc;
+
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return -1;
+	bound = deflateBound(&zs, rawLen);
+	if (bound > u->bodyCap)
+	{
+		uint8_t *p = realloc(u->body, bound);
+
+		if (p == NULL)
+		{
+			deflateEnd(&zs);
+			return -1;
+		}
+		u->body = p;
+		u->bodyCap = bound;
+	}
+	zs.next_in = (Bytef *)u->raw;
+	zs.avail_in = rawLen;
+	zs.next_out = u->body;
+	zs.avail_out = u->bodyCap;
+	rc = deflate(&zs, Z_FINISH);
+	deflateEnd(&zs);
+	return rc == Z_STREAM_END ? (int)zs.total_out : -1;
+}
+
+static int reserve(Uploader *u, uint32_t need)
+{
+	if (need > u->rawCap)
+	{
+		uint32_t cap = need * 2;
+		char *p = realloc(u->raw, cap);
+
+		if (p == NULL)
+			return -1;
+		u->raw = p;
+		u->rawCap = cap;
+	}
+	return 0;
+}
+
+// One row per sweep of a block of sweeps, returns rows or -1 if the block is corrupt.
+static int expandBlock(Uploader *u, const uint8_t *data, uint32_t len, uint32_t *rawLen)
+{
+	UPLfield fields[GOR_MAX_COLUMNS];
+	double values[GOR_MAX_COLUMNS];
+	int cols[GOR_MAX_COLUMNS], n, i, keyLen, rowLen, rows = 0;
+	uint32_t start = *rawLen;
+	int64_t t;
+
+	if (u->dec == NULL && (u->dec = malloc(sizeof(GORdecoder))) == NULL)
+		return -1;
+	if (GORdecode(u->dec, data, len) < 0)
+		return -1;
+	keyLen = strlen(u->dec->key);
+	while ((n = GORnext(u->dec, &t, cols, values)) > 0)
+	{
+		uint32_t room = keyLen + n * (GOR_MAX_NAME + 32) + 32;
+
+		if (reserve(u, *rawLen + room) < 0)
+		{
+			n = -1;
+			break;
+		}
+		for (i = 0; i < n; i++)
+		{
+			fields[i].key = u->dec->names[cols[i]];
+			fields[i].str = NULL;
+			fields[i].value = values[i];
+		}
+		// the key is already escaped, encode the fields after it
+		memcpy(u->raw + *rawLen, u->dec->key, keyLen);
+		rowLen = UPLencode(u->raw + *rawLen + keyLen, room - keyLen, "", NULL, 0, fields, n, t * 1000000);
+		if (rowLen < 0)
+			continue;       // nothing but NaNs
+		*rawLen += keyLen + rowLen;
+		u->raw[(*rawLen)++] = '\n';
+		rows++;
+	}
+	if (n < 0)
+	{
+		*rawLen = start;
+		return -1;
+	}
+	return rows;
+}
+
+int UPLbatch(Uploader *u, Spool *s, int force)
+{
+	int64_t now = nowMs();
+	uint32_t rawLen = 0, rows = 0, skipped = 0, len;
+	const uint8_t *data;
+	int bodyLen;
+
+	u->batchRows = 0;
+	if (now < u->retryAt)
+		return 0;
+	if (s->pending == 0)
+	{
+		u->pendingSince = 0;
+		return 0;
+	}
+	if (u->pendingSince == 0)
+		u->pendingSince = now;
+
+	SPOOLrewind(s);
+	while (rawLen < u->maxBytes && SPOOLpeek(s, &data, &len) == 1)
+	{
+		int n;
+
+		// JSON records from before the switch to line protocol
+		if (data[0] == '{')
+		{
+			skipped++;
+			continue;
+		}
+		if (GORisBlock(data, len))
+		{
+			if ((n = expandBlock(u, data, len, &rawLen)) < 0)
+				skipped++;
+			else
+				rows += n;
+			continue;
+		}
+		if (reserve(u, rawLen + len + 1) < 0)
+			break;
+		memcpy(u->raw + rawLen, data, len);
+		rawLen += len;
+		u->raw[rawLen++] = '\n';
+		rows++;
+	}
+	// not full and not old enough yet, wait for more rows
+	if (!force && rawLen < u->maxBytes && now - u->pendingSince < (int64_t)u->flushMs)
+	{
+		SPOOLrewind(s);
+		return 0;
+	}
+	if (rows == 0)
+	{
+		u->stats.skipped += skipped;
+		SPOOLcommit(s);
+		return 0;
+	}
+	if ((bodyLen = gzipBatch(u, rawLen)) < 0)
+	{
+		SPOOLrewind(s);
+		return -1;
+	}
+	u->batchRows = rows;
+	u->batchSkipped = skipped;
+	u->batchRaw = rawLen;
+	u->batchBody = bodyLen;
+	return bodyLen;
+}
+
+int UPLsend(Uploader *u)
+{
+	int64_t start = nowMs();
+	int status;
+
+	if (u->batchRows == 0)
+		return -1;
+	status = UPLpost(u, "text/plain; charset=utf-8", "gzip", u->body, u->batchBody);
+	u->stats.lastMs = nowMs() - start;
+	u->stats.lastStatus = status < 0 ? 0 : status;
+	u->stats.bodyBytes += u->batchBody;
+	return status;
+}
+
+int UPLsettle(Uploader *u, Spool *s, int status)
+{
+	int64_t now = nowMs();
+	uint32_t rows = u->batchRows;
+
+	u->batchRows = 0;
+	if (rows == 0)
+		return 0;
+	if (status >= 200 && status < 300)
+	{
+		SPOOLcommit(s);
+		u->stats.rows += rows;
+		u->stats.batches++;
+		u->stats.rawBytes += u->batchRaw;
+		u->stats.skipped += u->batchSkipped;
+		u->backoffMs = 0;
+		u->pendingSince = s->pending ? now : 0;
+		return rows;
+	}
+	if (status == 400 || status == 413 || status == 422)
+	{
+		// the batch itself is bad, the server will never take it, don't let it
+		// block the rest; any other 4xx (auth, wrong URL) is retried like a 5xx
+		SPOOLcommit(s);
+		u->stats.rejected++;
+		u->backoffMs = 0;
+		return 0;
+	}
+
+	// Retry the same batch, in order, once the backoff has passed
+	SPOOLrewind(s);
+	u->stats.failures++;
+	u->backoffMs = u->backoffMs ? u->backoffMs * 2 : 1000;
+	if (u->backoffMs > UPL_BACKOFF_MAX_MS)
+		u->backoffMs = UPL_BACKOFF_MAX_MS;
+	u->retryAt = now + u->backoffMs / 2 + rand() % (u->backoffMs / 2 + 1);
+	return -1;
+}
+
+int UPLpump(Uploader *u, Spool *s, int force)
+{
+	int rc = UPLbatch(u, s, force);
+
+	if (rc <= 0)
+		return rc;
+	return UPLsettle(u, s, UPLsend(u));
+}
+
+int UPLopen(Uploader *u, const char *url, uint32_t maxBytes, uint32_t flushMs)
+{
+	memset(u, 0, sizeof(*u));
+	u->fd = -1;
+	u->keepAlive = 1;
+	u->timeoutMs = 15000;
+	u->maxBytes = maxBytes ? maxBytes : UPL_MAX_BYTES;
+	u->flushMs = flushMs ? flushMs : UPL_FLUSH_MS;
+	if (parseUrl(u, url) < 0)
+		return -1;
+#ifdef UPLOAD_NO_TLS
+	if (u->tls)
+		return -1;
+#endif
+	srand(time(NULL) ^ getpid());
+	return 0;
+}
+
+void UPLclose(Uploader *u)
+{
+	disconnect(u);
+#ifndef UPLOAD_NO_TLS
+	if (u->sslCtx)
+		SSL_CTX_free(u->sslCtx);
+#endif
+	u->sslCtx = NULL;
+	free(u->raw);
+	free(u->body);
+	free(u->dec);
+	u->dec = NULL;
+	u->raw = NULL;
+	u->body = NULL;
+	u->rawCap = u->bodyCap = 0;
+}
+
+void UPLgetStats(const Uploader *u, UPLstats *st)
+{
+	*st = u->stats;
+}
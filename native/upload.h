@@ -0,0 +1,121 @@
+/*
+=================================================================================
+ Name        : upload.h
+ Version     : 0.1
+
+ Description : Batched metric uploader. Spooled samples are InfluxDB line
+     protocol rows; UPLpump() takes rows off the front of the spool until the
+     batch reaches maxBytes (or the oldest row has waited flushMs), gzips
+     them and POSTs the batch over one keep-alive HTTP or HTTPS connection.
+     The batch is committed only when the server accepts it; on failure it is
+     rewound and sent again, whole and in order, after an exponential
+     backoff with jitter. Only a 400, 413 or 422 drops it: a refused token
+     or a wrong URL keeps every batch in the spool until it is fixed. Spool records that are gorilla.h blocks are
+     expanded to one row per sweep.
+
+     Build with -DUPLOAD_NO_TLS to drop the OpenSSL dependency (http only).
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <stdint.h>
+#include "spool.h"
+#include "gorilla.h"
+
+#define UPL_MAX_BYTES (64 * 1024)       // uncompressed batch size
+#define UPL_FLUSH_MS 10000              // longest a row waits for a batch to fill
+#define UPL_BACKOFF_MAX_MS 60000
+
+typedef struct
+{
+	uint64_t rows;          // rows accepted by the server
+	uint64_t batches;
+	uint64_t rawBytes;      // line protocol before compression
+	uint64_t bodyBytes;     // gzip bodies sent, including retries
+	uint64_t wireOut;       // everything written to the socket
+	uint64_t wireIn;        // everything read back
+	uint32_t failures;      // batches that will be retried
+	uint32_t rejected;      // batches the server refused as bad (400, 413, 422), dropped
+	uint32_t skipped;       // spool records that were not line protocol
+	uint32_t connects;
+	uint32_t lastStatus;
+	uint32_t lastMs;        // duration of the last POST
+} UPLstats;
+
+typedef struct
+{
+	const char *key;
+	const char *value;
+} UPLtag;
+
+typedef struct
+{
+	const char *key;
+	const char *str;        // string field if not NULL
+	double value;
+} UPLfield;
+
+typedef struct
+{
+	char host[128];
+	char port[8];
+	char path[256];
+	char headers[256];      // extra request headers, each ending in \r\n
+	int tls;
+	int keepAlive;          // reuse the connection between POSTs, default 1
+	int timeoutMs;
+
+	int fd;
+	void *ssl;
+	void *sslCtx;
+	uint32_t onConn;        // requests made on the current connection
+	uint8_t rbuf[4096];
+	uint32_t rpos, rlen;
+
+	uint32_t maxBytes;
+	uint32_t flushMs;
+	int64_t pendingSince;   // when the spool was first seen non-empty
+	int64_t retryAt;
+	uint32_t backoffMs;
+
+	uint32_t batchRows;     // batch prepared by UPLbatch(), waiting for UPLsettle()
+	uint32_t batchSkipped;
+	uint32_t batchRaw;
+	uint32_t batchBody;
+
+	char *raw;
+	uint32_t rawCap;
+	GORdecoder *dec;        // for spooled blocks of sweeps
+	uint8_t *body;
+	uint32_t bodyCap;
+	UPLstats stats;
+} Uploader;
+
+// all int calls return -1 on failure
+ int UPLformatDouble(char *out, double v);   // shortest fixed form up to 6 decimals, returns length
+ int UPLencode(char *out, int size, const char *measurement, const UPLtag *tags, int ntags,
+	const UPLfield *fields, int nfields, int64_t timeNs);   // one row without newline, returns length
+ int UPLopen(Uploader *u, const char *url, uint32_t maxBytes, uint32_t flushMs);
+ void UPLclose(Uploader *u);
+ int UPLpost(Uploader *u, const char *contentType, const char *encoding, const void *body, uint32_t len);  // HTTP status
+ int UPLget(Uploader *u, const char *path, char *reply, int size);  // HTTP status, body in reply; NULL path = the URL's
+ int UPLpump(Uploader *u, Spool *s, int force);   // rows delivered, 0 if nothing was due
+ // UPLpump() in three steps, so only UPLsend() needs to run without the spool locked
+ int UPLbatch(Uploader *u, Spool *s, int force);  // gzip body length, 0 if nothing is due
+ int UPLsend(Uploader *u);                         // HTTP status of the POST
+ int UPLsettle(Uploader *u, Spool *s, int status); // commit or rewind, as UPLpump()
+ void UPLgetStats(const Uploader *u, UPLstats *st);
+
+#endif
@@ -44,11 +44,17 @@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
 Lesser General Public License for more details.
 ================================================================================
  */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef PCD8544_GPIO_SIM
+#include "pcd8544_sim.h"
+#else
 #include <wiringPi.h>
+#endif
 #include "PCD8544.h"
-
-// An abs() :)
-#define abs(a) (((a) < 0) ? -(a) : (a))
+#include "pcd8544_nokia.h"
 
 // bit set
 #define _BV(bit) (0x1 << (bit))
@@ -57,9 +63,78 @@ Lesser General Public License for more details.
 static uint8_t cursor_x, cursor_y, textsize, textcolor;
 static int8_t _din, _sclk, _dc, _rst, _cs;
 
+// drawing size and buffer layout for the orientation, see LCDsetOrientation()
+static uint8_t lcdW = LCDWIDTH, lcdH = LCDHEIGHT, lcdPages = LCDHEIGHT / 8;
+static uint8_t orientation, transposed, flipX, flipY;
+
+// LCDInit() leaves the display blank over the noise in its RAM until the
+// first whole frame is in; the splash does not count as a frame for the stats
+static uint8_t blanked, splashing;
+
+// told of every display RAM byte sent, see LCDsetByteHook()
+static LCDbyteHook byteHook;
+
+// driver statistics, read with LCDgetStats(). Counting is a few adds per byte
+// plus two clock reads per frame, so it stays on in production.
+static LCDstats stats;
+
+#ifndef PCD8544_NO_STATS
+static uint8_t composing;
+static uint64_t composeStart;
+
+static uint64_t statsNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// process start on the statsNow() scale, set by LCDInit(), and when the
+// driver was loaded into the process
+static uint64_t bootOrigin, loadedAt;
+
+static void __attribute__((constructor)) noteLoad(void)
+{
+	loadedAt = statsNow();
+}
+
+// when the kernel started this process, from the clock ticks since boot in
+// /proc/self/stat, so early by up to a tick; 0 if it cannot be read
+static uint64_t processStart(void)
+{
+	char line[1024], *p;
+	unsigned long long ticks;
+	uint64_t sinceBoot, startedAt, now = statsNow();
+	struct timespec ts;
+	FILE *f = fopen("/proc/self/stat", "r");
+	int field;
+
+	if (f == NULL)
+		return 0;
+	p = fgets(line, sizeof(line), f);
+	fclose(f);
+	// the command name may hold spaces, so count fields from its closing bracket
+	if (p == NULL || (p = strrchr(line, ')')) == NULL)
+		return 0;
+	for (field = 3; field <= 22 && p; field++)
+		p = strchr(p + 1, ' ');
+	if (p == NULL || sscanf(p, " %llu", &ticks) != 1 || clock_gettime(CLOCK_BOOTTIME, &ts) < 0)
+		return 0;
+	sinceBoot = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	startedAt = ticks * 1000000000ULL / sysconf(_SC_CLK_TCK);
+	if (startedAt > sinceBoot || sinceBoot - startedAt > now)
+		return 0;
+	return now - (sinceBoot - startedAt);
+}
+
+#define STATS_ADD(field, n) (stats.field += (n))
+#else
+#define STATS_ADD(field, n) do { } while (0)
+#endif
+
 // font bitmap
 
-static unsigned char  font[] = {
+const uint8_t pcd8544_font[] = {
 		0x00, 0x00, 0x00, 0x00, 0x00, // 00
 		0x3E, 0x5B, 0x4F, 0x5B, 0x3E, // 01
 		0x3E, 0x6B, 0x4F, 0x6B, 0x3E, // 02
@@ -323,11 +398,43 @@ static unsigned char  font[] = {
 // 0x20, 0x40, 0x20, 0x10, 0x08 Tick
 
 // the memory buffer for the LCD
-uint8_t pcd8544_buffer[LCDWIDTH * LCDHEIGHT / 8] = {0,};
+uint8_t pcd8544_buffer[LCDBUFSIZE] = {0,};
+
+// the panel frame the orientation stage builds from it, in the controller's layout
+static uint8_t panel[LCDWIDTH * LCDHEIGHT / 8];
+static uint8_t unflipped[LCDWIDTH * LCDHEIGHT / 8];
+// what the panel's display RAM holds once the flushes handed over are sent,
+// for the flush hook; kept on the drawing thread, apart from the bus side
+static uint8_t shown[LCDWIDTH * LCDHEIGHT / 8];
+static uint8_t shownUnflipped[LCDWIDTH * LCDHEIGHT / 8];
+static uint8_t shownFresh;
+static LCDflushHook flushHook;
+static LCDlockHook statsLock;
+static void sendPanel(const uint8_t *frame, uint8_t pp0, uint8_t pp1, uint8_t pc0, uint8_t pc1);
+
+// bit order of a byte reversed, turns a page upside down
+static const uint8_t bitReverse[256] = {
+	0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+	0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+	0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+	0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+	0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+	0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+	0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+	0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+	0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+	0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+	0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+	0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+	0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+	0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+	0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+	0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF,
+};
 
 // Le: get the bitmap assistance here! : http://en.radzio.dxp.pl/bitmap_converter/
 // Andre: or here! : http://www.henningkarlsen.com/electronics/t_imageconverter_mono.php
-const uint8_t pi_logo [] = {
+const uint8_t pi_logo [LCDWIDTH * LCDHEIGHT / 8] = {
 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,   // 0x0010 (16) pixels
 
 0x00, 0x00, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   // 0x0020 (32) pixels
@@ -395,15 +502,10 @@ const uint8_t pi_logo [] = {
 // originally derived from Steve Evans/JCW's mod but cleaned up and optimized
 //#define enablePartialUpdate
 
+// the primitives below build on 8 bit coordinates, wrapping past 255
 static void my_setpixel(uint8_t x, uint8_t y, uint8_t color)
 {
-	if ((x >= LCDWIDTH) || (y >= LCDHEIGHT))
-		return;
-	// x is which column
-	if (color)
-		pcd8544_buffer[x+ (y/8)*LCDWIDTH] |= _BV(y%8);
-	else
-		pcd8544_buffer[x+ (y/8)*LCDWIDTH] &= ~_BV(y%8);
+	NOKIAsetPixel(x, y, color);
 }
 
 // Set the text colour. 1 is Black on White, 0 is White on Black
@@ -411,6 +513,10 @@ void LCDsetTextColor(uint8_t color)
 {
         textcolor = color;
 }
+uint8_t LCDgetTextColor(void)
+{
+	return textcolor;
+}
 // Set the text spacing
 void LCDsetTextSize(uint8_t siz)
 {
@@ -419,12 +525,24 @@ void LCDsetTextSize(uint8_t siz)
 
 void LCDshowLogo()
 {
-	uint32_t i;
-	for (i = 0; i < LCDWIDTH * LCDHEIGHT / 8; i++  )
+	// the logo is landscape art; in portrait it goes to the panel as it is
+	if (transposed)
 	{
-		pcd8544_buffer[i] = pi_logo[i];
+		LCDclear();
+		sendPanel(pi_logo, 0, LCDHEIGHT/8 - 1, 0, LCDWIDTH - 1);
+		LCDunblank();
+		if (flushHook)
+		{
+			memcpy(shown, pi_logo, sizeof(shown));
+			shownFresh = 0;
+			flushHook(shown);
+		}
+		return;
 	}
+	memcpy(pcd8544_buffer, pi_logo, LCDWIDTH * LCDHEIGHT / 8);
+	splashing = 1;
 	LCDdisplay();
+	splashing = 0;
 }
 
 #ifdef enablePartialUpdate
@@ -432,6 +550,15 @@ static uint8_t xUpdateMin, xUpdateMax, yUpdateMin, yUpdateMax;
 #endif
 
 static void updateBoundingBox(uint8_t xmin, uint8_t ymin, uint8_t xmax, uint8_t ymax) {
+#ifndef PCD8544_NO_STATS
+	// every primitive ends up here; the first one after a flush starts the
+	// rasterization clock that LCDdisplay() stops
+	if (!composing)
+	{
+		composing = 1;
+		composeStart = statsNow();
+	}
+#endif
 #ifdef enablePartialUpdate
 	if (xmin < xUpdateMin) xUpdateMin = xmin;
 	if (xmax > xUpdateMax) xUpdateMax = xmax;
@@ -442,6 +569,20 @@ static void updateBoundingBox(uint8_t xmin, uint8_t ymin, uint8_t xmax, uint8_t
 
 void LCDInit(uint8_t SCLK, uint8_t DIN, uint8_t DC, uint8_t CS, uint8_t RST, uint8_t contrast)
 {
+#ifndef PCD8544_NO_STATS
+	uint64_t initStart = statsNow();
+
+	// the kernel's start time is up to a tick early; a load inside that tick
+	// is no later than a tick after the start, and for a driver linked into
+	// the program it is the closer mark. In an interpreter it loads late.
+	bootOrigin = processStart();
+	if (bootOrigin == 0 || (loadedAt && loadedAt < bootOrigin + 1000000000ULL / sysconf(_SC_CLK_TCK)))
+		bootOrigin = loadedAt;
+	if (bootOrigin == 0 || bootOrigin > initStart)
+		bootOrigin = initStart;
+	stats.startUs = (initStart - bootOrigin) / 1000;
+	stats.firstFrameUs = 0;
+#endif
 	_din = DIN;
 	_sclk = SCLK;
 	_dc = DC;
@@ -463,42 +604,76 @@ void LCDInit(uint8_t SCLK, uint8_t DIN, uint8_t DC, uint8_t CS, uint8_t RST, uin
 		digitalWrite(_cs, LOW);
 
 	digitalWrite(_rst, LOW);
-	_delay_ms(500);
+	delayMicroseconds(LCD_RESET_US);
 	digitalWrite(_rst, HIGH);
 
-	// get into the EXTENDED mode!
-	LCDcommand(PCD8544_FUNCTIONSET | PCD8544_EXTENDEDINSTRUCTION );
-
-	// LCD bias select (4 is optimal?)
-	LCDcommand(PCD8544_SETBIAS | 0x4);
-
-	// set VOP
-	if (contrast > 0x7f)
-		contrast = 0x7f;
-
-	LCDcommand( PCD8544_SETVOP | contrast); // Experimentally determined
-
-	// normal mode
-	LCDcommand(PCD8544_FUNCTIONSET);
-
-	// Set display to Normal
-	LCDcommand(PCD8544_DISPLAYCONTROL | PCD8544_DISPLAYNORMAL);
+	// one burst: EXTENDED mode, bias 4 (optimal?), VOP (experimentally
+	// determined), back to normal mode, and the display left blank as the
+	// reset put it. The first whole frame switches it on, so neither the
+	// noise in the RAM nor a clearing frame is ever sent to the glass.
+	NOKIAinit(contrast);
+	blanked = 1;
 
 	// set up a bounding box for screen updates
-	updateBoundingBox(0, 0, LCDWIDTH-1, LCDHEIGHT-1);
-
+	updateBoundingBox(0, 0, lcdW-1, lcdH-1);
+#ifndef PCD8544_NO_STATS
+	stats.initUs = (statsNow() - initStart) / 1000;
+#endif
 }
 
 void LCDdrawbitmap(uint8_t x, uint8_t y,const uint8_t *bitmap, uint8_t w, uint8_t h,uint8_t color)
 {
 	uint8_t j,i;
-	for ( j=0; j<h; j++)
+
+	// coordinates that wrap past 255 keep the original per-pixel behaviour
+	if ((x + w > 256) || (y + h > 256))
 	{
-		for ( i=0; i<w; i++ )
+		for ( j=0; j<h; j++)
 		{
-			if (*(bitmap + i + (j/8)*w) & _BV(j%8))
+			for ( i=0; i<w; i++ )
 			{
-				my_setpixel(x+i, y+j, color);
+				if (*(bitmap + i + (j/8)*w) & _BV(j%8))
+				{
+					my_setpixel(x+i, y+j, color);
+				}
+			}
+		}
+		updateBoundingBox(x, y, x+w, y+h);
+		return;
+	}
+
+	// a source page lands on at most two buffer pages, shifted by y%8
+	uint8_t cols = (x >= lcdW) ? 0 : ((x + w > lcdW) ? lcdW - x : w);
+	uint16_t row;
+	for (row = 0; cols && row < h; row += 8)
+	{
+		uint16_t ry = y + row;
+		if (ry >= lcdH)
+			break;
+		uint8_t n = (h - row < 8) ? h - row : 8;
+		uint8_t srcmask = 0xFF >> (8 - n);
+		uint8_t shift = ry % 8;
+		uint8_t *dst = pcd8544_buffer + (ry/8)*lcdW + x;
+		uint8_t *dst2 = (shift && ry/8 + 1 < lcdPages) ? dst + lcdW : 0;
+		const uint8_t *src = bitmap + (row/8)*w;
+		for (i = 0; i < cols; i++)
+		{
+			uint8_t b = src[i] & srcmask;
+			if (!b)
+				continue;
+			uint8_t lo = b << shift;
+			uint8_t hi = shift ? b >> (8 - shift) : 0;
+			if (color)
+			{
+				dst[i] |= lo;
+				if (dst2)
+					dst2[i] |= hi;
+			}
+			else
+			{
+				dst[i] &= ~lo;
+				if (dst2)
+					dst2[i] &= ~hi;
 			}
 		}
 	}
@@ -530,30 +705,10 @@ void LCDdrawstring_P(uint8_t x, uint8_t y, const char *str)
 
 void LCDdrawchar(uint8_t x, uint8_t y, char c)
 {
-	if (y >= LCDHEIGHT) return;
-	if ((x+5) >= LCDWIDTH) return;
-	uint8_t i,j;
-	for ( i =0; i<5; i++ )
-	{
-		uint8_t d = *(font+(c*5)+i);
-		uint8_t j;
-		for (j = 0; j<8; j++)
-		{
-			if (d & _BV(j))
-			{
-				my_setpixel(x+i, y+j, textcolor);
-			}
-			else
-			{
-				my_setpixel(x+i, y+j, !textcolor);
-			}
-		}
-	}
-
-	for ( j = 0; j<8; j++)
-	{
-		my_setpixel(x+5, y+j, !textcolor);
-	}
+	if (y >= lcdH) return;
+	if ((x+5) >= lcdW) return;
+	// each glyph column (plus the blank spacer) replaces 8 whole pixels
+	NOKIAdrawchar(x, y, c, textcolor);
 	updateBoundingBox(x, y, x+5, y + 8);
 }
 
@@ -572,12 +727,12 @@ void LCDwrite(uint8_t c)
 	{
 		LCDdrawchar(cursor_x, cursor_y, c);
 		cursor_x += textsize*6;
-		if (cursor_x >= (LCDWIDTH-5))
+		if (cursor_x >= (lcdW-5))
 		{
 			cursor_x = 0;
 			cursor_y+=8;
 		}
-		if (cursor_y >= LCDHEIGHT)
+		if (cursor_y >= lcdH)
 			cursor_y = 0;
 	}
 }
@@ -588,87 +743,42 @@ void LCDsetCursor(uint8_t x, uint8_t y)
 	cursor_y = y;
 }
 
-// bresenham's algorithm - thx wikpedia
-void LCDdrawline(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color)
+// bresenham's algorithm - thx wikpedia; any 16 bit coordinates, clipped
+// pixel by pixel by the canvas, never wrapped
+static void lineClipped(int16_t ax, int16_t ay, int16_t bx, int16_t by, uint8_t color)
 {
-	uint8_t steep = abs(y1 - y0) > abs(x1 - x0);
-	if (steep)
-	{
-		swap(x0, y0);
-		swap(x1, y1);
-	}
-
-	if (x0 > x1)
-	{
-		swap(x0, x1);
-		swap(y0, y1);
-	}
+	int16_t xmin = ax < bx ? ax : bx, xmax = ax < bx ? bx : ax;
+	int16_t ymin = ay < by ? ay : by, ymax = ay < by ? by : ay;
 
-	// much faster to put the test here, since we've already sorted the points
-	updateBoundingBox(x0, y0, x1, y1);
-
-	uint8_t dx, dy;
-	dx = x1 - x0;
-	dy = abs(y1 - y0);
-
-	int8_t err = dx / 2;
-	int8_t ystep;
-
-	if (y0 < y1)
-	{
-		ystep = 1;
-	} else
-	{
-		ystep = -1;
-	}
+	// nothing to draw when both ends are off the same side
+	if (xmax < 0 || ymax < 0 || xmin >= lcdW || ymin >= lcdH)
+		return;
+	updateBoundingBox(xmin < 0 ? 0 : xmin, ymin < 0 ? 0 : ymin,
+		xmax >= lcdW ? lcdW - 1 : xmax, ymax >= lcdH ? lcdH - 1 : ymax);
+	NOKIAdrawline(ax, ay, bx, by, color);
+}
 
-	for (; x0<=x1; x0++)
-	{
-		if (steep)
-		{
-			my_setpixel(y0, x0, color);
-		}
-		else
-		{
-			my_setpixel(x0, y0, color);
-		}
-		err -= dy;
-		if (err < 0)
-		{
-			y0 += ystep;
-			err += dx;
-		}
-	}
+void LCDdrawline(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color)
+{
+	lineClipped(x0, y0, x1, y1, color);
 }
 
 // filled rectangle
 void LCDfillrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h,  uint8_t color)
 {
-	// stupidest version - just pixels - but fast with internal buffer!
-	uint8_t i,j;
-	for ( i=x; i<x+w; i++)
-	{
-		for ( j=y; j<y+h; j++)
-		{
-			my_setpixel(i, j, color);
-		}
-	}
+	NOKIAfillrect(x, y, w, h, color);
 	updateBoundingBox(x, y, x+w, y+h);
 }
 
 // draw a rectangle
 void LCDdrawrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color)
 {
-	// stupidest version - just pixels - but fast with internal buffer!
-	uint8_t i;
-	for ( i=x; i<x+w; i++) {
-		my_setpixel(i, y, color);
-		my_setpixel(i, y+h-1, color);
-	}
-	for ( i=y; i<y+h; i++) {
-		my_setpixel(x, i, color);
-		my_setpixel(x+w-1, i, color);
-	}
+	// edges are 1 pixel blocks; the 8 bit wrap of y+h-1 / x+w-1 matches the
+	// old per-pixel loops for zero sized rectangles
+	NOKIAfillrect(x, y, w, 1, color);
+	NOKIAfillrect(x, (uint8_t)(y+h-1), w, 1, color);
+	NOKIAfillrect(x, y, 1, h, color);
+	NOKIAfillrect((uint8_t)(x+w-1), y, 1, h, color);
 
 	updateBoundingBox(x, y, x+w, y+h);
 }
@@ -754,31 +864,426 @@ void LCDfillcircle(uint8_t x0, uint8_t y0, uint8_t r, uint8_t color)
 	}
 }
 
+// sin of 0..90 degrees in Q14, the one table behind every angle the driver draws
+static const int16_t sinQ14[91] = {
+	    0,   286,   572,   857,  1143,  1428,  1713,  1997,  2280,  2563,
+	 2845,  3126,  3406,  3686,  3964,  4240,  4516,  4790,  5063,  5334,
+	 5604,  5872,  6138,  6402,  6664,  6924,  7182,  7438,  7692,  7943,
+	 8192,  8438,  8682,  8923,  9162,  9397,  9630,  9860, 10087, 10311,
+	10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+	12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+	14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+	15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+	16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+	16384,
+};
+
+int16_t LCDsin(int16_t deg)
+{
+	int16_t a = deg % 360;
+
+	if (a < 0)
+		a += 360;
+	if (a <= 90)
+		return sinQ14[a];
+	if (a <= 180)
+		return sinQ14[180 - a];
+	if (a <= 270)
+		return -sinQ14[a - 180];
+	return -sinQ14[360 - a];
+}
+
+int16_t LCDcos(int16_t deg)
+{
+	return LCDsin(deg + 90);
+}
+
+// offset of the point r pixels out at angle deg, rounded to the nearest pixel
+void LCDpolar(int16_t deg, int16_t r, int16_t *dx, int16_t *dy)
+{
+	*dx = ((int32_t)r * LCDsin(deg) + 8192) >> 14;
+	*dy = -(((int32_t)r * LCDcos(deg) + 8192) >> 14);
+}
+
+static uint16_t isqrt(uint32_t n)
+{
+	uint32_t root = 0, bit = 1UL << 30;
+
+	while (bit > n)
+		bit >>= 2;
+	while (bit)
+	{
+		if (n >= root + bit)
+		{
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+		bit >>= 2;
+	}
+	return root;
+}
+
+// Ring r0..r1 around (x0, y0) from a0 clockwise to a1, degrees from 12 o'clock.
+// A pixel is in the ring when its distance from the centre rounds to r0..r1
+// ((2r0-1)^2 <= 4d^2 < (2r1+1)^2, r0 = 0 takes the centre too) and inside the
+// sweep when it is clockwise of a0 and anticlockwise of a1. Each column works
+// out its rows from the ring by integer square root, walks the two half plane
+// tests down them with an add per row and writes the page bytes it built.
+void LCDfillarc(uint8_t x0, uint8_t y0, uint8_t r0, uint8_t r1, int16_t a0, int16_t a1, uint8_t color)
+{
+	int32_t s0 = LCDsin(a0), c0 = LCDcos(a0), s1 = LCDsin(a1), c1 = LCDcos(a1);
+	int32_t outer = (2 * r1 + 1) * (2 * r1 + 1), inner = (2 * r0 - 1) * (2 * r0 - 1);
+	int16_t sweep = a1 - a0, x, xs, xe, ys, ye;
+	uint8_t full = sweep >= 360, narrow = sweep <= 180;
+
+	if (sweep <= 0 || r0 > r1)
+		return;
+	xs = x0 - r1 < 0 ? 0 : x0 - r1;
+	xe = x0 + r1 >= lcdW ? lcdW - 1 : x0 + r1;
+	ys = y0 - r1 < 0 ? 0 : y0 - r1;
+	ye = y0 + r1 >= lcdH ? lcdH - 1 : y0 + r1;
+	if (xs > xe || ys > ye)
+		return;
+	updateBoundingBox(xs, ys, xe, ye);
+
+	for (x = xs; x <= xe; x++)
+	{
+		int32_t dx = x - x0, q = outer - 4 * dx * dx, p = inner - 4 * dx * dx;
+		int16_t ymax, ymin, lo[2], hi[2], span, y, page = -1;
+		uint8_t mask = 0;
+
+		if (q <= 0)
+			continue;
+		ymax = isqrt((q - 1) / 4);
+		ymin = r0 && p > 0 ? isqrt((p - 1) / 4) + 1 : 0;
+		if (ymin > ymax)
+			continue;
+		// rows above and below the centre, one span when they meet
+		lo[0] = y0 - ymax; hi[0] = y0 - ymin;
+		lo[1] = y0 + ymin; hi[1] = y0 + ymax;
+		if (ymin == 0)
+			hi[0] = hi[1];
+		for (span = 0; span < (ymin ? 2 : 1); span++)
+		{
+			int16_t top = lo[span] < ys ? ys : lo[span], bottom = hi[span] > ye ? ye : hi[span];
+			// clockwise of a0: s0*dy + c0*dx >= 0, anticlockwise of a1: -(s1*dy + c1*dx) >= 0
+			int32_t k0 = s0 * (top - y0) + c0 * dx, k1 = -(s1 * (top - y0) + c1 * dx);
+
+			for (y = top; y <= bottom; y++, k0 += s0, k1 -= s1)
+			{
+				if (!(full || (narrow ? (k0 >= 0 && k1 >= 0) : (k0 >= 0 || k1 >= 0))))
+					continue;
+				if (y / 8 != page)
+				{
+					if (page >= 0)
+					{
+						if (color)
+							pcd8544_buffer[page * lcdW + x] |= mask;
+						else
+							pcd8544_buffer[page * lcdW + x] &= ~mask;
+					}
+					page = y / 8;
+					mask = 0;
+				}
+				mask |= _BV(y % 8);
+			}
+		}
+		if (page >= 0)
+		{
+			if (color)
+				pcd8544_buffer[page * lcdW + x] |= mask;
+			else
+				pcd8544_buffer[page * lcdW + x] &= ~mask;
+		}
+	}
+}
+
+void LCDdrawarc(uint8_t x0, uint8_t y0, uint8_t r, int16_t a0, int16_t a1, uint8_t color)
+{
+	LCDfillarc(x0, y0, r, r, a0, a1, color);
+}
+
+// the line from r0 to r1 pixels out at angle deg
+void LCDdrawpolar(uint8_t x0, uint8_t y0, int16_t deg, uint8_t r0, uint8_t r1, uint8_t color)
+{
+	int16_t ax, ay, bx, by;
+
+	LCDpolar(deg, r0, &ax, &ay);
+	LCDpolar(deg, r1, &bx, &by);
+	lineClipped(x0 + ax, y0 + ay, x0 + bx, y0 + by, color);
+}
+
+// floor and ceiling of n / d for d > 0, whatever the sign of n
+static int32_t floorDiv(int32_t n, int32_t d)
+{
+	return n >= 0 ? n / d : -((d - 1 - n) / d);
+}
+
+static int32_t ceilDiv(int32_t n, int32_t d)
+{
+	return -floorDiv(-n, d);
+}
+
+// Polygon fill on vertices in 1/16 pixel. A pixel is inside when its centre
+// is, by the even-odd rule; a centre exactly on an edge counts as inside on
+// the top and left of a span and outside on the bottom and right, so shapes
+// sharing an edge neither overlap nor leave a gap. The screen is scanned
+// column by column, since a column is what a page byte holds: edges are
+// sorted by their first column and join the active list there, each keeps
+// the first row at or below its crossing as a quotient and remainder that
+// step with adds only, and the sorted rows pair up into vertical spans
+// written as masked page bytes. Vertices must be within +-LCD_POLY_RANGE,
+// which keeps every product inside 32 bits; a polygon with one outside it,
+// or with more than LCD_POLY_MAX vertices, is not drawn.
+void LCDfillpolygonQ4(const int16_t *xy, uint8_t n, uint8_t color)
+{
+	struct
+	{
+		int16_t xs, xe;             // first and last column crossed, clipped
+		int16_t q;                  // first row at or below the crossing
+		int32_t r, d;               // q * d - r is the crossing, d is 16 * dx
+		int16_t a;                  // q steps by a or a + 1 per column
+		int32_t b;                  // and r by -b, wrapping at d
+	} edge[LCD_POLY_MAX], t;
+	uint8_t act[LCD_POLY_MAX];
+	int16_t row[LCD_POLY_MAX];
+	int16_t x, xmin = lcdW, xmax = -1;
+	int16_t bx0 = lcdW, bx1 = -1, by0 = lcdH, by1 = -1;    // what was drawn
+	uint8_t edges = 0, next = 0, active = 0, i, j;
+
+	if (n < 3 || n > LCD_POLY_MAX)
+		return;
+	for (i = 0; i < 2 * n; i++)
+		if (xy[i] < -LCD_POLY_RANGE || xy[i] > LCD_POLY_RANGE)
+			return;
+
+	for (i = 0; i < n; i++)
+	{
+		int32_t x0 = xy[2 * i], y0 = xy[2 * i + 1], x1, y1, dx, dy, num;
+		int16_t xs, xe;
+
+		j = i + 1 < n ? i + 1 : 0;
+		x1 = xy[2 * j];
+		y1 = xy[2 * j + 1];
+		// upright edges meet no column centre
+		if (x0 == x1)
+			continue;
+		if (x0 > x1)
+		{
+			dx = x0; x0 = x1; x1 = dx;
+			dy = y0; y0 = y1; y1 = dy;
+		}
+		dx = x1 - x0;
+		dy = y1 - y0;
+		// columns whose centre 16x + 8 is in [x0, x1)
+		xs = ceilDiv(x0 - 8, 16);
+		xe = ceilDiv(x1 - 8, 16) - 1;
+		if (xs < 0)
+			xs = 0;
+		if (xe >= lcdW)
+			xe = lcdW - 1;
+		if (xs > xe)
+			continue;
+		// crossing at column xs is y0 + (16xs + 8 - x0) dy / dx, the first row
+		// with its centre at or below it is ceil((crossing - 8) / 16)
+		num = y0 * dx + (16 * xs + 8 - x0) * dy - 8 * dx;
+		t.xs = xs;
+		t.xe = xe;
+		t.d = 16 * dx;
+		t.q = ceilDiv(num, t.d);
+		t.r = t.q * t.d - num;
+		t.a = floorDiv(16 * dy, t.d);
+		t.b = 16 * dy - t.a * t.d;
+		// sorted by first column as they go in
+		for (j = edges; j > 0 && edge[j - 1].xs > xs; j--)
+			edge[j] = edge[j - 1];
+		edge[j] = t;
+		edges++;
+		if (xs < xmin)
+			xmin = xs;
+		if (xe > xmax)
+			xmax = xe;
+	}
+
+	for (x = xmin; x <= xmax; x++)
+	{
+		while (next < edges && edge[next].xs <= x)
+			act[active++] = next++;
+		// drop what ended, sort the rest by row
+		for (i = j = 0; i < active; i++)
+			if (edge[act[i]].xe >= x)
+				act[j++] = act[i];
+		active = j;
+		for (i = 0; i < active; i++)
+		{
+			int16_t q = edge[act[i]].q;
+			for (j = i; j > 0 && row[j - 1] > q; j--)
+				row[j] = row[j - 1];
+			row[j] = q;
+		}
+
+		for (i = 0; i + 1 < active; i += 2)
+		{
+			int16_t top = row[i] < 0 ? 0 : row[i], bottom = row[i + 1] > lcdH ? lcdH : row[i + 1];
+			uint8_t p;
+
+			if (top >= bottom)
+				continue;
+			if (x < bx0)
+				bx0 = x;
+			bx1 = x;
+			if (top < by0)
+				by0 = top;
+			if (bottom - 1 > by1)
+				by1 = bottom - 1;
+			for (p = top / 8; p <= (bottom - 1) / 8; p++)
+			{
+				uint8_t lo = top > p * 8 ? top - p * 8 : 0;
+				uint8_t hi = bottom < (p + 1) * 8 ? bottom - p * 8 : 8;
+				uint8_t mask = (0xFF << lo) & (0xFF >> (8 - hi));
+				if (color)
+					pcd8544_buffer[p * lcdW + x] |= mask;
+				else
+					pcd8544_buffer[p * lcdW + x] &= ~mask;
+			}
+		}
+		// on to the next column
+		for (i = 0; i < active; i++)
+		{
+			j = act[i];
+			edge[j].q += edge[j].a;
+			edge[j].r -= edge[j].b;
+			if (edge[j].r < 0)
+			{
+				edge[j].r += edge[j].d;
+				edge[j].q++;
+			}
+		}
+	}
+	if (bx0 <= bx1)
+		updateBoundingBox(bx0, by0, bx1, by1);
+}
+
+// vertices in whole pixels are pixel corners: (x, y) (x+w, y) (x+w, y+h)
+// (x, y+h) covers what LCDfillrect(x, y, w, h) does
+void LCDfillpolygon(const int16_t *xy, uint8_t n, uint8_t color)
+{
+	int16_t q4[2 * LCD_POLY_MAX];
+	uint8_t i;
+
+	if (n < 3 || n > LCD_POLY_MAX)
+		return;
+	for (i = 0; i < 2 * n; i++)
+	{
+		if (xy[i] < -LCD_POLY_RANGE / 16 || xy[i] > LCD_POLY_RANGE / 16)
+			return;
+		q4[i] = xy[i] * 16;
+	}
+	LCDfillpolygonQ4(q4, n, color);
+}
+
+void LCDfilltriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t color)
+{
+	int16_t xy[6];
+
+	xy[0] = x0; xy[1] = y0;
+	xy[2] = x1; xy[3] = y1;
+	xy[4] = x2; xy[5] = y2;
+	LCDfillpolygon(xy, 3, color);
+}
+
+// Outline, in 1/16 pixel, of a width pixel wide line between the centres of
+// pixels (x0, y0) and (x1, y1): the two sides, each half the width from the
+// centre line, closed by the caps. LCD_CAP_SQUARE reaches half the width past
+// each end, LCD_CAP_ROUND is a half circle there in 15 degree steps. Returns
+// the vertex count, at most LCD_POLY_MAX.
+uint8_t LCDthickOutline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, uint8_t cap, int16_t *xy)
+{
+	int32_t dx = x1 - x0, dy = y1 - y0, len, nx, ny, ex, ey;
+	int16_t ax = x0 * 16 + 8, ay = y0 * 16 + 8, bx = x1 * 16 + 8, by = y1 * 16 + 8;
+	uint8_t n = 0;
+	int16_t a;
+
+	if (x0 < -LCD_POLY_RANGE / 16 || x0 > LCD_POLY_RANGE / 16 || y0 < -LCD_POLY_RANGE / 16 ||
+		y0 > LCD_POLY_RANGE / 16 || x1 < -LCD_POLY_RANGE / 16 || x1 > LCD_POLY_RANGE / 16 ||
+		y1 < -LCD_POLY_RANGE / 16 || y1 > LCD_POLY_RANGE / 16)
+		return 0;
+	// a single point still gets its caps, lying along x
+	if (!dx && !dy)
+		dx = 1;
+	// length in 1/16 pixel, then the half width across (n) and along (e) the line
+	len = isqrt((uint32_t)(dx * dx + dy * dy) * 256);
+	nx = (-dy * 128 * width + (dy > 0 ? -len / 2 : len / 2)) / len;
+	ny = (dx * 128 * width + (dx < 0 ? -len / 2 : len / 2)) / len;
+	ex = ny;
+	ey = -nx;
+	if (x0 == x1 && y0 == y1 && cap == LCD_CAP_BUTT)
+		return 0;
+	if (cap == LCD_CAP_ROUND)
+	{
+		// from the left side round the far end to the right side, then back round the near end
+		for (a = 0; a <= 180; a += 15)
+		{
+			int32_t c = LCDcos(a), s = LCDsin(a);
+			xy[n++] = bx + ((nx * c + ex * s + 8192) >> 14);
+			xy[n++] = by + ((ny * c + ey * s + 8192) >> 14);
+		}
+		for (a = 0; a <= 180; a += 15)
+		{
+			int32_t c = LCDcos(a), s = LCDsin(a);
+			xy[n++] = ax - ((nx * c + ex * s + 8192) >> 14);
+			xy[n++] = ay - ((ny * c + ey * s + 8192) >> 14);
+		}
+		return n / 2;
+	}
+	if (cap != LCD_CAP_SQUARE)
+		ex = ey = 0;
+	xy[0] = bx + nx + ex; xy[1] = by + ny + ey;
+	xy[2] = bx - nx + ex; xy[3] = by - ny + ey;
+	xy[4] = ax - nx - ex; xy[5] = ay - ny - ey;
+	xy[6] = ax + nx - ex; xy[7] = ay + ny - ey;
+	return 4;
+}
+
+// width 1 is the plain line, wider ones are filled outlines
+void LCDdrawthickline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, uint8_t cap, uint8_t color)
+{
+	int16_t xy[2 * LCD_POLY_MAX];
+	uint8_t n;
+
+	if (width == 0)
+		return;
+	if (width == 1)
+	{
+		lineClipped(x0, y0, x1, y1, color);
+		return;
+	}
+	n = LCDthickOutline(x0, y0, x1, y1, width, cap, xy);
+	if (n)
+		LCDfillpolygonQ4(xy, n, color);
+}
+
 // the most basic function, set a single pixel
 void LCDsetPixel(uint8_t x, uint8_t y, uint8_t color)
 {
-	if ((x >= LCDWIDTH) || (y >= LCDHEIGHT))
+	if ((x >= lcdW) || (y >= lcdH))
 		return;
 
-	// x is which column
-	if (color)
-		pcd8544_buffer[x+ (y/8)*LCDWIDTH] |= _BV(y%8);
-	else
-		pcd8544_buffer[x+ (y/8)*LCDWIDTH] &= ~_BV(y%8);
+	NOKIAsetPixel(x, y, color);
 	updateBoundingBox(x,y,x,y);
 }
 
 // the most basic function, get a single pixel
 uint8_t LCDgetPixel(uint8_t x, uint8_t y)
 {
-	if ((x >= LCDWIDTH) || (y >= LCDHEIGHT))
-		return 0;
-
-	return (pcd8544_buffer[x+ (y/8)*LCDWIDTH] >> (7-(y%8))) & 0x1;
+	return NOKIAgetPixel(x, y);
 }
 
 void LCDspiwrite(uint8_t c)
 {
+	STATS_ADD(gpioWrites, 2);
 	digitalWrite(_cs, LOW);  //bugfix
 
 	shiftOut(_din, _sclk, MSBFIRST, c);
@@ -790,82 +1295,440 @@ void LCDspiwrite(uint8_t c)
 
 void LCDcommand(uint8_t c)
 {
+	STATS_ADD(commands, 1);
+	STATS_ADD(gpioWrites, 1);
 	digitalWrite( _dc, LOW);
 	LCDspiwrite(c);
 }
 
 void LCDdata(uint8_t c)
 {
+	STATS_ADD(dataBytes, 1);
+	STATS_ADD(gpioWrites, 1);
 	digitalWrite(_dc, HIGH);
 	LCDspiwrite(c);
 }
 
-void LCDsetContrast(uint8_t val)
+// command bytes with D/C set once and CS held low throughout, as LCDdataRun()
+void LCDcommandRun(const uint8_t *c, uint8_t n)
 {
-	if (val > 0x7f) {
-		val = 0x7f;
-	}
-	LCDcommand(PCD8544_FUNCTIONSET | PCD8544_EXTENDEDINSTRUCTION );
-	LCDcommand( PCD8544_SETVOP | val);
-	LCDcommand(PCD8544_FUNCTIONSET);
+	STATS_ADD(commands, n);
+	STATS_ADD(gpioWrites, 3);
+	digitalWrite(_dc, LOW);
+	digitalWrite(_cs, LOW);
+	while (n--)
+		shiftOut(_din, _sclk, MSBFIRST, *c++);
+	digitalWrite(_cs, HIGH);
 }
 
-void LCDdisplay(void)
+// a run of display RAM bytes with D/C set once and CS held low throughout,
+// three GPIO writes per run instead of per byte
+void LCDdataRun(const uint8_t *data, uint16_t n)
 {
-	uint8_t col, maxcol, p;
-
-	for(p = 0; p < 6; p++)
+	STATS_ADD(dataBytes, n);
+	STATS_ADD(gpioWrites, 3);
+	digitalWrite(_dc, HIGH);
+	digitalWrite(_cs, LOW);
+	if (byteHook)
 	{
-#ifdef enablePartialUpdate
-		// check if this page is part of update
-		if ( yUpdateMin >= ((p+1)*8) )
+		byteHook(1);
+		while (n--)
 		{
-			continue;   // nope, skip it!
+			shiftOut(_din, _sclk, MSBFIRST, *data++);
+			byteHook(0);
 		}
-		if (yUpdateMax < p*8)
+	}
+	else
+	{
+		while (n--)
+			shiftOut(_din, _sclk, MSBFIRST, *data++);
+	}
+	digitalWrite(_cs, HIGH);
+}
+
+void LCDsetByteHook(LCDbyteHook hook)
+{
+	byteHook = hook;
+}
+
+void LCDsetContrast(uint8_t val)
+{
+	NOKIAsetContrast(val);
+}
+
+// switch on a display LCDInit() left blank, once its RAM holds a whole frame
+int LCDunblank(void)
+{
+	if (!blanked)
+		return 0;
+	blanked = 0;
+	NOKIAshow();
+	return 1;
+}
+
+/*
+ * Orientation stage. The primitives draw in the caller's coordinates at full
+ * speed; only the part of the buffer being flushed is turned into the panel's
+ * layout. Mirroring reverses the columns (X) or the pages and the bits in each
+ * byte (Y), 180 is both, and 90 / 270 first transpose 8x8 blocks of bits so
+ * that a portrait column becomes a panel page.
+ */
+
+static inline uint64_t load64(const uint8_t *p)
+{
+	uint64_t x;
+	memcpy(&x, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	return x;
+}
+
+static inline void store64(uint8_t *p, uint64_t x, uint8_t n)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	x = __builtin_bswap64(x);
+#endif
+	memcpy(p, &x, n);
+}
+
+// 8x8 bit matrix transpose, bit i of byte j <-> bit j of byte i (Hacker's Delight 7-3)
+static inline uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x ^= t ^ (t << 28);
+	return x;
+}
+
+// two blocks at once in a 128 bit register (SSE2 / NEON), same steps
+#if (defined(__SSE2__) || defined(__ARM_NEON)) && !defined(PCD8544_NO_SIMD) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LCD_SIMD_TRANSPOSE
+typedef uint64_t u64x2 __attribute__((vector_size(16)));
+
+static inline u64x2 transpose8x2(u64x2 x)
+{
+	u64x2 t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x ^= t ^ (t << 28);
+	return x;
+}
+#endif
+
+// portrait frame -> panel layout before mirroring, for panel pages up0..up1
+// and portrait pages lp0..lp1 (panel columns 8*lp0 .. 8*lp1+7)
+static void transposeBlocks(const uint8_t *src, uint8_t *dst, uint8_t up0, uint8_t up1, uint8_t lp0, uint8_t lp1)
+{
+	uint8_t up, lp;
+
+	for (lp = lp0; lp <= lp1; lp++)
+	{
+		// eight portrait columns of page lp are one panel page's worth of bits;
+		// the last page holds rows 80-83 only
+		const uint8_t *row = src + lp * LCDHEIGHT;
+		uint8_t n = (lp * 8 + 8 <= LCDWIDTH) ? 8 : LCDWIDTH - lp * 8;
+
+		up = up0;
+#ifdef LCD_SIMD_TRANSPOSE
+		for (; up < up1; up += 2)
 		{
-			break;
+			u64x2 v;
+			memcpy(&v, row + up * 8, 16);
+			v = transpose8x2(v);
+			memcpy(dst + up * LCDWIDTH + lp * 8, &v, n);
+			memcpy(dst + (up + 1) * LCDWIDTH + lp * 8, (uint8_t *)&v + 8, n);
 		}
 #endif
+		for (; up <= up1; up++)
+			store64(dst + up * LCDWIDTH + lp * 8, transpose8(load64(row + up * 8)), n);
+	}
+}
 
-		LCDcommand(PCD8544_SETYADDR | p);
+// panel pages pp0..pp1, columns pc0..pc1 of the frame src drawn in the current
+// orientation; scratch holds the transposed blocks, one per thread that orients
+static void orient(const uint8_t *src, uint8_t *dst, uint8_t *scratch, uint8_t pp0, uint8_t pp1, uint8_t pc0, uint8_t pc1)
+{
+	const uint8_t *base = src;
+	uint8_t pp, pc;
 
+	if (transposed)
+	{
+		uint8_t up0 = flipY ? LCDHEIGHT/8 - 1 - pp1 : pp0, up1 = flipY ? LCDHEIGHT/8 - 1 - pp0 : pp1;
+		uint8_t uc0 = flipX ? LCDWIDTH - 1 - pc1 : pc0, uc1 = flipX ? LCDWIDTH - 1 - pc0 : pc1;
+		transposeBlocks(src, scratch, up0, up1, uc0 / 8, uc1 / 8);
+		base = scratch;
+	}
+	for (pp = pp0; pp <= pp1; pp++)
+	{
+		const uint8_t *row = base + (flipY ? LCDHEIGHT/8 - 1 - pp : pp) * LCDWIDTH;
+		uint8_t *out = dst + pp * LCDWIDTH;
+
+		if (!flipX && !flipY)
+			memcpy(out + pc0, row + pc0, pc1 - pc0 + 1);
+		else if (!flipY)
+			for (pc = pc0; pc <= pc1; pc++)
+				out[pc] = row[LCDWIDTH - 1 - pc];
+		else if (!flipX)
+			for (pc = pc0; pc <= pc1; pc++)
+				out[pc] = bitReverse[row[pc]];
+		else
+			for (pc = pc0; pc <= pc1; pc++)
+				out[pc] = bitReverse[row[LCDWIDTH - 1 - pc]];
+	}
+}
 
-#ifdef enablePartialUpdate
-		col = xUpdateMin;
-		maxcol = xUpdateMax;
-#else
-		// start at the beginning of the row
-		col = 0;
-		maxcol = LCDWIDTH-1;
+// a whole frame drawn in the current orientation, in the panel's layout
+void LCDorientFrame(const uint8_t *src, uint8_t *dst)
+{
+	orient(src, dst, unflipped, 0, LCDHEIGHT/8 - 1, 0, LCDWIDTH - 1);
+}
+
+void LCDsetOrientation(uint8_t o)
+{
+	// transpose, then mirror X / Y, for each quarter turn clockwise
+	static const uint8_t turns[4][3] = { { 0, 0, 0 }, { 1, 1, 0 }, { 0, 1, 1 }, { 1, 0, 1 } };
+
+	orientation = o & (3 | LCD_MIRROR_X | LCD_MIRROR_Y);
+	transposed = turns[o & 3][0];
+	flipX = turns[o & 3][1] ^ ((o & LCD_MIRROR_X) != 0);
+	flipY = turns[o & 3][2] ^ ((o & LCD_MIRROR_Y) != 0);
+	lcdW = transposed ? LCDHEIGHT : LCDWIDTH;
+	lcdH = transposed ? LCDWIDTH : LCDHEIGHT;
+	lcdPages = (lcdH + 7) / 8;
+	// what was drawn is laid out for the old orientation, and in its shape
+	NOKIAclear();
+	NOKIAsetPortrait(transposed);
+	LCDclear();
+}
+
+uint8_t LCDgetOrientation(void)
+{
+	return orientation;
+}
+
+uint8_t LCDwidth(void)
+{
+	return lcdW;
+}
+
+uint8_t LCDheight(void)
+{
+	return lcdH;
+}
+
+// send panel pages pp0..pp1, columns pc0..pc1 of frame
+static void sendPanel(const uint8_t *frame, uint8_t pp0, uint8_t pp1, uint8_t pc0, uint8_t pc1)
+{
+	uint8_t p;
+
+	for (p = pp0; p <= pp1; p++)
+	{
+		NOKIAaddress(p, pc0);
+		LCDdataRun(frame + p * LCDWIDTH + pc0, pc1 - pc0 + 1);
+	}
+	NOKIAfinish();  // no idea why this is necessary but it is to finish the last byte?
+}
+
+void LCDsetFlushHook(LCDflushHook hook)
+{
+	// the panel may hold anything drawn before, the first frame is all of it
+	if (hook && !flushHook)
+		shownFresh = 1;
+	flushHook = hook;
+}
+
+void LCDsetStatsLock(LCDlockHook hook)
+{
+	statsLock = hook;
+}
+
+// the rectangle [x, x+w) x [y, y+h) of the drawing as panel pages and
+// columns, clipped; 0 if nothing of it is on the screen
+static int panelRect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t *pp0, uint8_t *pp1, uint8_t *pc0, uint8_t *pc1)
+{
+	uint16_t x1, y1;
+	uint8_t px0, px1, py0, py1, t;
+
+	if (x >= lcdW || y >= lcdH || !w || !h)
+		return 0;
+	x1 = x + w;
+	y1 = y + h;
+	if (x1 > lcdW)
+		x1 = lcdW;
+	if (y1 > lcdH)
+		y1 = lcdH;
+	// the same rectangle on the panel
+	if (transposed)
+	{
+		px0 = y; px1 = y1 - 1;
+		py0 = x; py1 = x1 - 1;
+	}
+	else
+	{
+		px0 = x; px1 = x1 - 1;
+		py0 = y; py1 = y1 - 1;
+	}
+	if (flipX)
+	{
+		t = px0;
+		px0 = LCDWIDTH - 1 - px1;
+		px1 = LCDWIDTH - 1 - t;
+	}
+	if (flipY)
+	{
+		t = py0;
+		py0 = LCDHEIGHT - 1 - py1;
+		py1 = LCDHEIGHT - 1 - t;
+	}
+	*pp0 = py0 / 8;
+	*pp1 = py1 / 8;
+	*pc0 = px0;
+	*pc1 = px1;
+	return 1;
+}
+
+// the drawing thread's half of a flush: stops the rasterization clock and
+// gives the flush hook what src puts on the panel. A frame sent from another
+// thread with LCDdisplayBuffer() is handed over here, so that thread never
+// touches the clock, the hook or what the hook is shown
+void LCDhandover(const uint8_t *src, uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+	uint8_t pp0, pp1, pc0, pc1;
+
+#ifndef PCD8544_NO_STATS
+	if (composing)
+		stats.rasterNs += statsNow() - composeStart;
+	composing = 0;
 #endif
+	if (!flushHook)
+		return;
+	if (shownFresh)
+	{
+		x = y = 0;
+		w = lcdW;
+		h = lcdH;
+	}
+	if (!panelRect(x, y, w, h, &pp0, &pp1, &pc0, &pc1))
+		return;
+	shownFresh = 0;
+	orient(src, shown, shownUnflipped, pp0, pp1, pc0, pc1);
+	flushHook(shown);
+}
 
-		LCDcommand(PCD8544_SETXADDR | col);
+// flush the rectangle [x, x+w) x [y, y+h) of the drawing, whole pages high
+void LCDdisplayRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+	LCDhandover(pcd8544_buffer, x, y, w, h);
+	LCDdisplayBuffer(pcd8544_buffer, x, y, w, h);
+}
 
-		for(; col <= maxcol; col++) {
-			//uart_putw_dec(col);
-			//uart_putchar(' ');
-			LCDdata(pcd8544_buffer[(LCDWIDTH*p)+col]);
-		}
+// the same from a copy of the drawing, laid out as pcd8544_buffer, so another
+// thread can send a frame while the next one is drawn. This is the bus side
+// only: the thread that drew the frame calls LCDhandover() for it
+void LCDdisplayBuffer(const uint8_t *src, uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+	uint8_t pp0, pp1, pc0, pc1;
+	const uint8_t *frame = src;
+#ifndef PCD8544_NO_STATS
+	uint64_t flushStart = statsNow();
+#endif
+
+	// a blank panel holds noise, its first frame is the whole of it
+	if (blanked)
+	{
+		x = y = 0;
+		w = lcdW;
+		h = lcdH;
 	}
+	if (!panelRect(x, y, w, h, &pp0, &pp1, &pc0, &pc1))
+		return;
+	if (orientation)
+	{
+		orient(src, panel, unflipped, pp0, pp1, pc0, pc1);
+		frame = panel;
+	}
+#ifndef PCD8544_NO_STATS
+	stats.orientNs += statsNow() - flushStart;
+#endif
+	sendPanel(frame, pp0, pp1, pc0, pc1);
+	LCDunblank();
+
+#ifndef PCD8544_NO_STATS
+	uint64_t ns = statsNow() - flushStart;
+	uint32_t us = ns / 1000;
+	uint8_t bucket = us ? 31 - __builtin_clz(us) : 0;
+	if (bucket >= LCD_HIST_BUCKETS)
+		bucket = LCD_HIST_BUCKETS - 1;
+	stats.frames++;
+	stats.pagesSkipped += LCDHEIGHT/8 - (pp1 - pp0 + 1);
+	stats.transferNs += ns;
+	stats.lastFlushUs = us;
+	if (us > stats.maxFlushUs)
+		stats.maxFlushUs = us;
+	stats.flushHist[bucket]++;
+	if (!stats.firstFrameUs && !splashing && bootOrigin)
+		stats.firstFrameUs = (statsNow() - bootOrigin) / 1000;
+#endif
+}
 
-	LCDcommand(PCD8544_SETYADDR );  // no idea why this is necessary but it is to finish the last byte?
+void LCDdisplay(void)
+{
 #ifdef enablePartialUpdate
-	xUpdateMin = LCDWIDTH - 1;
+	// only what the primitives touched since the last flush
+	if (xUpdateMin <= xUpdateMax && yUpdateMin <= yUpdateMax)
+		LCDdisplayRegion(xUpdateMin, yUpdateMin, xUpdateMax - xUpdateMin + 1, yUpdateMax - yUpdateMin + 1);
+	xUpdateMin = lcdW - 1;
 	xUpdateMax = 0;
-	yUpdateMin = LCDHEIGHT-1;
+	yUpdateMin = lcdH - 1;
 	yUpdateMax = 0;
+#else
+	LCDdisplayRegion(0, 0, lcdW, lcdH);
 #endif
+}
 
+// copy out the driver counters (all zero when built with PCD8544_NO_STATS),
+// with the bus held if another thread sends the frames
+void LCDgetStats(LCDstats *s)
+{
+	if (statsLock)
+		statsLock(1);
+	*s = stats;
+	if (statsLock)
+		statsLock(0);
+}
+
+// counters back to zero; the bring-up times happen once and stay
+void LCDresetStats(void)
+{
+	uint32_t startUs, initUs, firstFrameUs;
+
+	if (statsLock)
+		statsLock(1);
+	startUs = stats.startUs;
+	initUs = stats.initUs;
+	firstFrameUs = stats.firstFrameUs;
+	memset(&stats, 0, sizeof(stats));
+	stats.startUs = startUs;
+	stats.initUs = initUs;
+	stats.firstFrameUs = firstFrameUs;
+	if (statsLock)
+		statsLock(0);
 }
 
 // clear everything
 void LCDclear(void) {
-	//memset(pcd8544_buffer, 0, LCDWIDTH*LCDHEIGHT/8);
-	uint32_t i;
-	for ( i = 0; i < LCDWIDTH*LCDHEIGHT/8 ; i++)
-		pcd8544_buffer[i] = 0;
-	updateBoundingBox(0, 0, LCDWIDTH-1, LCDHEIGHT-1);
+	NOKIAclear();
+	updateBoundingBox(0, 0, lcdW-1, lcdH-1);
 	cursor_y = cursor_x = 0;
 }
 
@@ -876,6 +1739,7 @@ void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val)
 	uint8_t i;
 	uint32_t j;
 
+	STATS_ADD(gpioWrites, 24);
 	for (i = 0; i < 8; i++)  {
 		if (bitOrder == LSBFIRST)
 			digitalWrite(dataPin, !!(val & (1 << i)));
@@ -21,6 +21,9 @@ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
 Lesser General Public License for more details.
 ================================================================================
  */
+#ifndef PCD8544_H
+#define PCD8544_H
+
 #include <stdint.h>
 
 #define BLACK 1
@@ -29,6 +32,29 @@ Lesser General Public License for more details.
 #define LCDWIDTH 84
 #define LCDHEIGHT 48
 
+// orientation of the drawing on the panel, applied when flushing: a rotation
+// (clockwise) and optional mirrors along the panel's own axes. Rotated by 90 or
+// 270 the drawing coordinates are portrait, LCDwidth() x LCDheight() = 48 x 84.
+#define LCD_ROTATE_0 0
+#define LCD_ROTATE_90 1
+#define LCD_ROTATE_180 2
+#define LCD_ROTATE_270 3
+#define LCD_MIRROR_X 4          // left to right
+#define LCD_MIRROR_Y 8          // top to bottom
+
+// frame buffer bytes: 6 pages of 84 columns, or 11 pages of 48 in portrait
+#define LCDBUFSIZE (LCDHEIGHT * ((LCDWIDTH + 7) / 8))
+
+// polygons: vertices at most, and how far off the screen one may be in 1/16
+// pixel (+-1023 pixels) with the rasterizer's math still in 32 bits
+#define LCD_POLY_MAX 32
+#define LCD_POLY_RANGE 16383
+
+// thick line ends
+#define LCD_CAP_BUTT 0          // square, at the end point
+#define LCD_CAP_SQUARE 1        // square, half the width past it
+#define LCD_CAP_ROUND 2
+
 #define PCD8544_POWERDOWN 0x04
 #define PCD8544_ENTRYMODE 0x02
 #define PCD8544_EXTENDEDINSTRUCTION 0x01
@@ -55,19 +81,84 @@ Lesser General Public License for more details.
 #define CLKCONST_1  8000
 #define CLKCONST_2  400  // 400 is a good tested value for Raspberry Pi
 
+// RST low time in LCDInit(): the datasheet asks for 100 ns, this leaves room
+// for slow edges on long wires. RST has to go low within 30 ms of power up.
+#define LCD_RESET_US 10
+
 // keywords
 #define LSBFIRST  0
 #define MSBFIRST  1
 
+// driver instrumentation, always on unless built with -DPCD8544_NO_STATS
+#define LCD_HIST_BUCKETS 16     // flush latency bucket i counts flushes of [2^i, 2^(i+1)) us
+
+typedef struct
+{
+	uint32_t frames;            // LCDdisplay() calls
+	uint32_t dataBytes;         // display RAM bytes sent
+	uint32_t commands;          // command bytes sent
+	uint32_t pagesSkipped;      // pages left out by partial updates
+	uint64_t gpioWrites;        // GPIO level writes on the bit-banged bus
+	uint64_t rasterNs;          // first drawing call of a frame until its flush
+	uint64_t transferNs;        // time spent inside LCDdisplay()
+	uint64_t orientNs;          // of it, turning the buffer into the panel's orientation
+	uint32_t lastFlushUs;
+	uint32_t maxFlushUs;
+	uint32_t flushHist[LCD_HIST_BUCKETS];
+	// bring-up, kept by LCDresetStats(); process start is known to a clock tick
+	uint32_t startUs;           // process start until LCDInit()
+	uint32_t initUs;            // LCDInit() itself
+	uint32_t firstFrameUs;      // process start until the first frame other than the splash is on the panel
+} LCDstats;
+
+// called on the drawing thread as each flush is handed over, with the panel's
+// whole display RAM as it is once sent, 6 pages of 84 columns
+typedef void (*LCDflushHook)(const uint8_t *panel);
+
+// called with lock 1 before LCDgetStats() / LCDresetStats() touch the counters, 0 after
+typedef void (*LCDlockHook)(uint8_t lock);
+
+// called with start 1 as a run of display RAM bytes begins, then with 0 after each byte
+typedef void (*LCDbyteHook)(uint8_t start);
+
+// frame buffer (pages of LCDwidth() columns, bit 0 = top row of a page) and 5x8 font
+extern uint8_t pcd8544_buffer[LCDBUFSIZE];
+extern const uint8_t pcd8544_font[];
+
  void LCDInit(uint8_t SCLK, uint8_t DIN, uint8_t DC, uint8_t CS, uint8_t RST, uint8_t contrast);
  void LCDcommand(uint8_t c);
+ void LCDcommandRun(const uint8_t *c, uint8_t n);
  void LCDdata(uint8_t c);
+ void LCDdataRun(const uint8_t *data, uint16_t n);
  void LCDsetContrast(uint8_t val);
+ int LCDunblank(void);                           // after a whole frame written without LCDdisplay(), 1 if it was blank
  void LCDclear();
  void LCDdisplay();
+ void LCDdisplayRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
+ void LCDdisplayBuffer(const uint8_t *src, uint8_t x, uint8_t y, uint8_t w, uint8_t h);   // from a copy of pcd8544_buffer, the bus side only
+ void LCDhandover(const uint8_t *src, uint8_t x, uint8_t y, uint8_t w, uint8_t h);        // the drawing side of it, before the copy is sent
+ void LCDsetOrientation(uint8_t orientation);    // LCD_ROTATE_* | LCD_MIRROR_*, clears the buffer
+ void LCDorientFrame(const uint8_t *src, uint8_t *dst);
+ uint8_t LCDgetOrientation(void);
+ uint8_t LCDwidth(void);
+ uint8_t LCDheight(void);
+ void LCDsetFlushHook(LCDflushHook hook);        // NULL to remove, e.g. STREAMframe in pcd8544_stream.h
+ void LCDsetByteHook(LCDbyteHook hook);          // NULL to remove, e.g. the timing in pcd8544_rt.c
+ void LCDsetStatsLock(LCDlockHook hook);        // while another thread flushes, e.g. pcd8544_rt.c
  void LCDsetPixel(uint8_t x, uint8_t y, uint8_t color);
  uint8_t LCDgetPixel(uint8_t x, uint8_t y);
  void LCDfillcircle(uint8_t x0, uint8_t y0, uint8_t r,uint8_t color);
+ int16_t LCDsin(int16_t deg);                   // Q14, from a 91 entry table
+ int16_t LCDcos(int16_t deg);
+ void LCDpolar(int16_t deg, int16_t r, int16_t *dx, int16_t *dy);    // degrees clockwise from 12 o'clock
+ void LCDdrawarc(uint8_t x0, uint8_t y0, uint8_t r, int16_t a0, int16_t a1, uint8_t color);
+ void LCDfillarc(uint8_t x0, uint8_t y0, uint8_t r0, uint8_t r1, int16_t a0, int16_t a1, uint8_t color);
+ void LCDdrawpolar(uint8_t x0, uint8_t y0, int16_t deg, uint8_t r0, uint8_t r1, uint8_t color);
+ void LCDfillpolygon(const int16_t *xy, uint8_t n, uint8_t color);       // x y pairs, pixel corners
+ void LCDfillpolygonQ4(const int16_t *xy, uint8_t n, uint8_t color);     // x y pairs in 1/16 pixel
+ void LCDfilltriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t color);
+ uint8_t LCDthickOutline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, uint8_t cap, int16_t *xy);
+ void LCDdrawthickline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, uint8_t cap, uint8_t color);
  void LCDdrawcircle(uint8_t x0, uint8_t y0, uint8_t r,uint8_t color);
  void LCDdrawrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h,uint8_t color);
  void LCDfillrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h,uint8_t color);
@@ -75,6 +166,7 @@ Lesser General Public License for more details.
  void LCDsetCursor(uint8_t x, uint8_t y);
  void LCDsetTextSize(uint8_t s);
  void LCDsetTextColor(uint8_t c);
+ uint8_t LCDgetTextColor(void);
  void LCDwrite(uint8_t c);
  void LCDshowLogo();
  void LCDdrawchar(uint8_t x, uint8_t line, char c);
@@ -84,3 +176,7 @@ Lesser General Public License for more details.
  void LCDspiwrite(uint8_t c);
  void shiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val);
  void _delay_ms(uint32_t t);
+ void LCDgetStats(LCDstats *stats);
+ void LCDresetStats(void);
+
+#endif
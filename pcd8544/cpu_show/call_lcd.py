@@ -16,6 +16,8 @@
 # lcdSetTextSize(int size)
 # lcdSetContrast(int contrast)
 # lcdSetCursor(int x, int y)
+# lcdStats() returns dict of driver counters / flush latency histogram
+# lcdResetStats() - zero the driver counters
 #########################################################
 
 import sys,time
@@ -1,7 +1,50 @@
 #!/bin/bash
+# The LCD* drawing and controller commands are the C++ panel template's Nokia5110; built
+# once with g++ (position independent for lcd.so, no C++ runtime needed) and linked into all.
+# It uses none of the template's GPIO, so it is built on the stub's header and needs no wiringPi
+echo "Building pcd8544_nokia.o"
+g++ -O2 -fPIC -fno-exceptions -fno-rtti -DPCD8544_GPIO_SIM -c -o pcd8544_nokia.o pcd8544_nokia.cpp
+
 # Compile the main cpushow executable
 echo "Building cpushow"
-gcc -o cpushow pcd8544_rpi.c PCD8544.c  -L/usr/local/lib -lwiringPi
+gcc -o cpushow pcd8544_rpi.c PCD8544.c pcd8544_nokia.o  -L/usr/local/lib -lwiringPi
+
+# Compile the LCD display server, which owns the panel and lets several clients share it
+echo "Building lcdd"
+gcc -o lcdd lcdd.c PCD8544.c pcd8544_nokia.o pcd8544_stream.c pcd8544_rt.c  -L/usr/local/lib -lwiringPi -lpthread
+
+# Compile the live vehicle dashboard, which reads the OBD collector's metric bus
+echo "Building lcddash"
+gcc -o lcddash lcddash.c PCD8544.c pcd8544_nokia.o lcdd_client.c ../../native/metricbus.c  -L/usr/local/lib -lwiringPi -lrt
+
+# Compile the driver benchmark / reference checker against the counting GPIO stub
+# (needs neither wiringPi nor a panel, so it also runs on a desktop Linux box)
+echo "Building pcd8544_bench"
+gcc -O2 -DPCD8544_GPIO_SIM -o pcd8544_bench pcd8544_bench.c pcd8544_ref.c pcd8544_dial.c pcd8544_text.c pcd8544_term.c pcd8544_sim.c PCD8544.c pcd8544_nokia.o
+
+# Compile the grayscale mode check / refresh report, against the stub and for the panel
+echo "Building graybench"
+gcc -O2 -DPCD8544_GPIO_SIM -o graybench graybench.c pcd8544_gray.c pcd8544_sim.c PCD8544.c pcd8544_nokia.o -lpthread -lm
+gcc -O2 -o graybench_panel graybench.c pcd8544_gray.c PCD8544.c pcd8544_nokia.o  -L/usr/local/lib -lwiringPi -lpthread -lm
+
+# Compile the remote mirror viewer and its check / size report (stub, no panel needed)
+echo "Building lcdview and streambench"
+gcc -O2 -o lcdview lcdview.c pcd8544_stream.c
+gcc -O2 -DPCD8544_GPIO_SIM -o streambench streambench.c pcd8544_stream.c pcd8544_sim.c PCD8544.c pcd8544_nokia.o -lpthread
+
+# Compile the header-only C++ panel driver's check / benchmark against PCD8544.c (stub, no panel needed)
+echo "Building panelbench"
+gcc -O2 -DPCD8544_GPIO_SIM -c -o panelbench_lcd.o PCD8544.c
+gcc -O2 -DPCD8544_GPIO_SIM -c -o panelbench_sim.o pcd8544_sim.c
+g++ -O2 -DPCD8544_GPIO_SIM -o panelbench panelbench.cpp panelbench_lcd.o panelbench_sim.o pcd8544_nokia.o
+rm -f panelbench_lcd.o panelbench_sim.o
+
+# Compile the real-time transmit mode check / jitter report (stub, no panel needed); PCD8544.c
+# is built without -O as it is for the panel, so a byte takes about as long as on the Pi
+echo "Building rtbench"
+gcc -DPCD8544_GPIO_SIM -c -o rtbench_lcd.o PCD8544.c
+gcc -O2 -DPCD8544_GPIO_SIM -o rtbench rtbench.c pcd8544_rt.c pcd8544_sim.c rtbench_lcd.o pcd8544_nokia.o -lpthread
+rm -f rtbench_lcd.o
 
 # Compile a shard object library that can be used in Python - may need to change location of Python libraries
 # depending on version of Python installed
@@ -18,10 +61,13 @@ if [ "$VER" != "NONE" ]
 then
   echo "Found Python version : "$VER
   echo "Building Shared Object Library lcd.so"
-  gcc -shared -I /usr/include/$VER/ -l$VER -o lcd.so pcd8544_rpi_py.c PCD8544.c  -L/usr/local/lib -lwiringPi
-  echo "Installing Shared Object Library lcd.so"
+  gcc -shared -I /usr/include/$VER/ -l$VER -o lcd.so pcd8544_rpi_py.c PCD8544.c pcd8544_gray.c pcd8544_stream.c pcd8544_dial.c pcd8544_text.c pcd8544_term.c pcd8544_rt.c pcd8544_nokia.o  -L/usr/local/lib -lwiringPi -lpthread
+  echo "Building Shared Object Library lcdc.so (lcdd client)"
+  gcc -shared -I /usr/include/$VER/ -l$VER -o lcdc.so lcdd_py.c lcdd_client.c
+  echo "Installing Shared Object Libraries lcd.so lcdc.so"
   mkdir -p /usr/local/lib/lcd
-  cp -fp lcd.so /usr/local/lib/lcd/.
+  cp -fp lcd.so lcdc.so /usr/local/lib/lcd/.
 else
   echo "Python.h Library not found - Python 2.7 recommended"
 fi
+rm -f pcd8544_nokia.o
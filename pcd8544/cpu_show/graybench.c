@@ -0,0 +1,259 @@
+/*
+=================================================================================
+ Name        : graybench.c
+ Version     : 0.1
+
+ Description : Grayscale mode check and refresh report.
+     Built against the counting GPIO stub (-DPCD8544_GPIO_SIM) it first
+     checks that every plane the panel receives is the dithered surface,
+     pixel for pixel, also with the panel turned 180 and mirrored, and that
+     a commit only shows from the next cycle. Then
+     it runs the refresh thread for -t seconds while redrawing a screen of
+     gray gauges ten times a second, and reports the plane rate achieved,
+     bytes per plane against a full frame, how much of the time the bus was
+     busy, and how late the wakeups were. Built with wiringPi the same run
+     drives the panel.
+
+     graybench [-r planes/s] [-t seconds] [-k bus kHz] [-s seed]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef PCD8544_GPIO_SIM
+#include "pcd8544_sim.h"
+#else
+#include <wiringPi.h>
+#endif
+#include "PCD8544.h"
+#include "pcd8544_gray.h"
+
+#define BUFSIZE (LCDWIDTH * LCDHEIGHT / 8)
+
+// pin setup, as pcd8544_rpi.c
+static int _sclk = 0;
+static int _din = 1;
+static int _dc = 2;
+static int _cs = 3;
+static int _rst = 4;
+
+static uint32_t rng = 1;
+
+static uint32_t rnd(void)
+{
+	// xorshift32, repeatable with -s
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static double nowSec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef PCD8544_GPIO_SIM
+// what plane k must hold, worked out a pixel at a time
+static int checkPlane(int k, const uint8_t *levels)
+{
+	const uint8_t *ram = SIMram();
+	uint8_t o = LCDgetOrientation();
+	int x, y;
+
+	for (y = 0; y < LCDHEIGHT; y++)
+		for (x = 0; x < LCDWIDTH; x++)
+		{
+			// where a panel turned 180 or mirrored shows the pixel
+			int px = ((o & LCD_ROTATE_180) != 0) ^ ((o & LCD_MIRROR_X) != 0) ? LCDWIDTH - 1 - x : x;
+			int py = ((o & LCD_ROTATE_180) != 0) ^ ((o & LCD_MIRROR_Y) != 0) ? LCDHEIGHT - 1 - y : y;
+			int on = (k + (x + y) % 3) % 3 < levels[y * LCDWIDTH + x];
+			int got = (ram[(py / 8) * LCDWIDTH + px] >> (py % 8)) & 1;
+			if (on != got)
+			{
+				printf("plane %d: pixel %d,%d level %d is %d, expected %d\n", k, x, y, levels[y * LCDWIDTH + x], got, on);
+				return 1;
+			}
+		}
+	return 0;
+}
+
+static int checkGray(int surfaces)
+{
+	static uint8_t levels[LCDWIDTH * LCDHEIGHT], before[LCDWIDTH * LCDHEIGHT];
+	int s, k, i, x, y;
+
+	// start from a white surface shown in full, synced to the top of a cycle
+	GRAYclear(0);
+	GRAYcommit();
+	while (GRAYtick() != 0)
+		;
+	while (GRAYtick() != GRAY_PHASES - 1)
+		;
+	memset(before, 0, sizeof(before));
+	for (s = 0; s < surfaces; s++)
+	{
+		// random blocks of each level, some single pixels, a string painted on top
+		GRAYclear(rnd() % GRAY_LEVELS);
+		for (i = 0; i < 8; i++)
+			GRAYfillrect(rnd() % LCDWIDTH, rnd() % LCDHEIGHT, rnd() % 40, rnd() % 24, rnd() % GRAY_LEVELS);
+		for (i = 0; i < 50; i++)
+			GRAYsetPixel(rnd() % LCDWIDTH, rnd() % LCDHEIGHT, rnd() % GRAY_LEVELS);
+		LCDclear();
+		LCDdrawstring(rnd() % 40, rnd() % 40, "GRAY");
+		GRAYfromMono(rnd() % GRAY_LEVELS);
+		for (y = 0; y < LCDHEIGHT; y++)
+			for (x = 0; x < LCDWIDTH; x++)
+				levels[y * LCDWIDTH + x] = GRAYgetPixel(x, y);
+
+		// committed mid-cycle, the rest of the cycle is still the old surface
+		k = GRAYtick();
+		if (checkPlane(k, before))
+			return 1;
+		GRAYcommit();
+		while ((k = GRAYtick()) != 0)
+			if (checkPlane(k, before))
+				return 1;
+		if (checkPlane(k, levels))
+			return 1;
+		for (i = 1; i < 2 * GRAY_PHASES; i++)
+			if (checkPlane(GRAYtick(), levels))
+				return 1;
+		memcpy(before, levels, sizeof(before));
+	}
+	printf("%d surfaces, orientation %d: every plane matches the per-pixel dither\n", surfaces, LCDgetOrientation());
+	return 0;
+}
+#endif
+
+// the kind of screen the dashboard shows: labels, gray bar backgrounds,
+// bars in black over a dark gray track, a light gray band for the warning zone
+static void drawScene(double t)
+{
+	static const char *labels[4] = { "RPM", "SPD", "ECT", "TPS" };
+	int g;
+
+	GRAYclear(0);
+	LCDclear();
+	for (g = 0; g < 4; g++)
+	{
+		int y = g * 12, fill = (int)(30 * (1 + sin(t * (g + 1) * 0.7)));
+
+		LCDdrawstring(0, y + 2, (char *)labels[g]);
+		GRAYfillrect(20, y + 2, 60, 8, 1);
+		GRAYfillrect(68, y + 2, 12, 8, 2);
+		GRAYfillrect(20, y + 2, fill, 8, 3);
+	}
+	GRAYfromMono(3);
+	GRAYcommit();
+}
+
+int main(int argc, char **argv)
+{
+	int hz = 200, seconds = 5, kHz = 1000, opt, i;
+	double start, t;
+	GRAYstats st;
+
+	while ((opt = getopt(argc, argv, "r:t:k:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'r': hz = atoi(optarg); break;
+		case 't': seconds = atoi(optarg); break;
+		case 'k': kHz = atoi(optarg); break;
+		case 's': rng = strtoul(optarg, NULL, 0); if (!rng) rng = 1; break;
+		default:
+			hz = 0;
+			break;
+		}
+	}
+	if (hz <= 0 || hz > 65535 || seconds <= 0 || kHz <= 0)
+	{
+		fprintf(stderr, "usage: %s [-r planes/s] [-t seconds] [-k bus kHz] [-s seed]\n", argv[0]);
+		return 2;
+	}
+
+#ifdef PCD8544_GPIO_SIM
+	SIMinit(_sclk, _din, _dc, _cs, _rst);
+#else
+	if (wiringPiSetup() == -1)
+	{
+		fprintf(stderr, "graybench: wiringPi setup failed\n");
+		return 1;
+	}
+#endif
+	LCDInit(_sclk, _din, _dc, _cs, _rst, 45);
+	LCDclear();
+	LCDdisplay();
+#ifdef PCD8544_GPIO_SIM
+	if (checkGray(200))
+	{
+		printf("gray check FAILED\n");
+		return 1;
+	}
+	LCDsetOrientation(LCD_ROTATE_180);
+	if (checkGray(50) || (LCDsetOrientation(LCD_MIRROR_X), checkGray(50)))
+	{
+		printf("gray check FAILED\n");
+		return 1;
+	}
+	LCDsetOrientation(LCD_ROTATE_90);
+	if (GRAYstart(hz) == 0)
+	{
+		printf("gray check FAILED: started in portrait\n");
+		return 1;
+	}
+	LCDsetOrientation(LCD_ROTATE_0);
+#endif
+
+	GRAYresetStats();
+	if (GRAYstart(hz) < 0)
+	{
+		fprintf(stderr, "graybench: cannot start the refresh thread\n");
+		return 1;
+	}
+	start = nowSec();
+	for (i = 0; (t = nowSec() - start) < seconds; i++)
+	{
+		drawScene(t);
+		usleep(100000);
+	}
+	GRAYgetStats(&st);
+	GRAYstop();
+
+	double secs = st.elapsedNs / 1e9, frames = st.frames ? st.frames : 1;
+	double perPlane = (st.dataBytes + st.cmdBytes) / frames;
+	double fullUs = (BUFSIZE + 13) * 8 * 1000.0 / kHz, diffUs = perPlane * 8 * 1000.0 / kHz;
+
+	printf("target %d planes/s, achieved %.1f planes/s = %.1f gray frames/s over %.1f s (%u surfaces)\n",
+		hz, st.frames / secs, st.cycles / secs, secs, st.commits);
+	printf("per plane %.1f data + %.1f command bytes, %.1f of %d unchanged and skipped\n",
+		st.dataBytes / frames, st.cmdBytes / frames, st.bytesSkipped / frames, BUFSIZE);
+	printf("bus busy %.2f%% of the time (%.1f us per plane in the driver)\n",
+		st.busyNs * 100.0 / st.elapsedNs, st.busyNs / frames / 1000);
+	printf("at a %d kHz bus clock: %.0f us per plane, %.1f%% utilisation, %.0f planes/s at most (%.0f sending whole frames)\n",
+		kHz, diffUs, diffUs * st.frames / secs / 1e4, 1e6 / diffUs, 1e6 / fullUs);
+	printf("wakeup lateness: max %u us, %u overruns, histogram", st.maxLateUs, st.overruns);
+	for (i = 0; i < GRAY_HIST_BUCKETS; i++)
+		if (st.lateHist[i])
+			printf(" <%uus:%u", 2u << i, st.lateHist[i]);
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,487 @@
+/*
+=================================================================================
+ Name        : lcdd.c
+ Version     : 0.1
+
+ Description : LCD display server. Owns the PCD8544 panel exclusively so
+     cpushow, the telemetry script and anything else can share it without
+     interleaving their bit-banged frames. Clients send batched draw commands
+     over a SOCK_SEQPACKET Unix socket (see lcdd_proto.h); each gets its own
+     canvas, screen region and priority. Flushes from all clients are
+     coalesced into at most one composed frame per refresh tick, and a frame
+     identical to the one on the glass is not sent at all.
+
+     Usage: lcdd [-s socket] [-r fps] [-c contrast] [-o degrees] [-m axis] [-R target] [-F fps] [-T cpu[:prio]] [-S secs] [-f]
+       -s socket   socket path (default /var/run/lcdd.sock)
+       -r fps      maximum refresh rate (default 20)
+       -c contrast initial contrast (default 60)
+       -o degrees  0 or 180, for a panel mounted upside down (clients stay 84x48)
+       -m axis     mirror along x or y, for a panel seen through a reflector
+       -R target   mirror the panel to lcdview listening on a socket path or host:port
+       -F fps      most frames a second sent to the mirror (default 4)
+       -T cpu[:prio] send frames from a SCHED_FIFO thread pinned to cpu (-1 any), at
+                   prio (default 50); needs root, see pcd8544_rt.h
+       -S secs     log driver stats to syslog every secs seconds (default 0, off)
+       -f          stay in the foreground and log to stderr as well
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifdef PCD8544_GPIO_SIM
+#include "pcd8544_sim.h"
+#else
+#include <wiringPi.h>
+#endif
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "PCD8544.h"
+#include "lcdd_proto.h"
+#include "pcd8544_stream.h"
+#include "pcd8544_rt.h"
+
+#define BUFSIZE (LCDWIDTH * LCDHEIGHT / 8)
+#define MAX_CLIENTS 8
+
+// pin setup
+int _sclk = 0;
+int _din = 1;
+int _dc = 2;
+int _cs = 3;
+int _rst = 4;
+
+extern const uint8_t pi_logo[];
+
+typedef struct
+{
+	int fd;
+	uint8_t x, y, w, h, priority;
+	uint8_t textcolor, textsize;
+	uint8_t work[BUFSIZE];       // canvas the commands draw into
+	uint8_t shown[BUFSIZE];      // canvas as of the client's last LCDD_FLUSH
+} Client;
+
+static Client clients[MAX_CLIENTS];
+static uint8_t onGlass[BUFSIZE];
+static int dirty;                  // something flushed or left since the last frame
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static uint64_t nowMs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static Client *addClient(int fd)
+{
+	int i;
+	for (i = 0; i < MAX_CLIENTS; i++)
+	{
+		if (clients[i].fd < 0)
+		{
+			Client *cl = &clients[i];
+			memset(cl, 0, sizeof(*cl));
+			cl->fd = fd;
+			cl->w = LCDWIDTH;
+			cl->h = LCDHEIGHT;
+			cl->textcolor = BLACK;
+			cl->textsize = 1;
+			return cl;
+		}
+	}
+	return NULL;
+}
+
+// run one packet of draw operations against the client's work canvas
+static void execute(Client *cl, const uint8_t *p, ssize_t len)
+{
+	const uint8_t *end = p + len;
+
+	// the driver draws into pcd8544_buffer, so borrow it for this client
+	memcpy(pcd8544_buffer, cl->work, BUFSIZE);
+	LCDsetTextColor(cl->textcolor);
+	LCDsetTextSize(cl->textsize);
+
+	while (p < end)
+	{
+		uint8_t op = *p++;
+		const uint8_t *a = p;
+		// line ends off the canvas come from a broken client, like a bad opcode
+		if (op == 0 || op >= LCDD_OPS || end - p < lcdd_arglen[op] ||
+			(op == LCDD_LINE && (a[0] >= LCDwidth() || a[1] >= LCDheight() || a[2] >= LCDwidth() || a[3] >= LCDheight())))
+		{
+			syslog(LOG_WARNING, "client %d sent a malformed packet, dropping the rest", cl->fd);
+			break;
+		}
+		p += lcdd_arglen[op];
+
+		switch (op)
+		{
+		case LCDD_CLEAR:      memset(pcd8544_buffer, 0, BUFSIZE); break;
+		case LCDD_PIXEL:      LCDsetPixel(a[0], a[1], a[2]); break;
+		case LCDD_LINE:       LCDdrawline(a[0], a[1], a[2], a[3], a[4]); break;
+		case LCDD_RECT:       LCDdrawrect(a[0], a[1], a[2], a[3], a[4]); break;
+		case LCDD_FILLRECT:   LCDfillrect(a[0], a[1], a[2], a[3], a[4]); break;
+		case LCDD_CIRCLE:     LCDdrawcircle(a[0], a[1], a[2], a[3]); break;
+		case LCDD_FILLCIRCLE: LCDfillcircle(a[0], a[1], a[2], a[3]); break;
+		case LCDD_TEXTCOLOR:  cl->textcolor = a[0]; LCDsetTextColor(a[0]); break;
+		case LCDD_TEXTSIZE:   cl->textsize = a[0]; LCDsetTextSize(a[0]); break;
+		case LCDD_LOGO:       memcpy(pcd8544_buffer, pi_logo, BUFSIZE); break;
+		case LCDD_CONTRAST:   RTwait(); LCDsetContrast(a[0]); break;
+		case LCDD_REGION:
+			cl->x = a[0];
+			cl->y = a[1];
+			cl->w = a[2];
+			cl->h = a[3];
+			cl->priority = a[4];
+			break;
+		case LCDD_FLUSH:
+			dirty = 1;
+			memcpy(cl->shown, pcd8544_buffer, BUFSIZE);
+			break;
+		case LCDD_TEXT:
+		{
+			char text[256];
+			if (end - p < a[2])
+			{
+				p = end;
+				break;
+			}
+			memcpy(text, p, a[2]);
+			text[a[2]] = 0;
+			p += a[2];
+			LCDdrawstring_P(a[0], a[1], text);
+			break;
+		}
+		case LCDD_BITMAP:
+		{
+			uint32_t n = (uint32_t)a[2] * ((a[3] + 7) / 8);
+			if ((uint32_t)(end - p) < n)
+			{
+				p = end;
+				break;
+			}
+			LCDdrawbitmap(a[0], a[1], p, a[2], a[3], a[4]);
+			p += n;
+			break;
+		}
+		}
+	}
+
+	memcpy(cl->work, pcd8544_buffer, BUFSIZE);
+}
+
+// copy the client's region out of its shown canvas into the frame
+static void blitRegion(uint8_t *frame, const Client *cl)
+{
+	uint16_t x1 = cl->x + cl->w, y1 = cl->y + cl->h;
+	uint8_t p;
+
+	if (cl->x >= LCDWIDTH || cl->y >= LCDHEIGHT || !cl->w || !cl->h)
+		return;
+	if (x1 > LCDWIDTH)
+		x1 = LCDWIDTH;
+	if (y1 > LCDHEIGHT)
+		y1 = LCDHEIGHT;
+
+	for (p = cl->y / 8; p <= (y1 - 1) / 8; p++)
+	{
+		uint8_t lo = (cl->y > p*8) ? cl->y - p*8 : 0;
+		uint8_t hi = (y1 < (p+1)*8) ? y1 - p*8 : 8;
+		uint8_t mask = (0xFF << lo) & (0xFF >> (8 - hi));
+		uint16_t i;
+		for (i = p*LCDWIDTH + cl->x; i < p*LCDWIDTH + x1; i++)
+			frame[i] = (frame[i] & ~mask) | (cl->shown[i] & mask);
+	}
+}
+
+static void compose(void)
+{
+	uint8_t frame[BUFSIZE];
+	int prio, i;
+
+	memset(frame, 0, BUFSIZE);
+	for (prio = 0; prio < 256; prio++)
+	{
+		for (i = 0; i < MAX_CLIENTS; i++)
+		{
+			if (clients[i].fd >= 0 && clients[i].priority == prio)
+				blitRegion(frame, &clients[i]);
+		}
+	}
+	dirty = 0;
+
+	if (!memcmp(frame, onGlass, BUFSIZE))
+		return;
+	memcpy(pcd8544_buffer, frame, BUFSIZE);
+	if (RTactive())
+		RTdisplay();
+	else
+		LCDdisplay();
+	memcpy(onGlass, frame, BUFSIZE);
+}
+
+static void logStats(void)
+{
+	LCDstats st;
+	uint32_t frames;
+
+	LCDgetStats(&st);
+	frames = st.frames ? st.frames : 1;
+	syslog(LOG_INFO, "frames=%u bytes=%u cmds=%u skipped=%u gpio=%llu xfer=%lluus/frame maxflush=%uus",
+		st.frames, st.dataBytes, st.commands, st.pagesSkipped, (unsigned long long)st.gpioWrites,
+		(unsigned long long)(st.transferNs / frames / 1000), st.maxFlushUs);
+
+	STREAMstats ms;
+	STREAMgetStats(&ms);
+	if (ms.fps)
+		syslog(LOG_INFO, "mirror: sent=%u key=%u limited=%u dropped=%u connects=%u bytes=%llu",
+			ms.sent, ms.keyFrames, ms.limited, ms.dropped, ms.connects, (unsigned long long)ms.bytes);
+
+	RTstats rt;
+	RTgetStats(&rt);
+	if (RTactive())
+		syslog(LOG_INFO, "realtime: cpu=%d prio=%u sent=%u folded=%u frame p50=%lluus p99=%lluus max=%lluus byte p50=%lluns p99=%lluns max=%lluns",
+			rt.cpu, rt.priority, rt.frames, rt.coalesced,
+			(unsigned long long)(RTpercentile(rt.frameHist, 500, rt.maxFrameNs) / 1000),
+			(unsigned long long)(RTpercentile(rt.frameHist, 990, rt.maxFrameNs) / 1000),
+			(unsigned long long)(rt.maxFrameNs / 1000),
+			(unsigned long long)RTpercentile(rt.byteHist, 500, rt.maxByteNs),
+			(unsigned long long)RTpercentile(rt.byteHist, 990, rt.maxByteNs),
+			(unsigned long long)rt.maxByteNs);
+}
+
+static int openSocket(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (fd < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, MAX_CLIENTS) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	chmod(path, 0666);
+	return fd;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = LCDD_SOCKET, *mirror = NULL;
+	int mirrorFps = 4, fps = 20, contrast = 60, statsEvery = 0, foreground = 0, orientation = LCD_ROTATE_0, opt, i;
+	int rtCpu = -2, rtPriority = RT_PRIORITY;
+	char *colon;
+	int listenFd;
+	uint64_t nextFrame = 0, nextStats;
+
+	while ((opt = getopt(argc, argv, "s:r:c:o:m:R:F:T:S:f")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': path = optarg; break;
+		case 'r': fps = atoi(optarg); if (fps < 1) fps = 1; break;
+		case 'c': contrast = atoi(optarg); break;
+		case 'o':
+			if (atoi(optarg) == 180)
+				orientation |= LCD_ROTATE_180;
+			else if (atoi(optarg) != 0)
+				orientation = -1;
+			break;
+		case 'm':
+			if (strchr(optarg, 'x'))
+				orientation |= LCD_MIRROR_X;
+			if (strchr(optarg, 'y'))
+				orientation |= LCD_MIRROR_Y;
+			break;
+		case 'R': mirror = optarg; break;
+		case 'F': mirrorFps = atoi(optarg); break;
+		case 'T':
+			rtCpu = atoi(optarg);
+			colon = strchr(optarg, ':');
+			if (colon)
+				rtPriority = atoi(colon + 1);
+			if (rtCpu < -1)
+				orientation = -1;
+			break;
+		case 'S': statsEvery = atoi(optarg); break;
+		case 'f': foreground = 1; break;
+		default:
+			orientation = -1;
+			break;
+		}
+	}
+	if (orientation < 0 || mirrorFps < 1 || mirrorFps > 65535 || (mirror && STREAMopen(mirror, mirrorFps) < 0))
+	{
+		fprintf(stderr, "usage: %s [-s socket] [-r fps] [-c contrast] [-o degrees] [-m axis] [-R target] [-F fps] [-T cpu[:prio]] [-S secs] [-f]\n", argv[0]);
+		return 2;
+	}
+
+	openlog("lcdd", foreground ? LOG_PERROR : 0, LOG_DAEMON);
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (wiringPiSetup() == -1)
+	{
+		syslog(LOG_ERR, "wiringPi-Error");
+		return 1;
+	}
+#ifdef PCD8544_GPIO_SIM
+	SIMinit(_sclk, _din, _dc, _cs, _rst);
+#endif
+	LCDInit(_sclk, _din, _dc, _cs, _rst, contrast);
+	LCDsetOrientation(orientation);
+	if (mirror)
+		LCDsetFlushHook(STREAMframe);
+	// the panel stays blank from LCDInit() until the first client frame
+	LCDclear();
+
+	listenFd = openSocket(path);
+	if (listenFd < 0)
+	{
+		syslog(LOG_ERR, "cannot listen on %s: %s", path, strerror(errno));
+		return 1;
+	}
+	if (!foreground && daemon(0, 0) < 0)
+	{
+		syslog(LOG_ERR, "daemon: %s", strerror(errno));
+		return 1;
+	}
+	// threads do not survive the fork in daemon(), so the transmit thread starts here
+	if (rtCpu >= -1)
+	{
+		if (RTstart(rtCpu, rtPriority) < 0)
+			syslog(LOG_WARNING, "real-time flush refused: %s, sending from the main loop", strerror(errno));
+		else
+			syslog(LOG_INFO, "real-time flush on cpu %d at priority %d", rtCpu, rtPriority);
+	}
+	for (i = 0; i < MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+	syslog(LOG_INFO, "listening on %s, %d fps", path, fps);
+	nextStats = nowMs() + statsEvery * 1000ULL;
+
+	while (running)
+	{
+		struct pollfd pfd[MAX_CLIENTS + 1];
+		Client *owner[MAX_CLIENTS + 1];
+		int n = 0, timeout = -1;
+		uint64_t now = nowMs();
+
+		pfd[n].fd = listenFd;
+		pfd[n].events = POLLIN;
+		owner[n++] = NULL;
+		for (i = 0; i < MAX_CLIENTS; i++)
+		{
+			if (clients[i].fd < 0)
+				continue;
+			pfd[n].fd = clients[i].fd;
+			pfd[n].events = POLLIN;
+			owner[n++] = &clients[i];
+		}
+
+		// pace frames: flush once the tick is due, otherwise sleep until it is
+		if (dirty)
+		{
+			if (now >= nextFrame)
+			{
+				compose();
+				nextFrame = now + 1000 / fps;
+				continue;
+			}
+			timeout = nextFrame - now;
+		}
+		if (statsEvery > 0)
+		{
+			if (now >= nextStats)
+			{
+				logStats();
+				nextStats = now + statsEvery * 1000ULL;
+			}
+			if (timeout < 0 || nextStats - now < (uint64_t)timeout)
+				timeout = nextStats - now;
+		}
+		// a frame the mirror's rate limit held back goes out once it is due
+		if (mirror)
+		{
+			int wait = STREAMtick();
+
+			if (wait >= 0 && (timeout < 0 || wait < timeout))
+				timeout = wait;
+		}
+
+		if (poll(pfd, n, timeout) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			syslog(LOG_ERR, "poll: %s", strerror(errno));
+			break;
+		}
+
+		if (pfd[0].revents & POLLIN)
+		{
+			int fd = accept(listenFd, NULL, NULL);
+			if (fd >= 0 && !addClient(fd))
+			{
+				syslog(LOG_WARNING, "too many clients, refusing connection");
+				close(fd);
+			}
+		}
+		for (i = 1; i < n; i++)
+		{
+			Client *cl = owner[i];
+			uint8_t packet[LCDD_MAX_PACKET];
+			ssize_t len;
+
+			if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			len = recv(cl->fd, packet, sizeof(packet), 0);
+			if (len <= 0)
+			{
+				// a client going away uncovers whatever was below its region
+				close(cl->fd);
+				cl->fd = -1;
+				dirty = 1;
+				continue;
+			}
+			execute(cl, packet, len);
+		}
+	}
+
+	RTstop();
+	close(listenFd);
+	unlink(path);
+	syslog(LOG_INFO, "exiting");
+	return 0;
+}
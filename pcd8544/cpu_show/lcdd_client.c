@@ -0,0 +1,183 @@
+/*
+=================================================================================
+ Name        : lcdd_client.c
+ Version     : 0.1
+
+ Description : Thin client library for lcdd, see lcdd_client.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "lcdd_client.h"
+
+int LCDCconnect(LCDclient *c, const char *path)
+{
+	struct sockaddr_un addr;
+
+	c->len = 0;
+	c->fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if (c->fd < 0)
+		return -1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path ? path : LCDD_SOCKET, sizeof(addr.sun_path) - 1);
+	if (connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		close(c->fd);
+		c->fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+void LCDCclose(LCDclient *c)
+{
+	if (c->fd >= 0)
+		close(c->fd);
+	c->fd = -1;
+	c->len = 0;
+}
+
+int LCDCsend(LCDclient *c)
+{
+	if (c->fd < 0)
+		return -1;
+	if (c->len == 0)
+		return 0;
+	if (send(c->fd, c->batch, c->len, MSG_NOSIGNAL) != c->len)
+	{
+		c->len = 0;
+		return -1;
+	}
+	c->len = 0;
+	return 0;
+}
+
+// append one operation, sending the batch first if it would not fit
+static int put(LCDclient *c, uint8_t op, const uint8_t *args, const uint8_t *payload, uint16_t plen)
+{
+	uint16_t need = 1 + lcdd_arglen[op] + plen;
+
+	if (need > LCDD_MAX_PACKET)
+		return -1;
+	if (c->len + need > LCDD_MAX_PACKET && LCDCsend(c) < 0)
+		return -1;
+	c->batch[c->len++] = op;
+	if (lcdd_arglen[op])
+	{
+		memcpy(c->batch + c->len, args, lcdd_arglen[op]);
+		c->len += lcdd_arglen[op];
+	}
+	if (plen)
+	{
+		memcpy(c->batch + c->len, payload, plen);
+		c->len += plen;
+	}
+	return 0;
+}
+
+int LCDCregion(LCDclient *c, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t priority)
+{
+	uint8_t a[5] = { x, y, w, h, priority };
+	return put(c, LCDD_REGION, a, NULL, 0);
+}
+
+int LCDCclear(LCDclient *c)
+{
+	return put(c, LCDD_CLEAR, NULL, NULL, 0);
+}
+
+int LCDCsetPixel(LCDclient *c, uint8_t x, uint8_t y, uint8_t color)
+{
+	uint8_t a[3] = { x, y, color };
+	return put(c, LCDD_PIXEL, a, NULL, 0);
+}
+
+int LCDCdrawline(LCDclient *c, uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color)
+{
+	uint8_t a[5] = { x0, y0, x1, y1, color };
+	return put(c, LCDD_LINE, a, NULL, 0);
+}
+
+int LCDCdrawrect(LCDclient *c, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color)
+{
+	uint8_t a[5] = { x, y, w, h, color };
+	return put(c, LCDD_RECT, a, NULL, 0);
+}
+
+int LCDCfillrect(LCDclient *c, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color)
+{
+	uint8_t a[5] = { x, y, w, h, color };
+	return put(c, LCDD_FILLRECT, a, NULL, 0);
+}
+
+int LCDCdrawcircle(LCDclient *c, uint8_t x0, uint8_t y0, uint8_t r, uint8_t color)
+{
+	uint8_t a[4] = { x0, y0, r, color };
+	return put(c, LCDD_CIRCLE, a, NULL, 0);
+}
+
+int LCDCfillcircle(LCDclient *c, uint8_t x0, uint8_t y0, uint8_t r, uint8_t color)
+{
+	uint8_t a[4] = { x0, y0, r, color };
+	return put(c, LCDD_FILLCIRCLE, a, NULL, 0);
+}
+
+int LCDCsetTextColor(LCDclient *c, uint8_t color)
+{
+	return put(c, LCDD_TEXTCOLOR, &color, NULL, 0);
+}
+
+int LCDCsetTextSize(LCDclient *c, uint8_t size)
+{
+	return put(c, LCDD_TEXTSIZE, &size, NULL, 0);
+}
+
+int LCDCdrawstring(LCDclient *c, uint8_t x, uint8_t y, const char *str)
+{
+	size_t len = strlen(str);
+	uint8_t a[3];
+
+	if (len > 255)
+		len = 255;
+	a[0] = x;
+	a[1] = y;
+	a[2] = len;
+	return put(c, LCDD_TEXT, a, (const uint8_t *)str, len);
+}
+
+int LCDCdrawbitmap(LCDclient *c, uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t w, uint8_t h, uint8_t color)
+{
+	uint8_t a[5] = { x, y, w, h, color };
+	return put(c, LCDD_BITMAP, a, bitmap, (uint16_t)w * ((h + 7) / 8));
+}
+
+int LCDCshowLogo(LCDclient *c)
+{
+	return put(c, LCDD_LOGO, NULL, NULL, 0);
+}
+
+int LCDCsetContrast(LCDclient *c, uint8_t val)
+{
+	return put(c, LCDD_CONTRAST, &val, NULL, 0);
+}
+
+int LCDCflush(LCDclient *c)
+{
+	if (put(c, LCDD_FLUSH, NULL, NULL, 0) < 0)
+		return -1;
+	return LCDCsend(c);
+}
@@ -0,0 +1,55 @@
+/*
+=================================================================================
+ Name        : lcdd_client.h
+ Version     : 0.1
+
+ Description : Thin client library for lcdd. Draw calls are appended to a
+     local batch and sent as one packet on LCDCflush() (or when the batch is
+     full), so a whole screen update costs a single send().
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef LCDD_CLIENT_H
+#define LCDD_CLIENT_H
+
+#include <stdint.h>
+#include "lcdd_proto.h"
+
+typedef struct
+{
+	int fd;
+	uint16_t len;
+	uint8_t batch[LCDD_MAX_PACKET];
+} LCDclient;
+
+// all calls return 0 on success, -1 if the server went away
+ int LCDCconnect(LCDclient *c, const char *path);   // path NULL = LCDD_SOCKET
+ void LCDCclose(LCDclient *c);
+ int LCDCregion(LCDclient *c, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t priority);
+ int LCDCclear(LCDclient *c);
+ int LCDCsetPixel(LCDclient *c, uint8_t x, uint8_t y, uint8_t color);
+ int LCDCdrawline(LCDclient *c, uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color);
+ int LCDCdrawrect(LCDclient *c, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color);
+ int LCDCfillrect(LCDclient *c, uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color);
+ int LCDCdrawcircle(LCDclient *c, uint8_t x0, uint8_t y0, uint8_t r, uint8_t color);
+ int LCDCfillcircle(LCDclient *c, uint8_t x0, uint8_t y0, uint8_t r, uint8_t color);
+ int LCDCsetTextColor(LCDclient *c, uint8_t color);
+ int LCDCsetTextSize(LCDclient *c, uint8_t size);
+ int LCDCdrawstring(LCDclient *c, uint8_t x, uint8_t y, const char *str);
+ int LCDCdrawbitmap(LCDclient *c, uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t w, uint8_t h, uint8_t color);
+ int LCDCshowLogo(LCDclient *c);
+ int LCDCsetContrast(LCDclient *c, uint8_t val);
+ int LCDCsend(LCDclient *c);      // send the batch without publishing it
+ int LCDCflush(LCDclient *c);     // publish everything drawn so far
+
+#endif
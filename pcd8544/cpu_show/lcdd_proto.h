@@ -0,0 +1,94 @@
+/*
+=================================================================================
+ Name        : lcdd_proto.h
+ Version     : 0.1
+
+ Description : Wire protocol between lcdd (the LCD display server) and its
+     clients. A client connects a SOCK_SEQPACKET Unix socket and sends packets
+     of up to LCDD_MAX_PACKET bytes; each packet is a batch of draw operations,
+     one opcode byte followed by that opcode's fixed argument bytes. LCDD_TEXT
+     and LCDD_BITMAP carry a variable payload after their fixed arguments.
+
+     Op               Arguments (bytes)
+     LCDD_CLEAR       -
+     LCDD_PIXEL       x y color
+     LCDD_LINE        x0 y0 x1 y1 color
+     LCDD_RECT        x y w h color
+     LCDD_FILLRECT    x y w h color
+     LCDD_CIRCLE      x y r color
+     LCDD_FILLCIRCLE  x y r color
+     LCDD_TEXTCOLOR   color
+     LCDD_TEXTSIZE    size
+     LCDD_TEXT        x y len, then len characters
+     LCDD_BITMAP      x y w h color, then w*((h+7)/8) bitmap bytes
+     LCDD_LOGO        -
+     LCDD_CONTRAST    value
+     LCDD_REGION      x y w h priority
+     LCDD_FLUSH       -
+
+     Drawing uses screen coordinates into a private canvas per client. Both
+     ends of a LCDD_LINE must be on it; like an unknown opcode, a line that
+     is not drops the rest of its packet. Only the client's region is
+     visible; where regions overlap the higher priority wins. LCDD_FLUSH
+     publishes the canvas, and the server pushes at most one composed frame
+     per refresh tick no matter how many clients flushed.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef LCDD_PROTO_H
+#define LCDD_PROTO_H
+
+#define LCDD_SOCKET "/var/run/lcdd.sock"
+#define LCDD_MAX_PACKET 4096
+
+enum
+{
+	LCDD_CLEAR = 1,
+	LCDD_PIXEL,
+	LCDD_LINE,
+	LCDD_RECT,
+	LCDD_FILLRECT,
+	LCDD_CIRCLE,
+	LCDD_FILLCIRCLE,
+	LCDD_TEXTCOLOR,
+	LCDD_TEXTSIZE,
+	LCDD_TEXT,
+	LCDD_BITMAP,
+	LCDD_LOGO,
+	LCDD_CONTRAST,
+	LCDD_REGION,
+	LCDD_FLUSH,
+	LCDD_OPS
+};
+
+// fixed argument bytes per opcode, indexed by opcode
+static const unsigned char lcdd_arglen[LCDD_OPS] = {
+	0,  // unused
+	0,  // LCDD_CLEAR
+	3,  // LCDD_PIXEL
+	5,  // LCDD_LINE
+	5,  // LCDD_RECT
+	5,  // LCDD_FILLRECT
+	4,  // LCDD_CIRCLE
+	4,  // LCDD_FILLCIRCLE
+	1,  // LCDD_TEXTCOLOR
+	1,  // LCDD_TEXTSIZE
+	3,  // LCDD_TEXT
+	5,  // LCDD_BITMAP
+	0,  // LCDD_LOGO
+	1,  // LCDD_CONTRAST
+	5,  // LCDD_REGION
+	0,  // LCDD_FLUSH
+};
+
+#endif
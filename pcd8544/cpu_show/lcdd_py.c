@@ -0,0 +1,209 @@
+/*
+=================================================================================
+ Name        : lcdd_py.c
+ Version     : 0.1
+
+ Description : Python bindings for the lcdd client library, built as lcdc.so.
+     Mirrors the function names of lcd.so so a script can switch from driving
+     the panel directly to going through lcdd by changing its import. Drawing
+     calls are batched locally; lcdDisplay() sends the batch and publishes it.
+
+     Extra calls :-
+     lcdRegion(int x, int y, int w, int h, int priority) - visible area of this client
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <Python.h>
+#include <stdint.h>
+#include "lcdd_client.h"
+
+static LCDclient client = { -1, 0 };
+static char socketPath[108] = LCDD_SOCKET;
+
+static PyObject* result(int rc)
+{
+  return Py_BuildValue("i", rc);
+}
+
+static PyObject* py_initDisplay(PyObject* self, PyObject* args)
+{
+  const char *path = NULL;
+
+  // Optional socket path, defaults to /var/run/lcdd.sock
+  if (!PyArg_ParseTuple(args, "|s", &path))
+    return result(-1);
+  if (path)
+  {
+    strncpy(socketPath, path, sizeof(socketPath) - 1);
+    socketPath[sizeof(socketPath) - 1] = 0;
+  }
+  LCDCclose(&client);
+  if (LCDCconnect(&client, socketPath) < 0)
+    return result(-1);
+  LCDCclear(&client);
+  return result(LCDCflush(&client));
+}
+
+static PyObject* py_lcdClear(PyObject* self, PyObject* args)
+{
+  return result(LCDCclear(&client));
+}
+static PyObject* py_lcdShowLogo(PyObject* self, PyObject* args)
+{
+  // Logo is published straight away, like lcd.lcdShowLogo()
+  LCDCshowLogo(&client);
+  return result(LCDCflush(&client));
+}
+static PyObject* py_lcdDisplay(PyObject* self, PyObject* args)
+{
+  // Send the batch; if lcdd restarted, reconnect so the next frame gets through
+  if (LCDCflush(&client) < 0)
+  {
+    LCDCclose(&client);
+    LCDCconnect(&client, socketPath);
+    return result(-1);
+  }
+  return result(0);
+}
+static PyObject* py_lcdDisplayText(PyObject* self, PyObject* args)
+{
+  int x,y;
+  const char *pyarg;
+
+  if (!PyArg_ParseTuple(args, "iis", &x, &y, &pyarg))
+    return result(-1);
+  return result(LCDCdrawstring(&client, x, y, pyarg));
+}
+static PyObject* py_lcdDrawRect(PyObject* self, PyObject* args)
+{
+  int x,y,w,h,c;
+
+  if (!PyArg_ParseTuple(args, "iiiii", &x, &y, &w, &h, &c))
+    return result(-1);
+  return result(LCDCdrawrect(&client, x, y, w, h, c));
+}
+static PyObject* py_lcdFillRect(PyObject* self, PyObject* args)
+{
+  int x,y,w,h,c;
+
+  if (!PyArg_ParseTuple(args, "iiiii", &x, &y, &w, &h, &c))
+    return result(-1);
+  return result(LCDCfillrect(&client, x, y, w, h, c));
+}
+static PyObject* py_lcdDrawLine(PyObject* self, PyObject* args)
+{
+  int xa,ya,xb,yb,c;
+
+  if (!PyArg_ParseTuple(args, "iiiii", &xa, &ya, &xb, &yb, &c))
+    return result(-1);
+  return result(LCDCdrawline(&client, xa, ya, xb, yb, c));
+}
+static PyObject* py_lcdDrawCircle(PyObject* self, PyObject* args)
+{
+  int x,y,r,c;
+
+  if (!PyArg_ParseTuple(args, "iiii", &x, &y, &r, &c))
+    return result(-1);
+  return result(LCDCdrawcircle(&client, x, y, r, c));
+}
+static PyObject* py_lcdFillCircle(PyObject* self, PyObject* args)
+{
+  int x,y,r,c;
+
+  if (!PyArg_ParseTuple(args, "iiii", &x, &y, &r, &c))
+    return result(-1);
+  return result(LCDCfillcircle(&client, x, y, r, c));
+}
+static PyObject* py_lcdSetPixel(PyObject* self, PyObject* args)
+{
+  int x,y,c;
+
+  if (!PyArg_ParseTuple(args, "iii", &x, &y, &c))
+    return result(-1);
+  return result(LCDCsetPixel(&client, x, y, c));
+}
+static PyObject* py_lcdGetPixel(PyObject* self, PyObject* args)
+{
+  // The canvas lives in lcdd, reading it back is not supported
+  return result(-1);
+}
+static PyObject* py_lcdSetTextColour(PyObject* self, PyObject* args)
+{
+  int c;
+
+  if (!PyArg_ParseTuple(args, "i", &c))
+    return result(-1);
+  return result(LCDCsetTextColor(&client, c));
+}
+static PyObject* py_lcdSetTextSize(PyObject* self, PyObject* args)
+{
+  int s;
+
+  if (!PyArg_ParseTuple(args, "i", &s))
+    return result(-1);
+  return result(LCDCsetTextSize(&client, s));
+}
+static PyObject* py_lcdSetContrast(PyObject* self, PyObject* args)
+{
+  int c;
+
+  if (!PyArg_ParseTuple(args, "i", &c))
+    return result(-1);
+  return result(LCDCsetContrast(&client, c));
+}
+static PyObject* py_lcdSetCursor(PyObject* self, PyObject* args)
+{
+  // Text is always drawn at an explicit position through lcdDisplayText()
+  return result(0);
+}
+static PyObject* py_lcdRegion(PyObject* self, PyObject* args)
+{
+  int x,y,w,h,p;
+
+  if (!PyArg_ParseTuple(args, "iiiii", &x, &y, &w, &h, &p))
+    return result(-1);
+  return result(LCDCregion(&client, x, y, w, h, p));
+}
+
+
+/*
+ * Bind Python function names to our C functions
+ */
+static PyMethodDef lcdc_methods[] = {
+  {"initDisplay", py_initDisplay, METH_VARARGS},
+  {"lcdClear", py_lcdClear, METH_VARARGS},
+  {"lcdShowLogo", py_lcdShowLogo, METH_VARARGS},
+  {"lcdDisplay", py_lcdDisplay, METH_VARARGS},
+  {"lcdDisplayText", py_lcdDisplayText, METH_VARARGS},
+  {"lcdDrawRect", py_lcdDrawRect, METH_VARARGS},
+  {"lcdFillRect", py_lcdFillRect, METH_VARARGS},
+  {"lcdDrawLine", py_lcdDrawLine, METH_VARARGS},
+  {"lcdDrawCircle", py_lcdDrawCircle, METH_VARARGS},
+  {"lcdFillCircle", py_lcdFillCircle, METH_VARARGS},
+  {"lcdSetPixel", py_lcdSetPixel, METH_VARARGS},
+  {"lcdGetPixel", py_lcdGetPixel, METH_VARARGS},
+  {"lcdSetTextColour", py_lcdSetTextColour, METH_VARARGS},
+  {"lcdSetTextSize", py_lcdSetTextSize, METH_VARARGS},
+  {"lcdSetContrast", py_lcdSetContrast, METH_VARARGS},
+  {"lcdSetCursor", py_lcdSetCursor, METH_VARARGS},
+  {"lcdRegion", py_lcdRegion, METH_VARARGS},
+  {NULL, NULL}
+};
+
+/*
+ * Python calls this to let us initialize our module
+ */
+void initlcdc()
+{
+  (void) Py_InitModule("lcdc", lcdc_methods);
+}
@@ -0,0 +1,342 @@
+/*
+=================================================================================
+ Name        : lcddash.c
+ Version     : 0.1
+
+ Description : Live vehicle dashboard for the PCD8544. Reads the latest PID
+     values the OBD collector publishes on the shared memory metric bus
+     (native/metricbus.h) and shows up to six gauges, a label, a bar and the
+     value each, in a 2 x 3 grid. Reading the bus takes no system call and no
+     lock, so the dashboard can never hold up the collector, and it refreshes
+     at its own rate whatever the polling loop is doing.
+
+     Each tick the gauges whose slot sequence has not moved are skipped with a
+     single load; the rest are redrawn only if their text or bar changed. A
+     value older than the stale time shows as "--". The frame goes through
+     lcdd when it is running (changed gauges only, as bitmaps), otherwise
+     straight to the panel, where LCDdisplayRegion() sends each changed gauge.
+
+     Usage: lcddash [-g pids] [-r fps] [-t stale_secs] [-s socket] [-p priority] [-d] [-c contrast] [-S secs]
+       -g pids     gauges as hex PIDs, default 0C,0D,05,11,04,42
+                   (RPM, speed, coolant, throttle, load, module voltage)
+       -r fps      refresh rate (default 10)
+       -t secs     a value older than this is shown as stale (default 3)
+       -s socket   lcdd socket (default /var/run/lcdd.sock)
+       -p priority lcdd region priority (default 1, above the status text)
+       -d          drive the panel directly even if lcdd is running
+       -c contrast contrast when driving the panel directly (default 60)
+       -S secs     print redraw counters every secs seconds
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifdef PCD8544_GPIO_SIM
+#include "pcd8544_sim.h"
+#else
+#include <wiringPi.h>
+#endif
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "PCD8544.h"
+#include "lcdd_client.h"
+#include "../../native/metricbus.h"
+
+#define MAX_GAUGES 6
+#define GAUGE_W 42
+#define GAUGE_H 16
+#define BAR_X 21                // bar beside the label
+#define BAR_W 20
+
+// pin setup
+int _sclk = 0;
+int _din = 1;
+int _dc = 2;
+int _cs = 3;
+int _rst = 4;
+
+typedef struct
+{
+	uint8_t pid;
+	const char *label;
+	double min, max;        // bar scale
+	int decimals;
+} GaugeDef;
+
+static const GaugeDef gaugeDefs[] = {
+	{ 0x0C, "RPM", 0, 8000, 0 },
+	{ 0x0D, "SPD", 0, 200, 0 },
+	{ 0x05, "CLT", -40, 130, 0 },
+	{ 0x11, "THR", 0, 100, 0 },
+	{ 0x04, "LOD", 0, 100, 0 },
+	{ 0x42, "BAT", 10, 16, 1 },
+	{ 0x0F, "IAT", -40, 80, 0 },
+	{ 0x10, "MAF", 0, 200, 1 },
+	{ 0x2F, "FUL", 0, 100, 0 },
+	{ 0x5C, "OIL", -40, 150, 0 },
+	{ 0x0B, "MAP", 0, 255, 0 },
+	{ 0x0E, "ADV", -64, 64, 0 },
+	{ 0x33, "BRO", 0, 255, 0 },
+	{ 0x46, "AMB", -40, 60, 0 },
+};
+
+typedef struct
+{
+	const GaugeDef *def;
+	uint8_t x, y;
+	uint32_t seq;           // slot sequence last read
+	double value;
+	int64_t timeMs;
+	char shown[8];          // what is on the glass
+	int shownBar;           // -1 = nothing drawn yet
+	int changed;
+} Gauge;
+
+static Gauge gauges[MAX_GAUGES];
+static int ngauges;
+static volatile sig_atomic_t running = 1;
+static uint64_t ticks, redraws, frames, stale;
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static int64_t wallMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static const GaugeDef *findGauge(uint8_t pid)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(gaugeDefs) / sizeof(gaugeDefs[0]); i++)
+		if (gaugeDefs[i].pid == pid)
+			return &gaugeDefs[i];
+	return NULL;
+}
+
+static int parseGauges(const char *list)
+{
+	const char *p = list;
+
+	ngauges = 0;
+	while (*p && ngauges < MAX_GAUGES)
+	{
+		char *end;
+		const GaugeDef *def = findGauge(strtol(p, &end, 16));
+
+		if (end == p || def == NULL)
+			return -1;
+		gauges[ngauges].def = def;
+		gauges[ngauges].x = (ngauges % 2) * GAUGE_W;
+		gauges[ngauges].y = (ngauges / 2) * GAUGE_H;
+		gauges[ngauges].shownBar = -1;
+		ngauges++;
+		p = *end == ',' ? end + 1 : end;
+	}
+	return ngauges ? 0 : -1;
+}
+
+// Redraw one gauge into pcd8544_buffer if its text or bar would change
+static void updateGauge(Gauge *g, const MBUSmap *m, int64_t now, int64_t staleMs)
+{
+	char text[8];
+	int bar = 0, i;
+	uint32_t seq;
+
+	if (m && (seq = MBUSseq(m, g->def->pid)) != g->seq)
+	{
+		double value;
+		int64_t t;
+
+		seq = MBUSread(m, g->def->pid, &value, &t);
+		if (!(seq & 1))
+		{
+			g->seq = seq;
+			g->value = value;
+			g->timeMs = t;
+		}
+	}
+	if (m == NULL || g->timeMs == 0 || now - g->timeMs > staleMs)
+		snprintf(text, sizeof(text), "--");
+	else
+	{
+		double f = (g->value - g->def->min) / (g->def->max - g->def->min);
+
+		snprintf(text, sizeof(text), "%.*f", g->def->decimals, g->value);
+		bar = f <= 0 ? 0 : f >= 1 ? BAR_W - 2 : (int)(f * (BAR_W - 2) + 0.5);
+	}
+	if (bar == g->shownBar && strcmp(text, g->shown) == 0)
+		return;
+	if (strcmp(text, "--") == 0 && g->shown[0] && strcmp(g->shown, "--"))
+		stale++;
+
+	LCDfillrect(g->x, g->y, GAUGE_W, GAUGE_H, WHITE);
+	LCDdrawstring(g->x + 1, g->y, (char *)g->def->label);
+	LCDdrawrect(g->x + BAR_X, g->y + 1, BAR_W, 6, BLACK);
+	if (bar)
+		LCDfillrect(g->x + BAR_X + 1, g->y + 2, bar, 4, BLACK);
+	// value right aligned in the gauge
+	i = strlen(text);
+	LCDdrawstring(g->x + GAUGE_W - 1 - 6 * i, g->y + 8, text);
+	strcpy(g->shown, text);
+	g->shownBar = bar;
+	g->changed = 1;
+	redraws++;
+}
+
+// Send the changed gauges to lcdd, each as a bitmap cut from the frame buffer
+static int sendGauges(LCDclient *c)
+{
+	uint8_t bitmap[GAUGE_W * GAUGE_H / 8];
+	int i, page;
+
+	for (i = 0; i < ngauges; i++)
+	{
+		Gauge *g = &gauges[i];
+
+		if (!g->changed)
+			continue;
+		// gauges sit on page boundaries, so the bitmap is the buffer's pages as they are
+		for (page = 0; page < GAUGE_H / 8; page++)
+			memcpy(bitmap + page * GAUGE_W, pcd8544_buffer + (g->y / 8 + page) * LCDWIDTH + g->x, GAUGE_W);
+		if (LCDCfillrect(c, g->x, g->y, GAUGE_W, GAUGE_H, WHITE) < 0 ||
+			LCDCdrawbitmap(c, g->x, g->y, bitmap, GAUGE_W, GAUGE_H, BLACK) < 0)
+			return -1;
+		g->changed = 0;
+	}
+	return LCDCflush(c);
+}
+
+int main(int argc, char **argv)
+{
+	const char *socketPath = NULL;
+	int fps = 10, priority = 1, direct = 0, contrast = 60, statsEvery = 0, opt, i;
+	int64_t staleMs = 3000, nextStats, nextTry = 0;
+	MBUSbus bus;
+	LCDclient client;
+	int haveClient = 0;
+
+	if (parseGauges("0C,0D,05,11,04,42") < 0)
+		return 1;
+	while ((opt = getopt(argc, argv, "g:r:t:s:p:dc:S:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'g':
+			if (parseGauges(optarg) < 0)
+			{
+				fprintf(stderr, "lcddash: unknown gauge PID in %s\n", optarg);
+				return 2;
+			}
+			break;
+		case 'r': fps = atoi(optarg); if (fps < 1) fps = 1; break;
+		case 't': staleMs = (int64_t)(atof(optarg) * 1000); break;
+		case 's': socketPath = optarg; break;
+		case 'p': priority = atoi(optarg); break;
+		case 'd': direct = 1; break;
+		case 'c': contrast = atoi(optarg); break;
+		case 'S': statsEvery = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: %s [-g pids] [-r fps] [-t stale_secs] [-s socket] [-p priority] [-d] [-c contrast] [-S secs]\n",
+				argv[0]);
+			return 2;
+		}
+	}
+	signal(SIGINT, onSignal);
+	signal(SIGTERM, onSignal);
+	signal(SIGPIPE, SIG_IGN);
+
+	// lcdd owns the panel when it runs; only bit-bang it ourselves when it does not
+	if (!direct && LCDCconnect(&client, socketPath) == 0)
+	{
+		haveClient = 1;
+		LCDCregion(&client, 0, 0, LCDWIDTH, LCDHEIGHT, priority);
+		LCDCclear(&client);
+	}
+	else
+	{
+		if (wiringPiSetup() == -1)
+		{
+			fprintf(stderr, "lcddash: wiringPi-Error\n");
+			return 1;
+		}
+#ifdef PCD8544_GPIO_SIM
+		SIMinit(_sclk, _din, _dc, _cs, _rst);
+#endif
+		LCDInit(_sclk, _din, _dc, _cs, _rst, contrast);
+		direct = 1;
+	}
+	LCDclear();
+	LCDsetTextSize(1);
+	LCDsetTextColor(BLACK);
+	bus.map = NULL;
+	nextStats = wallMs() + statsEvery * 1000LL;
+
+	while (running)
+	{
+		int64_t now = wallMs();
+		int changed = 0;
+
+		// the collector creates the bus, wait for it
+		if (bus.map == NULL && now >= nextTry && MBUSopen(&bus, NULL, 0) < 0)
+			nextTry = now + 1000;
+		for (i = 0; i < ngauges; i++)
+		{
+			updateGauge(&gauges[i], bus.map, now, staleMs);
+			changed |= gauges[i].changed;
+		}
+		if (changed)
+		{
+			frames++;
+			if (direct)
+			{
+				for (i = 0; i < ngauges; i++)
+					if (gauges[i].changed)
+					{
+						LCDdisplayRegion(gauges[i].x, gauges[i].y, GAUGE_W, GAUGE_H);
+						gauges[i].changed = 0;
+					}
+			}
+			else if (sendGauges(&client) < 0)
+			{
+				fprintf(stderr, "lcddash: lcdd went away\n");
+				break;
+			}
+		}
+		ticks++;
+		if (statsEvery && now >= nextStats)
+		{
+			printf("lcddash: %llu ticks, %llu gauge redraws, %llu frames, %llu went stale\n", (unsigned long long)ticks,
+				(unsigned long long)redraws, (unsigned long long)frames, (unsigned long long)stale);
+			fflush(stdout);
+			nextStats = now + statsEvery * 1000LL;
+		}
+		usleep(1000000 / fps);
+	}
+	if (haveClient)
+		LCDCclose(&client);
+	MBUSclose(&bus);
+	printf("lcddash: %llu ticks, %llu gauge redraws, %llu frames, %llu went stale\n", (unsigned long long)ticks,
+		(unsigned long long)redraws, (unsigned long long)frames, (unsigned long long)stale);
+	return 0;
+}
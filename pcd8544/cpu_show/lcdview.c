@@ -0,0 +1,258 @@
+/*
+=================================================================================
+ Name        : lcdview.c
+ Version     : 0.1
+
+ Description : Viewer for the remote LCD mirror (pcd8544_stream.h). Listens
+     on a Unix socket or TCP port for the stream lcdd, lcd.so or cpushow
+     publish, rebuilds each frame from its deltas and draws the panel in the
+     terminal, two pixel rows to a character cell. One sender at a time; when
+     it goes away the viewer waits for the next. On exit, or every -S
+     seconds, it reports messages, key frames and bytes per frame against the
+     504 a raw frame takes.
+
+     Usage: lcdview [-l listen] [-n messages] [-p file.pbm] [-S secs] [-q]
+       -l listen   socket path or [host]:port (default /tmp/lcdmirror.sock)
+       -n messages exit after this many messages
+       -p file     write the latest frame as a PBM image after each message
+       -S secs     print the byte counts every secs seconds
+       -q          do not draw the panel
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <errno.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pcd8544_stream.h"
+
+static volatile sig_atomic_t running = 1;
+static uint8_t frame[STREAM_FRAME];
+static uint32_t messages, keyFrames, badMessages, connections;
+static uint64_t wireBytes;
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static int openListener(const char *target, char *unixPath, int size)
+{
+	const char *colon = strrchr(target, ':');
+	int fd, one = 1;
+
+	unixPath[0] = 0;
+	if (strncmp(target, "unix:", 5) == 0)
+		target += 5;
+	if (target[0] == '/' || colon == NULL)
+	{
+		struct sockaddr_un addr;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, target, sizeof(addr.sun_path) - 1);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(target);
+		if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0)
+			return -1;
+		snprintf(unixPath, size, "%s", target);
+		return fd;
+	}
+	else
+	{
+		struct addrinfo hints, *res;
+		char host[256];
+
+		snprintf(host, sizeof(host), "%.*s", (int)(colon - target), target);
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_flags = AI_PASSIVE;
+		if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res) != 0)
+			return -1;
+		fd = socket(res->ai_family, SOCK_STREAM, 0);
+		if (fd >= 0)
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (fd < 0 || bind(fd, res->ai_addr, res->ai_addrlen) < 0 || listen(fd, 1) < 0)
+		{
+			freeaddrinfo(res);
+			return -1;
+		}
+		freeaddrinfo(res);
+		return fd;
+	}
+}
+
+static int readFull(int fd, uint8_t *p, int n)
+{
+	while (n > 0)
+	{
+		ssize_t got = read(fd, p, n);
+		if (got < 0 && errno == EINTR && running)
+			continue;
+		if (got <= 0)
+			return -1;
+		p += got;
+		n -= got;
+	}
+	return 0;
+}
+
+static int pixel(int x, int y)
+{
+	return (frame[(y / 8) * LCDWIDTH + x] >> (y % 8)) & 1;
+}
+
+static void draw(uint32_t ms, int type, int len)
+{
+	// upper and lower pixel of a cell, as half and full blocks
+	static const char *cell[4] = { " ", "\xe2\x96\x80", "\xe2\x96\x84", "\xe2\x96\x88" };
+	int x, y;
+
+	printf("\033[H");
+	for (y = 0; y < LCDHEIGHT; y += 2)
+	{
+		printf("|");
+		for (x = 0; x < LCDWIDTH; x++)
+			fputs(cell[pixel(x, y) | (pixel(x, y + 1) << 1)], stdout);
+		printf("|\n");
+	}
+	printf("%6u.%03us  %s %3d bytes  \n", ms / 1000, ms % 1000, type == STREAM_KEY ? "key  " : "delta", STREAM_HEADER + len);
+	fflush(stdout);
+}
+
+static void writePbm(const char *path)
+{
+	char tmp[512];
+	FILE *f;
+	int x, y;
+
+	// written aside and renamed, so a reader never sees half a frame
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "w");
+	if (f == NULL)
+		return;
+	fprintf(f, "P1\n%d %d\n", LCDWIDTH, LCDHEIGHT);
+	for (y = 0; y < LCDHEIGHT; y++)
+		for (x = 0; x < LCDWIDTH; x++)
+			fputs(pixel(x, y) ? (x == LCDWIDTH - 1 ? "1\n" : "1 ") : (x == LCDWIDTH - 1 ? "0\n" : "0 "), f);
+	fclose(f);
+	rename(tmp, path);
+}
+
+static void report(void)
+{
+	uint32_t n = messages ? messages : 1;
+
+	printf("%u messages (%u key frames, %u malformed) over %u connections, %.1f bytes per frame against %d raw (%.1f%%)\n",
+		messages, keyFrames, badMessages, connections, (double)wireBytes / n, STREAM_FRAME,
+		wireBytes * 100.0 / n / STREAM_FRAME);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	const char *target = "/tmp/lcdmirror.sock", *pbm = NULL;
+	char unixPath[108];
+	uint8_t header[STREAM_HEADER], payload[65536];
+	int limit = 0, statsEvery = 0, quiet = 0, opt, listenFd;
+	time_t nextStats = 0;
+	struct sigaction sa;
+
+	while ((opt = getopt(argc, argv, "l:n:p:S:q")) != -1)
+	{
+		switch (opt)
+		{
+		case 'l': target = optarg; break;
+		case 'n': limit = atoi(optarg); break;
+		case 'p': pbm = optarg; break;
+		case 'S': statsEvery = atoi(optarg); break;
+		case 'q': quiet = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-l listen] [-n messages] [-p file.pbm] [-S secs] [-q]\n", argv[0]);
+			return 2;
+		}
+	}
+	listenFd = openListener(target, unixPath, sizeof(unixPath));
+	if (listenFd < 0)
+	{
+		fprintf(stderr, "lcdview: cannot listen on %s: %s\n", target, strerror(errno));
+		return 1;
+	}
+	// no SA_RESTART, so a signal gets the viewer out of accept() and read()
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	if (statsEvery)
+		nextStats = time(NULL) + statsEvery;
+	if (!quiet)
+		printf("\033[2J");
+
+	while (running && (!limit || messages < (uint32_t)limit))
+	{
+		int fd = accept(listenFd, NULL, NULL);
+
+		if (fd < 0)
+			continue;
+		connections++;
+		while (running && (!limit || messages < (uint32_t)limit))
+		{
+			uint32_t ms;
+			int len;
+
+			if (readFull(fd, header, STREAM_HEADER) < 0)
+				break;
+			len = header[2] | (header[3] << 8);
+			ms = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t)header[7] << 24);
+			if (header[0] != STREAM_MAGIC || (header[1] != STREAM_KEY && header[1] != STREAM_DELTA))
+			{
+				fprintf(stderr, "lcdview: lost sync, dropping the connection\n");
+				badMessages++;
+				break;
+			}
+			if (readFull(fd, payload, len) < 0)
+				break;
+			if (header[1] == STREAM_KEY)
+			{
+				memset(frame, 0, sizeof(frame));
+				keyFrames++;
+			}
+			if (STREAMdecode(frame, payload, len) < 0)
+				badMessages++;
+			messages++;
+			wireBytes += STREAM_HEADER + len;
+			if (!quiet)
+				draw(ms, header[1], len);
+			if (pbm)
+				writePbm(pbm);
+			if (statsEvery && time(NULL) >= nextStats)
+			{
+				report();
+				nextStats = time(NULL) + statsEvery;
+			}
+		}
+		close(fd);
+	}
+	close(listenFd);
+	if (unixPath[0])
+		unlink(unixPath);
+	report();
+	return 0;
+}
@@ -0,0 +1,395 @@
+/*
+=================================================================================
+ Name        : panelbench.cpp
+ Version     : 0.1
+
+ Description : Check and benchmark for pcd8544_panel.hpp, built against the
+     counting GPIO stub. The Nokia5110 instantiation draws random pixels,
+     rectangles, lines and characters next to the C driver, whose LCD*
+     calls run the same instantiation on pcd8544_buffer (pcd8544_nokia.cpp),
+     and the two frame buffers must stay byte for byte the same; its init
+     and flushes, on the template's own transport, must latch the same
+     command and data bytes, clock the same edges and leave the same
+     display RAM on the stub as PCD8544.c's bus. The 128x64 ST7565 and SSD1306
+     panels flush into a model of their page addressing, which must end up
+     holding the frame buffer. Then each primitive and the flush are timed
+     against PCD8544.c, in alternating rounds, the best round of each kept.
+
+     panelbench [-n checks] [-t ms] [-s seed]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+extern "C" {
+#include "pcd8544_sim.h"
+#include "PCD8544.h"
+}
+#include "pcd8544_panel.hpp"
+
+using namespace pcd8544;
+
+static uint32_t rng = 1;
+static unsigned benchMs = 200;
+
+static uint32_t rnd(void)
+{
+	// xorshift32, repeatable with -s
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static uint32_t rndn(uint32_t n)
+{
+	return n ? rnd() % n : 0;
+}
+
+static uint64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// the page addressing ST7565 and SSD1306 share, data landing where it points
+template <uint16_t W, uint16_t H>
+struct ModelBus
+{
+	uint8_t ram[W * H / 8];
+	uint8_t page, column;
+	uint32_t cmdBytes, dataBytes;
+
+	ModelBus() : page(0), column(0), cmdBytes(0), dataBytes(0)
+	{
+		memset(ram, 0, sizeof(ram));
+	}
+
+	void begin()
+	{
+	}
+
+	void command(uint8_t c)
+	{
+		cmdBytes++;
+		if ((c & 0xF0) == 0xB0)
+			page = c & 0x0F;
+		else if ((c & 0xF0) == 0x10)
+			column = (column & 0x0F) | ((c & 0x0F) << 4);
+		else if ((c & 0xF0) == 0x00)
+			column = (column & 0xF0) | c;
+	}
+
+	void commands(const uint8_t *p, uint16_t n)
+	{
+		while (n--)
+			command(*p++);
+	}
+
+	void data(const uint8_t *p, uint16_t n)
+	{
+		dataBytes += n;
+		while (n--)
+		{
+			if (page < H / 8 && column < W)
+				ram[page * W + column] = *p;
+			p++;
+			column++;
+		}
+	}
+};
+
+static int checkDrawing(Nokia5110 &panel, uint32_t checks)
+{
+	uint32_t i;
+
+	LCDclear();
+	panel.clear();
+	for (i = 0; i < checks; i++)
+	{
+		// some ends past the right edge, both sides clip them
+		uint8_t a = rndn(100), b = rndn(64), c = rndn(100), d = rndn(64), color = rndn(2), op = rndn(5);
+		switch (op)
+		{
+		case 0:
+			LCDsetPixel(a, b, color);
+			panel.setPixel(a, b, color);
+			break;
+		case 1:
+			LCDfillrect(a, b, c, d, color);
+			panel.fillRect(a, b, c, d, color);
+			break;
+		case 2:
+			c = 1 + c % 60;
+			d = 1 + d % 40;
+			LCDdrawrect(a, b, c, d, color);
+			panel.drawRect(a, b, c, d, color);
+			break;
+		case 3:
+			LCDdrawline(a, b, c, d, color);
+			panel.drawLine(a, b, c, d, color);
+			break;
+		default:
+			c = rnd();
+			LCDsetTextColor(color);
+			LCDdrawchar(a, b, c);
+			panel.drawChar(a, b, c, pcd8544_font, color);
+			break;
+		}
+		if (memcmp(pcd8544_buffer, panel.buffer, sizeof(panel.buffer)))
+		{
+			printf("check %-10s FAILED: operation %u (%u at %u,%u %u,%u colour %u) differs\n", "drawing", i, op, a, b, c, d, color);
+			return 1;
+		}
+	}
+	LCDsetTextColor(BLACK);
+	printf("check %-10s ok\n", "drawing");
+	return 0;
+}
+
+static int sameBus(const char *what, const SIMcounters &c, const SIMcounters &t, const uint8_t *ram)
+{
+	if (c.cmdBytes != t.cmdBytes || c.dataBytes != t.dataBytes || c.clocks != t.clocks || c.toggles != t.toggles ||
+		memcmp(ram, SIMram(), LCDWIDTH * LCDHEIGHT / 8))
+	{
+		printf("check %-10s FAILED: %s: C %llu cmd %llu data %llu clocks %llu toggles, template %llu %llu %llu %llu%s\n",
+			"bus", what, (unsigned long long)c.cmdBytes, (unsigned long long)c.dataBytes, (unsigned long long)c.clocks,
+			(unsigned long long)c.toggles, (unsigned long long)t.cmdBytes, (unsigned long long)t.dataBytes,
+			(unsigned long long)t.clocks, (unsigned long long)t.toggles,
+			memcmp(ram, SIMram(), LCDWIDTH * LCDHEIGHT / 8) ? ", display RAM differs" : "");
+		return 1;
+	}
+	return 0;
+}
+
+static int checkBus(Nokia5110 &panel)
+{
+	static uint8_t ram[LCDWIDTH * LCDHEIGHT / 8], shown[LCDWIDTH * LCDHEIGHT / 8];
+	SIMcounters c, t;
+	int i;
+
+	// bring-up leaves the display blank, the first flush sends the whole
+	// frame whatever region it was given and then switches it on
+	for (i = 0; i < (int)sizeof(shown); i++)
+		pcd8544_buffer[i] = panel.buffer[i] = rnd();
+	SIMinit(0, 1, 2, 3, 4);
+	LCDInit(0, 1, 2, 3, 4, 45);
+	SIMgetCounters(&c);
+	memcpy(ram, SIMram(), sizeof(ram));
+	SIMinit(0, 1, 2, 3, 4);
+	panel.begin(45);
+	SIMgetCounters(&t);
+	if (sameBus("init", c, t, ram))
+		return 1;
+	if (SIMdisplayMode() != PCD8544_DISPLAYBLANK)
+	{
+		printf("check %-10s FAILED: display not blank after init\n", "bus");
+		return 1;
+	}
+	SIMinit(0, 1, 2, 3, 4);
+	LCDInit(0, 1, 2, 3, 4, 45);
+	LCDdisplayRegion(10, 8, 20, 8);
+	SIMgetCounters(&c);
+	memcpy(ram, SIMram(), sizeof(ram));
+	SIMinit(0, 1, 2, 3, 4);
+	panel.begin(45);
+	panel.displayRegion(10, 8, 20, 8);
+	SIMgetCounters(&t);
+	if (sameBus("first", c, t, ram))
+		return 1;
+	if (SIMdisplayMode() != PCD8544_DISPLAYNORMAL || memcmp(SIMram(), pcd8544_buffer, sizeof(shown)))
+	{
+		printf("check %-10s FAILED: first flush left the display %s\n", "bus",
+			SIMdisplayMode() != PCD8544_DISPLAYNORMAL ? "blank" : "partly unwritten");
+		return 1;
+	}
+	memcpy(shown, pcd8544_buffer, sizeof(shown));
+
+	for (i = 0; i < 50; i++)
+	{
+		uint8_t x = rndn(LCDWIDTH), y = rndn(LCDHEIGHT), w = 1 + rndn(LCDWIDTH), h = 1 + rndn(LCDHEIGHT);
+
+		LCDfillrect(rndn(84), rndn(48), rndn(40), rndn(30), rndn(2));
+		memcpy(panel.buffer, pcd8544_buffer, sizeof(panel.buffer));
+		SIMresetCounters();
+		if (i % 2)
+			LCDdisplay();
+		else
+			LCDdisplayRegion(x, y, w, h);
+		SIMgetCounters(&c);
+		memcpy(ram, SIMram(), sizeof(ram));
+		// the stub's RAM back to what it was, then the template's turn
+		memcpy(pcd8544_buffer, shown, sizeof(shown));
+		LCDdisplay();
+		SIMresetCounters();
+		if (i % 2)
+			panel.display();
+		else
+			panel.displayRegion(x, y, w, h);
+		SIMgetCounters(&t);
+		memcpy(pcd8544_buffer, panel.buffer, sizeof(panel.buffer));
+		if (sameBus(i % 2 ? "display" : "region", c, t, ram))
+			return 1;
+		// leave both the same for the next round
+		LCDdisplay();
+		memcpy(shown, pcd8544_buffer, sizeof(shown));
+	}
+	printf("check %-10s ok\n", "bus");
+	return 0;
+}
+
+template <class Controller>
+static int checkController(const char *name)
+{
+	typedef Panel<Geometry<128, 64>, Controller, ModelBus<128, 64> > Big;
+	static Big panel;
+	int i;
+
+	// the first flush is always the whole frame, regions are checked after it
+	panel.begin(0x30);
+	panel.display();
+	for (i = 0; i < 200; i++)
+	{
+		int16_t x = rndn(140), y = rndn(70), w = rndn(130), h = rndn(70);
+
+		panel.fillRect((int16_t)rndn(140) - 6, (int16_t)rndn(70) - 6, rndn(60), rndn(40), rndn(2));
+		panel.drawLine(rndn(128), rndn(64), rndn(128), rndn(64), rndn(2));
+		panel.drawString(rndn(128), rndn(64), "0123456789", pcd8544_font, rndn(2));
+		if (i % 3)
+			panel.display();
+		else
+		{
+			// a region leaves everything outside its pages and columns alone
+			static uint8_t before[128 * 8];
+			memcpy(before, panel.bus.ram, sizeof(before));
+			panel.displayRegion(x, y, w, h);
+			for (int p = 0; p < 8; p++)
+				for (int col = 0; col < 128; col++)
+				{
+					bool inside = x < 128 && y < 64 && w > 0 && h > 0 && col >= x && col < x + w &&
+						p >= y / 8 && p <= (y + h - 1 < 63 ? y + h - 1 : 63) / 8;
+					uint8_t want = inside ? panel.buffer[p * 128 + col] : before[p * 128 + col];
+					if (panel.bus.ram[p * 128 + col] != want)
+					{
+						printf("check %-10s FAILED: round %d region %d,%d %dx%d, page %d column %d\n", name, i, x, y, w, h, p, col);
+						return 1;
+					}
+				}
+			continue;
+		}
+		if (memcmp(panel.bus.ram, panel.buffer, sizeof(panel.buffer)))
+		{
+			printf("check %-10s FAILED: round %d, controller RAM differs from the frame buffer\n", name, i);
+			return 1;
+		}
+	}
+	printf("check %-10s ok\n", name);
+	return 0;
+}
+
+#define ROUNDS 8     // each primitive's budget is split into rounds, C and template alternating
+
+// time loop() for a round of the budget, ns per call
+template <class F>
+static double timeLoop(F loop)
+{
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL / ROUNDS, start = nowNs(), elapsed, n = 0;
+
+	do
+	{
+		loop(n);
+		n++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	return (double)elapsed / n;
+}
+
+struct Args
+{
+	uint8_t a, b, c, d;
+};
+
+static void benchAll(Nokia5110 &panel)
+{
+	static Args args[1024];
+	const char *names[] = { "pixel x4032", "fillrect", "line", "char", "display" };
+	double c[5], t[5];
+	int i;
+
+	for (i = 0; i < 1024; i++)
+	{
+		args[i].a = rndn(84);
+		args[i].b = rndn(48);
+		args[i].c = rndn(84);
+		args[i].d = rndn(48);
+	}
+	// the best round of each, so a burst of other load on the box hits neither side
+	for (i = 0; i < 5; i++)
+		c[i] = t[i] = 1e30;
+	for (int r = 0; r < ROUNDS; r++)
+	{
+		c[0] = fmin(c[0], timeLoop([](uint64_t n) { for (uint8_t y = 0; y < 48; y++) for (uint8_t x = 0; x < 84; x++) LCDsetPixel(x, y, (x ^ y ^ n) & 1); }));
+		t[0] = fmin(t[0], timeLoop([&](uint64_t n) { for (uint8_t y = 0; y < 48; y++) for (uint8_t x = 0; x < 84; x++) panel.setPixel(x, y, (x ^ y ^ n) & 1); }));
+		c[1] = fmin(c[1], timeLoop([](uint64_t n) { const Args &g = args[n & 1023]; LCDfillrect(g.a, g.b, g.c, g.d, n & 1); }));
+		t[1] = fmin(t[1], timeLoop([&](uint64_t n) { const Args &g = args[n & 1023]; panel.fillRect(g.a, g.b, g.c, g.d, n & 1); }));
+		c[2] = fmin(c[2], timeLoop([](uint64_t n) { const Args &g = args[n & 1023]; LCDdrawline(g.a, g.b, g.c, g.d, n & 1); }));
+		t[2] = fmin(t[2], timeLoop([&](uint64_t n) { const Args &g = args[n & 1023]; panel.drawLine(g.a, g.b, g.c, g.d, n & 1); }));
+		c[3] = fmin(c[3], timeLoop([](uint64_t n) { const Args &g = args[n & 1023]; LCDdrawchar(g.a, g.b, 'A' + (n & 15)); }));
+		t[3] = fmin(t[3], timeLoop([&](uint64_t n) { const Args &g = args[n & 1023]; panel.drawChar(g.a, g.b, 'A' + (n & 15), pcd8544_font, 1); }));
+		c[4] = fmin(c[4], timeLoop([](uint64_t) { LCDdisplay(); }));
+		t[4] = fmin(t[4], timeLoop([&](uint64_t) { panel.display(); }));
+	}
+
+	printf("\n%-12s %12s %12s %8s\n", "primitive", "C ns", "template ns", "C/tmpl");
+	for (i = 0; i < 5; i++)
+		printf("%-12s %12.1f %12.1f %7.2fx\n", names[i], c[i], t[i], c[i] / t[i]);
+}
+
+int main(int argc, char **argv)
+{
+	static Nokia5110 panel;
+	uint32_t checks = 20000;
+	int opt, failed = 0;
+
+	while ((opt = getopt(argc, argv, "n:t:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': checks = strtoul(optarg, NULL, 0); break;
+		case 't': benchMs = strtoul(optarg, NULL, 0); break;
+		case 's': rng = strtoul(optarg, NULL, 0); if (!rng) rng = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-n checks] [-t ms] [-s seed]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	SIMinit(0, 1, 2, 3, 4);
+	failed += checkBus(panel);
+	failed += checkDrawing(panel, checks);
+	failed += checkController<ST7565Controller>("st7565");
+	failed += checkController<SSD1306Controller>("ssd1306");
+	if (failed)
+	{
+		printf("%d check(s) FAILED\n", failed);
+		return 1;
+	}
+	if (benchMs)
+		benchAll(panel);
+	return 0;
+}
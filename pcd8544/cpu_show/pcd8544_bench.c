@@ -0,0 +1,1059 @@
+/*
+=================================================================================
+ Name        : pcd8544_bench.c
+ Version     : 0.1
+
+ Description : Benchmark and reference-equivalence checker for PCD8544.c.
+     Runs every drawing primitive against the per-pixel reference in
+     pcd8544_ref.c with randomized inputs and compares the whole frame buffer,
+     then times each primitive and LCDdisplay() through the counting GPIO stub
+     in pcd8544_sim.c. Every rotation and mirror is checked pixel by pixel on
+     the stub's display RAM, for whole frames and for random flush regions,
+     and the orientation stage is timed on its own. Dial needles moved in
+     place are checked against freshly drawn dials and timed against them, and
+     text wrapping, marquee windows and the scrolling console are checked
+     against the font, the console on the panel after each flush. The
+     bring-up is checked to keep the display blank until a whole frame is
+     in, and timed from process start. Exits non-zero on the first mismatch.
+
+     Usage: pcd8544_bench [-s seed] [-n checks] [-t ms] [-c]
+       -s seed    random seed (default 1)
+       -n checks  randomized comparisons per primitive (default 20000)
+       -t ms      time budget per benchmark (default 200)
+       -c         check only, skip the timing runs
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "PCD8544.h"
+#include "pcd8544_ref.h"
+#include "pcd8544_dial.h"
+#include "pcd8544_text.h"
+#include "pcd8544_term.h"
+#include "pcd8544_sim.h"
+
+#define BUFSIZE (LCDWIDTH * LCDHEIGHT / 8)
+#define ARGSETS 1024
+
+// pin setup, same as cpushow
+static int _sclk = 0;
+static int _din = 1;
+static int _dc = 2;
+static int _cs = 3;
+static int _rst = 4;
+
+extern const uint8_t pi_logo[];
+
+static uint32_t rng = 1;
+static unsigned int benchMs = 200;
+
+static uint32_t rnd(void)
+{
+	// xorshift32, identical sequence on every platform
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static uint32_t rndn(uint32_t n)
+{
+	return n ? rnd() % n : 0;
+}
+
+static uint64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Equivalence checking
+ */
+
+typedef struct
+{
+	uint8_t a, b, c, d, color, tc, ts;
+	uint8_t bw, bh;
+	uint8_t bitmap[100 * 8];      // bw up to 99 columns by bh up to 63 rows
+	char str[40];
+	int16_t poly[2 * 12];         // up to 12 vertices, some off the screen
+	uint8_t n;
+} Args;
+
+static void randomArgs(Args *g)
+{
+	uint32_t i, len;
+
+	// the reference loops on 8 bit counters, so keep x+w and y+h below 255
+	// or it never terminates; lines take their ends from poly below instead
+	g->a = rndn(8) ? rndn(100) : rndn(255);
+	g->b = rndn(8) ? rndn(64) : rndn(200);
+	g->c = rndn(g->a < 155 ? 100 : 255 - g->a);
+	g->d = rndn(g->b < 185 ? 70 : 255 - g->b);
+	g->color = rndn(2);
+	g->tc = rndn(2);
+	g->ts = 1 + rndn(3);
+	g->bw = rndn(100);
+	g->bh = rndn(64);
+	for (i = 0; i < sizeof(g->bitmap); i++)
+		g->bitmap[i] = rndn(4) ? rnd() : 0;
+	len = rndn(sizeof(g->str));
+	for (i = 0; i < len; i++)
+	{
+		g->str[i] = 1 + rndn(255);
+		if (!rndn(12))
+			g->str[i] = '\n';
+	}
+	g->str[len] = 0;
+	g->n = 3 + rndn(10);
+	for (i = 0; i < 12; i++)
+	{
+		g->poly[2 * i] = rndn(8) ? (int16_t)rndn(124) - 20 : (int16_t)rndn(2400) - 1200;
+		g->poly[2 * i + 1] = rndn(8) ? (int16_t)rndn(88) - 20 : (int16_t)rndn(2400) - 1200;
+	}
+	// as line ends the negative ones wrap to 236-255, off the right or bottom
+}
+
+static void loadBuffers(void)
+{
+	uint32_t i;
+	for (i = 0; i < BUFSIZE; i++)
+		pcd8544_buffer[i] = ref_buffer[i] = rnd();
+}
+
+static int compareBuffers(const char *name, uint32_t iter, const Args *g)
+{
+	uint32_t i;
+	if (!memcmp(pcd8544_buffer, ref_buffer, BUFSIZE))
+		return 0;
+	for (i = 0; i < BUFSIZE; i++)
+	{
+		if (pcd8544_buffer[i] != ref_buffer[i])
+		{
+			printf("MISMATCH %s iteration %u: args (%u,%u,%u,%u) color %u textcolor %u\n",
+				name, iter, g->a, g->b, g->c, g->d, g->color, g->tc);
+			printf("  first difference at column %u page %u: driver 0x%02x reference 0x%02x\n",
+				i % LCDWIDTH, i / LCDWIDTH, pcd8544_buffer[i], ref_buffer[i]);
+			break;
+		}
+	}
+	return 1;
+}
+
+enum { P_PIXEL, P_LINE, P_RECT, P_FILL, P_CIRCLE, P_FILLCIRCLE, P_CHAR, P_STRING, P_BITMAP, P_CLEAR,
+	P_ARC, P_FILLARC, P_POLAR, P_POLYGON, P_TRIANGLE, P_THICKLINE, P_COUNT };
+
+static const char *primName[P_COUNT] = {
+	"pixel", "line", "rect", "fill", "circle", "fillcircle", "char", "string", "bitmap", "clear",
+	"arc", "fillarc", "polar", "polygon", "triangle", "thickline"
+};
+
+// polygon vertices in 1/16 pixel, some of them on exact pixel centres and edges
+static void polygonQ4(const Args *g, int16_t *xy)
+{
+	uint8_t i;
+
+	for (i = 0; i < 2 * g->n; i++)
+		xy[i] = g->d % 3 ? g->poly[i] * 16 + (g->poly[i] * 5 & 15) : g->poly[i] * 16 + 8 * (i & 1);
+}
+
+// angles for the arc primitives: any start, sweeps past 180 and 360 included
+static int16_t angleA(const Args *g)
+{
+	return (int16_t)(g->a * 7 + g->c) - 400;
+}
+
+static int16_t angleB(const Args *g)
+{
+	return angleA(g) + (g->d * 3 + g->color) % 420 - 20;
+}
+
+static void runDriver(int p, const Args *g)
+{
+	int16_t xy[2 * 12];
+
+	switch (p)
+	{
+	case P_PIXEL:      LCDsetPixel(g->a, g->b, g->color); break;
+	case P_LINE:       LCDdrawline(g->poly[0], g->poly[1], g->poly[2], g->poly[3], g->color); break;
+	case P_RECT:       LCDdrawrect(g->a, g->b, g->c, g->d, g->color); break;
+	case P_FILL:       LCDfillrect(g->a, g->b, g->c, g->d, g->color); break;
+	case P_CIRCLE:     LCDdrawcircle(g->a, g->b, g->d % 48, g->color); break;
+	case P_FILLCIRCLE: LCDfillcircle(g->a, g->b, g->d % 48, g->color); break;
+	case P_CHAR:       LCDsetTextColor(g->tc); LCDdrawchar(g->a, g->b, (char)g->c * 3 + g->d); break;
+	case P_STRING:     LCDsetTextColor(g->tc); LCDsetTextSize(g->ts); LCDdrawstring(g->a % LCDWIDTH, g->b % LCDHEIGHT, (char *)g->str); break;
+	case P_BITMAP:     LCDdrawbitmap(g->a, g->b, g->bitmap, g->bw, g->bh, g->color); break;
+	case P_CLEAR:      LCDclear(); break;
+	case P_ARC:        LCDdrawarc(g->a % 120, g->b % 80, g->c % 48, angleA(g), angleB(g), g->color); break;
+	case P_FILLARC:    LCDfillarc(g->a % 120, g->b % 80, g->d % 20, g->c % 48, angleA(g), angleB(g), g->color); break;
+	case P_POLAR:      LCDdrawpolar(48 + g->a % 150, 48 + g->b % 150, angleA(g), g->d % 48, g->c % 48, g->color); break;
+	case P_POLYGON:    polygonQ4(g, xy); LCDfillpolygonQ4(xy, g->n, g->color); break;
+	case P_TRIANGLE:   LCDfilltriangle(g->poly[0], g->poly[1], g->poly[2], g->poly[3], g->poly[4], g->poly[5], g->color); break;
+	case P_THICKLINE:  LCDdrawthickline(g->poly[0], g->poly[1], g->poly[2], g->poly[3], g->d % 12, g->c % 3, g->color); break;
+	}
+}
+
+static void runReference(int p, const Args *g)
+{
+	int16_t xy[2 * 12];
+
+	switch (p)
+	{
+	case P_PIXEL:      REFsetPixel(g->a, g->b, g->color); break;
+	case P_LINE:       REFdrawline(g->poly[0], g->poly[1], g->poly[2], g->poly[3], g->color); break;
+	case P_RECT:       REFdrawrect(g->a, g->b, g->c, g->d, g->color); break;
+	case P_FILL:       REFfillrect(g->a, g->b, g->c, g->d, g->color); break;
+	case P_CIRCLE:     REFdrawcircle(g->a, g->b, g->d % 48, g->color); break;
+	case P_FILLCIRCLE: REFfillcircle(g->a, g->b, g->d % 48, g->color); break;
+	case P_CHAR:       REFsetTextColor(g->tc); REFdrawchar(g->a, g->b, (char)g->c * 3 + g->d); break;
+	case P_STRING:     REFsetTextColor(g->tc); REFsetTextSize(g->ts); REFdrawstring(g->a % LCDWIDTH, g->b % LCDHEIGHT, g->str); break;
+	case P_BITMAP:     REFdrawbitmap(g->a, g->b, g->bitmap, g->bw, g->bh, g->color); break;
+	case P_CLEAR:      REFclear(); break;
+	case P_ARC:        REFfillarc(g->a % 120, g->b % 80, g->c % 48, g->c % 48, angleA(g), angleB(g), g->color); break;
+	case P_FILLARC:    REFfillarc(g->a % 120, g->b % 80, g->d % 20, g->c % 48, angleA(g), angleB(g), g->color); break;
+	case P_POLAR:      REFdrawpolar(48 + g->a % 150, 48 + g->b % 150, angleA(g), g->d % 48, g->c % 48, g->color); break;
+	case P_POLYGON:    polygonQ4(g, xy); REFfillpolygonQ4(xy, g->n, g->color); break;
+	case P_TRIANGLE:   REFfilltriangle(g->poly[0], g->poly[1], g->poly[2], g->poly[3], g->poly[4], g->poly[5], g->color); break;
+	case P_THICKLINE:  REFdrawthickline(g->poly[0], g->poly[1], g->poly[2], g->poly[3], g->d % 12, g->c % 3, g->color); break;
+	}
+}
+
+// LCDInit() sends one command burst and leaves the display blank; the splash
+// or the first flush, whatever its region, puts a whole frame in and switches
+// it on, and only a frame that is not the splash counts as the first one
+static int checkBoot(void)
+{
+	SIMcounters c;
+	LCDstats st;
+	uint32_t i;
+
+	SIMinit(_sclk, _din, _dc, _cs, _rst);
+	LCDInit(_sclk, _din, _dc, _cs, _rst, 45);
+	SIMgetCounters(&c);
+	if (c.resets != 1 || c.cmdBytes != 5 || c.dataBytes || SIMdisplayMode() != PCD8544_DISPLAYBLANK)
+	{
+		printf("check %-10s FAILED: init sent %llu command and %llu data bytes, display mode %u\n", "boot",
+			(unsigned long long)c.cmdBytes, (unsigned long long)c.dataBytes, SIMdisplayMode());
+		return 1;
+	}
+	LCDshowLogo();
+	LCDgetStats(&st);
+	if (SIMdisplayMode() != PCD8544_DISPLAYNORMAL || memcmp(SIMram(), pi_logo, BUFSIZE) || st.firstFrameUs)
+	{
+		printf("check %-10s FAILED: splash not shown or counted as the first frame\n", "boot");
+		return 1;
+	}
+	LCDclear();
+	LCDdrawstring(0, 0, "OBD:        Up");
+	LCDdisplay();
+	LCDgetStats(&st);
+	SIMgetCounters(&c);
+#ifndef PCD8544_NO_STATS
+	if (!st.firstFrameUs)
+	{
+		printf("check %-10s FAILED: first frame not timed\n", "boot");
+		return 1;
+	}
+#endif
+	printf("bring-up on the stub: %u us from process start to LCDInit(), %u us in it, first frame %u us after start,"
+		" %llu command and %llu data bytes with the splash\n", st.startUs, st.initUs, st.firstFrameUs,
+		(unsigned long long)c.cmdBytes, (unsigned long long)c.dataBytes);
+
+	SIMinit(_sclk, _din, _dc, _cs, _rst);
+	LCDInit(_sclk, _din, _dc, _cs, _rst, 45);
+	for (i = 0; i < BUFSIZE; i++)
+		pcd8544_buffer[i] = rnd();
+	LCDdisplayRegion(rndn(LCDWIDTH), rndn(LCDHEIGHT), 1 + rndn(20), 1 + rndn(20));
+	if (SIMdisplayMode() != PCD8544_DISPLAYNORMAL || memcmp(SIMram(), pcd8544_buffer, BUFSIZE))
+	{
+		printf("check %-10s FAILED: a region as the first flush left the panel partly unwritten\n", "boot");
+		return 1;
+	}
+	printf("check %-10s ok\n", "boot");
+	return 0;
+}
+
+static int checkPrimitives(uint32_t checks)
+{
+	static Args g;
+	uint32_t i;
+	int p, failed = 0;
+
+	for (p = 0; p < P_COUNT; p++)
+	{
+		for (i = 0; i < checks; i++)
+		{
+			randomArgs(&g);
+			loadBuffers();
+			runDriver(p, &g);
+			runReference(p, &g);
+			if (compareBuffers(primName[p], i, &g))
+			{
+				failed++;
+				break;
+			}
+		}
+		printf("check %-10s %s\n", primName[p], (i == checks) ? "ok" : "FAILED");
+	}
+	return failed;
+}
+
+static int checkDisplay(uint32_t checks)
+{
+	uint32_t i;
+
+	for (i = 0; i < checks / 100 + 1; i++)
+	{
+		uint32_t j;
+		for (j = 0; j < BUFSIZE; j++)
+			pcd8544_buffer[j] = rnd();
+		LCDdisplay();
+		if (memcmp(SIMram(), pcd8544_buffer, BUFSIZE))
+		{
+			printf("check %-10s FAILED: panel RAM differs from buffer after frame %u\n", "display", i);
+			return 1;
+		}
+	}
+	printf("check %-10s ok\n", "display");
+
+#ifndef PCD8544_NO_STATS
+	// the driver's own counters must agree with what the stub saw on the pins
+	SIMcounters c;
+	LCDstats st;
+	SIMresetCounters();
+	LCDresetStats();
+	LCDdisplay();
+	SIMgetCounters(&c);
+	LCDgetStats(&st);
+	if (st.frames != 1 || st.dataBytes != c.dataBytes || st.commands != c.cmdBytes || st.gpioWrites != c.writes)
+	{
+		printf("check %-10s FAILED: stats %u data %u cmd %llu writes, bus %llu data %llu cmd %llu writes\n", "stats",
+			st.dataBytes, st.commands, (unsigned long long)st.gpioWrites,
+			(unsigned long long)c.dataBytes, (unsigned long long)c.cmdBytes, (unsigned long long)c.writes);
+		return 1;
+	}
+	printf("check %-10s ok\n", "stats");
+#endif
+	return 0;
+}
+
+// where a drawing pixel must land on the panel, worked out per pixel
+static void orientPixel(uint8_t o, int lx, int ly, int *px, int *py)
+{
+	switch (o & 3)
+	{
+	case LCD_ROTATE_0:   *px = lx;                *py = ly; break;
+	case LCD_ROTATE_90:  *px = LCDWIDTH - 1 - ly; *py = lx; break;
+	case LCD_ROTATE_180: *px = LCDWIDTH - 1 - lx; *py = LCDHEIGHT - 1 - ly; break;
+	default:             *px = ly;                *py = LCDHEIGHT - 1 - lx; break;
+	}
+	if (o & LCD_MIRROR_X)
+		*px = LCDWIDTH - 1 - *px;
+	if (o & LCD_MIRROR_Y)
+		*py = LCDHEIGHT - 1 - *py;
+}
+
+static int panelPixel(const uint8_t *ram, int px, int py)
+{
+	return (ram[(py / 8) * LCDWIDTH + px] >> (py % 8)) & 1;
+}
+
+static int drawnPixel(int lx, int ly)
+{
+	return (pcd8544_buffer[(ly / 8) * LCDwidth() + lx] >> (ly % 8)) & 1;
+}
+
+// every rotation and mirror, whole frames and then random regions; outside
+// the pages and columns a region covers the panel must not change
+static int checkOrientation(uint32_t checks)
+{
+	static uint8_t before[BUFSIZE];
+	uint32_t i;
+	int o, lx, ly, px, py;
+
+	for (o = 0; o < 16; o++)
+	{
+		LCDsetOrientation(o);
+		for (i = 0; i < checks / 1000 + 1; i++)
+		{
+			int x = rndn(LCDwidth()), y = rndn(LCDheight()), w = 1 + rndn(LCDwidth()), h = 1 + rndn(LCDheight());
+			int x0 = LCDWIDTH, x1 = -1, p0 = LCDHEIGHT / 8, p1 = -1;
+			uint32_t j;
+
+			for (j = 0; j < LCDBUFSIZE; j++)
+				pcd8544_buffer[j] = rnd();
+			if (i == 0)
+			{
+				x = y = 0;
+				w = LCDwidth();
+				h = LCDheight();
+			}
+			memcpy(before, SIMram(), BUFSIZE);
+			LCDdisplayRegion(x, y, w, h);
+			for (ly = 0; ly < LCDheight(); ly++)
+				for (lx = 0; lx < LCDwidth(); lx++)
+				{
+					if (lx < x || lx >= x + w || ly < y || ly >= y + h)
+						continue;
+					orientPixel(o, lx, ly, &px, &py);
+					if (panelPixel(SIMram(), px, py) != drawnPixel(lx, ly))
+					{
+						printf("check %-10s FAILED: orientation %d region %d,%d %dx%d pixel %d,%d -> panel %d,%d\n",
+							"orient", o, x, y, w, h, lx, ly, px, py);
+						LCDsetOrientation(LCD_ROTATE_0);
+						return 1;
+					}
+					if (px < x0) x0 = px;
+					if (px > x1) x1 = px;
+					if (py / 8 < p0) p0 = py / 8;
+					if (py / 8 > p1) p1 = py / 8;
+				}
+			for (j = 0; j < BUFSIZE; j++)
+				if ((int)(j % LCDWIDTH) < x0 || (int)(j % LCDWIDTH) > x1 || (int)(j / LCDWIDTH) < p0 || (int)(j / LCDWIDTH) > p1)
+					if (SIMram()[j] != before[j])
+					{
+						printf("check %-10s FAILED: orientation %d region %d,%d %dx%d sent panel byte %u outside it\n",
+							"orient", o, x, y, w, h, j);
+						LCDsetOrientation(LCD_ROTATE_0);
+						return 1;
+					}
+		}
+	}
+	LCDsetOrientation(LCD_ROTATE_0);
+	printf("check %-10s ok\n", "orient");
+	return 0;
+}
+
+// a needle moved with DIALset() must leave the frame a fresh DIALdraw() would,
+// and change nothing outside the rectangle it reports
+// a marquee's pixel worked out from the font alone
+static int marqueePixel(const TEXTmarquee *m, const char *text, int n, int x, int y)
+{
+	int k = (m->offset + x - m->x) % m->len, c = k / TEXT_CELL, col = k % TEXT_CELL;
+	int on = c < n && col < 5 && ((pcd8544_font[(uint8_t)text[c] * 5 + col] >> (y - m->y)) & 1);
+
+	return m->color ? on : !on;
+}
+
+static int checkText(uint32_t checks)
+{
+	static TEXTmarquee m;
+	static uint8_t before[BUFSIZE];
+	TEXTspan lines[TEXT_MARQUEE_MAX + 1];
+	char text[TEXT_MARQUEE_MAX + 1];
+	uint32_t i, k;
+	int x, y, n, len, l, c, pos;
+	uint8_t w;
+
+	for (i = 0; i < checks / 20 + 1; i++)
+	{
+		// words of random length, runs of spaces, now and then a newline
+		len = rndn(TEXT_MARQUEE_MAX + 1);
+		for (k = 0; k < (uint32_t)len; k++)
+			text[k] = rndn(5) ? 'a' + rndn(26) : rndn(8) ? ' ' : '\n';
+		text[len] = 0;
+
+		// every line fits, and between them only spaces and newlines are left out
+		w = rndn(LCDWIDTH + 1);
+		pos = 0;
+		n = TEXTwrap(text, w, lines, TEXT_MARQUEE_MAX + 1);
+		for (l = 0; l <= n; l++)
+		{
+			// after the last line, the rest of the text
+			int start = l < n ? lines[l].start : w >= TEXT_CELL ? len : pos;
+			if (l < n && (lines[l].len * TEXT_CELL > w || start < pos))
+			{
+				printf("check %-10s FAILED: wrap %u line %d does not fit %u columns\n", "text", i, l, w);
+				return 1;
+			}
+			for (; pos < start; pos++)
+				if (text[pos] != ' ' && text[pos] != '\n')
+				{
+					printf("check %-10s FAILED: wrap %u dropped '%c' at %d\n", "text", i, text[pos], pos);
+					return 1;
+				}
+			if (l < n)
+				pos = start + lines[l].len;
+		}
+
+		// marquee boxes anywhere, on page boundaries or not, scrolled any distance
+		for (k = 0; k < 16; k++)
+			text[k] = rndn(26) ? 'A' + rndn(26) : ' ';
+		text[rndn(2) ? 16 : 4 + rndn(12)] = 0;
+		n = strlen(text);
+		w = TEXT_CELL + rndn(LCDWIDTH - TEXT_CELL + 1);
+		x = rndn(LCDWIDTH - w + 1);
+		y = rndn(LCDHEIGHT - 7);
+		loadBuffers();
+		LCDsetTextColor(rndn(2));
+		TEXTmarqueeInit(&m, x, y, w, rndn(3));
+		TEXTmarqueeSet(&m, text);
+		for (c = rndn(200); c > 0; c--)
+			TEXTmarqueeTick(&m, 1 + rndn(3));
+		memcpy(before, pcd8544_buffer, BUFSIZE);
+		TEXTmarqueeTick(&m, 1);
+		for (y = 0; y < LCDHEIGHT; y++)
+			for (x = 0; x < LCDWIDTH; x++)
+			{
+				int got = (pcd8544_buffer[(y/8)*LCDWIDTH + x] >> (y%8)) & 1;
+				int inside = x >= m.x && x < m.x + m.w && y >= m.y && y < m.y + 8;
+				int want = inside ? marqueePixel(&m, text, n, x, y) : (before[(y/8)*LCDWIDTH + x] >> (y%8)) & 1;
+				if (got != want)
+				{
+					printf("check %-10s FAILED: marquee %u \"%s\" in %d,%d w %d offset %u, pixel %d,%d\n",
+						"text", i, text, m.x, m.y, m.w, m.offset, x, y);
+					return 1;
+				}
+			}
+	}
+	LCDsetTextColor(BLACK);
+	printf("check %-10s ok\n", "text");
+	return 0;
+}
+
+// the console's lines, kept the plain way: every line, no ring
+#define MODEL_LINES 4096
+static char modelLines[MODEL_LINES][TERM_COLS + 1];
+static uint32_t modelCount, modelCol;
+static int modelOpen, modelBack;
+
+// the view scrolled back as far as it may go, the top row on the oldest line kept
+static int modelMaxBack(uint8_t rows)
+{
+	int kept = modelCount < TERM_LINES ? modelCount : TERM_LINES;
+
+	return kept > rows ? kept - rows : 0;
+}
+
+static void modelWrite(const char *s, uint8_t cols, uint8_t rows)
+{
+	for (; *s && modelCount < MODEL_LINES; s++)
+	{
+		if (*s == '\r')
+			continue;
+		if (*s == '\n' || !modelOpen || modelCol == cols)
+		{
+			// a newline after a newline leaves an empty line, any other character starts one
+			if (*s != '\n' || !modelOpen)
+			{
+				modelLines[modelCount++][0] = 0;
+				modelCol = 0;
+				// a view scrolled back keeps showing the same lines
+				if (modelBack)
+					modelBack = modelBack + 1 < modelMaxBack(rows) ? modelBack + 1 : modelMaxBack(rows);
+			}
+			modelOpen = *s != '\n';
+			if (*s == '\n' || modelCount == MODEL_LINES)
+				continue;
+		}
+		modelLines[modelCount - 1][modelCol++] = *s == '\t' ? ' ' : *s;
+		modelLines[modelCount - 1][modelCol] = 0;
+	}
+}
+
+static int checkTerm(uint32_t checks)
+{
+	static TERMconsole t;
+	static uint8_t before[BUFSIZE];
+	char text[48];
+	uint32_t i, k, step;
+	int p, x, back;
+	uint8_t color;
+
+	for (i = 0; i < checks / 200 + 1; i++)
+	{
+		// a random screen on the panel, the console in any run of pages
+		for (k = 0; k < BUFSIZE; k++)
+			pcd8544_buffer[k] = rnd();
+		LCDdisplay();
+		memcpy(before, pcd8544_buffer, BUFSIZE);
+		p = rndn(LCDHEIGHT / 8);
+		if (TERMinit(&t, p, rndn(LCDHEIGHT / 8 - p + 1), 0) < 0)
+		{
+			printf("check %-10s FAILED: console on pages %d on refused\n", "term", p);
+			return 1;
+		}
+		color = rndn(2);
+		LCDsetTextColor(color);
+		modelCount = modelCol = modelOpen = modelBack = 0;
+		for (step = 0; step < 40; step++)
+		{
+			// short and long lines, blank lines, bursts of many between flushes
+			for (k = rndn(4) ? rndn(20) : rndn(sizeof(text)); k > 0; k--)
+				text[k - 1] = rndn(6) ? ' ' + rndn(95) : rndn(3) ? '\n' : '\t';
+			text[rndn(4) ? rndn(20) : rndn(sizeof(text))] = 0;
+			TERMwrite(&t, text);
+			modelWrite(text, t.cols, t.rows);
+			if (!rndn(8))
+			{
+				back = rndn(2) ? 0 : rndn(80);
+				modelBack = back < modelMaxBack(t.rows) ? back : modelMaxBack(t.rows);
+				TERMscroll(&t, back);
+			}
+			if (rndn(3) && step < 39)
+				continue;
+			TERMflush(&t, step, NULL);
+			back = modelBack;
+			if (t.head != modelCount || t.back != back)
+			{
+				printf("check %-10s FAILED: console %u has %u lines scrolled back %d, not %u and %d\n", "term", i, t.head,
+					t.back, modelCount, back);
+				return 1;
+			}
+			for (p = 0; p < LCDHEIGHT / 8; p++)
+			{
+				const uint8_t *ram = SIMram() + p * LCDWIDTH;
+				int r = p - t.page0;
+				int64_t line = (int64_t)modelCount - back - t.rows + r;
+
+				for (x = 0; x < LCDWIDTH; x++)
+				{
+					int want = before[p * LCDWIDTH + x];
+					if (r >= 0 && r < t.rows)
+					{
+						const char *s = line >= 0 && modelCount - line <= TERM_LINES ? modelLines[line] : "";
+						int c = x / TEXT_CELL, col = x % TEXT_CELL;
+						want = c < (int)strlen(s) && col < 5 ? pcd8544_font[(uint8_t)s[c] * 5 + col] : 0;
+						if (!color)
+							want = (uint8_t)~want;
+					}
+					if (ram[x] != want)
+					{
+						printf("check %-10s FAILED: console %u pages %u+%u step %u back %d, page %d column %d is 0x%02x not 0x%02x\n",
+							"term", i, t.page0, t.rows, step, back, p, x, ram[x], want);
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	LCDsetTextColor(BLACK);
+	printf("check %-10s ok\n", "term");
+	return 0;
+}
+
+static int checkDial(uint32_t checks)
+{
+	static uint8_t background[BUFSIZE], before[BUFSIZE];
+	static LCDdial dial, fresh;
+	uint32_t i, k;
+	int x, y;
+
+	for (i = 0; i < checks / 200 + 1; i++)
+	{
+		uint8_t r = 4 + rndn(20);
+		int16_t a0 = (int16_t)rndn(360) - 180;
+
+		if (DIALinit(&dial, r + rndn(LCDWIDTH - 2 * r), r + rndn(LCDHEIGHT - 2 * r), r, a0, a0 + 1 + rndn(360),
+			0, 1000, rndn(DIAL_MAX_TICKS + 1)) < 0)
+		{
+			printf("check %-10s FAILED: dial %u does not fit\n", "dial", i);
+			return 1;
+		}
+		for (k = 0; k < BUFSIZE; k++)
+			background[k] = rnd();
+		memcpy(pcd8544_buffer, background, BUFSIZE);
+		DIALdraw(&dial, rndn(1000));
+		for (k = 0; k < 20; k++)
+		{
+			int32_t v = (int32_t)rndn(1200) - 100;
+
+			memcpy(before, pcd8544_buffer, BUFSIZE);
+			DIALset(&dial, v);
+			for (y = 0; y < LCDHEIGHT; y++)
+				for (x = 0; x < LCDWIDTH; x++)
+					if (((before[(y/8)*LCDWIDTH + x] ^ pcd8544_buffer[(y/8)*LCDWIDTH + x]) >> (y%8)) & 1 &&
+						(x < dial.dirtyX || x >= dial.dirtyX + dial.dirtyW || y < dial.dirtyY || y >= dial.dirtyY + dial.dirtyH))
+					{
+						printf("check %-10s FAILED: dial %u pixel %d,%d changed outside the reported rectangle\n", "dial", i, x, y);
+						return 1;
+					}
+			memcpy(before, pcd8544_buffer, BUFSIZE);
+			memcpy(pcd8544_buffer, background, BUFSIZE);
+			fresh = dial;
+			DIALdraw(&fresh, v);
+			if (memcmp(before, pcd8544_buffer, BUFSIZE))
+			{
+				printf("check %-10s FAILED: dial %u step %u differs from a fresh draw\n", "dial", i, k);
+				return 1;
+			}
+		}
+	}
+	printf("check %-10s ok\n", "dial");
+	return 0;
+}
+
+/*
+ * Timing
+ */
+
+static Args *argSet;
+
+static double timeLoop(int p, int reference)
+{
+	uint64_t start, elapsed, ops = 0;
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL;
+	uint32_t i;
+
+	start = nowNs();
+	do
+	{
+		for (i = 0; i < ARGSETS; i++)
+		{
+			if (reference)
+				runReference(p, &argSet[i]);
+			else
+				runDriver(p, &argSet[i]);
+		}
+		ops += ARGSETS;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	return (double)elapsed / ops;
+}
+
+static void benchPrimitives(void)
+{
+	uint32_t i;
+	int p;
+
+	// on-screen arguments so the timings reflect real drawing, not clipping
+	argSet = calloc(ARGSETS, sizeof(Args));
+	for (i = 0; i < ARGSETS; i++)
+	{
+		Args *g = &argSet[i];
+		randomArgs(g);
+		g->a = rndn(LCDWIDTH);
+		g->b = rndn(LCDHEIGHT);
+		g->c = rndn(LCDWIDTH);
+		g->d = rndn(LCDHEIGHT);
+		g->bw = 8 + rndn(24);
+		g->bh = 8 + rndn(24);
+		strcpy(g->str, "RPM 2450 73C");
+	}
+
+	printf("\n%-12s %14s %14s %9s\n", "primitive", "driver ns/op", "reference ns/op", "speedup");
+	for (p = 0; p < P_COUNT; p++)
+	{
+		double drv = timeLoop(p, 0);
+		double ref = timeLoop(p, 1);
+		printf("%-12s %14.1f %14.1f %8.2fx\n", primName[p], drv, ref, ref / drv);
+	}
+	free(argSet);
+}
+
+static void benchDisplay(void)
+{
+	SIMcounters c;
+	uint64_t start, elapsed, frames = 0;
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL;
+
+	memcpy(pcd8544_buffer, pi_logo, BUFSIZE);
+	SIMresetCounters();
+	start = nowNs();
+	do
+	{
+		LCDdisplay();
+		frames++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	SIMgetCounters(&c);
+
+	printf("\n%-12s %14.1f ns/frame (GPIO stub, excludes real bus time)\n", "display", (double)elapsed / frames);
+	printf("%-12s %14.1f digitalWrite calls/frame\n", "", (double)c.writes / frames);
+	printf("%-12s %14.1f GPIO toggles/frame\n", "", (double)c.toggles / frames);
+	printf("%-12s %14.1f data bytes/frame\n", "", (double)c.dataBytes / frames);
+	printf("%-12s %14.1f command bytes/frame\n", "", (double)c.cmdBytes / frames);
+}
+
+// moving a needle against redrawing the dial, and what each sends to the panel
+static void benchDial(void)
+{
+	static LCDdial dial;
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL, start, elapsed, moves = 0, redraws = 0;
+	uint64_t moveBytes = 0, fullBytes = 0;
+	LCDstats st;
+	int32_t v = 0;
+
+	DIALinit(&dial, 23, 23, 22, -135, 135, 0, 8000, 9);
+	LCDclear();
+	DIALdraw(&dial, 0);
+	start = nowNs();
+	do
+	{
+		v = (v + 1237) % 8000;
+		DIALset(&dial, v);
+		moves++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	double moveNs = (double)elapsed / moves;
+	start = nowNs();
+	do
+	{
+		v = (v + 1237) % 8000;
+		DIALdraw(&dial, v);
+		redraws++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	double drawNs = (double)elapsed / redraws;
+
+	for (moves = 0; moves < 100; moves++)
+	{
+		v = (v + 1237) % 8000;
+		LCDresetStats();
+		DIALset(&dial, v);
+		LCDdisplayRegion(dial.dirtyX, dial.dirtyY, dial.dirtyW, dial.dirtyH);
+		LCDgetStats(&st);
+		moveBytes += st.dataBytes + st.commands;
+		LCDresetStats();
+		LCDdisplayRegion(dial.x, dial.y, dial.w, dial.h);
+		LCDgetStats(&st);
+		fullBytes += st.dataBytes + st.commands;
+	}
+	printf("\n%-12s %14.1f ns/needle move, %.1f ns/whole dial, %.1f bus bytes/move against %.1f for the dial\n",
+		"dial r=22", moveNs, drawNs, moveBytes / 100.0, fullBytes / 100.0);
+}
+
+// the orientation stage alone, a whole frame per call
+static void benchOrientation(void)
+{
+	static const uint8_t modes[] = { LCD_ROTATE_0, LCD_ROTATE_180, LCD_MIRROR_X, LCD_ROTATE_90, LCD_ROTATE_270 };
+	static const char *names[] = { "rotate 0", "rotate 180", "mirror x", "rotate 90", "rotate 270" };
+	static uint8_t frame[BUFSIZE];
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL;
+	uint32_t i;
+
+	printf("\n%-12s %14s\n", "orientation", "ns/frame");
+	for (i = 0; i < sizeof(modes); i++)
+	{
+		uint64_t start, elapsed, frames = 0;
+		uint32_t j;
+
+		LCDsetOrientation(modes[i]);
+		for (j = 0; j < LCDBUFSIZE; j++)
+			pcd8544_buffer[j] = rnd();
+		start = nowNs();
+		do
+		{
+			LCDorientFrame(pcd8544_buffer, frame);
+			frames++;
+			elapsed = nowNs() - start;
+		} while (elapsed < budget);
+		printf("%-12s %14.1f\n", names[i], (double)elapsed / frames);
+	}
+	LCDsetOrientation(LCD_ROTATE_0);
+}
+
+static void benchText(void)
+{
+	static TEXTmarquee m;
+	const char *text = "P0420 Catalyst system efficiency below threshold (bank 1)";
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL, start, elapsed, ticks = 0, redraws = 0;
+	uint64_t tickBytes = 0, fullBytes = 0;
+	LCDstats st;
+	int shift = 0;
+
+	LCDclear();
+	TEXTmarqueeInit(&m, 0, 40, LCDWIDTH, 0);
+	TEXTmarqueeSet(&m, text);
+	start = nowNs();
+	do
+	{
+		TEXTmarqueeTick(&m, 1);
+		ticks++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	double tickNs = (double)elapsed / ticks;
+	// without it: clear the line and draw the string again a pixel further left,
+	// only the characters that fit whole, as LCDdrawchar() allows
+	start = nowNs();
+	do
+	{
+		int i, x;
+		shift = (shift + 1) % (int)(strlen(text) * TEXT_CELL);
+		LCDfillrect(0, 40, LCDWIDTH, 8, WHITE);
+		for (i = 0; text[i]; i++)
+		{
+			x = i * TEXT_CELL - shift;
+			if (x >= 0 && x + 5 < LCDWIDTH)
+				LCDdrawchar(x, 40, text[i]);
+		}
+		redraws++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	double drawNs = (double)elapsed / redraws;
+
+	for (ticks = 0; ticks < 100; ticks++)
+	{
+		LCDresetStats();
+		TEXTmarqueeTick(&m, 1);
+		LCDdisplayRegion(m.dirtyX, m.dirtyY, m.dirtyW, m.dirtyH);
+		LCDgetStats(&st);
+		tickBytes += st.dataBytes + st.commands;
+		LCDresetStats();
+		LCDdisplay();
+		LCDgetStats(&st);
+		fullBytes += st.dataBytes + st.commands;
+	}
+	printf("%-12s %14.1f ns/marquee step, %.1f ns/line redraw, %.1f bus bytes/step against %.1f for the frame\n",
+		"marquee", tickNs, drawNs, tickBytes / 100.0, fullBytes / 100.0);
+}
+
+// a log line at a time: the rows moved up in place against the console drawn
+// again, the bus bytes of each, and a burst
+static void benchTerm(void)
+{
+	static TERMconsole t;
+	uint64_t budget = (uint64_t)benchMs * 1000000ULL, start, elapsed, n;
+	double scrollNs, redrawNs, burstUs;
+	char text[16], shown[LCDHEIGHT / 8][16];
+	uint64_t lineBytes = 0, windowBytes = 0, growBytes = 0, frameBytes;
+	SIMcounters c;
+	int i;
+
+	LCDclear();
+	TERMinit(&t, 0, 0, 0);
+	n = 0;
+	start = nowNs();
+	do
+	{
+		snprintf(text, sizeof(text), "%06u OBD ok\n", (unsigned)(n & 0xffff));
+		TERMwrite(&t, text);
+		TERMrender(&t, 0);
+		n++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	scrollNs = (double)elapsed / n;
+
+	// without it: the last six lines drawn again
+	memset(shown, 0, sizeof(shown));
+	n = 0;
+	start = nowNs();
+	do
+	{
+		memmove(shown[0], shown[1], sizeof(shown) - sizeof(shown[0]));
+		snprintf(shown[LCDHEIGHT / 8 - 1], sizeof(shown[0]), "%06u OBD ok", (unsigned)(n & 0xffff));
+		LCDclear();
+		for (i = 0; i < LCDHEIGHT / 8; i++)
+			LCDdrawstring(0, i * 8, shown[i]);
+		n++;
+		elapsed = nowNs() - start;
+	} while (elapsed < budget);
+	redrawNs = (double)elapsed / n;
+
+	// on the bus: a line on the whole screen, in four rows under two status rows,
+	// and a character at a time, a new line every 14
+	LCDclear();
+	LCDdisplay();
+	SIMresetCounters();
+	LCDdisplay();
+	SIMgetCounters(&c);
+	frameBytes = c.dataBytes + c.cmdBytes;
+	for (i = 0; i < 3; i++)
+	{
+		TERMinit(&t, i == 1 ? 2 : 0, 0, 0);
+		for (n = 0; n < 12; n++)
+		{
+			snprintf(text, sizeof(text), "%06u OBD ok\n", (unsigned)n);
+			TERMwrite(&t, i == 2 ? "...." : text);
+			TERMflush(&t, 0, NULL);
+		}
+		SIMresetCounters();
+		for (n = 0; n < 100; n++)
+		{
+			snprintf(text, sizeof(text), "%06u OBD ok\n", (unsigned)n);
+			if (i == 2)
+			{
+				text[0] = '0' + n % 10;
+				text[1] = 0;
+			}
+			TERMwrite(&t, text);
+			TERMflush(&t, 0, NULL);
+		}
+		SIMgetCounters(&c);
+		*(i == 0 ? &lineBytes : i == 1 ? &windowBytes : &growBytes) = c.dataBytes + c.cmdBytes;
+	}
+
+	// a hundred lines at once, then the one flush the rate limit lets through
+	TERMinit(&t, 0, 0, 200);
+	TERMflush(&t, 0, NULL);
+	SIMresetCounters();
+	start = nowNs();
+	for (i = 0; i < 100; i++)
+	{
+		snprintf(text, sizeof(text), "%06d burst\n", i);
+		TERMwrite(&t, text);
+		TERMflush(&t, i, NULL);
+	}
+	TERMflush(&t, 200, NULL);
+	burstUs = (nowNs() - start) / 1000.0;
+	SIMgetCounters(&c);
+
+	printf("%-12s %14.1f ns/line moved in, %.1f ns/console redrawn\n", "console", scrollNs, redrawNs);
+	printf("%-12s %14.1f bus bytes/line, %.1f in 4 rows, %.1f/character, %llu for the frame\n", "",
+		lineBytes / 100.0, windowBytes / 100.0, growBytes / 100.0, (unsigned long long)frameBytes);
+	printf("%-12s %14.1f us for 100 lines in a burst, %u flush, %u put off, %llu bus bytes\n",
+		"", burstUs, t.stats.flushes - 1, t.stats.limited, (unsigned long long)(c.dataBytes + c.cmdBytes));
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t checks = 20000;
+	int checkOnly = 0, opt, failed;
+
+	while ((opt = getopt(argc, argv, "s:n:t:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 's': rng = strtoul(optarg, NULL, 0); if (!rng) rng = 1; break;
+		case 'n': checks = strtoul(optarg, NULL, 0); break;
+		case 't': benchMs = strtoul(optarg, NULL, 0); break;
+		case 'c': checkOnly = 1; break;
+		default:
+			fprintf(stderr, "usage: %s [-s seed] [-n checks] [-t ms] [-c]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	printf("Raspberry Pi PCD8544 driver benchmark\n");
+	printf("========================================\n");
+
+	failed = checkBoot();
+	failed += checkPrimitives(checks);
+	failed += checkDisplay(checks);
+	failed += checkOrientation(checks);
+	failed += checkDial(checks);
+	failed += checkText(checks);
+	failed += checkTerm(checks);
+	if (failed)
+	{
+		printf("%d check(s) FAILED\n", failed);
+		return 1;
+	}
+	if (!checkOnly)
+	{
+		benchPrimitives();
+		benchDisplay();
+		benchOrientation();
+		benchDial();
+		benchText();
+		benchTerm();
+	}
+	return 0;
+}
@@ -0,0 +1,139 @@
+/*
+=================================================================================
+ Name        : pcd8544_dial.c
+ Version     : 0.1
+
+ Description : Round gauges with a moving needle for the PCD8544 driver,
+     see pcd8544_dial.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include "pcd8544_dial.h"
+
+int DIALinit(LCDdial *d, uint8_t cx, uint8_t cy, uint8_t r, int16_t a0, int16_t a1,
+	int32_t min, int32_t max, uint8_t ticks)
+{
+	int16_t ox, oy, ix, iy;
+	uint8_t i;
+
+	if (r < 4 || cx < r || cy < r || cx + r >= LCDwidth() || cy + r >= LCDheight() ||
+		a1 <= a0 || a1 - a0 > 360 || max == min || ticks > DIAL_MAX_TICKS)
+		return -1;
+	memset(d, 0, sizeof(*d));
+	d->cx = cx;
+	d->cy = cy;
+	d->r = r;
+	d->a0 = a0;
+	d->a1 = a1;
+	d->min = min;
+	d->max = max;
+	d->ticks = ticks;
+	d->tickLen = r / 5 + 1;
+	d->hub = r / 8 + 1;
+	d->needle = r - d->tickLen - 1;
+	// tick ends are the same for every frame, work them out once
+	for (i = 0; i < ticks; i++)
+	{
+		int16_t a = ticks > 1 ? a0 + (int32_t)(a1 - a0) * i / (ticks - 1) : a0;
+		LCDpolar(a, r, &ox, &oy);
+		LCDpolar(a, r - d->tickLen, &ix, &iy);
+		d->tick[i][0] = ox;
+		d->tick[i][1] = oy;
+		d->tick[i][2] = ix;
+		d->tick[i][3] = iy;
+	}
+	d->x = cx - r;
+	d->w = 2 * r + 1;
+	d->y = (cy - r) / 8 * 8;
+	d->h = ((cy + r) / 8 + 1) * 8 - d->y;
+	if (d->y + d->h > LCDheight())
+		d->h = LCDheight() - d->y;
+	d->shown = DIAL_NONE;
+	return 0;
+}
+
+int16_t DIALangle(const LCDdial *d, int32_t value)
+{
+	if ((d->max > d->min) ? value <= d->min : value >= d->min)
+		return d->a0;
+	if ((d->max > d->min) ? value >= d->max : value <= d->max)
+		return d->a1;
+	return d->a0 + (int64_t)(value - d->min) * (d->a1 - d->a0) / (d->max - d->min);
+}
+
+void DIALdraw(LCDdial *d, int32_t value)
+{
+	uint8_t p, i;
+
+	LCDfillrect(d->x, d->y, d->w, d->h, WHITE);
+	LCDdrawarc(d->cx, d->cy, d->r, d->a0, d->a1, BLACK);
+	for (i = 0; i < d->ticks; i++)
+		LCDdrawline(d->cx + d->tick[i][0], d->cy + d->tick[i][1], d->cx + d->tick[i][2], d->cy + d->tick[i][3], BLACK);
+	LCDfillcircle(d->cx, d->cy, d->hub, BLACK);
+	for (p = 0; p < (d->h + 7) / 8; p++)
+		memcpy(d->face + p * d->w, pcd8544_buffer + (d->y / 8 + p) * LCDwidth() + d->x, d->w);
+
+	d->shown = DIALangle(d, value);
+	LCDdrawpolar(d->cx, d->cy, d->shown, d->hub + 1, d->needle, BLACK);
+	d->dirtyX = d->x;
+	d->dirtyY = d->y;
+	d->dirtyW = d->w;
+	d->dirtyH = d->h;
+}
+
+// columns and rows the needle at angle a covers, as a box
+static void needleBox(const LCDdial *d, int16_t a, int16_t *x0, int16_t *y0, int16_t *x1, int16_t *y1)
+{
+	int16_t ax, ay, bx, by;
+
+	LCDpolar(a, d->hub + 1, &ax, &ay);
+	LCDpolar(a, d->needle, &bx, &by);
+	*x0 = d->cx + (ax < bx ? ax : bx);
+	*x1 = d->cx + (ax < bx ? bx : ax);
+	*y0 = d->cy + (ay < by ? ay : by);
+	*y1 = d->cy + (ay < by ? by : ay);
+}
+
+int DIALset(LCDdial *d, int32_t value)
+{
+	int16_t a = DIALangle(d, value), ox0, oy0, ox1, oy1, nx0, ny0, nx1, ny1, x, p;
+	uint8_t stride = LCDwidth();
+
+	if (a == d->shown)
+		return 0;
+	if (d->shown == DIAL_NONE)
+	{
+		DIALdraw(d, value);
+		return 1;
+	}
+	// rub out the old needle, then put back the face bytes its box covers
+	needleBox(d, d->shown, &ox0, &oy0, &ox1, &oy1);
+	LCDdrawpolar(d->cx, d->cy, d->shown, d->hub + 1, d->needle, WHITE);
+	for (p = oy0 / 8; p <= oy1 / 8; p++)
+	{
+		uint8_t *row = pcd8544_buffer + p * stride;
+		const uint8_t *face = d->face + (p - d->y / 8) * d->w - d->x;
+		for (x = ox0; x <= ox1; x++)
+			row[x] |= face[x];
+	}
+	d->shown = a;
+	LCDdrawpolar(d->cx, d->cy, a, d->hub + 1, d->needle, BLACK);
+
+	needleBox(d, a, &nx0, &ny0, &nx1, &ny1);
+	d->dirtyX = ox0 < nx0 ? ox0 : nx0;
+	d->dirtyY = oy0 < ny0 ? oy0 : ny0;
+	d->dirtyW = (ox1 > nx1 ? ox1 : nx1) - d->dirtyX + 1;
+	d->dirtyH = (oy1 > ny1 ? oy1 : ny1) - d->dirtyY + 1;
+	return 1;
+}
@@ -0,0 +1,60 @@
+/*
+=================================================================================
+ Name        : pcd8544_dial.h
+ Version     : 0.1
+
+ Description : Round gauges (RPM, coolant) on the PCD8544: a scale arc,
+     tick marks and a needle turning about a hub. Angles are whole degrees
+     clockwise from 12 o'clock, so a usual gauge runs from -135 to 135.
+
+     DIALinit() works out the geometry once, tick ends included, from the
+     driver's fixed point sine table. DIALdraw() draws the face into
+     pcd8544_buffer and keeps a copy of it. DIALset() then moves the needle
+     by rubbing out the old one, putting back the face bytes under it, and
+     drawing the new one; nothing else in the frame is touched, and the
+     rectangle it changed is left in dirtyX/Y/W/H for LCDdisplayRegion().
+     Anything to show inside the dial's box (a label, the value) is drawn
+     before DIALdraw(), so it is part of the face.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_DIAL_H
+#define PCD8544_DIAL_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+
+#define DIAL_MAX_TICKS 16
+#define DIAL_NONE -32768        // no needle drawn yet
+
+typedef struct
+{
+	uint8_t cx, cy, r;          // centre and radius of the scale arc
+	int16_t a0, a1;             // scale from a0 clockwise to a1
+	int32_t min, max;           // values at a0 and a1
+	uint8_t ticks, tickLen;     // tick marks, and how far in from the arc they reach
+	uint8_t hub, needle;        // hub radius, needle tip radius
+	int8_t tick[DIAL_MAX_TICKS][4];    // tick ends from the centre, outer x y then inner x y
+	uint8_t x, y, w, h;         // box the dial covers, whole pages high
+	uint8_t face[LCDBUFSIZE];   // the box's page bytes without the needle
+	int16_t shown;              // needle angle on the face
+	uint8_t dirtyX, dirtyY, dirtyW, dirtyH;   // what the last DIALset() changed
+} LCDdial;
+
+ int DIALinit(LCDdial *dial, uint8_t cx, uint8_t cy, uint8_t r, int16_t a0, int16_t a1,
+	int32_t min, int32_t max, uint8_t ticks);     // -1 if it does not fit the screen
+ void DIALdraw(LCDdial *dial, int32_t value);     // face and needle into pcd8544_buffer
+ int DIALset(LCDdial *dial, int32_t value);       // 1 if the needle moved
+ int16_t DIALangle(const LCDdial *dial, int32_t value);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+=================================================================================
+ Name        : pcd8544_gray.c
+ Version     : 0.1
+
+ Description : Temporal dithering grayscale mode for the PCD8544 driver,
+     see pcd8544_gray.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "pcd8544_gray.h"
+
+#define BUFSIZE (LCDWIDTH * LCDHEIGHT / 8)
+
+// unchanged bytes inside a run are resent when that is no dearer than the
+// two address commands needed to skip them
+#define GRAY_GAP 2
+
+// bits of a page byte whose dither phase (x + y) % 3 is ph, by (x + 8 * page) % 3;
+// spreading the phase along diagonals keeps a gray area from blinking as a whole
+static const uint8_t phaseMask[3][3] = {
+	{ 0x49, 0x92, 0x24 },
+	{ 0x24, 0x49, 0x92 },
+	{ 0x92, 0x24, 0x49 },
+};
+
+// drawing surface, high and low bit of each level in pcd8544_buffer's layout
+static uint8_t surfHi[BUFSIZE], surfLo[BUFSIZE];
+
+// planes handed over by GRAYcommit() and the ones being cycled
+static uint8_t pending[GRAY_PHASES][BUFSIZE];
+static uint8_t active[GRAY_PHASES][BUFSIZE];
+static uint8_t havePending;
+
+// what the panel's display RAM holds
+static uint8_t shown[BUFSIZE];
+static uint8_t shownValid;
+static uint8_t phase;
+
+static pthread_mutex_t grayMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t refreshThread;
+static volatile uint8_t running;
+static uint64_t startNs;
+static GRAYstats stats;
+
+static uint64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void paint(uint16_t i, uint8_t mask, uint8_t level)
+{
+	surfHi[i] = (level & 2) ? surfHi[i] | mask : surfHi[i] & ~mask;
+	surfLo[i] = (level & 1) ? surfLo[i] | mask : surfLo[i] & ~mask;
+}
+
+void GRAYclear(uint8_t level)
+{
+	memset(surfHi, (level & 2) ? 0xFF : 0, BUFSIZE);
+	memset(surfLo, (level & 1) ? 0xFF : 0, BUFSIZE);
+}
+
+void GRAYsetPixel(uint8_t x, uint8_t y, uint8_t level)
+{
+	if ((x >= LCDWIDTH) || (y >= LCDHEIGHT))
+		return;
+	paint(x + (y/8)*LCDWIDTH, 1 << (y%8), level);
+}
+
+uint8_t GRAYgetPixel(uint8_t x, uint8_t y)
+{
+	uint16_t i = x + (y/8)*LCDWIDTH;
+
+	if ((x >= LCDWIDTH) || (y >= LCDHEIGHT))
+		return 0;
+	return (((surfHi[i] >> (y%8)) & 1) << 1) | ((surfLo[i] >> (y%8)) & 1);
+}
+
+// the clipped block [x, x+w) x [y, y+h) a page byte at a time, as fillblock()
+void GRAYfillrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t level)
+{
+	uint16_t x1 = x + w, y1 = y + h, i;
+	uint8_t p;
+
+	if (x >= LCDWIDTH || y >= LCDHEIGHT || !w || !h)
+		return;
+	if (x1 > LCDWIDTH)
+		x1 = LCDWIDTH;
+	if (y1 > LCDHEIGHT)
+		y1 = LCDHEIGHT;
+	for (p = y/8; p <= (y1-1)/8; p++)
+	{
+		uint8_t lo = (y > p*8) ? y - p*8 : 0;
+		uint8_t hi = (y1 < (p+1)*8) ? y1 - p*8 : 8;
+		uint8_t mask = (0xFF << lo) & (0xFF >> (8 - hi));
+		for (i = x; i < x1; i++)
+			paint(p*LCDWIDTH + i, mask, level);
+	}
+}
+
+void GRAYfromMono(uint8_t level)
+{
+	uint16_t i;
+
+	for (i = 0; i < BUFSIZE; i++)
+		if (pcd8544_buffer[i])
+			paint(i, pcd8544_buffer[i], level);
+}
+
+// plane k lights level 3 always, level 2 unless the pixel's phase is the one
+// left out this frame and level 1 only in its own phase
+void GRAYcommit(void)
+{
+	static uint8_t planes[GRAY_PHASES][BUFSIZE];
+	uint16_t i;
+	uint8_t k;
+
+	for (i = 0; i < BUFSIZE; i++)
+	{
+		const uint8_t *m = phaseMask[(i % LCDWIDTH + (i / LCDWIDTH) * 8) % 3];
+		uint8_t hi = surfHi[i], lo = surfLo[i];
+		for (k = 0; k < GRAY_PHASES; k++)
+			planes[k][i] = (hi & lo) | (hi & ~lo & ~m[(5 - k) % 3]) | (~hi & lo & m[(3 - k) % 3]);
+	}
+	// a panel turned 180 or mirrored gets the planes in its own layout
+	if (LCDgetOrientation() != LCD_ROTATE_0)
+		for (k = 0; k < GRAY_PHASES; k++)
+		{
+			uint8_t turned[BUFSIZE];
+			LCDorientFrame(planes[k], turned);
+			memcpy(planes[k], turned, BUFSIZE);
+		}
+	pthread_mutex_lock(&grayMutex);
+	memcpy(pending, planes, sizeof(pending));
+	havePending = 1;
+	pthread_mutex_unlock(&grayMutex);
+}
+
+// changed runs of the plane, addressed linearly: the controller moves on to the
+// next page by itself after column 83
+static void sendPlane(const uint8_t *plane, uint32_t *data, uint32_t *cmds)
+{
+	uint16_t i = 0, start, end;
+
+	while (i < BUFSIZE)
+	{
+		if (shownValid && plane[i] == shown[i])
+		{
+			i++;
+			continue;
+		}
+		start = i;
+		end = i + 1;
+		for (i = end; i < BUFSIZE; i++)
+		{
+			if (!shownValid || plane[i] != shown[i])
+				end = i + 1;
+			else if (i + 1 - end > GRAY_GAP)
+				break;
+		}
+		LCDcommand(PCD8544_SETYADDR | (start / LCDWIDTH));
+		LCDcommand(PCD8544_SETXADDR | (start % LCDWIDTH));
+		LCDdataRun(plane + start, end - start);
+		memcpy(shown + start, plane + start, end - start);
+		*data += end - start;
+		*cmds += 2;
+		i = end;
+	}
+	if (*cmds)
+	{
+		LCDcommand(PCD8544_SETYADDR);   // as LCDdisplay() ends its frames
+		(*cmds)++;
+	}
+	// a whole plane went out, a panel still blank from LCDInit() can show it
+	if (!shownValid)
+		*cmds += LCDunblank();
+	shownValid = 1;
+}
+
+int GRAYtick(void)
+{
+	uint64_t start = nowNs();
+	uint32_t data = 0, cmds = 0;
+	uint8_t sent = phase, took = 0;
+
+	// a new surface only ever starts at the top of a cycle
+	if (phase == 0)
+	{
+		pthread_mutex_lock(&grayMutex);
+		if (havePending)
+		{
+			memcpy(active, pending, sizeof(active));
+			havePending = 0;
+			took = 1;
+		}
+		pthread_mutex_unlock(&grayMutex);
+	}
+	sendPlane(active[sent], &data, &cmds);
+	phase = (phase + 1) % GRAY_PHASES;
+
+	pthread_mutex_lock(&grayMutex);
+	stats.frames++;
+	stats.commits += took;
+	stats.cycles += phase == 0;
+	stats.dataBytes += data;
+	stats.cmdBytes += cmds;
+	stats.bytesSkipped += BUFSIZE - data;
+	stats.busyNs += nowNs() - start;
+	pthread_mutex_unlock(&grayMutex);
+	return sent;
+}
+
+static void *refresh(void *arg)
+{
+	uint64_t period = 1000000000ULL / stats.hz, next = nowNs(), now;
+	struct timespec ts;
+
+	(void)arg;
+	while (running)
+	{
+		next += period;
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0 && running)
+			;
+		now = nowNs();
+		uint32_t us = now > next ? (now - next) / 1000 : 0;
+		uint8_t bucket = us ? 31 - __builtin_clz(us) : 0;
+		if (bucket >= GRAY_HIST_BUCKETS)
+			bucket = GRAY_HIST_BUCKETS - 1;
+		pthread_mutex_lock(&grayMutex);
+		stats.lateHist[bucket]++;
+		if (us > stats.maxLateUs)
+			stats.maxLateUs = us;
+		pthread_mutex_unlock(&grayMutex);
+
+		GRAYtick();
+
+		// keep to the grid: deadlines already gone are dropped, not made up
+		now = nowNs();
+		while (now >= next + period)
+		{
+			next += period;
+			pthread_mutex_lock(&grayMutex);
+			stats.overruns++;
+			pthread_mutex_unlock(&grayMutex);
+		}
+	}
+	return NULL;
+}
+
+int GRAYstart(uint16_t hz)
+{
+	// the surface is 84x48, portrait orientations are not supported
+	if (running || hz == 0 || LCDwidth() != LCDWIDTH)
+		return -1;
+	// whatever LCDdisplay() left on the panel is not known here
+	shownValid = 0;
+	phase = 0;
+	stats.hz = hz;
+	startNs = nowNs();
+	running = 1;
+	if (pthread_create(&refreshThread, NULL, refresh, NULL) != 0)
+	{
+		running = 0;
+		stats.hz = 0;
+		return -1;
+	}
+	return 0;
+}
+
+void GRAYstop(void)
+{
+	if (!running)
+		return;
+	running = 0;
+	pthread_join(refreshThread, NULL);
+	pthread_mutex_lock(&grayMutex);
+	stats.elapsedNs += nowNs() - startNs;
+	stats.hz = 0;
+	pthread_mutex_unlock(&grayMutex);
+}
+
+int GRAYrunning(void)
+{
+	return running;
+}
+
+void GRAYgetStats(GRAYstats *s)
+{
+	pthread_mutex_lock(&grayMutex);
+	*s = stats;
+	if (running)
+		s->elapsedNs += nowNs() - startNs;
+	pthread_mutex_unlock(&grayMutex);
+}
+
+void GRAYresetStats(void)
+{
+	pthread_mutex_lock(&grayMutex);
+	uint32_t hz = stats.hz;
+	memset(&stats, 0, sizeof(stats));
+	stats.hz = hz;
+	if (running)
+		startNs = nowNs();
+	pthread_mutex_unlock(&grayMutex);
+}
@@ -0,0 +1,76 @@
+/*
+=================================================================================
+ Name        : pcd8544_gray.h
+ Version     : 0.1
+
+ Description : Four gray levels on the 1-bit PCD8544 by temporal dithering.
+     Drawing goes to a 2 bit per pixel surface; GRAYcommit() turns it into
+     GRAY_PHASES precomputed bitplanes, level L being on in L of them, and a
+     refresh thread cycles through the planes at a fixed rate. The liquid
+     crystal is slow enough that a pixel on one frame in three reads as light
+     gray and two in three as dark gray.
+
+     Each tick sends only the bytes of display RAM that differ from the plane
+     before it, so black and white areas cost nothing after the first cycle.
+     Ticks are on absolute CLOCK_MONOTONIC deadlines; a tick that overruns
+     drops the deadlines it missed rather than bursting to catch up, and the
+     lateness of every wakeup goes into a histogram.
+
+     While the thread runs it owns the bus: do not call LCDdisplay(). Text,
+     lines, circles and bitmaps are drawn with the usual LCD calls into
+     pcd8544_buffer and painted onto the surface at a level with GRAYfromMono().
+     The surface is always 84x48: a panel set to rotate 180 or mirror gets
+     the planes turned by LCDorientFrame(), portrait orientations are refused.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_GRAY_H
+#define PCD8544_GRAY_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+
+#define GRAY_LEVELS 4           // 0 white, 1 light, 2 dark, 3 black
+#define GRAY_PHASES 3           // bitplanes per dither cycle
+#define GRAY_HIST_BUCKETS 16    // wakeup lateness bucket i counts [2^i, 2^(i+1)) us
+
+typedef struct
+{
+	uint32_t hz;                // target planes per second, 0 when stopped
+	uint32_t frames;            // bitplanes sent
+	uint32_t cycles;            // complete dither cycles
+	uint32_t commits;           // surfaces taken up by the refresh thread
+	uint32_t overruns;          // deadlines dropped because a tick ran past them
+	uint64_t dataBytes;         // display RAM bytes sent
+	uint64_t cmdBytes;          // address commands sent
+	uint64_t bytesSkipped;      // unchanged from the previous plane, not sent
+	uint64_t busyNs;            // time spent sending planes
+	uint64_t elapsedNs;         // since GRAYstart()
+	uint32_t maxLateUs;
+	uint32_t lateHist[GRAY_HIST_BUCKETS];
+} GRAYstats;
+
+ void GRAYclear(uint8_t level);
+ void GRAYsetPixel(uint8_t x, uint8_t y, uint8_t level);
+ uint8_t GRAYgetPixel(uint8_t x, uint8_t y);
+ void GRAYfillrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t level);
+ void GRAYfromMono(uint8_t level);   // paint every pixel set in pcd8544_buffer at level
+ void GRAYcommit(void);              // precompute the planes, shown from the next cycle
+ int GRAYtick(void);                 // send the next plane now, returns its phase
+ int GRAYstart(uint16_t hz);         // refresh thread at hz planes/s, -1 if it cannot or in portrait
+ void GRAYstop(void);
+ int GRAYrunning(void);
+ void GRAYgetStats(GRAYstats *stats);
+ void GRAYresetStats(void);
+
+#endif
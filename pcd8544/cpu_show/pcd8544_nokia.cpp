@@ -0,0 +1,141 @@
+/*
+=================================================================================
+ Name        : pcd8544_nokia.cpp
+ Version     : 0.1
+
+ Description : The LCD* API's drawing and controller commands, as the
+     pcd8544::Nokia5110 instantiation of pcd8544_panel.hpp. Its canvas is
+     laid over pcd8544_buffer, 84x48 or 48x84 when LCDsetOrientation() turns
+     the drawing to portrait (the same steps on the other geometry, 11 pages
+     in the 528 byte buffer), and its controller sends through LCDcommand()
+     and LCDcommandRun(), so the bus, its stats and its hooks stay those of
+     PCD8544.c. The pins are given at run time there, so the template's
+     transport is not used.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+extern "C" {
+#include "PCD8544.h"
+#include "pcd8544_nokia.h"
+}
+#include "pcd8544_panel.hpp"
+
+using namespace pcd8544;
+
+typedef Nokia5110::geometry Landscape;
+typedef Geometry<Landscape::height, Landscape::width> Portrait;
+typedef Nokia5110::controller Controller;
+
+static_assert(Portrait::bytes <= LCDBUFSIZE && Landscape::bytes <= LCDBUFSIZE, "pcd8544_buffer holds either");
+
+// the controller's byte level, through the C driver's bus
+struct DriverBus
+{
+	void command(uint8_t c)
+	{
+		LCDcommand(c);
+	}
+
+	void commands(const uint8_t *p, uint16_t n)
+	{
+		LCDcommandRun(p, n);
+	}
+};
+
+// the canvas's pages, the driver's frame buffer
+struct DriverPages
+{
+	static uint8_t (&buffer)[LCDBUFSIZE];
+};
+
+uint8_t (&DriverPages::buffer)[LCDBUFSIZE] = pcd8544_buffer;
+
+static DriverBus bus;
+static Canvas<Landscape, DriverPages> landscape;
+static Canvas<Portrait, DriverPages> portrait;
+static uint8_t tall;
+
+void NOKIAinit(uint8_t contrast)
+{
+	Controller::init(bus, contrast);
+}
+
+void NOKIAshow(void)
+{
+	Controller::show(bus);
+}
+
+void NOKIAsetContrast(uint8_t contrast)
+{
+	Controller::setContrast(bus, contrast);
+}
+
+void NOKIAaddress(uint8_t page, uint8_t column)
+{
+	Controller::address(bus, page, column);
+}
+
+void NOKIAfinish(void)
+{
+	Controller::finish(bus);
+}
+
+void NOKIAsetPortrait(uint8_t on)
+{
+	tall = on;
+}
+
+void NOKIAclear(void)
+{
+	if (tall)
+		portrait.clear();
+	else
+		landscape.clear();
+}
+
+void NOKIAsetPixel(int16_t x, int16_t y, uint8_t color)
+{
+	if (tall)
+		portrait.setPixel(x, y, color);
+	else
+		landscape.setPixel(x, y, color);
+}
+
+uint8_t NOKIAgetPixel(int16_t x, int16_t y)
+{
+	return tall ? portrait.getPixel(x, y) : landscape.getPixel(x, y);
+}
+
+void NOKIAfillrect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color)
+{
+	if (tall)
+		portrait.fillRect(x, y, w, h, color);
+	else
+		landscape.fillRect(x, y, w, h, color);
+}
+
+void NOKIAdrawline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color)
+{
+	if (tall)
+		portrait.drawLine(x0, y0, x1, y1, color);
+	else
+		landscape.drawLine(x0, y0, x1, y1, color);
+}
+
+void NOKIAdrawchar(int16_t x, int16_t y, char c, uint8_t color)
+{
+	if (tall)
+		portrait.drawChar(x, y, c, pcd8544_font, color);
+	else
+		landscape.drawChar(x, y, c, pcd8544_font, color);
+}
@@ -0,0 +1,44 @@
+/*
+=================================================================================
+ Name        : pcd8544_nokia.h
+ Version     : 0.1
+
+ Description : The C side of pcd8544_nokia.cpp, which is what the LCD* API in
+     PCD8544.c draws and talks to the controller with: pcd8544::Nokia5110 from
+     pcd8544_panel.hpp, its canvas laid over pcd8544_buffer and its
+     controller on the driver's own bus calls. PCD8544.c keeps the pins, the
+     orientation, the flush, the stats and the hooks; nothing else needs to
+     call these. Build the .cpp with g++, without exceptions or RTTI, and
+     link it with the C objects as usual.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_NOKIA_H
+#define PCD8544_NOKIA_H
+
+#include <stdint.h>
+
+ void NOKIAinit(uint8_t contrast);              // the setup burst, display left blank
+ void NOKIAshow(void);                          // display normal
+ void NOKIAsetContrast(uint8_t contrast);
+ void NOKIAaddress(uint8_t page, uint8_t column);
+ void NOKIAfinish(void);                        // after the last page of a flush
+ void NOKIAsetPortrait(uint8_t portrait);       // draw on 48x84 instead of 84x48
+ void NOKIAclear(void);
+ void NOKIAsetPixel(int16_t x, int16_t y, uint8_t color);
+ uint8_t NOKIAgetPixel(int16_t x, int16_t y);
+ void NOKIAfillrect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color);
+ void NOKIAdrawline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color);
+ void NOKIAdrawchar(int16_t x, int16_t y, char c, uint8_t color);
+
+#endif
@@ -0,0 +1,562 @@
+/*
+=================================================================================
+ Name        : pcd8544_panel.hpp
+ Version     : 0.1
+
+ Description : Header-only C++ driver for page addressed monochrome panels:
+     the PCD8544 (Nokia 5110, 84x48), and the 128x64 ST7565 and SSD1306
+     controllers on 4-wire SPI. A panel is three template parameters:
+
+       Geometry<W, H>      columns and rows, whole pages high for a panel
+       a controller        init sequence, addressing and contrast commands
+                           (PCD8544Controller, ST7565Controller, SSD1306Controller)
+       a transport         how bytes reach it (BitBangSpi<SCLK, DIN, DC, CS, RST>)
+
+     Every size, bound, page and offset is a compile time constant and the
+     controller and transport are static calls, so the drawing loops have
+     no virtual dispatch and nothing to look up; a geometry a controller
+     cannot drive is a compile error.
+
+       typedef pcd8544::Panel<pcd8544::Geometry<128, 64>, pcd8544::SSD1306Controller,
+           pcd8544::BitBangSpi<0, 1, 2, 3, 4> > Oled;
+       Oled oled;
+       oled.begin(0x7F);
+       oled.fillRect(0, 0, 20, 10, pcd8544::BLACK_PIXEL);
+       oled.display();
+
+     Nokia5110 is the 84x48 PCD8544 on the pins pcd8544_rpi.c uses, and
+     the C LCD* API is an instantiation of it: pcd8544_nokia.cpp lays its
+     canvas over pcd8544_buffer and sends its controller's commands on
+     PCD8544.c's bus, whose pins are given at run time. Orientation,
+     grayscale, the mirror, gauges and text stay C layers on that frame.
+     On its own transport it flushes exactly what PCD8544.c does, bus
+     traffic included; panelbench checks that and times the two.
+
+     Drawing clips to the panel. A character is a 5 byte column glyph from
+     the font given (pcd8544_font for the driver's own) plus a blank
+     spacer column, 8 rows; like LCDdrawchar() it is only drawn when the
+     whole cell fits.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_PANEL_HPP
+#define PCD8544_PANEL_HPP
+
+#include <stdint.h>
+#include <string.h>
+#ifdef PCD8544_GPIO_SIM
+extern "C" {
+#include "pcd8544_sim.h"
+}
+#else
+#include <wiringPi.h>
+#endif
+
+namespace pcd8544
+{
+
+enum { WHITE_PIXEL = 0, BLACK_PIXEL = 1 };
+
+template <uint16_t W, uint16_t H>
+struct Geometry
+{
+	static_assert(W > 0 && W <= 256, "columns are addressed with one byte");
+	static_assert(H > 0 && H <= 256, "rows are addressed with one byte");
+	static const uint16_t width = W;
+	static const uint16_t height = H;
+	static const uint16_t pages = (H + 7) / 8;
+	static const uint16_t bytes = W * ((H + 7) / 8);
+};
+
+/*
+ * Controllers. Each says how big a panel it can drive, how to start it
+ * with the display still off and switch it on once a frame is in, point it
+ * at a page and column, and set the contrast; the byte level goes through
+ * the transport given.
+ */
+
+struct PCD8544Controller
+{
+	static const uint16_t maxWidth = 84;
+	static const uint16_t maxHeight = 48;
+
+	// one burst, leaving the display blank over the noise in its RAM
+	template <class Bus>
+	static void init(Bus &bus, uint8_t contrast)
+	{
+		const uint8_t sequence[] = {
+			0x21,                                       // extended instructions
+			0x14,                                       // bias 4
+			(uint8_t)(0x80 | (contrast > 0x7F ? 0x7F : contrast)),
+			0x20,                                       // basic instructions
+			0x08                                        // display blank
+		};
+		bus.commands(sequence, sizeof(sequence));
+	}
+
+	template <class Bus>
+	static void show(Bus &bus)
+	{
+		bus.command(0x0C);                              // display normal
+	}
+
+	template <class Bus>
+	static void setContrast(Bus &bus, uint8_t contrast)
+	{
+		bus.command(0x21);
+		bus.command(0x80 | (contrast > 0x7F ? 0x7F : contrast));
+		bus.command(0x20);
+	}
+
+	template <class Bus>
+	static void address(Bus &bus, uint8_t page, uint8_t column)
+	{
+		bus.command(0x40 | page);
+		bus.command(0x80 | column);
+	}
+
+	// after a flush: the PCD8544 wants a Y address to finish the last byte
+	template <class Bus>
+	static void finish(Bus &bus)
+	{
+		bus.command(0x40);
+	}
+};
+
+struct ST7565Controller
+{
+	static const uint16_t maxWidth = 132;
+	static const uint16_t maxHeight = 64;
+
+	template <class Bus>
+	static void init(Bus &bus, uint8_t contrast)
+	{
+		const uint8_t sequence[] = {
+			0xA2,                                       // bias 1/9
+			0xA0,                                       // columns left to right
+			0xC8,                                       // rows top to bottom
+			0x40,                                       // start line 0
+			0x2F,                                       // booster, regulator, follower on
+			0x25,                                       // resistor ratio
+			0x81, (uint8_t)(contrast & 0x3F)            // contrast
+		};
+		bus.commands(sequence, sizeof(sequence));
+	}
+
+	template <class Bus>
+	static void show(Bus &bus)
+	{
+		bus.command(0xAF);                              // display on
+	}
+
+	template <class Bus>
+	static void setContrast(Bus &bus, uint8_t contrast)
+	{
+		bus.command(0x81);
+		bus.command(contrast & 0x3F);
+	}
+
+	template <class Bus>
+	static void address(Bus &bus, uint8_t page, uint8_t column)
+	{
+		bus.command(0xB0 | page);
+		bus.command(0x10 | (column >> 4));
+		bus.command(column & 0x0F);
+	}
+
+	template <class Bus>
+	static void finish(Bus &)
+	{
+	}
+};
+
+struct SSD1306Controller
+{
+	static const uint16_t maxWidth = 128;
+	static const uint16_t maxHeight = 64;
+
+	template <class Bus>
+	static void init(Bus &bus, uint8_t contrast)
+	{
+		const uint8_t sequence[] = {
+			0xAE,                                       // display off
+			0xD5, 0x80,                                 // clock divide
+			0xA8, 0x3F,                                 // multiplex 64
+			0xD3, 0x00,                                 // no display offset
+			0x40,                                       // start line 0
+			0x8D, 0x14,                                 // charge pump on
+			0x20, 0x02,                                 // page addressing
+			0xA1,                                       // columns left to right
+			0xC8,                                       // rows top to bottom
+			0xDA, 0x12,                                 // COM pins
+			0xD9, 0xF1,                                 // precharge
+			0xDB, 0x40,                                 // VCOMH
+			0xA4,                                       // show the RAM
+			0xA6,                                       // not inverted
+			0x81, contrast                              // contrast
+		};
+		bus.commands(sequence, sizeof(sequence));
+	}
+
+	template <class Bus>
+	static void show(Bus &bus)
+	{
+		bus.command(0xAF);                              // display on
+	}
+
+	template <class Bus>
+	static void setContrast(Bus &bus, uint8_t contrast)
+	{
+		bus.command(0x81);
+		bus.command(contrast);
+	}
+
+	template <class Bus>
+	static void address(Bus &bus, uint8_t page, uint8_t column)
+	{
+		bus.command(0xB0 | page);
+		bus.command(column & 0x0F);
+		bus.command(0x10 | (column >> 4));
+	}
+
+	template <class Bus>
+	static void finish(Bus &)
+	{
+	}
+};
+
+/*
+ * Transports. command() sends one byte with D/C low, commands() a burst of
+ * them and data() a run of display RAM with D/C high, both with CS held low
+ * throughout as LCDcommandRun() and LCDdataRun() do.
+ */
+
+template <uint8_t SCLK, uint8_t DIN, uint8_t DC, uint8_t CS, uint8_t RST>
+struct BitBangSpi
+{
+	uint64_t gpioWrites;
+
+	BitBangSpi() : gpioWrites(0)
+	{
+	}
+
+	void begin()
+	{
+		pinMode(DIN, OUTPUT);
+		pinMode(SCLK, OUTPUT);
+		pinMode(DC, OUTPUT);
+		pinMode(RST, OUTPUT);
+		pinMode(CS, OUTPUT);
+		if (CS > 0)
+			digitalWrite(CS, LOW);
+		// every controller here is reset by a few microseconds low
+		digitalWrite(RST, LOW);
+		delayMicroseconds(10);
+		digitalWrite(RST, HIGH);
+	}
+
+	void command(uint8_t c)
+	{
+		gpioWrites += 27;
+		digitalWrite(DC, LOW);
+		digitalWrite(CS, LOW);
+		shift(c);
+		digitalWrite(CS, HIGH);
+	}
+
+	void commands(const uint8_t *p, uint16_t n)
+	{
+		gpioWrites += 3 + 24 * n;
+		digitalWrite(DC, LOW);
+		digitalWrite(CS, LOW);
+		while (n--)
+			shift(*p++);
+		digitalWrite(CS, HIGH);
+	}
+
+	void data(const uint8_t *p, uint16_t n)
+	{
+		gpioWrites += 3 + 24 * n;
+		digitalWrite(DC, HIGH);
+		digitalWrite(CS, LOW);
+		while (n--)
+			shift(*p++);
+		digitalWrite(CS, HIGH);
+	}
+
+private:
+	// MSB first; the empty loop is the same clock stretch as the C driver's shiftOut()
+	void shift(uint8_t v)
+	{
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			digitalWrite(DIN, (v >> (7 - i)) & 1);
+			digitalWrite(SCLK, HIGH);
+			for (uint32_t j = 400; j > 0; j--)
+				;
+			digitalWrite(SCLK, LOW);
+		}
+	}
+};
+
+/*
+ * Drawing on a frame buffer of pages of Geom::width columns with bit 0 the
+ * top row of a page, the layout pcd8544_buffer has. Where the pages are is
+ * the second parameter, a class with a buffer member: a Frame brings its
+ * own, the C driver's LCD* calls draw on pcd8544_buffer (pcd8544_nokia.cpp).
+ * Either way its address is fixed, so no store has to reload it.
+ */
+
+template <class Geom>
+struct OwnPages
+{
+	uint8_t buffer[Geom::bytes];
+};
+
+template <class Geom, class Pages>
+class Canvas : public Pages
+{
+public:
+	typedef Geom geometry;
+	static const uint16_t W = Geom::width;
+	static const uint16_t H = Geom::height;
+
+	void clear()
+	{
+		memset(this->buffer, 0, Geom::bytes);
+	}
+
+	void setPixel(int16_t x, int16_t y, uint8_t color)
+	{
+		if ((uint16_t)x >= W || (uint16_t)y >= H)
+			return;
+		uint8_t *b = this->buffer + (y >> 3) * W + x;
+		if (color)
+			*b |= 1 << (y & 7);
+		else
+			*b &= ~(1 << (y & 7));
+	}
+
+	uint8_t getPixel(int16_t x, int16_t y) const
+	{
+		if ((uint16_t)x >= W || (uint16_t)y >= H)
+			return 0;
+		return (this->buffer[(y >> 3) * W + x] >> (y & 7)) & 1;
+	}
+
+	// [x, x+w) x [y, y+h), clipped, a masked page byte per column
+	void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color)
+	{
+		int16_t x1 = x + w, y1 = y + h;
+
+		if (x < 0)
+			x = 0;
+		if (y < 0)
+			y = 0;
+		if (x1 > (int16_t)W)
+			x1 = W;
+		if (y1 > (int16_t)H)
+			y1 = H;
+		if (x >= x1 || y >= y1)
+			return;
+		for (int16_t p = y >> 3; p <= (y1 - 1) >> 3; p++)
+		{
+			uint8_t lo = y > p * 8 ? y - p * 8 : 0;
+			uint8_t hi = y1 < (p + 1) * 8 ? y1 - p * 8 : 8;
+			uint8_t mask = (0xFF << lo) & (0xFF >> (8 - hi));
+			uint8_t *row = this->buffer + p * W;
+			if (color)
+				for (int16_t i = x; i < x1; i++)
+					row[i] |= mask;
+			else
+				for (int16_t i = x; i < x1; i++)
+					row[i] &= ~mask;
+		}
+	}
+
+	void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color)
+	{
+		if (w <= 0 || h <= 0)
+			return;
+		fillRect(x, y, w, 1, color);
+		fillRect(x, y + h - 1, w, 1, color);
+		fillRect(x, y, 1, h, color);
+		fillRect(x + w - 1, y, 1, h, color);
+	}
+
+	// Bresenham on any 16 bit ends, counted in 32 bits so ends off the panel
+	// are clipped pixel by pixel and never wrap; a line wholly on it skips the test
+	void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color)
+	{
+		int32_t ax = x0, ay = y0, bx = x1, by = y1, t;
+
+		if ((ax < 0 && bx < 0) || (ay < 0 && by < 0) || (ax >= W && bx >= W) || (ay >= H && by >= H))
+			return;
+		const bool inside = ax >= 0 && bx >= 0 && ay >= 0 && by >= 0 && ax < W && bx < W && ay < H && by < H;
+		const bool steep = (by > ay ? by - ay : ay - by) > (bx > ax ? bx - ax : ax - bx);
+		if (steep)
+		{
+			t = ax; ax = ay; ay = t;
+			t = bx; bx = by; by = t;
+		}
+		if (ax > bx)
+		{
+			t = ax; ax = bx; bx = t;
+			t = ay; ay = by; by = t;
+		}
+		int32_t dx = bx - ax, dy = by > ay ? by - ay : ay - by, err = dx / 2, ystep = ay < by ? 1 : -1;
+		for (; ax <= bx; ax++)
+		{
+			int32_t px = steep ? ay : ax, py = steep ? ax : ay;
+			if (inside || ((uint32_t)px < W && (uint32_t)py < H))
+			{
+				uint8_t *b = this->buffer + (py >> 3) * W + px;
+				if (color)
+					*b |= 1 << (py & 7);
+				else
+					*b &= ~(1 << (py & 7));
+			}
+			err -= dy;
+			if (err < 0)
+			{
+				ay += ystep;
+				err += dx;
+			}
+		}
+	}
+
+	// a 6 column cell: glyph and spacer replace all 8 rows from y. The colour
+	// and masks are worked out once; a cell on a page boundary is a plain copy
+	void drawChar(int16_t x, int16_t y, char c, const uint8_t *font, uint8_t color)
+	{
+		if (x < 0 || y < 0 || y >= (int16_t)H || x + 5 >= (int16_t)W)
+			return;
+		const uint8_t shift = y & 7, invert = color ? 0x00 : 0xFF;
+		const uint8_t *glyph = font + (uint8_t)c * 5;
+		uint8_t *dst = this->buffer + (y >> 3) * W + x;
+		uint8_t i;
+
+		if (!shift)
+		{
+			for (i = 0; i < 5; i++)
+				dst[i] = glyph[i] ^ invert;
+			dst[5] = invert;
+			return;
+		}
+		const uint8_t keep = 0xFF >> (8 - shift), keep2 = 0xFF << shift;
+		for (i = 0; i < 6; i++)
+			dst[i] = (dst[i] & keep) | (uint8_t)(((i < 5 ? glyph[i] : 0) ^ invert) << shift);
+		if ((y >> 3) + 1 >= (int16_t)Geom::pages)
+			return;
+		dst += W;
+		for (i = 0; i < 6; i++)
+			dst[i] = (dst[i] & keep2) | (uint8_t)(((i < 5 ? glyph[i] : 0) ^ invert) >> (8 - shift));
+	}
+
+	// one line, cells that do not fit whole are left out
+	void drawString(int16_t x, int16_t y, const char *s, const uint8_t *font, uint8_t color)
+	{
+		for (; *s && x + 5 < (int16_t)W; s++, x += 6)
+			drawChar(x, y, *s, font, color);
+	}
+};
+
+template <class Geom>
+class Frame : public Canvas<Geom, OwnPages<Geom> >
+{
+public:
+	Frame()
+	{
+		this->clear();
+	}
+};
+
+template <class Geom, class Controller, class Transport>
+class Panel : public Frame<Geom>
+{
+	static_assert(Geom::width <= Controller::maxWidth && Geom::height <= Controller::maxHeight,
+		"the controller cannot drive a panel this big");
+	static_assert(Geom::height % 8 == 0, "page addressed panels are whole pages high");
+
+public:
+	typedef Controller controller;
+	typedef Transport transport;
+
+	Transport bus;
+
+	Panel() : blanked(false)
+	{
+	}
+
+	// the display stays blank until the first flush, which sends the whole frame
+	void begin(uint8_t contrast)
+	{
+		bus.begin();
+		Controller::init(bus, contrast);
+		blanked = true;
+	}
+
+	void setContrast(uint8_t contrast)
+	{
+		Controller::setContrast(bus, contrast);
+	}
+
+	// [x, x+w) x [y, y+h) of the buffer, whole pages high
+	void displayRegion(int16_t x, int16_t y, int16_t w, int16_t h)
+	{
+		int16_t x1 = x + w, y1 = y + h;
+
+		if (blanked)
+		{
+			x = y = 0;
+			x1 = Geom::width;
+			y1 = Geom::height;
+		}
+		if (x < 0)
+			x = 0;
+		if (y < 0)
+			y = 0;
+		if (x1 > (int16_t)Geom::width)
+			x1 = Geom::width;
+		if (y1 > (int16_t)Geom::height)
+			y1 = Geom::height;
+		if (x >= x1 || y >= y1)
+			return;
+		for (int16_t p = y >> 3; p <= (y1 - 1) >> 3; p++)
+		{
+			Controller::address(bus, p, x);
+			bus.data(this->buffer + p * Geom::width + x, x1 - x);
+		}
+		Controller::finish(bus);
+		if (blanked)
+		{
+			Controller::show(bus);
+			blanked = false;
+		}
+	}
+
+	void display()
+	{
+		displayRegion(0, 0, Geom::width, Geom::height);
+	}
+
+private:
+	bool blanked;
+};
+
+// the panel PCD8544.c drives, on the pins pcd8544_rpi.c uses
+typedef Panel<Geometry<84, 48>, PCD8544Controller, BitBangSpi<0, 1, 2, 3, 4> > Nokia5110;
+
+}
+
+#endif
@@ -0,0 +1,385 @@
+/*
+=================================================================================
+ Name        : pcd8544_ref.c
+ Version     : 0.1
+
+ Copyright (C) 2010 Limor Fried, Adafruit Industries
+ CORTEX-M3 version by Le Dang Dung, 2011 LeeDangDung@gmail.com (tested on LPC1769)
+ Raspberry Pi version by Andre Wussow, 2012, desk@binerry.de
+
+ Description : Per-pixel reference implementation of the PCD8544.c drawing
+     primitives, kept exactly as they were before any fast paths were added
+     (including the 8 bit loop counters and int8_t error terms). Do not
+     optimize anything in here - it is the yardstick pcd8544_bench checks
+     the real driver against. REFfillarc(), REFdrawpolar() and the polygon
+     fills have no original; they test every pixel on its own. REFdrawline()
+     counts in 32 bits: the original never ended a line with an end at 255.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include "pcd8544_ref.h"
+
+#define abs(a) (((a) < 0) ? -(a) : (a))
+#define _BV(bit) (0x1 << (bit))
+
+uint8_t ref_buffer[LCDWIDTH * LCDHEIGHT / 8];
+static uint8_t cursor_x, cursor_y, textsize = 1, textcolor = BLACK;
+
+static void ref_setpixel(uint8_t x, uint8_t y, uint8_t color)
+{
+	if ((x >= LCDWIDTH) || (y >= LCDHEIGHT))
+		return;
+	if (color)
+		ref_buffer[x+ (y/8)*LCDWIDTH] |= _BV(y%8);
+	else
+		ref_buffer[x+ (y/8)*LCDWIDTH] &= ~_BV(y%8);
+}
+
+void REFsetTextColor(uint8_t c)
+{
+	textcolor = c;
+}
+
+void REFsetTextSize(uint8_t s)
+{
+	textsize = s;
+}
+
+void REFsetCursor(uint8_t x, uint8_t y)
+{
+	cursor_x = x;
+	cursor_y = y;
+}
+
+void REFclear(void)
+{
+	uint32_t i;
+	for ( i = 0; i < LCDWIDTH*LCDHEIGHT/8 ; i++)
+		ref_buffer[i] = 0;
+	cursor_y = cursor_x = 0;
+}
+
+void REFsetPixel(uint8_t x, uint8_t y, uint8_t color)
+{
+	ref_setpixel(x, y, color);
+}
+
+void REFdrawbitmap(uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t w, uint8_t h, uint8_t color)
+{
+	uint8_t j,i;
+	for ( j=0; j<h; j++)
+	{
+		for ( i=0; i<w; i++ )
+		{
+			if (*(bitmap + i + (j/8)*w) & _BV(j%8))
+			{
+				ref_setpixel(x+i, y+j, color);
+			}
+		}
+	}
+}
+
+void REFdrawchar(uint8_t x, uint8_t y, char c)
+{
+	if (y >= LCDHEIGHT) return;
+	if ((x+5) >= LCDWIDTH) return;
+	uint8_t i,j;
+	for ( i =0; i<5; i++ )
+	{
+		uint8_t d = pcd8544_font[(uint8_t)c*5+i];
+		for (j = 0; j<8; j++)
+		{
+			if (d & _BV(j))
+				ref_setpixel(x+i, y+j, textcolor);
+			else
+				ref_setpixel(x+i, y+j, !textcolor);
+		}
+	}
+	for ( j = 0; j<8; j++)
+		ref_setpixel(x+5, y+j, !textcolor);
+}
+
+void REFwrite(uint8_t c)
+{
+	if (c == '\n')
+	{
+		cursor_y += textsize*8;
+		cursor_x = 0;
+	}
+	else if (c == '\r')
+	{
+		// skip em
+	}
+	else
+	{
+		REFdrawchar(cursor_x, cursor_y, c);
+		cursor_x += textsize*6;
+		if (cursor_x >= (LCDWIDTH-5))
+		{
+			cursor_x = 0;
+			cursor_y+=8;
+		}
+		if (cursor_y >= LCDHEIGHT)
+			cursor_y = 0;
+	}
+}
+
+void REFdrawstring(uint8_t x, uint8_t y, const char *c)
+{
+	cursor_x = x;
+	cursor_y = y;
+	while (*c)
+		REFwrite(*c++);
+}
+
+// every pixel of the line on its own, in 32 bits, so ends anywhere clip
+// rather than wrap; the original's 8 bit counters never ended at 255
+static void refLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t color)
+{
+	int32_t dx = abs(x1 - x0), dy = abs(y1 - y0), sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1, err, x, y, i;
+
+	// Bresenham along the longer axis, from the end LCDdrawline() starts at
+	if (dy > dx)
+	{
+		if (y0 > y1)
+		{
+			x = x1; y = y1; sx = -sx;
+		}
+		else
+		{
+			x = x0; y = y0;
+		}
+		err = dy / 2;
+		for (i = 0; i <= dy; i++, y++)
+		{
+			if (x >= 0 && x < LCDWIDTH && y >= 0 && y < LCDHEIGHT)
+				ref_setpixel(x, y, color);
+			err -= dx;
+			if (err < 0)
+			{
+				x += sx;
+				err += dy;
+			}
+		}
+	}
+	else
+	{
+		if (x0 > x1)
+		{
+			x = x1; y = y1; sy = -sy;
+		}
+		else
+		{
+			x = x0; y = y0;
+		}
+		err = dx / 2;
+		for (i = 0; i <= dx; i++, x++)
+		{
+			if (x >= 0 && x < LCDWIDTH && y >= 0 && y < LCDHEIGHT)
+				ref_setpixel(x, y, color);
+			err -= dy;
+			if (err < 0)
+			{
+				y += sy;
+				err += dx;
+			}
+		}
+	}
+}
+
+void REFdrawline(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color)
+{
+	refLine(x0, y0, x1, y1, color);
+}
+
+void REFfillrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color)
+{
+	uint8_t i,j;
+	for ( i=x; i<x+w; i++)
+		for ( j=y; j<y+h; j++)
+			ref_setpixel(i, j, color);
+}
+
+void REFdrawrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color)
+{
+	uint8_t i;
+	for ( i=x; i<x+w; i++) {
+		ref_setpixel(i, y, color);
+		ref_setpixel(i, y+h-1, color);
+	}
+	for ( i=y; i<y+h; i++) {
+		ref_setpixel(x, i, color);
+		ref_setpixel(x+w-1, i, color);
+	}
+}
+
+void REFdrawcircle(uint8_t x0, uint8_t y0, uint8_t r, uint8_t color)
+{
+	int8_t f = 1 - r;
+	int8_t ddF_x = 1;
+	int8_t ddF_y = -2 * r;
+	int8_t x = 0;
+	int8_t y = r;
+
+	ref_setpixel(x0, y0+r, color);
+	ref_setpixel(x0, y0-r, color);
+	ref_setpixel(x0+r, y0, color);
+	ref_setpixel(x0-r, y0, color);
+
+	while (x<y)
+	{
+		if (f >= 0)
+		{
+			y--;
+			ddF_y += 2;
+			f += ddF_y;
+		}
+		x++;
+		ddF_x += 2;
+		f += ddF_x;
+
+		ref_setpixel(x0 + x, y0 + y, color);
+		ref_setpixel(x0 - x, y0 + y, color);
+		ref_setpixel(x0 + x, y0 - y, color);
+		ref_setpixel(x0 - x, y0 - y, color);
+
+		ref_setpixel(x0 + y, y0 + x, color);
+		ref_setpixel(x0 - y, y0 + x, color);
+		ref_setpixel(x0 + y, y0 - x, color);
+		ref_setpixel(x0 - y, y0 - x, color);
+	}
+}
+
+void REFfillcircle(uint8_t x0, uint8_t y0, uint8_t r, uint8_t color)
+{
+	int8_t f = 1 - r;
+	int8_t ddF_x = 1;
+	int8_t ddF_y = -2 * r;
+	int8_t x = 0;
+	int8_t y = r;
+	uint8_t i;
+
+	for (i=y0-r; i<=y0+r; i++)
+		ref_setpixel(x0, i, color);
+
+	while (x<y)
+	{
+		if (f >= 0)
+		{
+			y--;
+			ddF_y += 2;
+			f += ddF_y;
+		}
+		x++;
+		ddF_x += 2;
+		f += ddF_x;
+
+		for ( i=y0-y; i<=y0+y; i++)
+		{
+			ref_setpixel(x0+x, i, color);
+			ref_setpixel(x0-x, i, color);
+		}
+		for ( i=y0-x; i<=y0+x; i++)
+		{
+			ref_setpixel(x0+y, i, color);
+			ref_setpixel(x0-y, i, color);
+		}
+	}
+}
+
+void REFfillarc(uint8_t x0, uint8_t y0, uint8_t r0, uint8_t r1, int16_t a0, int16_t a1, uint8_t color)
+{
+	int32_t s0 = LCDsin(a0), c0 = LCDcos(a0), s1 = LCDsin(a1), c1 = LCDcos(a1);
+	int32_t x, y;
+
+	if (a1 <= a0 || r0 > r1)
+		return;
+	for (y = 0; y < LCDHEIGHT; y++)
+		for (x = 0; x < LCDWIDTH; x++)
+		{
+			int32_t dx = x - x0, dy = y - y0, d = 4 * (dx * dx + dy * dy);
+			int32_t cw = s0 * dy + c0 * dx, ccw = -(s1 * dy + c1 * dx);
+			if (d >= (2 * r1 + 1) * (2 * r1 + 1) || (r0 && d < (2 * r0 - 1) * (2 * r0 - 1)))
+				continue;
+			if (a1 - a0 >= 360 || (a1 - a0 <= 180 ? cw >= 0 && ccw >= 0 : cw >= 0 || ccw >= 0))
+				ref_setpixel(x, y, color);
+		}
+}
+
+void REFdrawpolar(uint8_t x0, uint8_t y0, int16_t deg, uint8_t r0, uint8_t r1, uint8_t color)
+{
+	int16_t ax, ay, bx, by;
+
+	LCDpolar(deg, r0, &ax, &ay);
+	LCDpolar(deg, r1, &bx, &by);
+	ax += x0; ay += y0;
+	bx += x0; by += y0;
+	refLine(ax, ay, bx, by, color);
+}
+
+// every pixel's centre against every edge of the polygon: it is inside when
+// an odd number of edges cross its column at or above it
+void REFfillpolygonQ4(const int16_t *xy, uint8_t n, uint8_t color)
+{
+	int32_t x, y, i;
+
+	if (n < 3 || n > LCD_POLY_MAX)
+		return;
+	for (i = 0; i < 2 * n; i++)
+		if (xy[i] < -LCD_POLY_RANGE || xy[i] > LCD_POLY_RANGE)
+			return;
+	for (y = 0; y < LCDHEIGHT; y++)
+		for (x = 0; x < LCDWIDTH; x++)
+		{
+			int32_t cx = 16 * x + 8, cy = 16 * y + 8, crossings = 0;
+			for (i = 0; i < n; i++)
+			{
+				int32_t j = (i + 1) % n;
+				int32_t x0 = xy[2 * i], y0 = xy[2 * i + 1], x1 = xy[2 * j], y1 = xy[2 * j + 1], t;
+				if (x0 > x1)
+				{
+					t = x0; x0 = x1; x1 = t;
+					t = y0; y0 = y1; y1 = t;
+				}
+				// crossing y0 + (cx - x0) (y1 - y0) / (x1 - x0) at or above cy
+				if (x0 <= cx && cx < x1 && y0 * (x1 - x0) + (cx - x0) * (y1 - y0) <= cy * (x1 - x0))
+					crossings++;
+			}
+			if (crossings & 1)
+				ref_setpixel(x, y, color);
+		}
+}
+
+void REFfilltriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t color)
+{
+	int16_t xy[6];
+
+	xy[0] = x0 * 16; xy[1] = y0 * 16;
+	xy[2] = x1 * 16; xy[3] = y1 * 16;
+	xy[4] = x2 * 16; xy[5] = y2 * 16;
+	REFfillpolygonQ4(xy, 3, color);
+}
+
+void REFdrawthickline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, uint8_t cap, uint8_t color)
+{
+	int16_t xy[2 * LCD_POLY_MAX];
+
+	if (width > 1)
+	{
+		REFfillpolygonQ4(xy, LCDthickOutline(x0, y0, x1, y1, width, cap, xy), color);
+		return;
+	}
+	if (width == 0)
+		return;
+	refLine(x0, y0, x1, y1, color);
+}
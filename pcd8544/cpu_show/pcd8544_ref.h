@@ -0,0 +1,52 @@
+/*
+=================================================================================
+ Name        : pcd8544_ref.h
+ Version     : 0.1
+
+ Description : Per-pixel reference implementation of the PCD8544.c drawing
+     primitives. Frozen copy of the original pixel-at-a-time code, used by
+     pcd8544_bench to prove optimized paths produce identical frames. The
+     arc and polar primitives came later; theirs is the plain definition,
+     every pixel tested on its own against the driver's sine table.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_REF_H
+#define PCD8544_REF_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+
+ extern uint8_t ref_buffer[LCDWIDTH * LCDHEIGHT / 8];
+
+ void REFsetTextColor(uint8_t c);
+ void REFsetTextSize(uint8_t s);
+ void REFsetCursor(uint8_t x, uint8_t y);
+ void REFclear(void);
+ void REFsetPixel(uint8_t x, uint8_t y, uint8_t color);
+ void REFdrawline(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1, uint8_t color);
+ void REFdrawrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color);
+ void REFfillrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color);
+ void REFdrawcircle(uint8_t x0, uint8_t y0, uint8_t r, uint8_t color);
+ void REFfillcircle(uint8_t x0, uint8_t y0, uint8_t r, uint8_t color);
+ void REFdrawchar(uint8_t x, uint8_t y, char c);
+ void REFwrite(uint8_t c);
+ void REFdrawstring(uint8_t x, uint8_t y, const char *c);
+ void REFdrawbitmap(uint8_t x, uint8_t y, const uint8_t *bitmap, uint8_t w, uint8_t h, uint8_t color);
+ void REFfillarc(uint8_t x0, uint8_t y0, uint8_t r0, uint8_t r1, int16_t a0, int16_t a1, uint8_t color);
+ void REFdrawpolar(uint8_t x0, uint8_t y0, int16_t deg, uint8_t r0, uint8_t r1, uint8_t color);
+ void REFfillpolygonQ4(const int16_t *xy, uint8_t n, uint8_t color);
+ void REFfilltriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint8_t color);
+ void REFdrawthickline(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t width, uint8_t cap, uint8_t color);
+
+#endif
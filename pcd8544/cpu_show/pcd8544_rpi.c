@@ -69,11 +69,10 @@ int main (void)
   LCDInit(_sclk, _din, _dc, _cs, _rst, contrast);
   LCDclear();
   
-  // show logo
+  // show logo, until the first screen below replaces it
   LCDshowLogo();
   
-  delay(5000);
-  
+  int firstFrame = 1;
   for (;;)
   {
 	  // clear lcd
@@ -125,6 +124,14 @@ int main (void)
 	  LCDdrawstring(0, 40, datetime);
 	  LCDdisplay();
 	  
+	  if (firstFrame)
+	  {
+		LCDstats st;
+		LCDgetStats(&st);
+		printf("first frame %u.%03u ms after start (init %u us)\n", st.firstFrameUs / 1000, st.firstFrameUs % 1000, st.initUs);
+		firstFrame = 0;
+	  }
+	  
 	  delay(100);
   }
   
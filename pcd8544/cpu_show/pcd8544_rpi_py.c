@@ -44,6 +44,23 @@ void LCDdrawbitmap(uint8_t x, uint8_t y,  const uint8_t *bitmap, uint8_t w, uint
 #include <sys/sysinfo.h>
 #include <time.h>
 #include "PCD8544.h"
+#include "pcd8544_gray.h"
+#include "pcd8544_stream.h"
+#include "pcd8544_dial.h"
+#include "pcd8544_text.h"
+#include "pcd8544_rt.h"
+#include "pcd8544_term.h"
+
+#define MAX_DIALS 4
+static LCDdial dials[MAX_DIALS];
+static int dialReady[MAX_DIALS];
+
+#define MAX_MARQUEES 4
+static TEXTmarquee marquees[MAX_MARQUEES];
+static int marqueeReady[MAX_MARQUEES];
+
+static TERMconsole term;
+static int termReady;
 
 // pin setup
 int _sclk = 0;
@@ -64,10 +81,10 @@ static PyObject* py_initDisplay(PyObject* self, PyObject* args)
         return Py_BuildValue("i", -1);
   }
   
-  // init and clear lcd
+  // init and clear lcd; the panel stays blank until the first lcdDisplay(), no need to send a clear frame
+  RTwait();
   LCDInit(_sclk, _din, _dc, _cs, _rst, contrast);
   LCDclear();
-  LCDdisplay();
   return Py_BuildValue("i", 0);
 }
 
@@ -79,14 +96,20 @@ static PyObject* py_lcdClear(PyObject* self, PyObject* args)
 }
 static PyObject* py_lcdShowLogo(PyObject* self, PyObject* args)
 {
-  // Display the Logo
+  // Display the Logo, once the transmit thread is done with the bus
+  RTwait();
   LCDshowLogo();
   return Py_BuildValue("i", 0);
 }
 static PyObject* py_lcdDisplay(PyObject* self, PyObject* args)
 {
-  // Process the LCD Display Buffer
-  LCDdisplay();
+  // Process the LCD Display Buffer, unless grayscale mode owns the bus
+  if (GRAYrunning())
+    return Py_BuildValue("i", -1);
+  if (RTactive())
+    RTdisplay();
+  else
+    LCDdisplay();
   return Py_BuildValue("i", 0);
 }
 static PyObject* py_lcdDisplayText(PyObject* self, PyObject* args)
@@ -145,6 +168,133 @@ static PyObject* py_lcdDrawCircle(PyObject* self, PyObject* args)
   LCDdrawcircle(x, y, r, c);
   return Py_BuildValue("i", 0);
 }
+static PyObject* py_lcdDrawArc(PyObject* self, PyObject* args)
+{
+  int x,y,r,a0,a1,c;
+
+  // Angles in degrees clockwise from 12 o'clock, from a0 round to a1
+  if (!PyArg_ParseTuple(args, "iiiiii", &x, &y, &r, &a0, &a1, &c))
+    return Py_BuildValue("i", -1); 
+  LCDdrawarc(x, y, r, a0, a1, c);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdFillArc(PyObject* self, PyObject* args)
+{
+  int x,y,r0,r1,a0,a1,c;
+
+  // Ring from radius r0 out to r1, r0 = 0 for a pie slice
+  if (!PyArg_ParseTuple(args, "iiiiiii", &x, &y, &r0, &r1, &a0, &a1, &c))
+    return Py_BuildValue("i", -1); 
+  LCDfillarc(x, y, r0, r1, a0, a1, c);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdDrawPolar(PyObject* self, PyObject* args)
+{
+  int x,y,a,r0,r1,c;
+
+  // Line from r0 to r1 pixels out of (x, y) at angle a
+  if (!PyArg_ParseTuple(args, "iiiiii", &x, &y, &a, &r0, &r1, &c))
+    return Py_BuildValue("i", -1); 
+  LCDdrawpolar(x, y, a, r0, r1, c);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdFillPolygon(PyObject* self, PyObject* args)
+{
+  PyObject *points, *seq, *pt;
+  int16_t xy[2 * LCD_POLY_MAX];
+  int n, i, x, y, c;
+
+  // List of (x, y) corners, 3 to LCD_POLY_MAX of them
+  if (!PyArg_ParseTuple(args, "Oi", &points, &c))
+    return Py_BuildValue("i", -1); 
+  seq = PySequence_Fast(points, "points must be a sequence");
+  if (seq == NULL)
+  {
+    PyErr_Clear();
+    return Py_BuildValue("i", -1); 
+  }
+  n = PySequence_Fast_GET_SIZE(seq);
+  if (n < 3 || n > LCD_POLY_MAX)
+  {
+    Py_DECREF(seq);
+    return Py_BuildValue("i", -1); 
+  }
+  for (i = 0; i < n; i++)
+  {
+    pt = PySequence_Fast_GET_ITEM(seq, i);
+    if (!PyArg_ParseTuple(pt, "ii", &x, &y) || x < -32768 || x > 32767 || y < -32768 || y > 32767)
+    {
+      PyErr_Clear();
+      Py_DECREF(seq);
+      return Py_BuildValue("i", -1); 
+    }
+    xy[2 * i] = x;
+    xy[2 * i + 1] = y;
+  }
+  Py_DECREF(seq);
+  LCDfillpolygon(xy, n, c);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdFillTriangle(PyObject* self, PyObject* args)
+{
+  int x0,y0,x1,y1,x2,y2,c;
+
+  if (!PyArg_ParseTuple(args, "iiiiiii", &x0, &y0, &x1, &y1, &x2, &y2, &c))
+    return Py_BuildValue("i", -1); 
+  LCDfilltriangle(x0, y0, x1, y1, x2, y2, c);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdDrawThickLine(PyObject* self, PyObject* args)
+{
+  int x0,y0,x1,y1,w,cap,c;
+
+  // cap 0 butt, 1 square, 2 round
+  if (!PyArg_ParseTuple(args, "iiiiiii", &x0, &y0, &x1, &y1, &w, &cap, &c) || w < 0 || w > 255)
+    return Py_BuildValue("i", -1); 
+  LCDdrawthickline(x0, y0, x1, y1, w, cap, c);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdDialInit(PyObject* self, PyObject* args)
+{
+  int id,x,y,r,a0,a1,ticks;
+  long min,max;
+
+  // Dial id (0-3) centred on x, y: min at angle a0 round to max at a1
+  if (!PyArg_ParseTuple(args, "iiiiiilli", &id, &x, &y, &r, &a0, &a1, &min, &max, &ticks))
+    return Py_BuildValue("i", -1); 
+  if (id < 0 || id >= MAX_DIALS || x < 0 || y < 0 || r < 0 || x > 255 || y > 255 || r > 255 || ticks < 0 ||
+    DIALinit(&dials[id], x, y, r, a0, a1, min, max, ticks) < 0)
+    return Py_BuildValue("i", -1); 
+  dialReady[id] = 1;
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdDialDraw(PyObject* self, PyObject* args)
+{
+  int id;
+  long v;
+
+  // Whole dial, face and needle; draw its label first
+  if (!PyArg_ParseTuple(args, "il", &id, &v))
+    return Py_BuildValue("i", -1); 
+  if (id < 0 || id >= MAX_DIALS || !dialReady[id])
+    return Py_BuildValue("i", -1); 
+  DIALdraw(&dials[id], v);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdDialSet(PyObject* self, PyObject* args)
+{
+  int id;
+  long v;
+
+  // Move the needle; returns the (x, y, w, h) changed for lcdDisplayRegion, 0 if it did not move
+  if (!PyArg_ParseTuple(args, "il", &id, &v))
+    return Py_BuildValue("i", -1); 
+  if (id < 0 || id >= MAX_DIALS || !dialReady[id])
+    return Py_BuildValue("i", -1); 
+  if (!DIALset(&dials[id], v))
+    return Py_BuildValue("i", 0);
+  return Py_BuildValue("(iiii)", dials[id].dirtyX, dials[id].dirtyY, dials[id].dirtyW, dials[id].dirtyH);
+}
 static PyObject* py_lcdFillCircle(PyObject* self, PyObject* args)
 {
   int x,y,r,c;
@@ -156,6 +306,74 @@ static PyObject* py_lcdFillCircle(PyObject* self, PyObject* args)
   LCDfillcircle(x, y, r, c);
   return Py_BuildValue("i", 0);
 }
+static PyObject* py_lcdTextWidth(PyObject* self, PyObject* args)
+{
+  char *text;
+
+  if (!PyArg_ParseTuple(args, "s", &text))
+    return Py_BuildValue("i", -1); 
+  return Py_BuildValue("i", TEXTwidth(text));
+}
+static PyObject* py_lcdDrawTextLine(PyObject* self, PyObject* args)
+{
+  int x,y,w,align;
+  char *text;
+
+  // One line cleared to the background across w (0 to the edge), align 0 left, 1 right, 2 centre
+  if (!PyArg_ParseTuple(args, "iiiis", &x, &y, &w, &align, &text) || x < 0 || y < 0 || w < 0 ||
+    x > 255 || y > 255 || w > 255)
+    return Py_BuildValue("i", -1); 
+  return Py_BuildValue("i", TEXTline(x, y, w, align, text, strlen(text)));
+}
+static PyObject* py_lcdDrawTextBox(PyObject* self, PyObject* args)
+{
+  int x,y,w,h,align;
+  char *text;
+
+  // Word wrapped into the box; returns the lines the text needs, more than fit if it was cut
+  if (!PyArg_ParseTuple(args, "iiiiis", &x, &y, &w, &h, &align, &text) || x < 0 || y < 0 || w < 0 || h < 0 ||
+    x > 255 || y > 255 || w > 255 || h > 255)
+    return Py_BuildValue("i", -1); 
+  return Py_BuildValue("i", TEXTbox(x, y, w, h, align, text));
+}
+static PyObject* py_lcdMarqueeInit(PyObject* self, PyObject* args)
+{
+  int id,x,y,w,hold;
+
+  // Marquee id (0-3) in an 8 row box at x, y, w wide, resting hold ticks at the start of each lap
+  if (!PyArg_ParseTuple(args, "iiiii", &id, &x, &y, &w, &hold))
+    return Py_BuildValue("i", -1); 
+  if (id < 0 || id >= MAX_MARQUEES || x < 0 || y < 0 || w < 0 || hold < 0 || x > 255 || y > 255 ||
+    w > 255 || hold > 255 || TEXTmarqueeInit(&marquees[id], x, y, w, hold) < 0)
+    return Py_BuildValue("i", -1); 
+  marqueeReady[id] = 1;
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdMarqueeText(PyObject* self, PyObject* args)
+{
+  int id;
+  char *text;
+
+  // Same text as before keeps scrolling where it is; returns 1 when it changed and was redrawn
+  if (!PyArg_ParseTuple(args, "is", &id, &text))
+    return Py_BuildValue("i", -1); 
+  if (id < 0 || id >= MAX_MARQUEES || !marqueeReady[id])
+    return Py_BuildValue("i", -1); 
+  return Py_BuildValue("i", TEXTmarqueeSet(&marquees[id], text));
+}
+static PyObject* py_lcdMarqueeTick(PyObject* self, PyObject* args)
+{
+  int id, step;
+
+  // Scroll step pixels; returns the (x, y, w, h) changed for lcdDisplayRegion, 0 if it did not move
+  if (!PyArg_ParseTuple(args, "ii", &id, &step))
+    return Py_BuildValue("i", -1); 
+  if (id < 0 || id >= MAX_MARQUEES || !marqueeReady[id] || step < 0 || step > 255)
+    return Py_BuildValue("i", -1); 
+  if (!TEXTmarqueeTick(&marquees[id], step))
+    return Py_BuildValue("i", 0);
+  return Py_BuildValue("(iiii)", marquees[id].dirtyX, marquees[id].dirtyY, marquees[id].dirtyW, marquees[id].dirtyH);
+}
 static PyObject* py_lcdSetPixel(PyObject* self, PyObject* args)
 {
   int x,y,c;
@@ -208,6 +426,7 @@ static PyObject* py_lcdSetContrast(PyObject* self, PyObject* args)
   if (!PyArg_ParseTuple(args, "i", &c))
     return Py_BuildValue("i", -1); 
   // Set Text Contrast
+  RTwait();
   LCDsetContrast(c);
   return Py_BuildValue("i", 0);
 }
@@ -222,6 +441,302 @@ static PyObject* py_lcdSetCursor(PyObject* self, PyObject* args)
   LCDsetCursor(x,y);
   return Py_BuildValue("i", 0);
 }
+static PyObject* py_lcdSetOrientation(PyObject* self, PyObject* args)
+{
+  int o;
+
+  // LCD_ROTATE_* (0-3) | LCD_MIRROR_X (4) | LCD_MIRROR_Y (8), clears the buffer
+  if (!PyArg_ParseTuple(args, "i", &o))
+    return Py_BuildValue("i", -1); 
+  if (o < 0 || o > 15 || GRAYrunning())
+    return Py_BuildValue("i", -1); 
+  RTwait();
+  LCDsetOrientation(o);
+  return Py_BuildValue("ii", LCDwidth(), LCDheight());
+}
+static PyObject* py_lcdDisplayRegion(PyObject* self, PyObject* args)
+{
+  int x,y,w,h;
+
+  // Send just this rectangle of the buffer
+  if (!PyArg_ParseTuple(args, "iiii", &x, &y, &w, &h))
+    return Py_BuildValue("i", -1); 
+  if (GRAYrunning() || x < 0 || y < 0 || w < 0 || h < 0)
+    return Py_BuildValue("i", -1); 
+  if (RTactive())
+    RTdisplayRegion(x, y, w > 255 ? 255 : w, h > 255 ? 255 : h);
+  else
+    LCDdisplayRegion(x, y, w > 255 ? 255 : w, h > 255 ? 255 : h);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdStats(PyObject* self, PyObject* args)
+{
+  LCDstats st;
+  PyObject *hist;
+  int i;
+
+  // Driver counters as a dict, flushHistUs[i] counts flushes of [2^i, 2^(i+1)) us,
+  // and the bring-up: startUs to initDisplay(), initUs in it, firstFrameUs to the first frame after the logo
+  LCDgetStats(&st);
+  hist = PyList_New(LCD_HIST_BUCKETS);
+  if (hist == NULL)
+    return NULL;
+  for (i = 0; i < LCD_HIST_BUCKETS; i++)
+    PyList_SET_ITEM(hist, i, PyInt_FromLong(st.flushHist[i]));
+  return Py_BuildValue("{s:I,s:I,s:I,s:I,s:K,s:K,s:K,s:K,s:I,s:I,s:N,s:I,s:I,s:I}",
+    "frames", st.frames,
+    "dataBytes", st.dataBytes,
+    "commands", st.commands,
+    "pagesSkipped", st.pagesSkipped,
+    "gpioWrites", (unsigned PY_LONG_LONG)st.gpioWrites,
+    "rasterNs", (unsigned PY_LONG_LONG)st.rasterNs,
+    "transferNs", (unsigned PY_LONG_LONG)st.transferNs,
+    "orientNs", (unsigned PY_LONG_LONG)st.orientNs,
+    "lastFlushUs", st.lastFlushUs,
+    "maxFlushUs", st.maxFlushUs,
+    "flushHistUs", hist,
+    "startUs", st.startUs,
+    "initUs", st.initUs,
+    "firstFrameUs", st.firstFrameUs);
+}
+static PyObject* py_lcdStreamStart(PyObject* self, PyObject* args)
+{
+  char *target;
+  int fps;
+
+  // Publish every flushed frame to lcdview at target ("/path" or "host:port"), at most fps a second
+  if (!PyArg_ParseTuple(args, "si", &target, &fps))
+    return Py_BuildValue("i", -1); 
+  if (fps < 1 || fps > 65535 || STREAMopen(target, fps) < 0)
+    return Py_BuildValue("i", -1); 
+  LCDsetFlushHook(STREAMframe);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdStreamStop(PyObject* self, PyObject* args)
+{
+  LCDsetFlushHook(NULL);
+  STREAMclose();
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdStreamTick(PyObject* self, PyObject* args)
+{
+  // Send a frame the rate limit held back once it is due; ms until it is, -1 if none
+  return Py_BuildValue("i", STREAMtick());
+}
+static PyObject* py_lcdStreamStats(PyObject* self, PyObject* args)
+{
+  STREAMstats st;
+
+  // Mirror counters as a dict, bytes includes the message headers
+  STREAMgetStats(&st);
+  return Py_BuildValue("{s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:K,s:K}",
+    "fps", st.fps,
+    "frames", st.frames,
+    "sent", st.sent,
+    "keyFrames", st.keyFrames,
+    "limited", st.limited,
+    "dropped", st.dropped,
+    "connects", st.connects,
+    "bytes", (unsigned PY_LONG_LONG)st.bytes,
+    "encodeNs", (unsigned PY_LONG_LONG)st.encodeNs);
+}
+static PyObject* py_lcdResetStats(PyObject* self, PyObject* args)
+{
+  // Zero the driver counters
+  LCDresetStats();
+  return Py_BuildValue("i", 0);
+}
+
+static PyObject* py_lcdGrayStart(PyObject* self, PyObject* args)
+{
+  int hz = 180;
+
+  // Cycle the gray bitplanes at hz planes a second; lcdDisplay() is off until lcdGrayStop()
+  if (!PyArg_ParseTuple(args, "|i", &hz) || hz <= 0 || hz > 65535 || RTactive())
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", GRAYstart(hz));
+}
+static PyObject* py_lcdGrayStop(PyObject* self, PyObject* args)
+{
+  GRAYstop();
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdGrayClear(PyObject* self, PyObject* args)
+{
+  int level = 0;
+
+  if (!PyArg_ParseTuple(args, "|i", &level))
+    return Py_BuildValue("i", -1);
+  GRAYclear(level);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdGrayPixel(PyObject* self, PyObject* args)
+{
+  int x,y,level;
+
+  if (!PyArg_ParseTuple(args, "iii", &x, &y, &level))
+    return Py_BuildValue("i", -1);
+  GRAYsetPixel(x, y, level);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdGrayFillRect(PyObject* self, PyObject* args)
+{
+  int x,y,w,h,level;
+
+  if (!PyArg_ParseTuple(args, "iiiii", &x, &y, &w, &h, &level))
+    return Py_BuildValue("i", -1);
+  GRAYfillrect(x, y, w, h, level);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdGrayMono(PyObject* self, PyObject* args)
+{
+  int level;
+
+  // Paint whatever the lcd* calls drew into the buffer at this gray level
+  if (!PyArg_ParseTuple(args, "i", &level))
+    return Py_BuildValue("i", -1);
+  GRAYfromMono(level);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdGrayCommit(PyObject* self, PyObject* args)
+{
+  // Shown from the next dither cycle
+  GRAYcommit();
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdGrayStats(PyObject* self, PyObject* args)
+{
+  GRAYstats st;
+  PyObject *hist;
+  int i;
+
+  // Refresh counters as a dict, lateHistUs[i] counts wakeups [2^i, 2^(i+1)) us late
+  GRAYgetStats(&st);
+  hist = PyList_New(GRAY_HIST_BUCKETS);
+  if (hist == NULL)
+    return NULL;
+  for (i = 0; i < GRAY_HIST_BUCKETS; i++)
+    PyList_SET_ITEM(hist, i, PyInt_FromLong(st.lateHist[i]));
+  return Py_BuildValue("{s:I,s:I,s:I,s:I,s:I,s:K,s:K,s:K,s:K,s:K,s:I,s:N}",
+    "hz", st.hz,
+    "frames", st.frames,
+    "cycles", st.cycles,
+    "commits", st.commits,
+    "overruns", st.overruns,
+    "dataBytes", (unsigned PY_LONG_LONG)st.dataBytes,
+    "cmdBytes", (unsigned PY_LONG_LONG)st.cmdBytes,
+    "bytesSkipped", (unsigned PY_LONG_LONG)st.bytesSkipped,
+    "busyNs", (unsigned PY_LONG_LONG)st.busyNs,
+    "elapsedNs", (unsigned PY_LONG_LONG)st.elapsedNs,
+    "maxLateUs", st.maxLateUs,
+    "lateHistUs", hist);
+}
+
+static PyObject* py_lcdRealtimeStart(PyObject* self, PyObject* args)
+{
+  int cpu = -1, priority = RT_PRIORITY;
+
+  // Flush from a SCHED_FIFO thread pinned to cpu (-1 any); needs root or CAP_SYS_NICE, not with grayscale mode
+  if (!PyArg_ParseTuple(args, "|ii", &cpu, &priority) || GRAYrunning())
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", RTstart(cpu, priority));
+}
+static PyObject* py_lcdRealtimeStop(PyObject* self, PyObject* args)
+{
+  // Sends what was handed over, then flushes go back to the caller's thread
+  RTstop();
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdRealtimeStats(PyObject* self, PyObject* args)
+{
+  RTstats st;
+
+  // Flush timing as a dict, the mode on or off: frame times in us, gaps between display RAM bytes in ns
+  RTgetStats(&st);
+  return Py_BuildValue("{s:i,s:i,s:i,s:I,s:I,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+    "active", RTactive(),
+    "cpu", st.cpu,
+    "priority", st.priority,
+    "frames", st.frames,
+    "coalesced", st.coalesced,
+    "bytes", (unsigned PY_LONG_LONG)st.bytes,
+    "frameP50Us", (unsigned PY_LONG_LONG)(RTpercentile(st.frameHist, 500, st.maxFrameNs) / 1000),
+    "frameP99Us", (unsigned PY_LONG_LONG)(RTpercentile(st.frameHist, 990, st.maxFrameNs) / 1000),
+    "frameMaxUs", (unsigned PY_LONG_LONG)(st.maxFrameNs / 1000),
+    "byteP50Ns", (unsigned PY_LONG_LONG)RTpercentile(st.byteHist, 500, st.maxByteNs),
+    "byteP99Ns", (unsigned PY_LONG_LONG)RTpercentile(st.byteHist, 990, st.maxByteNs),
+    "byteMaxNs", (unsigned PY_LONG_LONG)st.maxByteNs);
+}
+static PyObject* py_lcdRealtimeResetStats(PyObject* self, PyObject* args)
+{
+  RTresetStats();
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdTermStart(PyObject* self, PyObject* args)
+{
+  int page0 = 0, rows = 0, minMs = 100;
+
+  // Console on pages page0 on (rows 0 = to the bottom), flushed at most every minMs
+  if (!PyArg_ParseTuple(args, "|iii", &page0, &rows, &minMs) || page0 < 0 || rows < 0 || minMs < 0 ||
+    page0 > 255 || rows > 255 || minMs > 65535 || TERMinit(&term, page0, rows, minMs) < 0)
+    return Py_BuildValue("i", -1);
+  termReady = 1;
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdTermWrite(PyObject* self, PyObject* args)
+{
+  const char *text;
+
+  // Into the scrollback only, nothing is drawn until lcdTermFlush(); '\n' ends a line
+  if (!PyArg_ParseTuple(args, "s", &text) || !termReady)
+    return Py_BuildValue("i", -1);
+  TERMwrite(&term, text);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdTermFlush(PyObject* self, PyObject* args)
+{
+  struct timespec ts;
+
+  // Draws and sends the rows that changed, unless the last flush was under minMs ago; pages sent
+  if (!termReady || GRAYrunning())
+    return Py_BuildValue("i", -1);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return Py_BuildValue("i", TERMflush(&term, ts.tv_sec * 1000 + ts.tv_nsec / 1000000,
+    RTactive() ? RTdisplayRegion : LCDdisplayRegion));
+}
+static PyObject* py_lcdTermScroll(PyObject* self, PyObject* args)
+{
+  int back;
+
+  // View lines back from the newest, 0 follows them again; returns where it ended up
+  if (!PyArg_ParseTuple(args, "i", &back) || !termReady)
+    return Py_BuildValue("i", -1);
+  return Py_BuildValue("i", TERMscroll(&term, back));
+}
+static PyObject* py_lcdTermClear(PyObject* self, PyObject* args)
+{
+  if (!termReady)
+    return Py_BuildValue("i", -1);
+  TERMclear(&term);
+  return Py_BuildValue("i", 0);
+}
+static PyObject* py_lcdTermStats(PyObject* self, PyObject* args)
+{
+  TERMstats st;
+
+  if (!termReady)
+    return Py_BuildValue("i", -1);
+  TERMgetStats(&term, &st);
+  return Py_BuildValue("{s:I,s:I,s:I,s:I,s:I,s:I,s:I,s:i}",
+    "lines", st.lines,
+    "flushes", st.flushes,
+    "limited", st.limited,
+    "scrolls", st.scrolls,
+    "redraws", st.redraws,
+    "coalesced", st.coalesced,
+    "pagesSent", st.pagesSent,
+    "back", term.back);
+}
 
 
 /*
@@ -238,12 +753,53 @@ static PyMethodDef lcd_methods[] = {
   {"lcdDrawLine", py_lcdDrawLine, METH_VARARGS},
   {"lcdDrawCircle", py_lcdDrawCircle, METH_VARARGS},
   {"lcdFillCircle", py_lcdFillCircle, METH_VARARGS},
+  {"lcdDrawArc", py_lcdDrawArc, METH_VARARGS},
+  {"lcdFillArc", py_lcdFillArc, METH_VARARGS},
+  {"lcdDrawPolar", py_lcdDrawPolar, METH_VARARGS},
+  {"lcdFillPolygon", py_lcdFillPolygon, METH_VARARGS},
+  {"lcdFillTriangle", py_lcdFillTriangle, METH_VARARGS},
+  {"lcdDrawThickLine", py_lcdDrawThickLine, METH_VARARGS},
+  {"lcdDialInit", py_lcdDialInit, METH_VARARGS},
+  {"lcdDialDraw", py_lcdDialDraw, METH_VARARGS},
+  {"lcdDialSet", py_lcdDialSet, METH_VARARGS},
+  {"lcdTextWidth", py_lcdTextWidth, METH_VARARGS},
+  {"lcdDrawTextLine", py_lcdDrawTextLine, METH_VARARGS},
+  {"lcdDrawTextBox", py_lcdDrawTextBox, METH_VARARGS},
+  {"lcdMarqueeInit", py_lcdMarqueeInit, METH_VARARGS},
+  {"lcdMarqueeText", py_lcdMarqueeText, METH_VARARGS},
+  {"lcdMarqueeTick", py_lcdMarqueeTick, METH_VARARGS},
   {"lcdSetPixel", py_lcdSetPixel, METH_VARARGS},
   {"lcdGetPixel", py_lcdGetPixel, METH_VARARGS},
   {"lcdSetTextColour", py_lcdSetTextColour, METH_VARARGS},
   {"lcdSetTextSize", py_lcdSetTextSize, METH_VARARGS},
   {"lcdSetContrast", py_lcdSetContrast, METH_VARARGS},
   {"lcdSetCursor", py_lcdSetCursor, METH_VARARGS},
+  {"lcdSetOrientation", py_lcdSetOrientation, METH_VARARGS},
+  {"lcdDisplayRegion", py_lcdDisplayRegion, METH_VARARGS},
+  {"lcdStats", py_lcdStats, METH_VARARGS},
+  {"lcdResetStats", py_lcdResetStats, METH_VARARGS},
+  {"lcdStreamStart", py_lcdStreamStart, METH_VARARGS},
+  {"lcdStreamStop", py_lcdStreamStop, METH_VARARGS},
+  {"lcdStreamTick", py_lcdStreamTick, METH_VARARGS},
+  {"lcdStreamStats", py_lcdStreamStats, METH_VARARGS},
+  {"lcdGrayStart", py_lcdGrayStart, METH_VARARGS},
+  {"lcdGrayStop", py_lcdGrayStop, METH_VARARGS},
+  {"lcdGrayClear", py_lcdGrayClear, METH_VARARGS},
+  {"lcdGrayPixel", py_lcdGrayPixel, METH_VARARGS},
+  {"lcdGrayFillRect", py_lcdGrayFillRect, METH_VARARGS},
+  {"lcdGrayMono", py_lcdGrayMono, METH_VARARGS},
+  {"lcdGrayCommit", py_lcdGrayCommit, METH_VARARGS},
+  {"lcdGrayStats", py_lcdGrayStats, METH_VARARGS},
+  {"lcdRealtimeStart", py_lcdRealtimeStart, METH_VARARGS},
+  {"lcdRealtimeStop", py_lcdRealtimeStop, METH_VARARGS},
+  {"lcdRealtimeStats", py_lcdRealtimeStats, METH_VARARGS},
+  {"lcdRealtimeResetStats", py_lcdRealtimeResetStats, METH_VARARGS},
+  {"lcdTermStart", py_lcdTermStart, METH_VARARGS},
+  {"lcdTermWrite", py_lcdTermWrite, METH_VARARGS},
+  {"lcdTermFlush", py_lcdTermFlush, METH_VARARGS},
+  {"lcdTermScroll", py_lcdTermScroll, METH_VARARGS},
+  {"lcdTermClear", py_lcdTermClear, METH_VARARGS},
+  {"lcdTermStats", py_lcdTermStats, METH_VARARGS},
   {NULL, NULL}
 };
 
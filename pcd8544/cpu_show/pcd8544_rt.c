@@ -0,0 +1,335 @@
+/*
+=================================================================================
+ Name        : pcd8544_rt.c
+ Version     : 0.1
+
+ Description : Real-time transmit thread and flush timing, see pcd8544_rt.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#define _GNU_SOURCE             // CPU_SET, pthread_attr_setaffinity_np
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "pcd8544_rt.h"
+
+#define RT_STACK (256 * 1024)   // transmit thread stack, locked with the rest
+#define RT_PREFAULT (64 * 1024) // of it, touched before the first frame
+
+static pthread_mutex_t rtMutex = PTHREAD_MUTEX_INITIALIZER;
+// held while a frame is on the bus, and by LCDgetStats() / LCDresetStats()
+static pthread_mutex_t busMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rtWake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t rtIdle = PTHREAD_COND_INITIALIZER;
+static pthread_t transmitThread;
+static uint8_t active, running, pending, busy;
+
+// the drawing handed over and the region of it to send, and the thread's own copy
+static uint8_t handed[LCDBUFSIZE], sending[LCDBUFSIZE];
+static uint16_t pendX0, pendY0, pendX1, pendY1;
+
+// only the flushing thread writes these; they go into stats once a frame is out
+static uint32_t frameBytes[RT_HIST_BUCKETS];
+static uint64_t frameBytesMax, frameByteCount, lastByteNs;
+
+static RTstats stats = { .cpu = -1 };
+
+static uint64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// quarter octaves: the top bit picks the octave, the two below it the quarter
+static uint8_t bucket(uint64_t ns)
+{
+	int o;
+
+	if (ns < 4)
+		return ns;
+	o = 63 - __builtin_clzll(ns);
+	if (o > 32)
+		return RT_HIST_BUCKETS - 1;
+	return 4 * (o - 1) + ((ns >> (o - 2)) & 3);
+}
+
+uint64_t RTpercentile(const uint32_t *hist, uint32_t permille, uint64_t max)
+{
+	uint64_t total = 0, want, seen = 0, top;
+	int i, o;
+
+	for (i = 0; i < RT_HIST_BUCKETS; i++)
+		total += hist[i];
+	if (total == 0)
+		return 0;
+	want = (total * permille + 999) / 1000;
+	for (i = 0; i < RT_HIST_BUCKETS - 1; i++)
+	{
+		seen += hist[i];
+		if (seen >= want)
+			break;
+	}
+	if (i < 4)
+		top = i;
+	else
+	{
+		o = i / 4 + 1;
+		top = ((uint64_t)(5 + i % 4) << (o - 2)) - 1;
+	}
+	return top > max ? max : top;
+}
+
+static void onByte(uint8_t start)
+{
+	uint64_t now = nowNs(), ns = now - lastByteNs;
+
+	lastByteNs = now;
+	if (start)
+		return;
+	frameBytes[bucket(ns)]++;
+	frameByteCount++;
+	if (ns > frameBytesMax)
+		frameBytesMax = ns;
+}
+
+// one flush with its bytes timed, from whichever thread owns the bus
+static void sendTimed(const uint8_t *src, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+	uint64_t start = nowNs(), ns;
+	int i;
+
+	pthread_mutex_lock(&busMutex);
+	LCDsetByteHook(onByte);
+	LCDdisplayBuffer(src, x0, y0, x1 - x0 > 255 ? 255 : x1 - x0, y1 - y0 > 255 ? 255 : y1 - y0);
+	LCDsetByteHook(NULL);
+	pthread_mutex_unlock(&busMutex);
+	ns = nowNs() - start;
+
+	pthread_mutex_lock(&rtMutex);
+	stats.frames++;
+	stats.frameHist[bucket(ns)]++;
+	if (ns > stats.maxFrameNs)
+		stats.maxFrameNs = ns;
+	for (i = 0; i < RT_HIST_BUCKETS; i++)
+		stats.byteHist[i] += frameBytes[i];
+	stats.bytes += frameByteCount;
+	if (frameBytesMax > stats.maxByteNs)
+		stats.maxByteNs = frameBytesMax;
+	pthread_mutex_unlock(&rtMutex);
+	memset(frameBytes, 0, sizeof(frameBytes));
+	frameBytesMax = frameByteCount = 0;
+}
+
+static void lockBus(uint8_t lock)
+{
+	if (lock)
+		pthread_mutex_lock(&busMutex);
+	else
+		pthread_mutex_unlock(&busMutex);
+}
+
+static void *transmit(void *arg)
+{
+	volatile uint8_t stack[RT_PREFAULT];
+	uint16_t x0, y0, x1, y1;
+
+	(void)arg;
+	// the stack pages the flush will use, faulted in now rather than mid frame
+	memset((uint8_t *)stack, 0, sizeof(stack));
+
+	pthread_mutex_lock(&rtMutex);
+	for (;;)
+	{
+		while (running && !pending)
+			pthread_cond_wait(&rtWake, &rtMutex);
+		if (!pending)
+			break;
+		memcpy(sending, handed, LCDBUFSIZE);
+		x0 = pendX0;
+		y0 = pendY0;
+		x1 = pendX1;
+		y1 = pendY1;
+		pending = 0;
+		busy = 1;
+		pthread_mutex_unlock(&rtMutex);
+
+		sendTimed(sending, x0, y0, x1, y1);
+
+		pthread_mutex_lock(&rtMutex);
+		busy = 0;
+		pthread_cond_broadcast(&rtIdle);
+	}
+	pthread_mutex_unlock(&rtMutex);
+	return NULL;
+}
+
+int RTstart(int cpu, int priority)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	pthread_mutexattr_t lockAttr;
+	cpu_set_t cpus;
+	int err;
+
+	if (active)
+		return 0;
+	if (priority <= 0)
+		priority = RT_PRIORITY;
+	if (priority < sched_get_priority_min(SCHED_FIFO))
+		priority = sched_get_priority_min(SCHED_FIFO);
+	if (priority > sched_get_priority_max(SCHED_FIFO))
+		priority = sched_get_priority_max(SCHED_FIFO);
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+		return -1;
+	// locked already, written once so no first touch is left for a frame
+	memset(handed, 0, sizeof(handed));
+	memset(sending, 0, sizeof(sending));
+	memset(frameBytes, 0, sizeof(frameBytes));
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, RT_STACK);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = priority;
+	pthread_attr_setschedparam(&attr, &param);
+	if (cpu >= 0)
+	{
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+	running = 1;
+	pending = busy = 0;
+	// the driver counters are written on the thread, read them with the bus
+	// held; a reader preempted holding it lends the thread's priority
+	pthread_mutexattr_init(&lockAttr);
+	pthread_mutexattr_setprotocol(&lockAttr, PTHREAD_PRIO_INHERIT);
+	pthread_mutex_init(&busMutex, &lockAttr);
+	pthread_mutexattr_destroy(&lockAttr);
+	LCDsetStatsLock(lockBus);
+	err = pthread_create(&transmitThread, &attr, transmit, NULL);
+	pthread_attr_destroy(&attr);
+	if (err)
+	{
+		// not permitted (no CAP_SYS_NICE) or no such core
+		running = 0;
+		LCDsetStatsLock(NULL);
+		munlockall();
+		errno = err;
+		return -1;
+	}
+	active = 1;
+	pthread_mutex_lock(&rtMutex);
+	stats.cpu = cpu;
+	stats.priority = priority;
+	pthread_mutex_unlock(&rtMutex);
+	return 0;
+}
+
+void RTstop(void)
+{
+	if (!active)
+		return;
+	pthread_mutex_lock(&rtMutex);
+	running = 0;
+	pthread_cond_signal(&rtWake);
+	pthread_mutex_unlock(&rtMutex);
+	// whatever was handed over still goes out first
+	pthread_join(transmitThread, NULL);
+	active = 0;
+	LCDsetStatsLock(NULL);
+	munlockall();
+	pthread_mutex_lock(&rtMutex);
+	stats.cpu = -1;
+	stats.priority = 0;
+	pthread_mutex_unlock(&rtMutex);
+}
+
+int RTactive(void)
+{
+	return active;
+}
+
+void RTdisplayRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+	uint16_t x1 = x + w, y1 = y + h;
+
+	// the flush hook and the rasterization clock stay on this thread
+	LCDhandover(pcd8544_buffer, x, y, w, h);
+	if (!active)
+	{
+		sendTimed(pcd8544_buffer, x, y, x1, y1);
+		return;
+	}
+	if (!w || !h)
+		return;
+	pthread_mutex_lock(&rtMutex);
+	memcpy(handed, pcd8544_buffer, LCDBUFSIZE);
+	if (pending)
+	{
+		// the thread has not got to the last one yet, send both as one
+		stats.coalesced++;
+		if (x < pendX0)
+			pendX0 = x;
+		if (y < pendY0)
+			pendY0 = y;
+		if (x1 > pendX1)
+			pendX1 = x1;
+		if (y1 > pendY1)
+			pendY1 = y1;
+	}
+	else
+	{
+		pendX0 = x;
+		pendY0 = y;
+		pendX1 = x1;
+		pendY1 = y1;
+		pending = 1;
+	}
+	pthread_cond_signal(&rtWake);
+	pthread_mutex_unlock(&rtMutex);
+}
+
+void RTdisplay(void)
+{
+	RTdisplayRegion(0, 0, LCDwidth(), LCDheight());
+}
+
+void RTwait(void)
+{
+	pthread_mutex_lock(&rtMutex);
+	while (active && (pending || busy))
+		pthread_cond_wait(&rtIdle, &rtMutex);
+	pthread_mutex_unlock(&rtMutex);
+}
+
+void RTgetStats(RTstats *s)
+{
+	pthread_mutex_lock(&rtMutex);
+	*s = stats;
+	pthread_mutex_unlock(&rtMutex);
+}
+
+void RTresetStats(void)
+{
+	pthread_mutex_lock(&rtMutex);
+	memset(stats.frameHist, 0, sizeof(stats.frameHist));
+	memset(stats.byteHist, 0, sizeof(stats.byteHist));
+	stats.frames = stats.coalesced = 0;
+	stats.bytes = stats.maxFrameNs = stats.maxByteNs = 0;
+	pthread_mutex_unlock(&rtMutex);
+}
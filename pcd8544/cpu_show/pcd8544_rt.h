@@ -0,0 +1,70 @@
+/*
+=================================================================================
+ Name        : pcd8544_rt.h
+ Version     : 0.1
+
+ Description : Real-time transmit mode for the bit-banged PCD8544 bus. A
+     byte preempted half way through has its clock stretched, and on a busy
+     Pi (upload threads, the OBD client) that now and then garbles a frame.
+
+     RTstart() locks the process into memory, prefaults the frame buffers
+     and the thread's stack, and starts a transmit thread under SCHED_FIFO,
+     pinned to one core. RTdisplay() / RTdisplayRegion() copy the drawing
+     and hand it over, so the caller goes on drawing while the thread sends;
+     a flush arriving while one is still waiting is folded into it, the
+     regions joined. The thread owns the bus while the mode is on: flush
+     through RT* only, and not together with grayscale mode. The flush hook
+     and the rasterization clock stay with the caller (LCDhandover()), and
+     LCDgetStats() holds the bus while it reads what the thread counts.
+
+     Every flush made through RT* is timed, with the mode on or off: the
+     whole flush, and the gap between consecutive display RAM bytes, which
+     is where a preemption shows. Both go into histograms of quarter
+     octaves of nanoseconds, from which RTpercentile() reads p50 / p99.
+     rtbench compares the two modes under a synthetic CPU load.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_RT_H
+#define PCD8544_RT_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+
+#define RT_HIST_BUCKETS 128     // bucket 4*(o-1)+q counts [(4+q) << (o-2), (5+q) << (o-2)) ns, 0..3 exact
+#define RT_PRIORITY 50          // SCHED_FIFO priority when none is given
+
+typedef struct
+{
+	int8_t cpu;                 // core the transmit thread is pinned to, -1 for any
+	uint8_t priority;           // its SCHED_FIFO priority, 0 while the mode is off
+	uint32_t frames;            // flushes sent
+	uint32_t coalesced;         // flushes folded into one still waiting for the thread
+	uint64_t bytes;             // display RAM bytes timed
+	uint64_t maxFrameNs;
+	uint64_t maxByteNs;
+	uint32_t frameHist[RT_HIST_BUCKETS];   // ns per flush
+	uint32_t byteHist[RT_HIST_BUCKETS];    // ns from one display RAM byte to the next
+} RTstats;
+
+ int RTstart(int cpu, int priority);    // cpu -1 for any; -1 with errno if refused, the mode stays off
+ void RTstop(void);
+ int RTactive(void);
+ void RTdisplay(void);
+ void RTdisplayRegion(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
+ void RTwait(void);                     // until every flush handed over is on the panel
+ void RTgetStats(RTstats *stats);
+ void RTresetStats(void);
+ uint64_t RTpercentile(const uint32_t *hist, uint32_t permille, uint64_t max);   // ns, the top of its bucket but at most max
+
+#endif
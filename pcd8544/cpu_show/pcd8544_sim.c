@@ -0,0 +1,192 @@
+/*
+=================================================================================
+ Name        : pcd8544_sim.c
+ Version     : 0.1
+
+ Description : Counting GPIO stub and virtual PCD8544 controller.
+     Every digitalWrite() is counted, SCLK rising edges shift DIN into a byte
+     exactly like the real serial interface, and latched bytes are decoded into
+     a 504 byte display RAM so a flushed frame can be compared with the buffer.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include <time.h>
+#include "pcd8544_sim.h"
+
+#define SIM_PINS 64
+#define SIM_COLS 84
+#define SIM_PAGES 6
+
+static int pin_sclk = -1, pin_din = -1, pin_dc = -1, pin_cs = -1, pin_rst = -1;
+static uint8_t level[SIM_PINS];
+static SIMcounters counters;
+
+// serial interface and controller state
+static uint8_t shiftReg, shiftBits;
+static uint8_t extended, addrX, addrY, display;
+static uint8_t ram[SIM_COLS * SIM_PAGES];
+
+static void controllerReset(void)
+{
+	shiftReg = shiftBits = 0;
+	extended = 0;
+	addrX = addrY = 0;
+	display = 0;    // blank
+}
+
+static void latchCommand(uint8_t c)
+{
+	counters.cmdBytes++;
+	if (c & 0x80)
+	{
+		// H=0: set X address, H=1: set Vop (ignored)
+		if (!extended)
+			addrX = (c & 0x7f) % SIM_COLS;
+	}
+	else if (c & 0x40)
+	{
+		if (!extended)
+			addrY = (c & 0x07) % SIM_PAGES;
+	}
+	else if (c & 0x20)
+	{
+		// function set, only the H bit matters to the model
+		extended = c & 0x01;
+	}
+	else if (c & 0x08)
+	{
+		// display control: blank, normal, all on or inverted
+		if (!extended)
+			display = c & 0x05;
+	}
+	// bias and temperature commands have no visible effect here
+}
+
+static void latchData(uint8_t d)
+{
+	counters.dataBytes++;
+	ram[addrY * SIM_COLS + addrX] = d;
+	if (++addrX >= SIM_COLS)
+	{
+		addrX = 0;
+		addrY = (addrY + 1) % SIM_PAGES;
+	}
+}
+
+int wiringPiSetup(void)
+{
+	return 0;
+}
+
+void pinMode(int pin, int mode)
+{
+	(void)pin;
+	(void)mode;
+}
+
+void digitalWrite(int pin, int value)
+{
+	uint8_t old;
+
+	counters.writes++;
+	if (pin < 0 || pin >= SIM_PINS)
+		return;
+	value = value ? HIGH : LOW;
+	old = level[pin];
+	if (old == value)
+		return;
+	level[pin] = value;
+	counters.toggles++;
+
+	if (pin == pin_rst)
+	{
+		if (value == LOW)
+		{
+			counters.resets++;
+			controllerReset();
+		}
+	}
+	else if (pin == pin_cs)
+	{
+		// SCE high re-initialises the serial interface
+		if (value == HIGH)
+			shiftReg = shiftBits = 0;
+	}
+	else if (pin == pin_sclk && value == HIGH)
+	{
+		if (pin_cs >= 0 && level[pin_cs] != LOW)
+			return;
+		counters.clocks++;
+		shiftReg = (shiftReg << 1) | level[pin_din];
+		if (++shiftBits == 8)
+		{
+			if (level[pin_dc])
+				latchData(shiftReg);
+			else
+				latchCommand(shiftReg);
+			shiftReg = shiftBits = 0;
+		}
+	}
+}
+
+void delay(unsigned int howLong)
+{
+	struct timespec ts;
+	ts.tv_sec = howLong / 1000;
+	ts.tv_nsec = (howLong % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+void delayMicroseconds(unsigned int howLong)
+{
+	struct timespec ts;
+	ts.tv_sec = howLong / 1000000;
+	ts.tv_nsec = (howLong % 1000000) * 1000L;
+	nanosleep(&ts, NULL);
+}
+
+void SIMinit(uint8_t SCLK, uint8_t DIN, uint8_t DC, uint8_t CS, uint8_t RST)
+{
+	pin_sclk = SCLK;
+	pin_din = DIN;
+	pin_dc = DC;
+	pin_cs = CS;
+	pin_rst = RST;
+	memset(level, 0, sizeof(level));
+	level[pin_cs] = HIGH;
+	level[pin_rst] = HIGH;
+	memset(ram, 0, sizeof(ram));
+	controllerReset();
+	SIMresetCounters();
+}
+
+void SIMresetCounters(void)
+{
+	memset(&counters, 0, sizeof(counters));
+}
+
+void SIMgetCounters(SIMcounters *c)
+{
+	*c = counters;
+}
+
+const uint8_t *SIMram(void)
+{
+	return ram;
+}
+
+uint8_t SIMdisplayMode(void)
+{
+	return display;
+}
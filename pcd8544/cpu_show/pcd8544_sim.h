@@ -0,0 +1,56 @@
+/*
+=================================================================================
+ Name        : pcd8544_sim.h
+ Version     : 0.1
+
+ Description : Counting GPIO stub and virtual PCD8544 controller.
+     Stands in for WiringPI when PCD8544.c is built with -DPCD8544_GPIO_SIM so the
+     driver can be benchmarked and checked on any Linux box without a panel.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_SIM_H
+#define PCD8544_SIM_H
+
+#include <stdint.h>
+
+// WiringPI subset used by the driver
+#define INPUT  0
+#define OUTPUT 1
+#define LOW    0
+#define HIGH   1
+
+ int wiringPiSetup(void);
+ void pinMode(int pin, int mode);
+ void digitalWrite(int pin, int value);
+ void delay(unsigned int howLong);
+ void delayMicroseconds(unsigned int howLong);
+
+// bus counters, all cumulative since SIMinit()/SIMresetCounters()
+typedef struct
+{
+	uint64_t writes;      // digitalWrite() calls
+	uint64_t toggles;     // writes that actually changed a pin level
+	uint64_t clocks;      // rising SCLK edges while CS is low
+	uint64_t cmdBytes;    // bytes latched with D/C low
+	uint64_t dataBytes;   // bytes latched with D/C high
+	uint64_t resets;      // RST low pulses
+} SIMcounters;
+
+ void SIMinit(uint8_t SCLK, uint8_t DIN, uint8_t DC, uint8_t CS, uint8_t RST);
+ void SIMresetCounters(void);
+ void SIMgetCounters(SIMcounters *c);
+ const uint8_t *SIMram(void);    // 6 pages x 84 columns, same layout as pcd8544_buffer
+ uint8_t SIMdisplayMode(void);   // PCD8544_DISPLAY* the controller shows its RAM with, blank after reset
+
+#endif
@@ -0,0 +1,335 @@
+/*
+=================================================================================
+ Name        : pcd8544_stream.c
+ Version     : 0.1
+
+ Description : Delta encoded remote mirror of the PCD8544 panel,
+     see pcd8544_stream.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pcd8544_stream.h"
+
+// run lengths the control byte can carry
+#define SKIP_MAX 64
+#define FILL_MAX 64
+#define LITERAL_MAX 128
+
+static struct sockaddr_storage addr;
+static socklen_t addrLen;
+static int fd = -1;
+static uint64_t intervalNs, startNs, lastSendNs, nextConnectNs;
+
+// the frame the listener has once it has read everything sent
+static uint8_t sent[STREAM_FRAME];
+static uint8_t needKey;
+
+// the newest frame flushed, until it has gone out
+static uint8_t latest[STREAM_FRAME];
+static uint8_t pending;
+
+// a message the socket did not take all of yet
+static uint8_t msg[STREAM_HEADER + STREAM_MAX_PAYLOAD];
+static int msgLen, msgOff;
+
+static STREAMstats stats;
+
+static uint64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// identical bytes from i on, at most max
+static int sameRun(const uint8_t *frame, int i, int end, int max)
+{
+	int n = 1;
+
+	while (i + n < end && n < max && frame[i + n] == frame[i])
+		n++;
+	return n;
+}
+
+int STREAMencode(const uint8_t *prev, const uint8_t *frame, uint8_t *out)
+{
+	int end = STREAM_FRAME, i = 0, o = 0, n;
+
+	// bytes after the last change are left out altogether
+	while (end > 0 && frame[end - 1] == prev[end - 1])
+		end--;
+	while (i < end)
+	{
+		if (frame[i] == prev[i])
+		{
+			for (n = 1; i + n < end && n < SKIP_MAX && frame[i + n] == prev[i + n]; n++)
+				;
+			out[o++] = n - 1;
+			i += n;
+			continue;
+		}
+		n = sameRun(frame, i, end, FILL_MAX);
+		if (n >= 3)
+		{
+			out[o++] = 0x40 + n - 1;
+			out[o++] = frame[i];
+			i += n;
+			continue;
+		}
+		// literal until three unchanged bytes or four alike, which are cheaper as runs
+		for (n = 1; i + n < end && n < LITERAL_MAX; n++)
+		{
+			if (i + n + 2 < end && frame[i + n] == prev[i + n] && frame[i + n + 1] == prev[i + n + 1] &&
+				frame[i + n + 2] == prev[i + n + 2])
+				break;
+			if (sameRun(frame, i + n, end, 4) == 4)
+				break;
+		}
+		out[o++] = 0x80 + n - 1;
+		memcpy(out + o, frame + i, n);
+		o += n;
+		i += n;
+	}
+	return o;
+}
+
+int STREAMdecode(uint8_t *frame, const uint8_t *in, int len)
+{
+	int i = 0, o = 0, n;
+
+	while (i < len)
+	{
+		uint8_t c = in[i++];
+		if (c < 0x40)
+			n = c + 1;
+		else if (c < 0x80)
+		{
+			n = c - 0x3F;
+			if (i >= len || o + n > STREAM_FRAME)
+				return -1;
+			memset(frame + o, in[i++], n);
+		}
+		else
+		{
+			n = c - 0x7F;
+			if (i + n > len || o + n > STREAM_FRAME)
+				return -1;
+			memcpy(frame + o, in + i, n);
+			i += n;
+		}
+		o += n;
+		if (o > STREAM_FRAME)
+			return -1;
+	}
+	return 0;
+}
+
+int STREAMopen(const char *target, uint16_t fps)
+{
+	const char *colon;
+
+	STREAMclose();
+	if (target == NULL || fps == 0)
+		return -1;
+	if (strncmp(target, "unix:", 5) == 0)
+		target += 5;
+	colon = strrchr(target, ':');
+	memset(&addr, 0, sizeof(addr));
+	if (target[0] == '/' || colon == NULL)
+	{
+		struct sockaddr_un *un = (struct sockaddr_un *)&addr;
+
+		if (strlen(target) >= sizeof(un->sun_path))
+			return -1;
+		un->sun_family = AF_UNIX;
+		strcpy(un->sun_path, target);
+		addrLen = sizeof(*un);
+	}
+	else
+	{
+		struct addrinfo hints, *res;
+		char host[256];
+
+		if (colon - target >= (int)sizeof(host))
+			return -1;
+		memcpy(host, target, colon - target);
+		host[colon - target] = 0;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res) != 0)
+			return -1;
+		memcpy(&addr, res->ai_addr, res->ai_addrlen);
+		addrLen = res->ai_addrlen;
+		freeaddrinfo(res);
+	}
+	intervalNs = 1000000000ULL / fps;
+	startNs = nowNs();
+	lastSendNs = 0;
+	nextConnectNs = 0;
+	stats.fps = fps;
+	return 0;
+}
+
+void STREAMclose(void)
+{
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+	msgLen = msgOff = 0;
+	pending = 0;
+	stats.fps = 0;
+}
+
+static void drop(void)
+{
+	close(fd);
+	fd = -1;
+	msgLen = msgOff = 0;
+}
+
+// write what is left of the message; 1 when it is all out, 0 if the socket is full
+static int flushMsg(void)
+{
+	while (msgOff < msgLen)
+	{
+		ssize_t n = send(fd, msg + msgOff, msgLen - msgOff, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (n <= 0)
+		{
+			// the listener went away, start over with a key frame when it is back
+			drop();
+			return 0;
+		}
+		msgOff += n;
+		stats.bytes += n;
+	}
+	msgLen = msgOff = 0;
+	return 1;
+}
+
+// send the latest frame if the connection, the socket and the rate limit allow;
+// a flush counts what held it back, a tick only retries
+static void publish(uint64_t start, int flush)
+{
+	static const uint8_t blank[STREAM_FRAME];
+	uint64_t ms;
+	int len;
+
+	if (fd < 0)
+	{
+		if (start < nextConnectNs)
+			return;
+		nextConnectNs = start + 1000000000ULL;
+		fd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (fd < 0)
+			return;
+		if (connect(fd, (struct sockaddr *)&addr, addrLen) < 0 && errno != EINPROGRESS)
+		{
+			close(fd);
+			fd = -1;
+			return;
+		}
+		stats.connects++;
+		needKey = 1;
+		lastSendNs = 0;
+	}
+	if (msgLen && !flushMsg())
+	{
+		if (fd >= 0 && flush)
+			stats.dropped++;
+		return;
+	}
+	if (fd < 0)
+		return;
+	if (lastSendNs && start - lastSendNs < intervalNs)
+	{
+		if (flush)
+			stats.limited++;
+		return;
+	}
+	pending = 0;
+	if (!needKey && memcmp(latest, sent, STREAM_FRAME) == 0)
+		return;
+
+	len = STREAMencode(needKey ? blank : sent, latest, msg + STREAM_HEADER);
+	ms = (start - startNs) / 1000000;
+	msg[0] = STREAM_MAGIC;
+	msg[1] = needKey ? STREAM_KEY : STREAM_DELTA;
+	msg[2] = len & 0xFF;
+	msg[3] = len >> 8;
+	msg[4] = ms & 0xFF;
+	msg[5] = (ms >> 8) & 0xFF;
+	msg[6] = (ms >> 16) & 0xFF;
+	msg[7] = (ms >> 24) & 0xFF;
+	msgLen = STREAM_HEADER + len;
+	msgOff = 0;
+	memcpy(sent, latest, STREAM_FRAME);
+	stats.sent++;
+	stats.keyFrames += needKey;
+	needKey = 0;
+	lastSendNs = start;
+	flushMsg();
+	stats.encodeNs += nowNs() - start;
+}
+
+void STREAMframe(const uint8_t *frame)
+{
+	if (!stats.fps)
+		return;
+	stats.frames++;
+	memcpy(latest, frame, STREAM_FRAME);
+	pending = 1;
+	publish(nowNs(), 1);
+}
+
+int STREAMtick(void)
+{
+	uint64_t now = nowNs(), due;
+
+	if (!stats.fps || !pending)
+		return -1;
+	publish(now, 0);
+	if (!pending)
+		return -1;
+	due = fd < 0 ? nextConnectNs : lastSendNs + intervalNs;
+	// a full socket has no deadline, look again a frame later
+	if (due <= now)
+		due = now + intervalNs;
+	return (due - now + 999999) / 1000000;
+}
+
+void STREAMgetStats(STREAMstats *s)
+{
+	*s = stats;
+}
+
+void STREAMresetStats(void)
+{
+	uint32_t fps = stats.fps;
+
+	memset(&stats, 0, sizeof(stats));
+	stats.fps = fps;
+}
@@ -0,0 +1,87 @@
+/*
+=================================================================================
+ Name        : pcd8544_stream.h
+ Version     : 0.1
+
+ Description : Remote mirror of the PCD8544 panel. Every frame the driver
+     flushes can be published to a listener on a Unix or TCP stream socket,
+     so support staff see what the in-car LCD shows (lcdview.c is the
+     viewer). Frames are the 504 bytes of display RAM in the panel's own
+     layout, 6 pages of 84 columns, so a rotated panel shows as mounted.
+
+     Each message is a header then a payload:
+
+     Byte  Field
+     0     STREAM_MAGIC
+     1     STREAM_KEY (the frame against all white) or STREAM_DELTA
+           (against the frame of the previous message)
+     2-3   payload length, little endian
+     4-7   milliseconds since STREAMopen(), little endian
+
+     The payload walks the frame in display RAM order, page by page and
+     column by column, as a list of runs, each a control byte c:
+       0x00-0x3F  the next c+1 bytes are unchanged
+       0x40-0x7F  the next c-0x3F bytes are all the byte that follows
+       0x80-0xFF  the next c-0x7F bytes follow as they are
+     Bytes after the last run are unchanged, so a frame that did not change
+     is a header alone.
+
+     Publishing is rate limited to the fps given to STREAMopen(): a frame
+     flushed sooner than that after the last one sent is held, and goes out
+     with the next flush or STREAMtick() after the interval, unless a newer
+     frame has replaced it by then. The socket is never waited on; a message
+     the listener is not reading fast enough for is finished on later flushes
+     and ticks, and only the newest frame flushed meanwhile follows it. Without
+     a listener the connection is retried once a second, and each new
+     connection starts with a key frame. Call STREAMtick() from the drawing
+     loop when it sleeps, so the mirror catches up with the last frame drawn.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_STREAM_H
+#define PCD8544_STREAM_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+
+#define STREAM_FRAME (LCDWIDTH * LCDHEIGHT / 8)
+#define STREAM_MAGIC 0xD5
+#define STREAM_KEY 1
+#define STREAM_DELTA 2
+#define STREAM_HEADER 8
+// the most a payload can take: all literal runs of 128
+#define STREAM_MAX_PAYLOAD (STREAM_FRAME + (STREAM_FRAME + 127) / 128)
+
+typedef struct
+{
+	uint32_t fps;               // rate limit, 0 when stopped
+	uint32_t frames;            // flushes seen
+	uint32_t sent;              // messages sent
+	uint32_t keyFrames;         // of them, key frames
+	uint32_t limited;           // flushes inside the rate limit, folded into a later message
+	uint32_t dropped;           // flushes while a message was still going out
+	uint32_t connects;          // connections made to the listener
+	uint64_t bytes;             // header and payload bytes written
+	uint64_t encodeNs;          // time spent encoding and writing
+} STREAMstats;
+
+ int STREAMencode(const uint8_t *prev, const uint8_t *frame, uint8_t *out);  // payload bytes written to out
+ int STREAMdecode(uint8_t *frame, const uint8_t *in, int len);               // -1 if the payload is malformed
+ int STREAMopen(const char *target, uint16_t fps);   // "/path", "unix:/path" or "host:port", -1 on a bad target
+ void STREAMclose(void);
+ void STREAMframe(const uint8_t *frame);             // LCDsetFlushHook() callback, also callable directly
+ int STREAMtick(void);                               // sends a held frame once due; ms until it is, -1 if none
+ void STREAMgetStats(STREAMstats *stats);
+ void STREAMresetStats(void);
+
+#endif
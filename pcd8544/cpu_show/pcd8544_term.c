@@ -0,0 +1,227 @@
+/*
+=================================================================================
+ Name        : pcd8544_term.c
+ Version     : 0.1
+
+ Description : Scrolling text console with scrollback for the PCD8544
+     driver, see pcd8544_term.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include "pcd8544_term.h"
+
+#define LINE(t, n) ((t)->text[(n) & (TERM_LINES - 1)])
+
+int TERMinit(TERMconsole *t, uint8_t page0, uint8_t rows, uint16_t minMs)
+{
+	uint8_t pages = LCDheight() / 8;
+
+	if (!rows)
+		rows = page0 < pages ? pages - page0 : 0;
+	if (!rows || page0 + rows > pages || rows > TERM_ROWS)
+		return -1;
+	memset(t, 0, sizeof(*t));
+	t->page0 = page0;
+	t->rows = rows;
+	t->width = LCDwidth();
+	t->height = LCDheight();
+	t->cols = t->width / TEXT_CELL;
+	t->minMs = minMs;
+	t->full = 1;
+	return 0;
+}
+
+// furthest back the view goes: the top row on the oldest line kept
+static uint16_t maxBack(const TERMconsole *t)
+{
+	uint32_t kept = t->head < TERM_LINES ? t->head : TERM_LINES;
+
+	return kept > t->rows ? kept - t->rows : 0;
+}
+
+static void newLine(TERMconsole *t)
+{
+	LINE(t, t->head)[0] = 0;
+	t->head++;
+	t->col = 0;
+	t->stats.lines++;
+	// a view scrolled back stays on the lines it shows, as long as they are kept
+	if (t->back)
+	{
+		t->back++;
+		if (t->back > maxBack(t))
+			t->back = maxBack(t);
+	}
+}
+
+void TERMwrite(TERMconsole *t, const char *s)
+{
+	char *line;
+
+	for (; *s; s++)
+	{
+		if (*s == '\r')
+			continue;
+		if (*s == '\n')
+		{
+			// a second newline in a row is an empty line
+			if (!t->open)
+				newLine(t);
+			t->open = 0;
+			continue;
+		}
+		if (!t->open || t->col == t->cols)
+		{
+			newLine(t);
+			t->open = 1;
+		}
+		line = LINE(t, t->head - 1);
+		line[t->col++] = *s == '\t' ? ' ' : *s;
+		line[t->col] = 0;
+	}
+}
+
+void TERMclear(TERMconsole *t)
+{
+	t->head = 0;
+	t->col = 0;
+	t->open = 0;
+	t->back = 0;
+	t->full = 1;
+}
+
+int TERMscroll(TERMconsole *t, int back)
+{
+	if (back < 0)
+		back = 0;
+	if (back > maxBack(t))
+		back = maxBack(t);
+	t->back = back;
+	return back;
+}
+
+// one line as page bytes across the screen, in the text colour
+static void renderLine(const TERMconsole *t, const char *s, uint8_t color, uint8_t *dst)
+{
+	uint8_t bg = color ? 0x00 : 0xFF, i, j;
+
+	memset(dst, bg, t->width);
+	for (i = 0; s && s[i] && i < t->cols; i++)
+	{
+		const uint8_t *glyph = pcd8544_font + (uint8_t)s[i] * 5;
+		for (j = 0; j < 5; j++)
+			dst[i * TEXT_CELL + j] = color ? glyph[j] : ~glyph[j];
+	}
+}
+
+uint16_t TERMrender(TERMconsole *t, uint32_t nowMs)
+{
+	uint32_t end = t->head - t->back, line;
+	int32_t moved = (int32_t)(end - t->drawnEnd);
+	uint8_t color = LCDgetTextColor(), stride = t->width, r;
+	uint8_t *rows = pcd8544_buffer + t->page0 * stride, row[LCDWIDTH];
+	uint16_t changed = 0, draw = 0;
+	int grew;
+
+	if (t->width != LCDwidth() || t->height != LCDheight())
+		return 0;
+	if (color != t->drawnColor)
+		t->full = 1;
+	// the newest line drawn may have grown since, wherever it is now
+	grew = t->drawnHead && t->head - t->drawnHead < TERM_LINES && strlen(LINE(t, t->drawnHead - 1)) != t->drawnCol;
+	if (!t->full && !moved && !grew)
+		return 0;
+	if (t->flushed && nowMs - t->lastMs < t->minMs)
+	{
+		t->stats.limited++;
+		return 0;
+	}
+
+	if (t->full || moved < 0 || moved >= t->rows)
+	{
+		// scrolled back, a whole screen or more of new lines, or a fresh start
+		if (!t->full && moved > t->rows)
+			t->stats.coalesced += moved - t->rows;
+		draw = (1 << t->rows) - 1;
+		t->stats.redraws++;
+	}
+	else if (moved > 0)
+	{
+		// the rows that stay move up; a row changes only if the one below differs
+		for (r = 0; r + moved < t->rows; r++)
+			if (memcmp(rows + r * stride, rows + (r + moved) * stride, stride) != 0)
+				changed |= 1 << r;
+		memmove(rows, rows + moved * stride, (t->rows - moved) * stride);
+		draw = ((1 << moved) - 1) << (t->rows - moved);
+		t->stats.scrolls++;
+	}
+	// and the newest line drawn last time, if it grew and is still on the screen
+	if (grew && end - t->drawnHead < t->rows)
+		draw |= 1 << (t->rows - 1 - (end - t->drawnHead));
+
+	for (r = 0; r < t->rows; r++)
+	{
+		if (!(draw & (1 << r)))
+			continue;
+		// rows above the first line, or older than the scrollback keeps, are blank
+		line = end - t->rows + r;
+		renderLine(t, end >= (uint32_t)(t->rows - r) && t->head - line <= TERM_LINES ? LINE(t, line) : NULL, color, row);
+		if (memcmp(rows + r * stride, row, stride) != 0)
+		{
+			memcpy(rows + r * stride, row, stride);
+			changed |= 1 << r;
+		}
+	}
+
+	t->drawnEnd = end;
+	t->drawnHead = t->head;
+	t->drawnCol = t->col;
+	t->drawnColor = color;
+	t->full = 0;
+	t->flushed = 1;
+	t->lastMs = nowMs;
+	t->stats.flushes++;
+	return changed;
+}
+
+int TERMflush(TERMconsole *t, uint32_t nowMs, TERMsend send)
+{
+	uint16_t changed = TERMrender(t, nowMs);
+	uint8_t r = 0, n;
+	int pages = 0;
+
+	if (send == NULL)
+		send = LCDdisplayRegion;
+	// each run of changed rows as one region
+	while (changed >> r)
+	{
+		if (!(changed & (1 << r)))
+		{
+			r++;
+			continue;
+		}
+		for (n = 0; changed & (1 << (r + n)); n++)
+			;
+		send(0, (t->page0 + r) * 8, t->width, n * 8);
+		pages += n;
+		r += n;
+	}
+	t->stats.pagesSent += pages;
+	return pages;
+}
+
+void TERMgetStats(const TERMconsole *t, TERMstats *stats)
+{
+	*stats = t->stats;
+}
@@ -0,0 +1,94 @@
+/*
+=================================================================================
+ Name        : pcd8544_term.h
+ Version     : 0.1
+
+ Description : Scrolling text console for the PCD8544 driver, for showing a
+     log on the panel. Text goes into a ring of TERM_LINES lines (the
+     scrollback), wrapped at the width of the screen; TERMwrite() only
+     copies it there and is cheap enough to call for every log line.
+
+     TERMflush() puts what changed on the panel. The console takes whole
+     pages, one line each, so when n lines have come in it moves the rows
+     up with one memmove() of the page bytes (5 x 84 for one line on the
+     full screen), draws only the n new rows, and sends only the pages
+     whose bytes differ from what they held. However many lines came in
+     between two flushes, a flush draws at most one screen of them, and
+     flushes closer than minMs apart are put off, so a burst of log lines
+     costs one frame. TERMscroll() looks back through the scrollback; new
+     lines then leave the view where it is.
+
+     A line is only started by the first character after a newline, so
+     the bottom row holds the last line written, not an empty one. Draws
+     in the current text colour, text size 1. After LCDsetOrientation()
+     call TERMinit() again.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_TERM_H
+#define PCD8544_TERM_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+#include "pcd8544_text.h"
+
+#define TERM_LINES 64               // scrollback, a power of two
+#define TERM_COLS (LCDWIDTH / TEXT_CELL)    // characters a line holds, 8 used in portrait
+#define TERM_ROWS (LCDWIDTH / 8)    // pages a console can take, portrait included
+
+typedef struct
+{
+	uint32_t lines;             // lines started, wrapped ones included
+	uint32_t flushes;           // TERMflush() calls that drew something
+	uint32_t limited;           // calls put off by minMs, drawn by a later one
+	uint32_t scrolls;           // flushes that moved the rows up
+	uint32_t redraws;           // flushes that drew every row
+	uint32_t coalesced;         // lines that came and went between two flushes, never drawn
+	uint32_t pagesSent;
+} TERMstats;
+
+typedef struct
+{
+	uint8_t page0, rows;        // the window, whole pages across the screen
+	uint8_t width, height;      // screen it was set up for
+	uint8_t cols;               // characters a line wraps at
+	uint16_t minMs;             // flushes at most this often
+	char text[TERM_LINES][TERM_COLS + 1];
+	uint32_t head;              // lines started; the newest is head - 1
+	uint8_t col;                // characters in the newest line
+	uint8_t open;               // newest line not ended yet
+	uint16_t back;              // lines the view is scrolled back, 0 follows
+	// what is in pcd8544_buffer
+	uint32_t drawnEnd;          // line after the bottom row
+	uint32_t drawnHead;
+	uint8_t drawnCol;           // characters of the newest line then
+	uint8_t drawnColor;
+	uint8_t full;               // draw every row next time
+	uint8_t flushed;            // lastMs is set
+	uint32_t lastMs;
+	TERMstats stats;
+} TERMconsole;
+
+// sends a rectangle of pcd8544_buffer, LCDdisplayRegion() or RTdisplayRegion()
+typedef void (*TERMsend)(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
+
+// all int calls return -1 on failure
+ int TERMinit(TERMconsole *t, uint8_t page0, uint8_t rows, uint16_t minMs);  // rows 0 = to the bottom; -1 if off the screen
+ void TERMwrite(TERMconsole *t, const char *s);          // '\n' ends a line, long lines wrap
+ void TERMclear(TERMconsole *t);                         // scrollback too
+ int TERMscroll(TERMconsole *t, int back);               // lines back from the newest, 0 follows; where it ended up
+ uint16_t TERMrender(TERMconsole *t, uint32_t nowMs);    // draw into the buffer, bit n set if row n changed
+ int TERMflush(TERMconsole *t, uint32_t nowMs, TERMsend send);   // render and send, NULL = LCDdisplayRegion; pages sent
+ void TERMgetStats(const TERMconsole *t, TERMstats *stats);
+
+#endif
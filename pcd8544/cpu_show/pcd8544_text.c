@@ -0,0 +1,215 @@
+/*
+=================================================================================
+ Name        : pcd8544_text.c
+ Version     : 0.1
+
+ Description : Text measurement, wrapping, alignment and marquees for the
+     PCD8544 driver, see pcd8544_text.h.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <string.h>
+#include "pcd8544_text.h"
+
+uint16_t TEXTwidth(const char *s)
+{
+	uint16_t n = 0;
+
+	while (s[n] && s[n] != '\n')
+		n++;
+	return n * TEXT_CELL;
+}
+
+int TEXTwrap(const char *s, uint8_t w, TEXTspan *lines, int max)
+{
+	uint16_t cols = w / TEXT_CELL, pos = 0, start, end, next, brk, col;
+	int n = 0;
+
+	if (!cols)
+		return 0;
+	while (s[pos])
+	{
+		start = pos;
+		brk = 0;
+		for (col = 0; s[pos] && s[pos] != '\n' && col < cols; col++, pos++)
+			if (s[pos] == ' ')
+				brk = pos;
+		if (!s[pos] || s[pos] == '\n' || s[pos] == ' ')
+		{
+			// the text, a newline or a space ends the line where it is full
+			end = pos;
+			next = s[pos] ? pos + 1 : pos;
+		}
+		else if (brk > start)
+		{
+			end = brk;
+			next = brk + 1;
+		}
+		else
+		{
+			// one word wider than the line, cut it
+			end = pos;
+			next = pos;
+		}
+		while (end > start && s[end - 1] == ' ')
+			end--;
+		if (n < max)
+		{
+			lines[n].start = start;
+			lines[n].len = end - start;
+		}
+		n++;
+		pos = next;
+		// spaces a wrap lands on are not carried to the next line
+		if (s[pos - (pos > 0)] != '\n')
+			while (s[pos] == ' ')
+				pos++;
+	}
+	return n;
+}
+
+uint8_t TEXTline(uint8_t x, uint8_t y, uint8_t w, uint8_t align, const char *s, uint16_t len)
+{
+	uint8_t color = LCDgetTextColor(), i, n, left;
+
+	if (!w)
+		w = x < LCDwidth() ? LCDwidth() - x : 0;
+	if (x >= LCDwidth() || y + 8 > LCDheight() || x + w > LCDwidth())
+		return 0;
+	n = len < w / TEXT_CELL ? len : w / TEXT_CELL;
+	left = align == TEXT_RIGHT ? w - n * TEXT_CELL : align == TEXT_CENTER ? (w - n * TEXT_CELL) / 2 : 0;
+	LCDfillrect(x, y, w, 8, !color);
+	for (i = 0; i < n; i++)
+		LCDdrawchar(x + left + i * TEXT_CELL, y, s[i]);
+	return n;
+}
+
+int TEXTbox(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t align, const char *s)
+{
+	TEXTspan lines[LCDHEIGHT / 8 + 6];
+	int n, i, rows = h / 8;
+
+	if (!w)
+		w = x < LCDwidth() ? LCDwidth() - x : 0;
+	if (x >= LCDwidth() || y + h > LCDheight() || x + w > LCDwidth())
+		return -1;
+	if (rows > (int)(sizeof(lines) / sizeof(lines[0])))
+		rows = sizeof(lines) / sizeof(lines[0]);
+	n = TEXTwrap(s, w, lines, rows);
+	LCDfillrect(x, y, w, h, !LCDgetTextColor());
+	for (i = 0; i < n && i < rows; i++)
+		TEXTline(x, y + i * 8, w, align, s + lines[i].start, lines[i].len);
+	return n;
+}
+
+int TEXTmarqueeInit(TEXTmarquee *m, uint8_t x, uint8_t y, uint8_t w, uint8_t hold)
+{
+	if (!w)
+		w = x < LCDwidth() ? LCDwidth() - x : 0;
+	if (w < TEXT_CELL || x >= LCDwidth() || x + w > LCDwidth() || y + 8 > LCDheight())
+		return -1;
+	memset(m, 0, sizeof(*m));
+	m->x = x;
+	m->y = y;
+	m->w = w;
+	m->hold = hold;
+	m->dirtyX = x;
+	m->dirtyY = y;
+	m->dirtyW = w;
+	m->dirtyH = 8;
+	return 0;
+}
+
+int TEXTmarqueeSet(TEXTmarquee *m, const char *s)
+{
+	uint8_t color = LCDgetTextColor(), bg = color ? 0x00 : 0xFF;
+	uint16_t n, i, j;
+
+	if (strncmp(m->text, s, TEXT_MARQUEE_MAX) == 0 && m->len && m->color == color)
+		return 0;
+	strncpy(m->text, s, TEXT_MARQUEE_MAX);
+	m->text[TEXT_MARQUEE_MAX] = 0;
+	n = strlen(m->text);
+	m->color = color;
+
+	// the text once, as page bytes in the text colour, then the gap
+	memset(m->strip, bg, sizeof(m->strip));
+	for (i = 0; i < n; i++)
+	{
+		const uint8_t *glyph = pcd8544_font + (uint8_t)(m->text[i] == '\n' ? ' ' : m->text[i]) * 5;
+		for (j = 0; j < 5; j++)
+			m->strip[i * TEXT_CELL + j] = color ? glyph[j] : ~glyph[j];
+	}
+	if (n * TEXT_CELL <= m->w)
+		m->len = m->w;              // fits: stands still
+	else
+		m->len = n * TEXT_CELL + TEXT_MARQUEE_GAP;
+	m->offset = 0;
+	m->wait = m->hold;
+	TEXTmarqueeDraw(m);
+	return 1;
+}
+
+// the w columns of the strip from offset on, round past its end, into the box
+void TEXTmarqueeDraw(TEXTmarquee *m)
+{
+	uint8_t stride = LCDwidth(), shift = m->y % 8, w = m->w, i;
+	uint8_t *dst = pcd8544_buffer + (m->y / 8) * stride + m->x;
+	uint8_t *dst2 = shift ? dst + stride : NULL;     // the box is on the screen, so is the page below
+	uint16_t first = m->len - m->offset, k;
+
+	if (!m->len)
+		return;
+	if (!shift)
+	{
+		if (first >= w)
+			memcpy(dst, m->strip + m->offset, w);
+		else
+		{
+			memcpy(dst, m->strip + m->offset, first);
+			memcpy(dst + first, m->strip, w - first);
+		}
+		return;
+	}
+	// across two pages: each column goes in shifted, the rows around it kept
+	for (i = 0, k = m->offset; i < w; i++, k++)
+	{
+		uint8_t d;
+		if (k == m->len)
+			k = 0;
+		d = m->strip[k];
+		dst[i] = (dst[i] & ~(0xFF << shift)) | (d << shift);
+		if (dst2)
+			dst2[i] = (dst2[i] & ~(0xFF >> (8 - shift))) | (d >> (8 - shift));
+	}
+}
+
+int TEXTmarqueeTick(TEXTmarquee *m, uint8_t step)
+{
+	if (m->len <= m->w || !step)
+		return 0;
+	if (m->wait)
+	{
+		m->wait--;
+		return 0;
+	}
+	m->offset += step;
+	if (m->offset >= m->len)
+	{
+		// a lap done, rest at the start again
+		m->offset = 0;
+		m->wait = m->hold;
+	}
+	TEXTmarqueeDraw(m);
+	return 1;
+}
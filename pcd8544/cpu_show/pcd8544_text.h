@@ -0,0 +1,78 @@
+/*
+=================================================================================
+ Name        : pcd8544_text.h
+ Version     : 0.1
+
+ Description : Text layout for the PCD8544 driver, in the 6 x 8 cells of
+     the 5x7 font. TEXTwidth() measures a string, TEXTwrap() breaks it into
+     lines of a given width at spaces (a word longer than a line is cut),
+     and TEXTline() / TEXTbox() draw one line or a wrapped block into a box
+     left, right or centre aligned. The box is cleared to the background
+     first, so a shorter value leaves nothing behind and no one has to pad
+     with spaces; what does not fit is left out. A width of 0 runs to
+     the right edge of the screen.
+
+     A marquee shows a string too long for its box by scrolling it a pixel
+     at a time. TEXTmarqueeSet() renders the text once into a strip of
+     page bytes, followed by a gap, and each TEXTmarqueeTick() only moves
+     the window and copies it into pcd8544_buffer: one or two memcpy()s
+     when the box sits on a page boundary. The box it changed is left in
+     dirtyX/Y/W/H for LCDdisplayRegion(). Text that fits is drawn
+     aligned left and stays put.
+
+     All of it draws in the current text colour, text size 1.
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#ifndef PCD8544_TEXT_H
+#define PCD8544_TEXT_H
+
+#include <stdint.h>
+#include "PCD8544.h"
+
+#define TEXT_LEFT 0
+#define TEXT_RIGHT 1
+#define TEXT_CENTER 2
+
+#define TEXT_CELL 6                 // columns a character takes, spacer included
+#define TEXT_MARQUEE_MAX 96         // characters a marquee holds, more are cut
+#define TEXT_MARQUEE_GAP 18         // blank columns between the end and the start again
+
+typedef struct
+{
+	uint16_t start, len;        // where in the string, and how many characters
+} TEXTspan;
+
+typedef struct
+{
+	uint8_t x, y, w;            // box, 8 rows high
+	uint8_t hold;               // ticks to rest at the start of each lap
+	uint8_t color;              // text colour it was rendered in
+	uint8_t wait;               // ticks of rest left
+	uint16_t len;               // strip columns, text and gap
+	uint16_t offset;            // strip column at the left of the box
+	char text[TEXT_MARQUEE_MAX + 1];
+	uint8_t strip[TEXT_MARQUEE_MAX * TEXT_CELL + TEXT_MARQUEE_GAP + LCDWIDTH];
+	uint8_t dirtyX, dirtyY, dirtyW, dirtyH;   // what the last tick changed
+} TEXTmarquee;
+
+ uint16_t TEXTwidth(const char *s);              // columns, to the end or the first newline
+ int TEXTwrap(const char *s, uint8_t w, TEXTspan *lines, int max);   // lines needed, the first max filled in
+ uint8_t TEXTline(uint8_t x, uint8_t y, uint8_t w, uint8_t align, const char *s, uint16_t len);    // characters drawn
+ int TEXTbox(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t align, const char *s);   // lines needed
+ int TEXTmarqueeInit(TEXTmarquee *m, uint8_t x, uint8_t y, uint8_t w, uint8_t hold);     // -1 if off the screen
+ int TEXTmarqueeSet(TEXTmarquee *m, const char *s);     // 1 if the text changed, restarts it and draws it
+ int TEXTmarqueeTick(TEXTmarquee *m, uint8_t step);     // 1 if it moved
+ void TEXTmarqueeDraw(TEXTmarquee *m);
+
+#endif
@@ -0,0 +1,232 @@
+/*
+=================================================================================
+ Name        : rtbench.c
+ Version     : 0.1
+
+ Description : Real-time transmit mode check and jitter report. Built against
+     the counting GPIO stub, with PCD8544.c at -O0 as compile.sh builds it
+     for the panel, so the clock stretch loop is kept and a byte takes about
+     as long as on the Pi. It first checks that frames handed to the transmit
+     thread, one at a time and in bursts that get folded together, end up in
+     the stub's display RAM; then it sends random frames with the mode off,
+     idle and under load, and with it on under the same load, and prints
+     p50 / p99 / max per frame and per display RAM byte. The load is busy
+     threads at normal priority, each walking a buffer of its own.
+
+     rtbench [-n frames] [-l load threads] [-c cpu] [-p priority] [-s seed]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pcd8544_sim.h"
+#include "PCD8544.h"
+#include "pcd8544_rt.h"
+
+#define BUFSIZE (LCDWIDTH * LCDHEIGHT / 8)
+#define MAX_LOAD 64
+#define LOAD_BYTES (1 << 20)
+
+// pin setup, as pcd8544_rpi.c
+static int _sclk = 0;
+static int _din = 1;
+static int _dc = 2;
+static int _cs = 3;
+static int _rst = 4;
+
+static uint32_t rng = 1;
+
+static pthread_t loadThreads[MAX_LOAD];
+static volatile int loading;
+static int loadCount;
+
+static uint32_t rnd(void)
+{
+	// xorshift32, repeatable with -s
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static void randomFrame(void)
+{
+	int i;
+
+	for (i = 0; i < BUFSIZE; i++)
+		pcd8544_buffer[i] = rnd();
+}
+
+// a busy thread that also keeps the caches churning
+static void *burn(void *arg)
+{
+	uint8_t *mem = malloc(LOAD_BYTES);
+	uint32_t x = (uint32_t)(uintptr_t)arg * 2654435761u + 1, i = 0;
+
+	while (mem && loading)
+	{
+		x = x * 1103515245u + 12345u;
+		mem[(i += 4099) & (LOAD_BYTES - 1)] += x >> 24;
+	}
+	free(mem);
+	return NULL;
+}
+
+static void startLoad(int n)
+{
+	loading = 1;
+	for (loadCount = 0; loadCount < n; loadCount++)
+		pthread_create(&loadThreads[loadCount], NULL, burn, (void *)(uintptr_t)loadCount);
+	// let the scheduler spread them before anything is timed
+	usleep(50000);
+}
+
+static void stopLoad(void)
+{
+	loading = 0;
+	while (loadCount > 0)
+		pthread_join(loadThreads[--loadCount], NULL);
+}
+
+static int sameRam(const char *what, int i)
+{
+	if (memcmp(SIMram(), pcd8544_buffer, BUFSIZE))
+	{
+		printf("check %-10s FAILED: display RAM differs from the frame after %s %d\n", "rt", what, i);
+		return 1;
+	}
+	return 0;
+}
+
+// frames handed over one at a time, then bursts of regions without waiting:
+// each step draws only inside the region it flushes, so once the thread has
+// caught up the panel must hold the whole drawing however they were folded
+static int checkHandover(void)
+{
+	RTstats st;
+	int i, j;
+
+	RTresetStats();
+	for (i = 0; i < 20; i++)
+	{
+		randomFrame();
+		RTdisplay();
+		RTwait();
+		if (sameRam("frame", i))
+			return 1;
+	}
+	for (i = 0; i < 20; i++)
+	{
+		for (j = 0; j < 30; j++)
+		{
+			uint8_t x = rnd() % LCDWIDTH, y = rnd() % LCDHEIGHT, w = 1 + rnd() % 40, h = 1 + rnd() % 30;
+
+			LCDfillrect(x, y, w, h, rnd() & 1);
+			RTdisplayRegion(x, y, w, h);
+		}
+		RTwait();
+		if (sameRam("burst", i))
+			return 1;
+	}
+	RTgetStats(&st);
+	printf("check %-10s ok, %u flushes sent, %u folded into a waiting one\n", "rt", st.frames, st.coalesced);
+	return 0;
+}
+
+static void run(const char *name, int frames)
+{
+	RTstats st;
+	int i;
+
+	RTresetStats();
+	for (i = 0; i < frames; i++)
+	{
+		randomFrame();
+		RTdisplay();
+		RTwait();
+	}
+	RTgetStats(&st);
+	printf("%-22s %5u %9.0f %9.0f %9.0f %8llu %8llu %8llu\n", name, st.frames,
+		RTpercentile(st.frameHist, 500, st.maxFrameNs) / 1000.0, RTpercentile(st.frameHist, 990, st.maxFrameNs) / 1000.0,
+		st.maxFrameNs / 1000.0, (unsigned long long)RTpercentile(st.byteHist, 500, st.maxByteNs),
+		(unsigned long long)RTpercentile(st.byteHist, 990, st.maxByteNs), (unsigned long long)st.maxByteNs);
+}
+
+int main(int argc, char **argv)
+{
+	int frames = 200, load = -1, cpu = -2, priority = RT_PRIORITY, opt;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while ((opt = getopt(argc, argv, "n:l:c:p:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': frames = atoi(optarg); break;
+		case 'l': load = atoi(optarg); break;
+		case 'c': cpu = atoi(optarg); break;
+		case 'p': priority = atoi(optarg); break;
+		case 's': rng = strtoul(optarg, NULL, 0); if (!rng) rng = 1; break;
+		default:
+			frames = 0;
+			break;
+		}
+	}
+	if (cores < 1)
+		cores = 1;
+	// by default two busy threads a core, and the transmit thread on the last core
+	if (load < 0)
+		load = 2 * cores;
+	if (cpu == -2)
+		cpu = cores - 1;
+	if (frames <= 0 || load > MAX_LOAD || cpu < -1 || cpu >= cores)
+	{
+		fprintf(stderr, "usage: %s [-n frames] [-l load threads] [-c cpu] [-p priority] [-s seed]\n", argv[0]);
+		return 2;
+	}
+
+	SIMinit(_sclk, _din, _dc, _cs, _rst);
+	LCDInit(_sclk, _din, _dc, _cs, _rst, 45);
+	LCDdisplay();
+	if (checkHandover())
+		return 1;
+	if (RTstart(cpu, priority) < 0)
+	{
+		printf("real-time mode refused (%s), run as root or with CAP_SYS_NICE; only the plain flushes are measured\n",
+			strerror(errno));
+	}
+	else
+	{
+		if (checkHandover())
+			return 1;
+		RTstop();
+	}
+
+	printf("%d frames of %d bytes, %d load threads on %ld cores, transmit thread on cpu %d at priority %d\n",
+		frames, BUFSIZE, load, cores, cpu, priority);
+	printf("%-22s %5s %9s %9s %9s %8s %8s %8s\n", "", "", "frame us", "", "", "byte ns", "", "");
+	printf("%-22s %5s %9s %9s %9s %8s %8s %8s\n", "mode", "sent", "p50", "p99", "max", "p50", "p99", "max");
+	run("off, idle", frames);
+	startLoad(load);
+	run("off, loaded", frames);
+	if (RTstart(cpu, priority) == 0)
+	{
+		run("real-time, loaded", frames);
+		RTstop();
+	}
+	stopLoad();
+	return 0;
+}
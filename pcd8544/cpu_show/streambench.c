@@ -0,0 +1,319 @@
+/*
+=================================================================================
+ Name        : streambench.c
+ Version     : 0.1
+
+ Description : Remote mirror check and size report. Built against the
+     counting GPIO stub it first round-trips random and screen-like frames
+     through STREAMencode() / STREAMdecode(), then publishes frames drawn
+     with the driver to a listener thread over a local Unix socket and a
+     loopback TCP port, and checks the listener ends up with exactly the
+     stub's display RAM. It reports bytes per message against the 504 of a
+     raw frame for the status screen automated-metric.py draws, the CPU time
+     per message and what the rate limit folded away.
+
+     streambench [-n frames] [-r fps] [-s seed]
+
+================================================================================
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+================================================================================
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "pcd8544_sim.h"
+#include "PCD8544.h"
+#include "pcd8544_stream.h"
+
+// pin setup, as pcd8544_rpi.c
+static int _sclk = 0;
+static int _din = 1;
+static int _dc = 2;
+static int _cs = 3;
+static int _rst = 4;
+
+static uint32_t rng = 1;
+
+// what the listener thread rebuilt
+static int listenFd;
+static uint8_t received[STREAM_FRAME];
+static uint32_t rxMessages, rxBad;
+static uint64_t rxBytes;
+
+static uint32_t rnd(void)
+{
+	// xorshift32, repeatable with -s
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static uint64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int readFull(int fd, uint8_t *p, int n)
+{
+	while (n > 0)
+	{
+		ssize_t got = read(fd, p, n);
+		if (got <= 0)
+			return -1;
+		p += got;
+		n -= got;
+	}
+	return 0;
+}
+
+// as lcdview, without the drawing: one connection, decoded until it closes
+static void *listener(void *arg)
+{
+	uint8_t header[STREAM_HEADER], payload[65536];
+	int fd = accept(listenFd, NULL, NULL), len;
+
+	(void)arg;
+	while (fd >= 0 && readFull(fd, header, STREAM_HEADER) == 0)
+	{
+		len = header[2] | (header[3] << 8);
+		if (header[0] != STREAM_MAGIC || readFull(fd, payload, len) < 0)
+		{
+			rxBad++;
+			break;
+		}
+		if (header[1] == STREAM_KEY)
+			memset(received, 0, sizeof(received));
+		if (STREAMdecode(received, payload, len) < 0)
+			rxBad++;
+		rxMessages++;
+		rxBytes += STREAM_HEADER + len;
+	}
+	if (fd >= 0)
+		close(fd);
+	return NULL;
+}
+
+// the status screen uDisplay() draws four times a second, with the numbers moving
+static void drawStatus(int i)
+{
+	char line[32];
+
+	LCDclear();
+	LCDdrawstring(0, 0, "192.168.1.23");
+	LCDdrawstring(0, 8, "OBD:        Up");
+	LCDdrawstring(0, 16, i % 200 < 150 ? "ENGINE:     Up" : "ENGINE:   Down");
+	LCDdrawstring(0, 24, "NETWORK:    Up");
+	snprintf(line, sizeof(line), "CM/:%d %d %d", 5 + rnd() % 40, 31 + (i / 50) % 3, 47);
+	LCDdrawstring(0, 32, line);
+	snprintf(line, sizeof(line), "QT:%d %d", (i / 8) % 30, 1200 + i / 4);
+	LCDdrawstring(0, 40, line);
+}
+
+static void randomFrame(uint8_t *frame, int density)
+{
+	int i;
+
+	for (i = 0; i < STREAM_FRAME; i++)
+		if ((int)(rnd() % 100) < density)
+			frame[i] = rnd();
+}
+
+static int checkCodec(int rounds)
+{
+	static uint8_t prev[STREAM_FRAME], frame[STREAM_FRAME], out[STREAM_MAX_PAYLOAD + 64], got[STREAM_FRAME];
+	int r, len, worst = 0, screens = 0;
+	uint64_t screenNs = 0, t;
+
+	memset(prev, 0, sizeof(prev));
+	for (r = 0; r < rounds; r++)
+	{
+		// noise, sparse changes, runs of one byte, and the driver's own screens
+		memcpy(frame, prev, STREAM_FRAME);
+		switch (r % 4)
+		{
+		case 0: randomFrame(frame, 100); break;
+		case 1: randomFrame(frame, rnd() % 20); break;
+		case 2: memset(frame + rnd() % 400, rnd() % 3 ? 0 : 0xFF, rnd() % 100); break;
+		default:
+			drawStatus(r);
+			LCDdisplay();
+			memcpy(frame, SIMram(), STREAM_FRAME);
+			break;
+		}
+		t = nowNs();
+		len = STREAMencode(prev, frame, out);
+		if (r % 4 == 3)
+		{
+			screenNs += nowNs() - t;
+			screens++;
+		}
+		if (len > STREAM_MAX_PAYLOAD)
+		{
+			printf("round %d: %d payload bytes, more than %d\n", r, len, STREAM_MAX_PAYLOAD);
+			return 1;
+		}
+		if (len > worst)
+			worst = len;
+		memcpy(got, prev, STREAM_FRAME);
+		if (STREAMdecode(got, out, len) < 0 || memcmp(got, frame, STREAM_FRAME))
+		{
+			printf("round %d: decoded frame differs\n", r);
+			return 1;
+		}
+		memcpy(prev, frame, STREAM_FRAME);
+	}
+	printf("%d frames round-trip through the codec, largest payload %d bytes, %.0f ns to encode a status screen\n",
+		rounds, worst, (double)screenNs / screens);
+	return 0;
+}
+
+static int openListener(const char *unixPath, int *port)
+{
+	if (unixPath)
+	{
+		struct sockaddr_un un;
+
+		memset(&un, 0, sizeof(un));
+		un.sun_family = AF_UNIX;
+		strncpy(un.sun_path, unixPath, sizeof(un.sun_path) - 1);
+		unlink(unixPath);
+		listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		return bind(listenFd, (struct sockaddr *)&un, sizeof(un)) < 0 || listen(listenFd, 1) < 0 ? -1 : 0;
+	}
+	else
+	{
+		struct sockaddr_in in;
+		socklen_t len = sizeof(in);
+
+		memset(&in, 0, sizeof(in));
+		in.sin_family = AF_INET;
+		in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		listenFd = socket(AF_INET, SOCK_STREAM, 0);
+		if (bind(listenFd, (struct sockaddr *)&in, sizeof(in)) < 0 || listen(listenFd, 1) < 0 ||
+			getsockname(listenFd, (struct sockaddr *)&in, &len) < 0)
+			return -1;
+		*port = ntohs(in.sin_port);
+		return 0;
+	}
+}
+
+// drive frames through the flush hook at flushHz into a listener, limited to fps
+static int runStream(const char *name, const char *unixPath, int frames, int flushHz, int fps)
+{
+	char target[128];
+	pthread_t thread;
+	STREAMstats st;
+	int port = 0, i, wait;
+
+	rxMessages = rxBad = 0;
+	rxBytes = 0;
+	if (openListener(unixPath, &port) < 0)
+	{
+		printf("%s: cannot listen: %s\n", name, strerror(errno));
+		return 1;
+	}
+	if (unixPath)
+		snprintf(target, sizeof(target), "unix:%s", unixPath);
+	else
+		snprintf(target, sizeof(target), "127.0.0.1:%d", port);
+	pthread_create(&thread, NULL, listener, NULL);
+	STREAMopen(target, fps);
+	STREAMresetStats();
+	LCDsetFlushHook(STREAMframe);
+	for (i = 0; i < frames; i++)
+	{
+		drawStatus(i);
+		LCDdisplay();
+		usleep(1000000 / flushHz);
+	}
+	// the last frame may have been inside the rate limit, ticks send it once due
+	for (i = 0; i < 10 && (wait = STREAMtick()) >= 0; i++)
+		usleep(wait * 1000 + 1000);
+	STREAMgetStats(&st);
+	STREAMclose();
+	LCDsetFlushHook(NULL);
+	pthread_join(thread, NULL);
+	close(listenFd);
+	if (unixPath)
+		unlink(unixPath);
+
+	if (rxBad || rxMessages != st.sent || memcmp(received, SIMram(), STREAM_FRAME))
+	{
+		printf("%s: listener has %u of %u messages, %u bad, frame %s\n", name, rxMessages, st.sent, rxBad,
+			memcmp(received, SIMram(), STREAM_FRAME) ? "differs" : "matches");
+		return 1;
+	}
+	printf("%-22s %u flushes, %u sent (%u key), %u rate limited, %u dropped: %.1f bytes per message against %d raw"
+		" (%.1f%%), %.1f us per message\n", name, st.frames, st.sent, st.keyFrames, st.limited, st.dropped,
+		(double)st.bytes / st.sent, STREAM_FRAME, st.bytes * 100.0 / st.sent / STREAM_FRAME,
+		st.encodeNs / 1000.0 / st.sent);
+	printf("%-22s at %d messages/s that is %.0f bytes/s against %d raw\n", "", fps < flushHz ? fps : flushHz,
+		(double)st.bytes / st.sent * (fps < flushHz ? fps : flushHz), STREAM_FRAME * (fps < flushHz ? fps : flushHz));
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char path[64];
+	int frames = 400, fps = 4, opt, failed = 0;
+
+	while ((opt = getopt(argc, argv, "n:r:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': frames = atoi(optarg); break;
+		case 'r': fps = atoi(optarg); break;
+		case 's': rng = strtoul(optarg, NULL, 0); if (!rng) rng = 1; break;
+		default:
+			frames = 0;
+			break;
+		}
+	}
+	if (frames <= 0 || fps <= 0 || fps > 1000)
+	{
+		fprintf(stderr, "usage: %s [-n frames] [-r fps] [-s seed]\n", argv[0]);
+		return 2;
+	}
+
+	SIMinit(_sclk, _din, _dc, _cs, _rst);
+	LCDInit(_sclk, _din, _dc, _cs, _rst, 45);
+	LCDclear();
+	LCDdisplay();
+	if (checkCodec(20000))
+	{
+		printf("codec check FAILED\n");
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "/tmp/streambench.%d.sock", (int)getpid());
+	// every flush sent, then the panel flushing at 20 Hz with the mirror limited to -r
+	failed += runStream("unix, every frame", path, frames, 200, 1000);
+	failed += runStream("tcp, every frame", NULL, frames, 200, 1000);
+	failed += runStream("unix, rate limited", path, frames / 4, 20, fps);
+	if (failed)
+	{
+		printf("stream check FAILED\n");
+		return 1;
+	}
+	printf("listener frames match the panel's display RAM\n");
+	return 0;
+}